@@ -41,6 +41,7 @@ knowledge of the CeCILL-B license and that you accept its terms.
 
 #include <isnormal.H>
 #include <mesh.h>
+#include <integrator.h>
 
 namespace OpenMEEG {
 
@@ -245,20 +246,111 @@ namespace OpenMEEG {
         }
 
         Vect3 f(const Vect3& x) const {
-            Vect3 P1part(dotprod(H0p0DivNorm2,x-H0),dotprod(H1p1DivNorm2,x-H1),dotprod(H2p2DivNorm2,x-H2));
-
             // RK: B = n.grad_x(A) with grad_x(A)= q/||^3 - 3r(q.r)/||^5
             const Vect3& r   = x-r0;
             const double rn2 = r.norm2();
             const double EMpart = dotprod(n,q-3*dotprod(q,r)*r/rn2)/(rn2*sqrt(rn2));
 
-            return -EMpart*P1part; // RK: why - sign ?
+            return -EMpart*P1part(x); // RK: why - sign ?
         }
 
-    private:
+    protected:
+
+        Vect3 P1part(const Vect3& x) const {
+            return Vect3(dotprod(H0p0DivNorm2,x-H0),dotprod(H1p1DivNorm2,x-H1),dotprod(H2p2DivNorm2,x-H2));
+        }
 
         Vect3 q, r0;
         Vect3 H0, H1, H2;
         Vect3 H0p0DivNorm2, H1p1DivNorm2, H2p2DivNorm2, n;
     };
+
+    //  Free orientation versions of analyticDipPot and analyticDipPotDer: as these kernels are linear in q,
+    //  f(x)(j) is the value of the original kernel for q = e_j (the three orientations share the distances).
+
+    class OPENMEEG_EXPORT analyticDipPotFree {
+    public:
+
+         analyticDipPotFree(){}
+        ~analyticDipPotFree(){}
+
+        inline void init(const Vect3& _r0) { r0 = _r0; }
+
+        inline Vect3 f(const Vect3& x) const {
+            const Vect3& r = x-r0;
+            const double rn2 = r.norm2();
+            return r/(rn2*sqrt(rn2));
+        }
+
+    private:
+
+        Vect3 r0;
+    };
+
+    class OPENMEEG_EXPORT analyticDipPotDerFree: public analyticDipPotDer {
+    public:
+
+        void init(const Triangle& T,const Vect3& _r0) { analyticDipPotDer::init(T,Vect3(0.0),_r0); }
+
+        Vect3array<3> f(const Vect3& x) const {
+            // RK: B = q.(n-3(n.r)r/||^2)/||^3
+            const Vect3& r   = x-r0;
+            const double rn2 = r.norm2();
+            const Vect3& EMpart = (n-3*dotprod(n,r)*r/rn2)/(rn2*sqrt(rn2));
+            const Vect3& P1 = P1part(x);
+            Vect3array<3> result;
+            for (unsigned j=0;j<3;++j)
+                result(j) = -EMpart(j)*P1;
+            return result;
+        }
+    };
+
+    //  Derivatives of the two previous kernels with respect to the dipole position r0.
+    //  As they depend on r0 through r = x-r0 only, grad_r0 = -grad_r.
+
+    class OPENMEEG_EXPORT analyticDipPotGrad {
+    public:
+
+         analyticDipPotGrad(){}
+        ~analyticDipPotGrad(){}
+
+        inline void init(const Vect3& _q,const Vect3& _r0) {
+            q = _q;
+            r0 = _r0;
+        }
+
+        // RK: grad_r0(A) = -q/||^3 + 3r(q.r)/||^5
+
+        inline Vect3 f(const Vect3& x) const {
+            const Vect3& r = x-r0;
+            const double rn2 = r.norm2();
+            return (3*dotprod(q,r)*r/rn2-q)/(rn2*sqrt(rn2));
+        }
+
+    private:
+
+        Vect3 r0;
+        Vect3 q;
+    };
+
+    //  f(x)(j) is the derivative with respect to r0(j) of analyticDipPotDer::f(x) (one component per P1 basis function).
+
+    class OPENMEEG_EXPORT analyticDipPotDerGrad: public analyticDipPotDer {
+    public:
+
+        Vect3array<3> f(const Vect3& x) const {
+            // RK: B = n.q/||^3 - 3(q.r)(n.r)/||^5, so that
+            //     grad_r(B) = -3((n.q)r+(n.r)q+(q.r)n)/||^5 + 15(q.r)(n.r)r/||^7 and grad_r0(-B) = grad_r(B).
+            const Vect3& r   = x-r0;
+            const double rn2 = r.norm2();
+            const double qr  = dotprod(q,r);
+            const double nr  = dotprod(n,r);
+            const Vect3& gradB = (15*qr*nr/rn2*r-3*(dotprod(n,q)*r+nr*q+qr*n))/(rn2*rn2*sqrt(rn2));
+            const Vect3& P1 = P1part(x);
+            Vect3array<3> result;
+            for (unsigned j=0;j<3;++j)
+                result(j) = gradB(j)*P1;
+            return result;
+        }
+    };
 }
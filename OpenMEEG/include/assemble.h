@@ -44,6 +44,8 @@ knowledge of the CeCILL-B license and that you accept its terms.
 #include <vector.h>
 #include <matrix.h>
 #include <symmatrix.h>
+#include <linop_algebra.h>
+#include <checkpoint.h>
 #include <geometry.h>
 #include <sensors.h>
 
@@ -51,23 +53,64 @@ knowledge of the CeCILL-B license and that you accept its terms.
 
 namespace OpenMEEG {
 
+    /// With an enabled checkpoint, the block of each pair of communicating meshes is saved once computed and the blocks
+    /// already saved by an interrupted assembly are reloaded instead of being recomputed.
+
     class OPENMEEG_EXPORT HeadMat: public SymMatrix {
     public:
-        HeadMat(const Geometry& geo,const unsigned gauss_order=3);
+        HeadMat(const Geometry& geo,const unsigned gauss_order=3,const Checkpoint& checkpoint=Checkpoint());
         virtual ~HeadMat() { };
     };
 
+    /// Deflation of the current barriers of the head matrix (all deflated as one) as the implicit rank-k update
+    /// sum_k c_k*u_k*u_k', u_k being the indicator of the vertices of the k-th outermost mesh and c_k being computed
+    /// from the diagonal of the non deflated head matrix. This costs O(N*k) instead of the O(V^2) explicit update.
+
+    OPENMEEG_EXPORT std::shared_ptr<const LowRankOperator> deflation_operator(const Geometry& geo,const Vector& diagonal);
+
     class OPENMEEG_EXPORT SurfSourceMat: public Matrix {
     public:
         SurfSourceMat(const Geometry& geo,Mesh& sources,const unsigned gauss_order=3);
         virtual ~SurfSourceMat() { };
     };
 
+    /// The dipoles are given either as lines (position,moment), or as lines (position) only. In the latter
+    /// free orientation mode, each location gives 3 consecutive columns, for the unit moments along x, y and z,
+    /// computed together (the distances and the adaptive refinements are shared by the three orientations).
+    /// The same holds for DipSource2MEGMat and DipSource2InternalPotMat.
+
     class OPENMEEG_EXPORT DipSourceMat: public Matrix {
     public:
         DipSourceMat(const Geometry& geo,const Matrix& dipoles,const unsigned gauss_order=3,
                      const bool adapt_rhs=true,const std::string& domain_name="");
         virtual ~DipSourceMat() { };
+
+        /// Number of columns per dipole (3 in free orientation mode, 1 otherwise).
+
+        static unsigned components(const Matrix& dipoles) { return (dipoles.ncol()==3) ? 3 : 1; }
+
+        /// Dipoles with explicit moments: each location of a free orientation file is replaced by the 3 unit dipoles
+        /// along x, y and z (which give the 3 columns of the location). Other dipoles are returned as they are.
+
+        static Matrix oriented(const Matrix& dipoles);
+
+        /// Columns of the dipoles first,...,first+rhs.ncol()/components(dipoles)-1, written to rhs. This is
+        /// sequential, so that blocks of dipoles can be assembled in parallel (the constructor is parallel over the dipoles).
+
+        static void assemble(const Geometry& geo,const Matrix& dipoles,const size_t first,const MatrixView& rhs,
+                             const unsigned gauss_order=3,const bool adapt_rhs=true,const std::string& domain_name="");
+    };
+
+    /// Derivatives of DipSourceMat with respect to the dipole positions: columns 3*i,3*i+1,3*i+2 are the
+    /// derivatives of the i-th column of DipSourceMat along x, y and z. The Jacobian of a leadfield with
+    /// respect to the dipole positions is obtained by using this matrix in place of DipSourceMat.
+    /// With free orientation dipoles, each location thus gives 9 columns.
+
+    class OPENMEEG_EXPORT DipSourceGradMat: public Matrix {
+    public:
+        DipSourceGradMat(const Geometry& geo,const Matrix& dipoles,const unsigned gauss_order=3,
+                         const bool adapt_rhs=true,const std::string& domain_name="");
+        virtual ~DipSourceGradMat() { };
     };
 
     class OPENMEEG_EXPORT EITSourceMat: public Matrix {
@@ -117,6 +160,14 @@ namespace OpenMEEG {
         virtual ~DipSource2MEGMat() { }
     };
 
+    /// Derivatives of DipSource2MEGMat with respect to the dipole positions (same column layout as DipSourceGradMat).
+
+    class OPENMEEG_EXPORT DipSource2MEGGradMat: public Matrix {
+    public:
+        DipSource2MEGGradMat(const Matrix& dipoles,const Sensors& sensors);
+        virtual ~DipSource2MEGGradMat() { }
+    };
+
     class OPENMEEG_EXPORT DipSource2InternalPotMat: public Matrix {
     public:
         DipSource2InternalPotMat(const Geometry& geo,const Matrix& dipoles,
@@ -124,6 +175,15 @@ namespace OpenMEEG {
         virtual ~DipSource2InternalPotMat() { }
     };
 
+    /// Derivatives of DipSource2InternalPotMat with respect to the dipole positions (same column layout as DipSourceGradMat).
+
+    class OPENMEEG_EXPORT DipSource2InternalPotGradMat: public Matrix {
+    public:
+        DipSource2InternalPotGradMat(const Geometry& geo,const Matrix& dipoles,
+                                     const Matrix& points,const std::string& domain_name = "");
+        virtual ~DipSource2InternalPotGradMat() { }
+    };
+
     class OPENMEEG_EXPORT CorticalMat: public Matrix {
     public:
         CorticalMat(const Geometry& geo,const Head2EEGMat& M,const std::string& domain_name="CORTEX",
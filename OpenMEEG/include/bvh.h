@@ -0,0 +1,118 @@
+/*
+Project Name : OpenMEEG
+
+© INRIA and ENPC (contributors: Geoffray ADDE, Maureen CLERC, Alexandre 
+GRAMFORT, Renaud KERIVEN, Jan KYBIC, Perrine LANDREAU, Théodore PAPADOPOULO,
+Emmanuel OLIVI
+Maureen.Clerc.AT.inria.fr, keriven.AT.certis.enpc.fr,
+kybic.AT.fel.cvut.cz, papadop.AT.inria.fr)
+
+The OpenMEEG software is a C++ package for solving the forward/inverse
+problems of electroencephalography and magnetoencephalography.
+
+This software is governed by the CeCILL-B license under French law and
+abiding by the rules of distribution of free software.  You can  use,
+modify and/ or redistribute the software under the terms of the CeCILL-B
+license as circulated by CEA, CNRS and INRIA at the following URL
+"http://www.cecill.info".
+
+As a counterpart to the access to the source code and  rights to copy,
+modify and redistribute granted by the license, users are provided only
+with a limited warranty  and the software's authors,  the holders of the
+economic rights,  and the successive licensors  have only  limited
+liability.
+
+In this respect, the user's attention is drawn to the risks associated
+with loading,  using,  modifying and/or developing or reproducing the
+software by the user in light of its specific status of free software,
+that may mean  that it is complicated to manipulate,  and  that  also
+therefore means  that it is reserved for developers  and  experienced
+professionals having in-depth computer knowledge. Users are therefore
+encouraged to load and test the software's suitability as regards their
+requirements in conditions enabling the security of their systems and/or
+data to be ensured and,  more generally, to use and operate it in the
+same conditions as regards security.
+
+The fact that you are presently reading this means that you have had
+knowledge of the CeCILL-B license and that you accept its terms.
+*/
+
+#pragma once
+
+#include <vector>
+#include <utility>
+
+#include <vect3.h>
+#include <triangle.h>
+
+namespace OpenMEEG {
+
+    /// \brief Bounding volume hierarchy over a set of (oriented) triangles.
+    /// Nodes are axis aligned boxes stored in depth-first order (the left child of a node immediately follows it).
+    /// Each node also carries the first order (dipolar) expansion of the solid angle of its triangles, so that
+    /// the solid angle of a closed surface can be evaluated hierarchically (Barill et al., Fast winding numbers, 2018):
+    /// clusters far enough from the point are replaced by their expansion, the others are opened down to the triangles.
+    /// The hierarchy refers to the triangles and vertices of the meshes, which must not change after its creation.
+
+    class OPENMEEG_EXPORT TriangleBVH {
+    public:
+
+        struct Item {
+            const Triangle* triangle;
+            int             orientation;
+            unsigned        rank = 0;   ///< Position in the sequence given to the constructor.
+        };
+
+        typedef std::vector<Item> Items;
+
+        struct Node {
+            Vect3    lo,hi;     ///< Bounding box.
+            Vect3    center;    ///< Area weighted center of the triangles.
+            Vect3    normal;    ///< Sum of the oriented area vectors of the triangles.
+            double   radius;    ///< Radius of the ball centered at center containing all the triangles.
+            unsigned first;     ///< First item (leaves only).
+            unsigned count;     ///< Number of items (0 for internal nodes).
+            unsigned right;     ///< Index of the right child (internal nodes only).
+
+            bool leaf() const { return count!=0; }
+        };
+
+        typedef std::vector<Node> Nodes;
+
+        typedef std::vector<std::pair<unsigned,unsigned>> Pairs;
+
+        /// Clusters whose distance to the point is larger than FarField times their radius are approximated.
+
+        static constexpr double   FarField = 2.0;
+        static constexpr unsigned LeafSize = 4;
+
+        TriangleBVH(const Items& items);
+
+        const Items& items() const { return tree_items; }
+        const Nodes& nodes() const { return tree_nodes; }
+
+        /// Approximation of the sum of the oriented solid angles of the triangles seen from p.
+        /// Contributions of clusters near p are exact, so the result is exact for points close to the surface.
+
+        double solid_angle(const Vect3& p) const;
+
+        /// Closest triangle to p. Distances and barycentric coordinates (alphas) are those of dist_point_triangle
+        /// and, in case of equality, the first triangle in the original order is chosen, so the result is the
+        /// same as the one of an exhaustive search. \return the item of the closest triangle.
+
+        const Item& closest(const Vect3& p,Vect3& alphas,double& distance) const;
+
+        /// Pairs of items (of this hierarchy and of bvh) whose triangle bounding boxes overlap (broad phase of the
+        /// intersection tests). When bvh is this hierarchy, each pair of distinct items is reported once, the item
+        /// of lowest rank first.
+
+        Pairs overlapping(const TriangleBVH& bvh) const;
+
+    private:
+
+        unsigned build(const unsigned first,const unsigned last);
+
+        Items tree_items;
+        Nodes tree_nodes;
+    };
+}
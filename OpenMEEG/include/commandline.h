@@ -39,10 +39,17 @@ knowledge of the CeCILL-B license and that you accept its terms.
 
 #pragma once
 
+#include <cstdlib>
 #include <iostream>
 #include <iomanip>
 #include <string>
 #include <sstream>
+#include <stdexcept>
+#include <vector>
+
+#ifdef __linux__
+#include <unistd.h>
+#endif
 
 #ifdef WIN32
 #pragma warning( disable : 4530)    //MSVC standard library can't be inlined
@@ -53,6 +60,7 @@ knowledge of the CeCILL-B license and that you accept its terms.
 #endif
 
 #include "OpenMEEGConfigure.h"
+#include "execution_policy.h"
 
 #ifdef USE_OMP
 #include <omp.h>
@@ -166,6 +174,70 @@ namespace OpenMEEG {
         std::cout << display_info.str() << std::endl << std::endl;
     }
 
+    /// \brief Remove the execution options from the command line and apply them as the execution policy:
+    ///     --threads N                  threads of the OpenMP loops
+    ///     --blas-threads N             threads of the dense BLAS/LAPACK calls
+    ///     --bind none|close|spread     pinning of the threads to the cores
+    /// To be called first in main (before print_version, which displays the number of threads). As the binding is read
+    /// by the OpenMP runtime from its environment when it starts, the program is restarted with this environment if the
+    /// runtime was started before (GNU OpenMP, on Linux).
+
+    inline void execution_options(int& argc,char** argv) {
+        const auto count = [](const std::string& value) {
+            if (value.empty() || value.find_first_not_of("0123456789")!=std::string::npos)
+                throw std::invalid_argument("Invalid number of threads "+value+".");
+            return static_cast<unsigned>(std::stoul(value));
+        };
+
+        const std::vector<char*> args(argv,argv+argc+1);
+
+        ExecutionPolicy policy;
+        bool given = false;
+        int nargs = 1;
+        for (int i=1;i<argc;++i) {
+            const std::string arg = argv[i];
+            if (arg!="--threads" && arg!="--blas-threads" && arg!="--bind") {
+                argv[nargs++] = argv[i];
+                continue;
+            }
+            try {
+                if (i+1==argc)
+                    throw std::invalid_argument("Missing value for option "+arg+".");
+                const std::string value = argv[++i];
+                if (arg=="--threads")
+                    policy.threads = count(value);
+                else if (arg=="--blas-threads")
+                    policy.blas_threads = count(value);
+                else
+                    policy.binding = ExecutionPolicy::binding_from_string(value);
+            } catch (const std::exception& e) {
+                std::cerr << "Error: " << e.what() << std::endl;
+                exit(1);
+            }
+            given = true;
+        }
+        argc = nargs;
+        argv[argc] = nullptr;
+
+        //  Restart (once) if the binding set in the environment is not applied by the running OpenMP runtime.
+
+        #ifdef __linux__
+        const bool unset = std::getenv("OMP_PROC_BIND")==nullptr;
+        if (!set_thread_binding(policy.binding) && unset && std::getenv("OMP_PROC_BIND")!=nullptr)
+            execv("/proc/self/exe",args.data());
+        #endif
+
+        if (given)
+            set_execution_policy(policy);
+    }
+
+    inline const char* execution_options_help() {
+        return "   Execution options (anywhere on the command line):\n"
+               "       --threads N: number of threads of the OpenMP loops (assembly, operators).\n"
+               "       --blas-threads N: number of threads of the BLAS/LAPACK (factorizations, products), N=threads by default.\n"
+               "       --bind none|close|spread: pin the threads to the cores (packed or evenly distributed).\n";
+    }
+
 #if 0
     inline bool option(const char *const name, const int argc, char **argv,
                        const bool defaut, const char *const usage=NULL) 
@@ -51,6 +51,23 @@ knowledge of the CeCILL-B license and that you accept its terms.
 namespace OpenMEEG {
 
     double dist_point_cell(const Vect3&, const Triangle& , Vect3&, bool&);
+    OPENMEEG_EXPORT double dist_point_triangle(const Vect3&, const Triangle&, Vect3&, bool&);
     OPENMEEG_EXPORT double dist_point_interface(const Vect3&, const Interface&, Vect3&, Triangle&);
     OPENMEEG_EXPORT std::string dist_point_geom(const Vect3&, const Geometry&, Vect3&, Triangle&, double&);
+
+    /// Closest point on a surface: the triangle, the barycentric coordinates in this triangle and the distance.
+
+    struct ClosestPoint {
+        const Interface* interface;
+        const Triangle*  triangle;
+        Vect3            alphas;
+        double           distance;
+    };
+
+    typedef std::vector<ClosestPoint> ClosestPoints;
+
+    /// Batched (and parallel) versions of dist_point_interface and dist_point_geom for the lines of a n x 3 matrix.
+
+    OPENMEEG_EXPORT ClosestPoints dist_points_interface(const Matrix&, const Interface&);
+    OPENMEEG_EXPORT ClosestPoints dist_points_geom(const Matrix&, const Geometry&);
 }
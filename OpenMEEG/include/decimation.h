@@ -0,0 +1,60 @@
+/*
+Project Name : OpenMEEG
+
+© INRIA and ENPC (contributors: Geoffray ADDE, Maureen CLERC, Alexandre 
+GRAMFORT, Renaud KERIVEN, Jan KYBIC, Perrine LANDREAU, Théodore PAPADOPOULO,
+Emmanuel OLIVI
+Maureen.Clerc.AT.inria.fr, keriven.AT.certis.enpc.fr,
+kybic.AT.fel.cvut.cz, papadop.AT.inria.fr)
+
+The OpenMEEG software is a C++ package for solving the forward/inverse
+problems of electroencephalography and magnetoencephalography.
+
+This software is governed by the CeCILL-B license under French law and
+abiding by the rules of distribution of free software.  You can  use,
+modify and/ or redistribute the software under the terms of the CeCILL-B
+license as circulated by CEA, CNRS and INRIA at the following URL
+"http://www.cecill.info".
+
+As a counterpart to the access to the source code and  rights to copy,
+modify and redistribute granted by the license, users are provided only
+with a limited warranty  and the software's authors,  the holders of the
+economic rights,  and the successive licensors  have only  limited
+liability.
+
+In this respect, the user's attention is drawn to the risks associated
+with loading,  using,  modifying and/or developing or reproducing the
+software by the user in light of its specific status of free software,
+that may mean  that it is complicated to manipulate,  and  that  also
+therefore means  that it is reserved for developers  and  experienced
+professionals having in-depth computer knowledge. Users are therefore
+encouraged to load and test the software's suitability as regards their
+requirements in conditions enabling the security of their systems and/or
+data to be ensured and,  more generally, to use and operate it in the
+same conditions as regards security.
+
+The fact that you are presently reading this means that you have had
+knowledge of the CeCILL-B license and that you accept its terms.
+*/
+
+#pragma once
+
+#include <set>
+#include <vector>
+
+#include <vertex.h>
+#include <triangle.h>
+#include <mesh.h>
+
+namespace OpenMEEG {
+
+    /// \brief Simplify a mesh by successive collapses of its shortest edges, preserving its topology.
+    /// \param mesh the mesh to decimate.
+    /// \param locked vertices which must not be moved (e.g. vertices shared with other meshes).
+    /// \param ratio target ratio between the numbers of triangles of the decimated and original meshes.
+    /// \param points the vertices of the decimated mesh.
+    /// \param triangles the triangles of the decimated mesh (indices in points, with the original orientation).
+
+    OPENMEEG_EXPORT void decimate(const Mesh& mesh,const std::set<const Vertex*>& locked,const double ratio,
+                                  Vertices& points,std::vector<TriangleIndices>& triangles);
+}
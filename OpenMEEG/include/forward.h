@@ -39,26 +39,151 @@ knowledge of the CeCILL-B license and that you accept its terms.
 
 #pragma once
 
+#include <cstdint>
+#include <cmath>
+#include <random>
+#include <string>
+#include <algorithm>
+
+#include "Exceptions.H"
 #include "matrix.h"
+#include "compressed_leadfield.h"
+#include "out_of_core.h"
+#include "execution_policy.h"
+#include "constants.h"
 
 namespace OpenMEEG {
 
+    /// \brief Counter-based gaussian noise: the deviate of index (i,j) is a pure function of the seed and of (i,j).
+    /// The indices go through two SplitMix64 rounds (one per index) to give the counter, whose two hashes are combined
+    /// with the Box-Muller transform. There is no generator state, so the noise can be drawn in any order, by any
+    /// number of threads, and is reproducible for a given seed.
+
+    class CounterNoise {
+    public:
+
+        CounterNoise(const double sigma,const uint64_t seed): level(sigma),key(mix(seed)) { }
+
+        double operator()(const uint64_t i,const uint64_t j) const {
+            const uint64_t counter = mix(mix(key^i)^j);
+            const double u1 = uniform(mix(key^(2*counter)));
+            const double u2 = uniform(mix(key^(2*counter+1)));
+            return level*std::sqrt(-2.0*std::log(u1))*std::cos(2*Pi*u2);
+        }
+
+    private:
+
+        static uint64_t mix(uint64_t x) {
+            x += 0x9E3779B97F4A7C15ULL;
+            x = (x^(x>>30))*0xBF58476D1CE4E5B9ULL;
+            x = (x^(x>>27))*0x94D049BB133111EBULL;
+            return x^(x>>31);
+        }
+
+        // Uniform in (0,1] (53 random bits), so that the log is finite.
+
+        static double uniform(const uint64_t x) { return static_cast<double>((x>>11)+1)*0x1.0p-53; }
+
+        double   level;
+        uint64_t key;
+    };
+
+    /// \brief Simulation of sensor time series G*S+noise, by chunks of consecutive time samples (columns of S).
+    /// The chunks are processed in parallel (one chunk per thread with sequential BLAS), so that each column of the
+    /// result is always computed in the same way and the noise is a CounterNoise: for a given chunk size, the results
+    /// are bit-identical whatever the number of threads. Raw binary (.bin) sources and data files are read and written
+    /// chunk by chunk, so that long recordings never need to fit in memory (only one chunk per thread does).
+    /// GAIN is a Matrix or a CompressedLeadfield.
+
+    template <typename GAIN>
+    class ForwardSimulator {
+    public:
+
+        ForwardSimulator(const GAIN& G,const double noise_level,const uint64_t seed,const size_t chunk=1024):
+            gain(G),noise(noise_level,seed),noisy(noise_level!=0.0),chunk_size(chunk)
+        { }
+
+        Matrix operator()(const Matrix& sources) const {
+            om_assert(sources.nlin()==gain.ncol());
+            Matrix data(gain.nlin(),sources.ncol());
+            simulate(sources.ncol(),
+                     [&](const size_t j0,Matrix& chunk) { copy(sources.view(0,sources.nlin(),j0,chunk.ncol()),chunk.view()); },
+                     [&](const size_t j0,const Matrix& chunk) { copy(chunk.view(),data.view(0,data.nlin(),j0,chunk.ncol())); });
+            return data;
+        }
+
+        /// Streamed simulation, from and to raw binary files.
+
+        void operator()(const std::string& sources_file,const std::string& data_file) const {
+            MatrixFile sources(sources_file,LinOpInfo::FULL);
+            if (sources.nlin()!=gain.ncol())
+                throw maths::BadContent(sources_file,"matrix of "+std::to_string(gain.ncol())+" sources");
+            MatrixFile data(data_file,LinOpInfo::FULL,gain.nlin(),sources.ncol());
+            simulate(sources.ncol(),
+                     [&](const size_t j0,Matrix& chunk) { sources.read_panel(j0,j0+chunk.ncol(),chunk.data()); },
+                     [&](const size_t j0,const Matrix& chunk) { data.write_panel(j0,j0+chunk.ncol(),chunk.data());  });
+        }
+
+    private:
+
+        template <typename Read,typename Write>
+        void simulate(const size_t n_samples,Read read,Write write) const {
+            const size_t n_chunks = (n_samples+chunk_size-1)/chunk_size;
+            const ExecutionStage stage(ExecutionStage::OPENMP_LOOPS);
+            #pragma omp parallel for schedule(dynamic)
+            for (std::ptrdiff_t c=0; c<static_cast<std::ptrdiff_t>(n_chunks); ++c) {
+                const size_t j0 = c*chunk_size;
+                const size_t n  = std::min(chunk_size,n_samples-j0);
+                Matrix sources(gain.ncol(),n);
+                #pragma omp critical(forward_io)
+                read(j0,sources);
+                Matrix data = gain*sources;
+                if (noisy)
+                    for (size_t j=0; j<n; ++j)
+                        for (size_t i=0; i<data.nlin(); ++i)
+                            data(i,j) += noise(i,j0+j);
+                #pragma omp critical(forward_io)
+                write(j0,data);
+            }
+        }
+
+        const GAIN&        gain;
+        const CounterNoise noise;
+        const bool         noisy;
+        const size_t       chunk_size;
+    };
+
     class Forward : public virtual Matrix {
     public:
 
-        Forward(const Matrix& GainMatrix,const Matrix& RealSourcesData,const double NoiseLevel) {
+        /// Without a seed, a fresh one is drawn from std::random_device, so that the noise differs from one call
+        /// to the next: give a seed to obtain reproducible results.
 
-            std::random_device rd{};
-            std::mt19937 gen{rd()};
-            std::normal_distribution<> noise{0,NoiseLevel};
+        Forward(const Matrix& GainMatrix,const Matrix& RealSourcesData,const double NoiseLevel):
+            Forward(GainMatrix,RealSourcesData,NoiseLevel,std::random_device{}())
+        { }
 
-            Matrix& SimulatedData = *this;
-            SimulatedData = GainMatrix*RealSourcesData;
-            for (unsigned i=0; i<SimulatedData.nlin(); ++i)
-                for (unsigned j=0; j<SimulatedData.ncol(); ++j)
-                    SimulatedData(i,j) += noise(gen);
+        Forward(const Matrix& GainMatrix,const Matrix& RealSourcesData,const double NoiseLevel,const uint64_t seed) {
+            simulate(GainMatrix,RealSourcesData,NoiseLevel,seed);
+        }
+
+        /// GAIN is a Matrix or a CompressedLeadfield (not wrapped, the Matrix overloads above are).
+
+        #ifndef SWIG
+        template <typename GAIN>
+        Forward(const GAIN& GainMatrix,const Matrix& RealSourcesData,const double NoiseLevel,const uint64_t seed=std::random_device{}()) {
+            simulate(GainMatrix,RealSourcesData,NoiseLevel,seed);
         }
+        #endif
 
         virtual ~Forward() { }
+
+    private:
+
+        template <typename GAIN>
+        void simulate(const GAIN& GainMatrix,const Matrix& RealSourcesData,const double NoiseLevel,const uint64_t seed) {
+            Matrix& SimulatedData = *this;
+            SimulatedData = ForwardSimulator<GAIN>(GainMatrix,NoiseLevel,seed)(RealSourcesData);
+        }
     };
 }
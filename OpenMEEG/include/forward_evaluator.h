@@ -0,0 +1,171 @@
+/*
+Project Name : OpenMEEG
+
+© INRIA and ENPC (contributors: Geoffray ADDE, Maureen CLERC, Alexandre 
+GRAMFORT, Renaud KERIVEN, Jan KYBIC, Perrine LANDREAU, Théodore PAPADOPOULO,
+Emmanuel OLIVI
+Maureen.Clerc.AT.inria.fr, keriven.AT.certis.enpc.fr,
+kybic.AT.fel.cvut.cz, papadop.AT.inria.fr)
+
+The OpenMEEG software is a C++ package for solving the forward/inverse
+problems of electroencephalography and magnetoencephalography.
+
+This software is governed by the CeCILL-B license under French law and
+abiding by the rules of distribution of free software.  You can  use,
+modify and/ or redistribute the software under the terms of the CeCILL-B
+license as circulated by CEA, CNRS and INRIA at the following URL
+"http://www.cecill.info".
+
+As a counterpart to the access to the source code and  rights to copy,
+modify and redistribute granted by the license, users are provided only
+with a limited warranty  and the software's authors,  the holders of the
+economic rights,  and the successive licensors  have only  limited
+liability.
+
+In this respect, the user's attention is drawn to the risks associated
+with loading,  using,  modifying and/or developing or reproducing the
+software by the user in light of its specific status of free software,
+that may mean  that it is complicated to manipulate,  and  that  also
+therefore means  that it is reserved for developers  and  experienced
+professionals having in-depth computer knowledge. Users are therefore
+encouraged to load and test the software's suitability as regards their
+requirements in conditions enabling the security of their systems and/or
+data to be ensured and,  more generally, to use and operate it in the
+same conditions as regards security.
+
+The fact that you are presently reading this means that you have had
+knowledge of the CeCILL-B license and that you accept its terms.
+*/
+
+#pragma once
+
+#include <vector>
+#include <string>
+#include <memory>
+
+#include <vector.h>
+#include <matrix.h>
+#include <sparse_matrix.h>
+#include <symmatrix.h>
+#include <geometry.h>
+#include <sensors.h>
+
+namespace OpenMEEG {
+
+    /// \brief Sensor-space field of a single dipole, for dipole fitting loops.
+    /// The field is T*rhs(r,q) (+ the direct field for MEG), where T = Head2Sensors*HeadMat^{-1} is the
+    /// transfer matrix and rhs(r,q) is the column that DipSourceMat would compute (with adapt_rhs=false).
+    /// T is split once per domain into the columns reached by the domain boundaries, and the quadrature
+    /// points, weights and normals of the boundary triangles are precomputed, so that an evaluation is a
+    /// loop over the quadrature points followed by one gemv, without any heap allocation.
+    /// The domain of the last dipole location is kept, as fitting loops evaluate several moments at the same location.
+    /// The evaluation uses work buffers owned by the evaluator: use one copy of the evaluator per thread
+    /// (copies share the precomputed data, which is never modified).
+
+    class OPENMEEG_EXPORT ForwardEvaluator {
+    public:
+
+        /// EEG (or any potential based sensors): transfer is the sensors x unknowns matrix Head2EEGMat*HeadMat^{-1}.
+        /// If domain_name is not empty, all the dipoles are assumed to lie in this domain (no point location).
+
+        ForwardEvaluator(const Geometry& geo,const Matrix& transfer,const unsigned gauss_order=3,const std::string& domain_name="");
+
+        /// MEG: transfer is Head2MEGMat*HeadMat^{-1}, the direct field of the dipole on the squids is added.
+
+        ForwardEvaluator(const Geometry& geo,const Matrix& transfer,const Sensors& squids,const unsigned gauss_order=3,const std::string& domain_name="");
+
+        /// Same as above, but the transfer matrix is computed from the head matrix (which is factorized by LAPACK, not inverted).
+
+        ForwardEvaluator(const Geometry& geo,const SymMatrix& HeadMat,const SparseMatrix& Head2EEGMat,const unsigned gauss_order=3,const std::string& domain_name="");
+        ForwardEvaluator(const Geometry& geo,const SymMatrix& HeadMat,const Matrix& Head2MEGMat,const Sensors& squids,const unsigned gauss_order=3,const std::string& domain_name="");
+
+        size_t nb_sensors() const { return shared->n_sensors; }
+
+        /// Field of the dipole (r,q) on the sensors, written to field[0..nb_sensors()).
+        /// Dipoles in a domain of zero conductivity produce a zero field (as in DipSourceMat).
+
+        void evaluate(const Vect3& r,const Vect3& q,double* field);
+
+        void evaluate(const Vect3& r,const Vect3& q,Vector& field) {
+            om_assert(field.size()==nb_sensors());
+            evaluate(r,q,field.data());
+        }
+
+        Vector operator()(const Vect3& r,const Vect3& q) {
+            Vector field(nb_sensors());
+            evaluate(r,q,field.data());
+            return field;
+        }
+
+        /// Same, together with the derivatives of the field with respect to r, written to the nb_sensors() x 3
+        /// column-major array jacobian (the same quadrature pass serves both).
+
+        void evaluate(const Vect3& r,const Vect3& q,double* field,double* jacobian);
+
+        void evaluate(const Vect3& r,const Vect3& q,Vector& field,Matrix& jacobian) {
+            om_assert(field.size()==nb_sensors() && jacobian.nlin()==nb_sensors() && jacobian.ncol()==3);
+            evaluate(r,q,field.data(),jacobian.data());
+        }
+
+    private:
+
+        struct DomainData;
+
+        void init(const Matrix& transfer,const unsigned gauss_order,const std::string& domain_name,const Sensors* squids);
+        const DomainData& rhs(const Vect3& r,const Vect3& q,const bool gradient);
+        void direct_field(const Vect3& r,const Vect3& q,double* field,double* jacobian);
+
+        // Quadrature data of a boundary triangle: points and weights (including the jacobian) and unit normal.
+
+        struct QuadratureTriangle {
+            size_t first;
+            Vect3  normal;
+        };
+
+        // Contribution of a boundary mesh to the right hand side of a domain: the indices are local to the domain.
+
+        struct BoundaryMesh {
+            std::vector<QuadratureTriangle>::size_type first_triangle,nb_triangles;
+            std::vector<unsigned> vertices;  // 3 per triangle
+            std::vector<unsigned> triangles; // empty for current barriers
+            double coeffD;
+            double coeffS;
+        };
+
+        struct DomainData {
+            double conductivity;
+            std::vector<BoundaryMesh> meshes;
+            Matrix transfer; // columns of the global transfer matrix for the unknowns of the domain boundaries
+        };
+
+        // Data computed by the constructors and shared by the copies.
+
+        struct Precomputed {
+            std::ptrdiff_t                  domain_index;  // -1 if the domain is located for each dipole
+            size_t                          n_sensors;
+            unsigned                        n_points;      // quadrature points per triangle
+            size_t                          work_size;
+            std::vector<Vect3>              barycentrics;  // barycentric coordinates of the quadrature points
+            std::vector<Vect3>              points;
+            std::vector<double>             weights;
+            std::vector<QuadratureTriangle> quadrature;
+            std::vector<DomainData>         domains;
+
+            // Direct field (MEG only).
+
+            Matrix squid_positions;
+            Matrix squid_directions; // unit orientations scaled by MagFactor
+            Matrix squid_weights;
+        };
+
+        const Geometry&                    geo;
+        std::shared_ptr<const Precomputed> shared;
+
+        // Per copy data.
+
+        std::vector<double> work;                // right hand side and its 3 derivatives
+        std::vector<double> direct;              // direct field and its 3 derivatives
+        Vect3               last_location;
+        std::ptrdiff_t      last_domain = -1;    // domain of last_location (-1 if none)
+    };
+}
@@ -42,54 +42,69 @@ knowledge of the CeCILL-B license and that you accept its terms.
 #include "matrix.h"
 #include "sparse_matrix.h"
 #include "symmatrix.h"
+#include "product_chain.h"
 #include "geometry.h"
 #include "progressbar.h"
 #include "assemble.h"
-
-#define USE_GMRES 0
-#if USE_GMRES
+#include "matrix_free_headmat.h"
+#include "multigrid.h"
 #include "gmres.h"
-#endif
 
 namespace OpenMEEG {
 
-#if USE_GMRES
+    // Dense copies of the right hand sides, which are then overwritten by the solutions.
+
+    inline Matrix dense_copy(const Matrix& M)       { return Matrix(M,DEEP_COPY); }
+    inline Matrix dense_copy(const SparseMatrix& M) { return Matrix(M);           }
+
+    // Solve X*H = S with LAPACK. The lines of S are solved by panels, so neither S nor X is transposed.
+
+    template <typename SelectionMatrix>
+    Matrix linsolve(const SymMatrix& H,const SelectionMatrix& S) {
+        Matrix res = dense_copy(S);
+        factorize(H).solve_transposed(res);
+        return res;
+    }
+
+    // Same, but H is factorized in place when possible (its content is then lost).
+
+    template <typename SelectionMatrix>
+    Matrix linsolve(SymMatrix&& H,const SelectionMatrix& S) {
+        Matrix res = dense_copy(S);
+        factorize(std::move(H)).solve_transposed(res);
+        return res;
+    }
 
-    // Consider the GMRes solver for problems with dimension>15,000 (3,000 vertices per interface)
+    // The matrix-free head matrix can only be inverted iteratively (restarted GMRes).
+    // The preconditionner can be Jacobi<MatrixFreeHeadMat> or TwoLevelPreconditioner.
 
-    template <typename MATRIX>
-    Matrix linsolve(const SymMatrix& H,const MATRIX& S) {
+    template <typename SelectionMatrix,typename Preconditioner>
+    Matrix linsolve(const MatrixFreeHeadMat& H,const SelectionMatrix& S,const Preconditioner& M,const double tol=1e-7,const unsigned restart=100) {
         Matrix res(S.nlin(),H.nlin());
-        Jacobi<SymMatrix> M(H);    // Jacobi preconditionner
-        #pragma omp parallel for
-        #ifdef OPENMP_UNSIGNED
-        for (unsigned i=0; i<S.nlin(); ++i) {
-        #else
-        for (int i=0; i<static_cast<int>(S.nlin()); ++i) {
-        #endif
+        const unsigned m = std::min(restart,static_cast<unsigned>(H.nlin()));
+        ProgressBar pb(S.nlin());
+        for (unsigned i=0; i<S.nlin(); ++i,++pb) {
+            // The product H*x is already parallel, so right hand sides are processed one at a time.
             Vector vtemp(H.nlin());
-            GMRes(H,M,vtemp,S.getlin(i),1000,1e-7,H.nlin()); // max number of iteration=1000, and precision=1e-7 (1e-5 for faster resolution)
+            if (GMRes(H,M,vtemp,S.getlin(i),1000,tol,m))
+                std::cerr << "Warning: GMRes did not converge for line " << i << '.' << std::endl;
             res.setlin(i,vtemp);
-            #pragma omp critical
-            PROGRESSBAR(i,S.nlin());
         }
-        return res
+        return res;
     }
-#else
+
     template <typename SelectionMatrix>
-    Matrix linsolve(const SymMatrix& H,const SelectionMatrix& S) {
-        Matrix res(S.transpose());
-        H.solveLin(res); // solving the system AX=B with LAPACK
-        return res.transpose();
+    Matrix linsolve(const MatrixFreeHeadMat& H,const SelectionMatrix& S) {
+        const TwoLevelPreconditioner M(H);
+        return linsolve(H,S,M);
     }
-#endif
 
     class GainMEG: public Matrix {
     public:
         using Matrix::operator=;
         GainMEG (const Matrix& GainMat): Matrix(GainMat) {}
         GainMEG(const SymMatrix& HeadMatInv,const Matrix& SourceMat,const Matrix& Head2MEGMat,const Matrix& Source2MEGMat):
-            Matrix(Source2MEGMat+(Head2MEGMat*HeadMatInv)*SourceMat)
+            Matrix(chain(Head2MEGMat)*HeadMatInv*SourceMat+Source2MEGMat)
         { }
         ~GainMEG () {};
     };
@@ -99,24 +114,73 @@ namespace OpenMEEG {
         using Matrix::operator=;
         GainEEG (const Matrix& GainMat): Matrix(GainMat) {}
         GainEEG (const SymMatrix& HeadMatInv,const Matrix& SourceMat,const SparseMatrix& Head2EEGMat):
-            Matrix((Head2EEGMat*HeadMatInv)*SourceMat)
+            Matrix(chain(Head2EEGMat)*HeadMatInv*SourceMat)
         { }
         ~GainEEG () {};
     };
 
+    //  Adjoint gains: the right hand sides of the dipoles are assembled by blocks of AdjointBlockSize dipoles,
+    //  the blocks being processed in parallel, and each block is applied to the adjoint solutions with GEMMs
+    //  (sequential BLAS as the parallelism is across the blocks). apply(first,n,rhs) receives the n columns
+    //  first,...,first+n-1 of the DipSourceMat (3 per dipole in free orientation mode).
+
+    constexpr unsigned AdjointBlockSize = 64;
+
+    template <typename Apply>
+    void adjoint_blocks(const Geometry& geo,const Matrix& dipoles,const size_t size,Apply apply) {
+        const unsigned gauss_order = 3;
+        const unsigned nc          = DipSourceMat::components(dipoles);
+        const size_t   n_dipoles   = dipoles.nlin();
+        const size_t   n_blocks    = (n_dipoles+AdjointBlockSize-1)/AdjointBlockSize;
+
+        const ExecutionStage stage(ExecutionStage::OPENMP_LOOPS);
+        ProgressBar pb(n_blocks);
+        #pragma omp parallel
+        {
+            Matrix rhs(size,nc*AdjointBlockSize);
+            #pragma omp for schedule(dynamic)
+            for (std::ptrdiff_t b=0; b<static_cast<std::ptrdiff_t>(n_blocks); ++b) {
+                const size_t first = b*AdjointBlockSize;
+                const size_t n     = std::min(static_cast<size_t>(AdjointBlockSize),n_dipoles-first);
+                const MatrixView block = rhs.view(0,size,0,nc*n);
+                DipSourceMat::assemble(geo,dipoles,first,block,gauss_order,true,"");
+                apply(nc*first,nc*n,block);
+                #pragma omp critical
+                ++pb;
+            }
+        }
+    }
+
     class GainEEGadjoint: public Matrix {
     public:
 
         using Matrix::operator=;
 
-        GainEEGadjoint(const Geometry& geo,const Matrix& dipoles,const SymMatrix& HeadMat,const SparseMatrix& Head2EEGMat): Matrix(Head2EEGMat.nlin(),dipoles.nlin()) {
-            const Matrix& Hinv = linsolve(HeadMat,Head2EEGMat);
-            const int gauss_order = 3;
-            ProgressBar pb(ncol());
-            for (unsigned i=0; i<ncol(); ++i,++pb)
-                setcol(i,Hinv*DipSourceMat(geo,dipoles.submat(i,1,0,dipoles.ncol()),gauss_order,true,"").getcol(0)); // TODO ugly
+        GainEEGadjoint(const Geometry& geo,const Matrix& dipoles,const SymMatrix& HeadMat,const SparseMatrix& Head2EEGMat): Matrix(Head2EEGMat.nlin(),DipSourceMat::components(dipoles)*dipoles.nlin()) {
+            compute(geo,dipoles,HeadMat,Head2EEGMat);
         }
+
+        //  The head matrix is factorized in place (use std::move when the head matrix is no longer needed).
+
+        GainEEGadjoint(const Geometry& geo,const Matrix& dipoles,SymMatrix&& HeadMat,const SparseMatrix& Head2EEGMat): Matrix(Head2EEGMat.nlin(),DipSourceMat::components(dipoles)*dipoles.nlin()) {
+            compute(geo,dipoles,std::move(HeadMat),Head2EEGMat);
+        }
+
+        GainEEGadjoint(const Geometry& geo,const Matrix& dipoles,const MatrixFreeHeadMat& HeadMat,const SparseMatrix& Head2EEGMat): Matrix(Head2EEGMat.nlin(),DipSourceMat::components(dipoles)*dipoles.nlin()) {
+            compute(geo,dipoles,HeadMat,Head2EEGMat);
+        }
+
         ~GainEEGadjoint () {};
+
+    private:
+
+        template <typename HEADMAT>
+        void compute(const Geometry& geo,const Matrix& dipoles,HEADMAT&& HeadMat,const SparseMatrix& Head2EEGMat) {
+            const Matrix& Hinv = linsolve(std::forward<HEADMAT>(HeadMat),Head2EEGMat);
+            adjoint_blocks(geo,dipoles,Hinv.ncol(),[&](const size_t first,const size_t n,const MatrixView& rhs) {
+                gemm(false,false,1.0,Hinv.view(),rhs,0.0,view(0,nlin(),first,n));
+            });
+        }
     };
 
     class GainMEGadjoint: public Matrix {
@@ -125,46 +189,84 @@ namespace OpenMEEG {
         using Matrix::operator=;
 
         GainMEGadjoint(const Geometry& geo,const Matrix& dipoles,const SymMatrix& HeadMat,const Matrix& Head2MEGMat,const Matrix& Source2MEGMat):
-            Matrix(Head2MEGMat.nlin(),dipoles.nlin()) 
+            Matrix(Head2MEGMat.nlin(),DipSourceMat::components(dipoles)*dipoles.nlin()) 
+        {
+            compute(geo,dipoles,HeadMat,Head2MEGMat,Source2MEGMat);
+        }
+
+        //  The head matrix is factorized in place (use std::move when the head matrix is no longer needed).
+
+        GainMEGadjoint(const Geometry& geo,const Matrix& dipoles,SymMatrix&& HeadMat,const Matrix& Head2MEGMat,const Matrix& Source2MEGMat):
+            Matrix(Head2MEGMat.nlin(),DipSourceMat::components(dipoles)*dipoles.nlin()) 
         {
-            const Matrix& Hinv = linsolve(HeadMat,Head2MEGMat);
-            const int gauss_order = 3;
-            ProgressBar pb(ncol());
-            for (unsigned i=0; i<ncol(); ++i,++pb)
-                setcol(i,Hinv*DipSourceMat(geo,dipoles.submat(i,1,0,dipoles.ncol()),gauss_order,true,"").getcol(0)+Source2MEGMat.getcol(i)); // TODO ugly
+            compute(geo,dipoles,std::move(HeadMat),Head2MEGMat,Source2MEGMat);
         }
+
         ~GainMEGadjoint () {};
+
+    private:
+
+        template <typename HEADMAT>
+        void compute(const Geometry& geo,const Matrix& dipoles,HEADMAT&& HeadMat,const Matrix& Head2MEGMat,const Matrix& Source2MEGMat) {
+            const Matrix& Hinv = linsolve(std::forward<HEADMAT>(HeadMat),Head2MEGMat);
+            adjoint_blocks(geo,dipoles,Hinv.ncol(),[&](const size_t first,const size_t n,const MatrixView& rhs) {
+                const MatrixView leadfield = view(0,nlin(),first,n);
+                copy(Source2MEGMat.view(0,nlin(),first,n),leadfield);
+                gemm(false,false,1.0,Hinv.view(),rhs,1.0,leadfield);
+            });
+        }
     };
 
     class GainEEGMEGadjoint {
     public:
         GainEEGMEGadjoint(const Geometry& geo,const Matrix& dipoles,const SymMatrix& HeadMat,const SparseMatrix& Head2EEGMat,const Matrix& Head2MEGMat,const Matrix& Source2MEGMat):
-            EEGleadfield(Head2EEGMat.nlin(),dipoles.nlin()),MEGleadfield(Head2MEGMat.nlin(),dipoles.nlin())
+            EEGleadfield(Head2EEGMat.nlin(),DipSourceMat::components(dipoles)*dipoles.nlin()),MEGleadfield(Head2MEGMat.nlin(),DipSourceMat::components(dipoles)*dipoles.nlin())
         {
-            Matrix RHS(Head2EEGMat.nlin()+Head2MEGMat.nlin(),HeadMat.nlin());
-            for (unsigned i=0; i<Head2EEGMat.nlin(); ++i) {
-                RHS.setlin(i,Head2EEGMat.getlin(i));
-                RHS.setlin(i+Head2EEGMat.nlin(),Head2MEGMat.getlin(i));
-            }
+            compute(geo,dipoles,HeadMat,Head2EEGMat,Head2MEGMat,Source2MEGMat);
+        }
 
-            const Matrix& Hinv = linsolve(HeadMat,RHS);
+        //  The head matrix is factorized in place (use std::move when the head matrix is no longer needed).
 
-            const unsigned gauss_order = 3;
-            ProgressBar pb(dipoles.nlin());
-            for ( unsigned i=0; i<dipoles.nlin(); ++i,++pb) {
-                Vector dsm = DipSourceMat(geo,dipoles.submat(i, 1, 0, dipoles.ncol()), gauss_order, true, "").getcol(0); // TODO ugly
-                EEGleadfield.setcol(i,Hinv.submat(0,Head2EEGMat.nlin(),0,HeadMat.nlin())*dsm);
-                MEGleadfield.setcol(i,Hinv.submat(Head2EEGMat.nlin(), Head2MEGMat.nlin(),0,HeadMat.nlin())*dsm+Source2MEGMat.getcol(i));
-            }
+        GainEEGMEGadjoint(const Geometry& geo,const Matrix& dipoles,SymMatrix&& HeadMat,const SparseMatrix& Head2EEGMat,const Matrix& Head2MEGMat,const Matrix& Source2MEGMat):
+            EEGleadfield(Head2EEGMat.nlin(),DipSourceMat::components(dipoles)*dipoles.nlin()),MEGleadfield(Head2MEGMat.nlin(),DipSourceMat::components(dipoles)*dipoles.nlin())
+        {
+            compute(geo,dipoles,std::move(HeadMat),Head2EEGMat,Head2MEGMat,Source2MEGMat);
         }
         
         void saveEEG( const std::string filename ) const { EEGleadfield.save(filename); }
         void saveMEG( const std::string filename ) const { MEGleadfield.save(filename); }
+
+        const Matrix& EEG() const { return EEGleadfield; }
+        const Matrix& MEG() const { return MEGleadfield; }
         
         ~GainEEGMEGadjoint () {};
 
     private:
 
+        template <typename HEADMAT>
+        void compute(const Geometry& geo,const Matrix& dipoles,HEADMAT&& HeadMat,const SparseMatrix& Head2EEGMat,const Matrix& Head2MEGMat,const Matrix& Source2MEGMat) {
+            const unsigned n = HeadMat.nlin();
+            Matrix RHS(Head2EEGMat.nlin()+Head2MEGMat.nlin(),n);
+            for (unsigned i=0; i<Head2EEGMat.nlin(); ++i)
+                RHS.setlin(i,Head2EEGMat.getlin(i));
+            for (unsigned i=0; i<Head2MEGMat.nlin(); ++i)
+                RHS.setlin(i+Head2EEGMat.nlin(),Head2MEGMat.getlin(i));
+
+            const Matrix& Hinv = linsolve(std::forward<HEADMAT>(HeadMat),RHS);
+
+            //  Views on the EEG and MEG parts of Hinv: no copy in the dipole loop.
+
+            const ConstMatrixView HinvEEG = Hinv.view(0,Head2EEGMat.nlin(),0,n);
+            const ConstMatrixView HinvMEG = Hinv.view(Head2EEGMat.nlin(),Head2MEGMat.nlin(),0,n);
+
+            adjoint_blocks(geo,dipoles,n,[&](const size_t first,const size_t nb,const MatrixView& rhs) {
+                gemm(false,false,1.0,HinvEEG,rhs,0.0,EEGleadfield.view(0,EEGleadfield.nlin(),first,nb));
+                const MatrixView leadfield = MEGleadfield.view(0,MEGleadfield.nlin(),first,nb);
+                copy(Source2MEGMat.view(0,MEGleadfield.nlin(),first,nb),leadfield);
+                gemm(false,false,1.0,HinvMEG,rhs,1.0,leadfield);
+            });
+        }
+
         Matrix EEGleadfield;
         Matrix MEGleadfield;
     };
@@ -173,7 +275,7 @@ namespace OpenMEEG {
     public:
         using Matrix::operator=;
         GainInternalPot (const SymMatrix& HeadMatInv,const Matrix& SourceMat,const Matrix& Head2IPMat,const Matrix& Source2IPMat):
-            Matrix(Source2IPMat+(Head2IPMat*HeadMatInv)*SourceMat)
+            Matrix(chain(Head2IPMat)*HeadMatInv*SourceMat+Source2IPMat)
         { }
         ~GainInternalPot () {};
     };
@@ -182,7 +284,7 @@ namespace OpenMEEG {
     public:
         using Matrix::operator=;
         GainEITInternalPot (const SymMatrix& HeadMatInv,const Matrix& SourceMat,const Matrix& Head2IPMat):
-            Matrix((Head2IPMat*HeadMatInv)*SourceMat)
+            Matrix(chain(Head2IPMat)*HeadMatInv*SourceMat)
         { }
         ~GainEITInternalPot () {};
     };
@@ -169,6 +169,10 @@ namespace OpenMEEG {
         const Domain& domain(const std::string& name) const; ///< \brief returns the Domain called \param name
         const Domain& domain(const Vect3& p)          const; ///< \brief returns the Domain containing the point p \param p a point
 
+        /// \brief Returns the domains containing each line of \param points (a n x 3 matrix), computed in parallel.
+
+        DomainsReference domains(const Matrix& points) const;
+
         /// \brief  Return the list of domains containing a mesh.
 
         DomainsReference domains(const Mesh& m) const {
@@ -224,6 +228,11 @@ namespace OpenMEEG {
 
         void import(const MeshList& meshes);
 
+        /// \brief Build (in this empty geometry) a coarser version of \param geo with the same domains and conductivities.
+        /// Each mesh is decimated so that its number of triangles is multiplied by \param ratio .
+
+        void coarsen(const Geometry& geo,const double ratio);
+
         void save(const std::string& filename) const;
 
         void finalize(const bool OLD_ORDERING=false) {
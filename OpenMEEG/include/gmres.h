@@ -53,12 +53,19 @@ namespace OpenMEEG {
     template <typename M>
     class Jacobi {
     public:
-        Jacobi (const M& m): J(m.nlin()) { 
+        Jacobi (const M& m): J(m.nlin(),m.nlin()) { 
             for ( unsigned i = 0; i < m.nlin(); ++i) {
                 J(i, i) = 1.0 / m(i,i);
             }
         }
 
+        // For operators which only provide their diagonal (e.g. MatrixFreeHeadMat).
+
+        Jacobi (const Vector& diag): J(diag.nlin(),diag.nlin()) {
+            for (unsigned i=0;i<diag.nlin();++i)
+                J(i,i) = 1.0/diag(i);
+        }
+
         Vector operator()(const Vector& g) const {
             return J*g;
         }
@@ -72,7 +79,7 @@ namespace OpenMEEG {
     // = Define a GMRes solver =
     // =========================
 
-    void GeneratePlaneRotation(double &dx, double &dy, double &cs, double &sn)
+    inline void GeneratePlaneRotation(double &dx, double &dy, double &cs, double &sn)
     {
         if (dy == 0.0) {
             cs = 1.0;
@@ -88,7 +95,7 @@ namespace OpenMEEG {
         }
     }
 
-    void ApplyPlaneRotation(double &dx, double &dy, double &cs, double &sn)
+    inline void ApplyPlaneRotation(double &dx, double &dy, double &cs, double &sn)
     {
         double temp  =  cs * dx + sn * dy;
         dy = -sn * dx + cs * dy;
@@ -141,7 +148,7 @@ namespace OpenMEEG {
             s.set(0.0);
             s(0) = beta;
 
-            for (i = 0; i < m && j <= max_iter; i++, j++) {
+            for (i = 0; i < static_cast<int>(m) && j <= max_iter; i++, j++) {
                 w = M(A*v[i]); //M.solve(A * v[i]);
                 for (k = 0; k <= i; k++) {
                     H(k, i) = w*v[k];
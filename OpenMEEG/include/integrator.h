@@ -71,6 +71,27 @@ namespace OpenMEEG {
             return r;
         }
 
+        inline Vect3array<d> operator+(const Vect3array<d>& v) const {
+            Vect3array<d> r;
+            for (unsigned i=0;i<d;++i)
+                r.t[i] = t[i]+v.t[i];
+            return r;
+        }
+
+        inline Vect3array<d> operator-(const Vect3array<d>& v) const {
+            Vect3array<d> r;
+            for (unsigned i=0;i<d;++i)
+                r.t[i] = t[i]-v.t[i];
+            return r;
+        }
+
+        inline double norm() const {
+            double n2 = 0.0;
+            for (unsigned i=0;i<d;++i)
+                n2 += t[i].norm2();
+            return sqrt(n2);
+        }
+
         inline Vect3  operator()(const int i) const { return t[i]; }
         inline Vect3& operator()(const int i)       { return t[i]; }
     };
@@ -234,6 +255,9 @@ namespace OpenMEEG {
         double norm(const double a) { return fabs(a);  }
         double norm(const Vect3& a) { return a.norm(); }
 
+        template <unsigned d>
+        double norm(const Vect3array<d>& a) { return a.norm(); }
+
         virtual T integrate(const I& fc, const Triangle& triangle) {
             const Vect3 points[3] = { triangle.vertex(0), triangle.vertex(1), triangle.vertex(2) };
             T I0 = base::triangle_integration(fc,points);
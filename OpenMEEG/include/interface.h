@@ -42,10 +42,12 @@ knowledge of the CeCILL-B license and that you accept its terms.
 #include <string>
 #include <sstream>
 #include <vector>
+#include <memory>
 #include <cstdlib>
 #include <ctime>
 #include <om_common.h>
 #include <mesh.h>
+#include <bvh.h>
 
 namespace OpenMEEG {
 
@@ -103,6 +105,10 @@ namespace OpenMEEG {
 
         bool contains(const Vect3& p) const; ///< \param p a point \return true if point is inside interface
 
+        /// \return the bounding volume hierarchy of the interface triangles (built on first use, thread safe).
+
+        const TriangleBVH& bvh() const;
+
         bool is_mesh_orientations_coherent(const bool doublechecked=false); ///< Check the global orientation
 
         /// \return the total number of the interface vertices
@@ -141,6 +147,8 @@ namespace OpenMEEG {
         std::string    interface_name      = "";    ///< interface name is "" by default
         bool           outermost_interface = false; ///< whether or not the interface touches the Air (outermost) domain.
         OrientedMeshes orientedmeshes;
+
+        mutable std::shared_ptr<const TriangleBVH> tree; ///< Cached bvh, reset when orientations change.
     };
 
     /// A vector of Interface is called Interfaces.
@@ -0,0 +1,98 @@
+/*
+Project Name : OpenMEEG
+
+© INRIA and ENPC (contributors: Geoffray ADDE, Maureen CLERC, Alexandre 
+GRAMFORT, Renaud KERIVEN, Jan KYBIC, Perrine LANDREAU, Théodore PAPADOPOULO,
+Emmanuel OLIVI
+Maureen.Clerc.AT.inria.fr, keriven.AT.certis.enpc.fr,
+kybic.AT.fel.cvut.cz, papadop.AT.inria.fr)
+
+The OpenMEEG software is a C++ package for solving the forward/inverse
+problems of electroencephalography and magnetoencephalography.
+
+This software is governed by the CeCILL-B license under French law and
+abiding by the rules of distribution of free software.  You can  use,
+modify and/ or redistribute the software under the terms of the CeCILL-B
+license as circulated by CEA, CNRS and INRIA at the following URL
+"http://www.cecill.info".
+
+As a counterpart to the access to the source code and  rights to copy,
+modify and redistribute granted by the license, users are provided only
+with a limited warranty  and the software's authors,  the holders of the
+economic rights,  and the successive licensors  have only  limited
+liability.
+
+In this respect, the user's attention is drawn to the risks associated
+with loading,  using,  modifying and/or developing or reproducing the
+software by the user in light of its specific status of free software,
+that may mean  that it is complicated to manipulate,  and  that  also
+therefore means  that it is reserved for developers  and  experienced
+professionals having in-depth computer knowledge. Users are therefore
+encouraged to load and test the software's suitability as regards their
+requirements in conditions enabling the security of their systems and/or
+data to be ensured and,  more generally, to use and operate it in the
+same conditions as regards security.
+
+The fact that you are presently reading this means that you have had
+knowledge of the CeCILL-B license and that you accept its terms.
+*/
+
+#pragma once
+
+#include <string>
+
+#include <OpenMEEG_Export.h>
+#include <vector.h>
+#include <matrix.h>
+#include <symmatrix.h>
+
+namespace OpenMEEG {
+
+    /// \brief Linear inverse operator K (sources x sensors) computed from a gain matrix G (sensors x sources,
+    /// e.g. a GainEEG, a GainMEG or the gains of a LeadfieldPipeline, without going through files).
+    /// With free orientations (components=3), the 3 consecutive columns of a location (see DipSourceMat) give
+    /// 3 consecutive lines of K, and the noise normalizations are pooled over them.
+    /// The estimates are K*data, computed by apply() with one GEMM per chunk of time samples (the chunks being
+    /// processed in parallel, as in ForwardSimulator), raw binary files being streamed.
+
+    class OPENMEEG_EXPORT InverseOperator: public Matrix {
+    public:
+
+        using Matrix::operator=;
+
+        Matrix apply(const Matrix& data,const size_t chunk=1024) const;
+        void   apply(const std::string& data_file,const std::string& estimates_file,const size_t chunk=1024) const;
+
+    protected:
+
+        InverseOperator(): Matrix() { }
+    };
+
+    /// \brief Regularized minimum norm estimate (MNE) and its noise normalized versions dSPM (Dale et al, 2000) and
+    /// sLORETA (Pascual-Marqui, 2002). The gain is whitened by the noise covariance (W = C^{-1/2} from the SVD of C,
+    /// identity if not given) and decomposed by a thin SVD, W*G = U*diag(s)*V', so that K = V*diag(s/(s^2+l2))*U'*W.
+    /// lambda2 is 1/SNR^2 relative to the mean squared singular value of the whitened gain, l2 = lambda2*sum(s^2)/rank.
+
+    class OPENMEEG_EXPORT MinimumNormOperator: public InverseOperator {
+    public:
+
+        enum Method { MNE, dSPM, sLORETA };
+
+        MinimumNormOperator(const Matrix& G,const double lambda2,const Method method=MNE,const unsigned components=1);
+        MinimumNormOperator(const Matrix& G,const SymMatrix& noise_covariance,const double lambda2,const Method method=MNE,
+                            const unsigned components=1);
+
+    private:
+
+        void compute(const Matrix& G,const Matrix& whitener,const double lambda2,const Method method,const unsigned components);
+    };
+
+    /// \brief Unit gain LCMV beamformer (Van Veen et al, 1997): w = C^{-1}g/(g'C^{-1}g) for each source (or the 3x3
+    /// block version for free orientations) with the data covariance C regularized by reg*trace(C)/n_sensors on its
+    /// diagonal. C^{-1}G is obtained with a single factorization of C and one solve for all the sources.
+
+    class OPENMEEG_EXPORT LCMVOperator: public InverseOperator {
+    public:
+        LCMVOperator(const Matrix& G,const SymMatrix& data_covariance,const double reg=0.05,const unsigned components=1);
+    };
+}
@@ -0,0 +1,119 @@
+/*
+Project Name : OpenMEEG
+
+© INRIA and ENPC (contributors: Geoffray ADDE, Maureen CLERC, Alexandre 
+GRAMFORT, Renaud KERIVEN, Jan KYBIC, Perrine LANDREAU, Théodore PAPADOPOULO,
+Emmanuel OLIVI
+Maureen.Clerc.AT.inria.fr, keriven.AT.certis.enpc.fr,
+kybic.AT.fel.cvut.cz, papadop.AT.inria.fr)
+
+The OpenMEEG software is a C++ package for solving the forward/inverse
+problems of electroencephalography and magnetoencephalography.
+
+This software is governed by the CeCILL-B license under French law and
+abiding by the rules of distribution of free software.  You can  use,
+modify and/ or redistribute the software under the terms of the CeCILL-B
+license as circulated by CEA, CNRS and INRIA at the following URL
+"http://www.cecill.info".
+
+As a counterpart to the access to the source code and  rights to copy,
+modify and redistribute granted by the license, users are provided only
+with a limited warranty  and the software's authors,  the holders of the
+economic rights,  and the successive licensors  have only  limited
+liability.
+
+In this respect, the user's attention is drawn to the risks associated
+with loading,  using,  modifying and/or developing or reproducing the
+software by the user in light of its specific status of free software,
+that may mean  that it is complicated to manipulate,  and  that  also
+therefore means  that it is reserved for developers  and  experienced
+professionals having in-depth computer knowledge. Users are therefore
+encouraged to load and test the software's suitability as regards their
+requirements in conditions enabling the security of their systems and/or
+data to be ensured and,  more generally, to use and operate it in the
+same conditions as regards security.
+
+The fact that you are presently reading this means that you have had
+knowledge of the CeCILL-B license and that you accept its terms.
+*/
+
+#pragma once
+
+#include <string>
+
+#include <matrix.h>
+#include <symmatrix.h>
+#include <sparse_matrix.h>
+#include <geometry.h>
+#include <sensors.h>
+
+namespace OpenMEEG {
+
+    /// \brief One shot computation of the EEG and/or MEG leadfields of a set of dipoles.
+    /// All the stages (head matrix, source and sensor matrices, solves) are kept in memory and only the gains are
+    /// returned. The direct formulation solves the head system for the source columns (HeadMat^{-1}*DipSourceMat),
+    /// the adjoint one for the sensor lines (as GainEEGadjoint). Neither explicitly inverts the head matrix, which
+    /// is factorized in place. With AUTO, the formulation with the lowest estimated cost is chosen (see cost()).
+    /// Dipoles given by their location only (3 columns) produce 3 columns each, as for DipSourceMat.
+
+    class OPENMEEG_EXPORT LeadfieldPipeline {
+    public:
+
+        enum Method { AUTO, DIRECT, ADJOINT };
+
+        static const char* name(const Method method);
+
+        /// Estimated number of flops of a formulation for N unknowns, n_sensors sensor lines (EEG+MEG) and
+        /// n_sources source columns: the LDLt factorization (N^3/3), the solves (2N^2 per right hand side)
+        /// and the products with the sensor or source side (2*N*n_sensors*n_sources).
+        /// The memory used by the solutions (N*n_sources or N*n_sensors) follows the same ordering.
+
+        static double cost(const Method method,const size_t N,const size_t n_sensors,const size_t n_sources);
+
+        /// The cheapest of DIRECT and ADJOINT.
+
+        static Method choose(const size_t N,const size_t n_sensors,const size_t n_sources) {
+            return (cost(ADJOINT,N,n_sensors,n_sources)<cost(DIRECT,N,n_sensors,n_sources)) ? ADJOINT : DIRECT;
+        }
+
+        /// electrodes and/or squids may be null (no EEG or MEG leadfield). If intermediates is not empty, the
+        /// intermediate matrices actually computed are also saved to files named intermediates+"HeadMat.bin",
+        /// intermediates+"DipSourceMat.bin", ... (the prefix can be a directory, ending with a '/').
+
+        LeadfieldPipeline(const Geometry& geo,const Matrix& dipoles,const Sensors* electrodes,const Sensors* squids,
+                          const Method method=AUTO,const std::string& intermediates="");
+
+        /// Streaming mode, for very large source spaces: the gains are written to the raw binary (.bin) files
+        /// eeg_file and meg_file (for non null electrodes and squids) by blocks of AdjointBlockSize dipoles, each
+        /// block being written as soon as it is computed. Neither the source matrix nor the gains are formed in
+        /// memory, which is bounded by the head matrix (plus the adjoint solutions, sensors x unknowns) and one
+        /// block of columns per thread. EEG() and MEG() are then empty and only the head and sensor matrices
+        /// are saved as intermediates.
+
+        LeadfieldPipeline(const Geometry& geo,const Matrix& dipoles,const Sensors* electrodes,const Sensors* squids,
+                          const std::string& eeg_file,const std::string& meg_file,const Method method=AUTO,
+                          const std::string& intermediates="");
+
+        Method method() const { return used_method; }
+
+        const Matrix& EEG() const { return EEGleadfield; }
+        const Matrix& MEG() const { return MEGleadfield; }
+
+    private:
+
+        //  Head and sensor matrices, common to all the modes.
+
+        struct SystemMatrices {
+            SymMatrix    HM;
+            SparseMatrix H2EM;
+            Matrix       H2MM;
+        };
+
+        SystemMatrices assemble(const Geometry& geo,const Matrix& dipoles,const Sensors* electrodes,const Sensors* squids,
+                                const Method method,const std::string& intermediates);
+
+        Method used_method;
+        Matrix EEGleadfield;
+        Matrix MEGleadfield;
+    };
+}
@@ -0,0 +1,140 @@
+/*
+Project Name : OpenMEEG
+
+© INRIA and ENPC (contributors: Geoffray ADDE, Maureen CLERC, Alexandre 
+GRAMFORT, Renaud KERIVEN, Jan KYBIC, Perrine LANDREAU, Théodore PAPADOPOULO,
+Emmanuel OLIVI
+Maureen.Clerc.AT.inria.fr, keriven.AT.certis.enpc.fr,
+kybic.AT.fel.cvut.cz, papadop.AT.inria.fr)
+
+The OpenMEEG software is a C++ package for solving the forward/inverse
+problems of electroencephalography and magnetoencephalography.
+
+This software is governed by the CeCILL-B license under French law and
+abiding by the rules of distribution of free software.  You can  use,
+modify and/ or redistribute the software under the terms of the CeCILL-B
+license as circulated by CEA, CNRS and INRIA at the following URL
+"http://www.cecill.info".
+
+As a counterpart to the access to the source code and  rights to copy,
+modify and redistribute granted by the license, users are provided only
+with a limited warranty  and the software's authors,  the holders of the
+economic rights,  and the successive licensors  have only  limited
+liability.
+
+In this respect, the user's attention is drawn to the risks associated
+with loading,  using,  modifying and/or developing or reproducing the
+software by the user in light of its specific status of free software,
+that may mean  that it is complicated to manipulate,  and  that  also
+therefore means  that it is reserved for developers  and  experienced
+professionals having in-depth computer knowledge. Users are therefore
+encouraged to load and test the software's suitability as regards their
+requirements in conditions enabling the security of their systems and/or
+data to be ensured and,  more generally, to use and operate it in the
+same conditions as regards security.
+
+The fact that you are presently reading this means that you have had
+knowledge of the CeCILL-B license and that you accept its terms.
+*/
+
+#pragma once
+
+#include <vector>
+
+#include <vector.h>
+#include <matrix.h>
+#include <symmatrix.h>
+#include <sparse_matrix.h>
+#include <linop_algebra.h>
+#include <geometry.h>
+
+namespace OpenMEEG {
+
+    /// \brief Matrix-free version of HeadMat.
+    /// Only the product H*x is available. The entries of the operators S, D, D* and N are recomputed on the fly
+    /// at each product, except for the near-field triangle pairs whose integrals are computed once and cached.
+    /// Memory is thus O(N) (for quasi-uniform meshes) instead of O(N^2) for the assembled HeadMat.
+
+    class OPENMEEG_EXPORT MatrixFreeHeadMat: public ImplicitOperator {
+    public:
+
+        /// Two triangles are in the near field if the distance between their centers is less than
+        /// near_field*(r1+r2), with r1, r2 the radii of the circles centered on the triangle centers
+        /// and containing the triangles. near_field must be at least 1 so that adjacent triangles are cached.
+
+        MatrixFreeHeadMat(const Geometry& geo,const unsigned gauss_order=3,const double near_field=2.0);
+        ~MatrixFreeHeadMat() { }
+
+        size_t      size() const override { return near_field_size(); }
+        void        info() const override;
+        std::string name() const override { return "matrix-free head matrix"; }
+
+        using ImplicitOperator::operator*;
+
+        Vector operator*(const Vector& x) const;
+        Matrix apply(const Matrix& X) const override;
+
+        /// Diagonal of the operator (e.g. for the Jacobi preconditioner).
+
+        const Vector& diagonal() const { return diag; }
+
+        const Geometry& geometry() const { return geo; }
+
+        /// Galerkin projection P'*H*P (e.g. for a coarse grid correction). Each entry of H is projected on the
+        /// fly, so that H*P is never formed: the cost is about that of a product H*x.
+
+        SymMatrix galerkin(const SparseMatrix& P) const;
+
+        size_t near_field_size() const;
+
+    private:
+
+        // Integrals involving a pair of triangles: the S integral and the D integrals of T2 on T1 (D12) and of T1 on T2 (D21).
+
+        struct Kernel {
+            double S;
+            Vect3  D12{};
+            Vect3  D21{};
+        };
+
+        struct NearInteraction {
+            const Triangle* T1;
+            const Triangle* T2;
+            Kernel          kernel;
+        };
+
+        // The contribution of one pair of communicating meshes (see HeadMat::HeadMat).
+
+        struct Block {
+            const Mesh*  mesh1;
+            const Mesh*  mesh2;
+            bool         same_mesh;
+            bool         S;
+            bool         D;
+            bool         Dstar;
+            double       Scoeff;
+            double       Dcoeff;
+            double       Ncoeff;
+            std::vector<NearInteraction> near;
+        };
+
+        bool   is_near(const Triangle& T1,const Triangle& T2) const;
+        Kernel kernel(const Block& block,const Triangle& T1,const Triangle& T2) const;
+
+        template <typename Accumulator>
+        void interaction(const Block& block,const Triangle& T1,const Triangle& T2,const Kernel& kernel,Accumulator& acc) const;
+
+        //  All the interactions (to be called within a parallel region, the iterations are shared by its threads).
+
+        template <typename Accumulator>
+        void interactions(Accumulator& acc) const;
+
+        const Geometry&        geo;
+        unsigned               gauss_order;
+        double                 near_field;
+        std::vector<Block>     blocks;
+        Vector                 diag;
+
+        std::shared_ptr<const LowRankOperator> deflation;
+    };
+}
@@ -71,6 +71,9 @@ namespace OpenMEEG {
 
         typedef std::map<const Vertex*,TrianglesRefs> VertexTriangles;
 
+        typedef std::pair<const Triangle*,const Triangle*> TrianglePair;
+        typedef std::vector<TrianglePair>                  TrianglePairs;
+
         /// Default constructor
         /// or constructor using a provided geometry \param geometry
 
@@ -153,7 +156,10 @@ namespace OpenMEEG {
 
         void info(const bool verbose=false) const; ///< \brief Print mesh information.
         bool has_self_intersection() const; ///< \brief Check whether the mesh self-intersects.
-        bool intersection(const Mesh&) const; ///< \brief Check whether the mesh intersects another mesh.
+        bool intersection(const Mesh&,const bool verbose=false) const; ///< \brief Check whether the mesh intersects another mesh (verbose: print the intersecting pairs).
+
+        TrianglePairs self_intersections() const;       ///< \brief All pairs of intersecting triangles without common vertex.
+        TrianglePairs intersections(const Mesh&) const; ///< \brief All pairs of intersecting triangles with another mesh.
         bool has_correct_orientation() const; ///< \brief Check local orientation of mesh triangles.
         void generate_indices(); ///< \brief Generate indices (if allocate).
         void update(const bool topology_changed); ///< \brief Recompute triangles normals, area, and vertex triangles.
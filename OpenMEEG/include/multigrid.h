@@ -0,0 +1,89 @@
+/*
+Project Name : OpenMEEG
+
+© INRIA and ENPC (contributors: Geoffray ADDE, Maureen CLERC, Alexandre 
+GRAMFORT, Renaud KERIVEN, Jan KYBIC, Perrine LANDREAU, Théodore PAPADOPOULO,
+Emmanuel OLIVI
+Maureen.Clerc.AT.inria.fr, keriven.AT.certis.enpc.fr,
+kybic.AT.fel.cvut.cz, papadop.AT.inria.fr)
+
+The OpenMEEG software is a C++ package for solving the forward/inverse
+problems of electroencephalography and magnetoencephalography.
+
+This software is governed by the CeCILL-B license under French law and
+abiding by the rules of distribution of free software.  You can  use,
+modify and/ or redistribute the software under the terms of the CeCILL-B
+license as circulated by CEA, CNRS and INRIA at the following URL
+"http://www.cecill.info".
+
+As a counterpart to the access to the source code and  rights to copy,
+modify and redistribute granted by the license, users are provided only
+with a limited warranty  and the software's authors,  the holders of the
+economic rights,  and the successive licensors  have only  limited
+liability.
+
+In this respect, the user's attention is drawn to the risks associated
+with loading,  using,  modifying and/or developing or reproducing the
+software by the user in light of its specific status of free software,
+that may mean  that it is complicated to manipulate,  and  that  also
+therefore means  that it is reserved for developers  and  experienced
+professionals having in-depth computer knowledge. Users are therefore
+encouraged to load and test the software's suitability as regards their
+requirements in conditions enabling the security of their systems and/or
+data to be ensured and,  more generally, to use and operate it in the
+same conditions as regards security.
+
+The fact that you are presently reading this means that you have had
+knowledge of the CeCILL-B license and that you accept its terms.
+*/
+
+#pragma once
+
+#include <functional>
+#include <memory>
+
+#include <vector.h>
+#include <symmatrix.h>
+#include <sparse_matrix.h>
+#include <geometry.h>
+#include <matrix_free_headmat.h>
+
+namespace OpenMEEG {
+
+    /// \brief Two-level preconditioner for the iterative resolution of head matrix systems.
+    /// A coarse geometry is obtained by decimating each mesh with a fixed ratio, so that the coarse level scales
+    /// with the fine one. The prolongation P interpolates P1 unknowns with the barycentric coordinates of the
+    /// closest point on the coarse mesh and P0 unknowns with the closest coarse triangle. The coarse operator is
+    /// the Galerkin projection P'*H*P of the fine head matrix H, which is factorized.
+    /// Each application is a V-cycle: a damped Jacobi smoothing, the coarse grid correction of the residual and
+    /// a second smoothing (two products by H). The number of GMRes iterations then stays (roughly) constant when
+    /// the meshes are refined. The coarse matrix is dense: it needs ratio^2 times the memory of the assembled
+    /// head matrix.
+
+    class OPENMEEG_EXPORT TwoLevelPreconditioner {
+    public:
+
+        static constexpr double Damping = 0.6; // Damping of the Jacobi smoothing.
+
+        /// \param ratio the ratio between the numbers of triangles of the coarse and fine meshes.
+
+        TwoLevelPreconditioner(const MatrixFreeHeadMat& H,const double ratio=0.25);
+        TwoLevelPreconditioner(const Geometry& geo,const SymMatrix& H,const double ratio=0.25);
+
+        Vector operator()(const Vector& r) const;
+
+        const Geometry& coarse_geometry() const { return coarse; }
+
+    private:
+
+        void prolongation(const Geometry& geo,const Vector& diagonal,const double ratio);
+
+        std::function<Vector(const Vector&)> product; // Product by the fine head matrix.
+
+        Geometry     coarse;
+        SparseMatrix P;        // Prolongation.
+        SparseMatrix R;        // Restriction (transpose of P).
+        std::shared_ptr<const SymMatrixFactorization> coarse_solver; // Factorization of the coarse head matrix.
+        Vector       invdiag;
+    };
+}
@@ -63,8 +63,16 @@ namespace OpenMEEG {
     void operatorSinternal(const Mesh&,Matrix&,const Vertices&,const double&);
     void operatorDinternal(const Mesh&,Matrix&,const Vertices&,const double&);
     void operatorFerguson(const Vect3&,const Mesh&,Matrix&,const unsigned&,const double&);
-    void operatorDipolePotDer(const Vect3&,const Vect3&,const Mesh&,Vector&,const double&,const unsigned,const bool);
-    void operatorDipolePot   (const Vect3&,const Vect3&,const Mesh&,Vector&,const double&,const unsigned,const bool);
+    //  Dipole operators accumulate into views (e.g. the columns of a right hand side matrix) and keep no shared state,
+    //  so that they can be called concurrently for different dipoles.
+
+    void operatorDipolePotDer(const Vect3&,const Vect3&,const Mesh&,const VectorView&,const double&,const unsigned,const bool);
+    void operatorDipolePot   (const Vect3&,const Vect3&,const Mesh&,const VectorView&,const double&,const unsigned,const bool);
+
+    //  Derivatives of the two previous operators with respect to the dipole position: rhs has 3 columns (d/dx,d/dy,d/dz).
+
+    void operatorDipolePotDerGrad(const Vect3&,const Vect3&,const Mesh&,const MatrixView&,const double&,const unsigned,const bool);
+    void operatorDipolePotGrad   (const Vect3&,const Vect3&,const Mesh&,const MatrixView&,const double&,const unsigned,const bool);
 
     template <template <typename,typename> class Integrator>
     void operatorDipolePot(const Vect3& r0,const Vect3& q,const Mesh& m,Vector& rhs,const double& coeff,const unsigned gauss_order) {
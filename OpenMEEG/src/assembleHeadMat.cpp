@@ -40,6 +40,8 @@ knowledge of the CeCILL-B license and that you accept its terms.
 #define _USE_MATH_DEFINES
 #endif
 
+#include <algorithm>
+
 #include <om_common.h>
 #include <matrix.h>
 #include <symmatrix.h>
@@ -103,7 +105,100 @@ namespace OpenMEEG {
         }
     }
 
-    HeadMat::HeadMat(const Geometry& geo,const unsigned gauss_order) {
+    std::shared_ptr<const LowRankOperator> deflation_operator(const Geometry& geo,const Vector& diagonal) {
+
+        // Same coefficients as deflate(M,geo).
+
+        std::vector<std::pair<const Mesh*,double>> deflated;
+        for (const auto& part : geo.isolated_parts()) {
+            unsigned nb_vertices = 0;
+            unsigned i_first = 0;
+            for (const auto& meshptr : part)
+                if (meshptr->outermost()) {
+                    nb_vertices += meshptr->vertices().size();
+                    if (i_first==0)
+                        i_first = meshptr->vertices().front()->index();
+                }
+            const double coef = diagonal(i_first)/nb_vertices;
+            for (const auto& meshptr : part)
+                if (meshptr->outermost())
+                    deflated.push_back({ meshptr,coef });
+        }
+
+        Matrix U(diagonal.nlin(),deflated.size());
+        Matrix C(deflated.size(),deflated.size());
+        U.set(0.0);
+        C.set(0.0);
+        for (unsigned k=0;k<deflated.size();++k) {
+            for (const auto& vertex : deflated[k].first->vertices())
+                U(vertex->index(),k) = 1.0;
+            C(k,k) = deflated[k].second;
+        }
+
+        return low_rank(U,C);
+    }
+
+    // Indices of the unknowns of a mesh in the head matrix (no triangle unknowns for current barriers).
+
+    static std::vector<unsigned> unknowns(const Mesh& mesh) {
+        std::vector<unsigned> indices;
+        for (const auto& vertex : mesh.vertices())
+            indices.push_back(vertex->index());
+        if (!mesh.current_barrier())
+            for (const auto& triangle : mesh.triangles())
+                indices.push_back(triangle.index());
+        return indices;
+    }
+
+    // Runs of consecutive unknowns in a list of indices: (position in the list, first index, length).
+
+    struct IndexRun { unsigned pos; unsigned first; unsigned length; };
+
+    static std::vector<IndexRun> runs(const std::vector<unsigned>& indices) {
+        std::vector<IndexRun> res;
+        for (unsigned k=0;k<indices.size();++k)
+            if (!res.empty() && indices[k]==res.back().first+res.back().length)
+                ++res.back().length;
+            else
+                res.push_back({ k, indices[k], 1 });
+        return res;
+    }
+
+    // Visits the block of a symmetric matrix selected by rows indices1 and columns indices2 as ranges
+    // which are contiguous in the packed (upper) storage: f(packed,pos1,pos2,stride,length) is called
+    // with the first packed element of the range, the position in the block of its first element,
+    // the block stride (along rows (0) or columns (1)) and the range length.
+
+    template <typename F>
+    static void packed_ranges(SymMatrix& symmatrix,const std::vector<unsigned>& indices1,const std::vector<unsigned>& indices2,F f) {
+        const std::vector<IndexRun>& runs1 = runs(indices1);
+        const std::vector<IndexRun>& runs2 = runs(indices2);
+        double* data = symmatrix.data();
+
+        // Elements with row<=column are stored contiguously along the columns of the block.
+
+        for (unsigned j=0;j<indices2.size();++j) {
+            const size_t c = indices2[j];
+            for (const auto& run : runs1)
+                if (run.first<=c) {
+                    const unsigned len = std::min<size_t>(run.length,c+1-run.first);
+                    f(data+run.first+c*(c+1)/2,run.pos,j,0,len);
+                }
+        }
+
+        // Elements with row>column are stored contiguously along the rows of the block.
+
+        for (unsigned i=0;i<indices1.size();++i) {
+            const size_t r = indices1[i];
+            for (const auto& run : runs2)
+                if (run.first<r) {
+                    const unsigned len = std::min<size_t>(run.length,r-run.first);
+                    f(data+run.first+r*(r+1)/2,i,run.pos,1,len);
+                }
+        }
+    }
+
+    HeadMat::HeadMat(const Geometry& geo,const unsigned gauss_order,const Checkpoint& checkpoint) {
 
         SymMatrix& symmatrix = *this;
 
@@ -113,11 +208,35 @@ namespace OpenMEEG {
 
         // We iterate over pairs of communicating meshes (sharing a domains) to fill the
         // lower half of the HeadMat (since it is symmetric).
+        // The checkpoint of a pair holds its block after its computation: since the pairs are saved in order, the
+        // blocks of the first saved pairs are restored (in order, as blocks may overlap) and the others are computed.
 
+        unsigned pair = 0;
+        bool restore = true;
         for (const auto& mp : geo.communicating_mesh_pairs()) {
             const Mesh& mesh1 = mp(0);
             const Mesh& mesh2 = mp(1);
 
+            const std::string& name = "pair_"+std::to_string(pair++)+".bin";
+            const std::vector<unsigned>& indices1 = unknowns(mesh1);
+            const std::vector<unsigned>& indices2 = unknowns(mesh2);
+
+            restore = restore && checkpoint.exists(name);
+            if (restore) {
+                Matrix block;
+                checkpoint.load(name,block);
+                om_error(block.nlin()==indices1.size() && block.ncol()==indices2.size());
+                packed_ranges(symmatrix,indices1,indices2,
+                              [&](double* packed,const unsigned i,const unsigned j,const unsigned dir,const unsigned len) {
+                                  if (dir==0)
+                                      std::copy_n(&block(i,j),len,packed);
+                                  else
+                                      for (unsigned k=0;k<len;++k)
+                                          packed[k] = block(i,j+k);
+                              });
+                continue;
+            }
+
             const int orientation = mp.relative_orientation();
 
             double Ncoeff = geo.sigma(mesh1,mesh2);
@@ -143,6 +262,19 @@ namespace OpenMEEG {
             // Computing N block
 
             operatorN(mesh1,mesh2,symmatrix,Ncoeff,gauss_order);
+
+            if (checkpoint.enabled()) {
+                Matrix block(indices1.size(),indices2.size());
+                packed_ranges(symmatrix,indices1,indices2,
+                              [&](const double* packed,const unsigned i,const unsigned j,const unsigned dir,const unsigned len) {
+                                  if (dir==0)
+                                      std::copy_n(packed,len,&block(i,j));
+                                  else
+                                      for (unsigned k=0;k<len;++k)
+                                          block(i,j+k) = packed[k];
+                              });
+                checkpoint.save(name,block);
+            }
         }
 
         // Deflate all current barriers as one
@@ -210,10 +342,10 @@ namespace OpenMEEG {
         for (const auto& mesh : geo.meshes())
             if (mesh!=cortex) {
                 for (const auto& vertex : mesh.vertices())
-                    matrix.setlin(iNl++,symmatrix.getlin(vertex->index()));
+                    symmatrix.getlin(vertex->index(),matrix.lin_view(iNl++));
                 if (!mesh.current_barrier())
                     for (const auto& triangle : mesh.triangles())
-                        matrix.setlin(iNl++,symmatrix.getlin(triangle.index()));
+                        symmatrix.getlin(triangle.index(),matrix.lin_view(iNl++));
             }
 
         return matrix;
@@ -239,24 +371,30 @@ namespace OpenMEEG {
 
         const unsigned Nl = geo.nb_parameters()-geo.nb_current_barrier_triangles()-Cortex.nb_vertices()-Cortex.nb_triangles();
         const unsigned Nc = geo.nb_parameters()-geo.nb_current_barrier_triangles();
-        Matrix P;
+        NullSpaceProjector P;
         std::fstream f(filename.c_str());
         if (!f) {
             const Matrix& mat = HeadMatrix(geo,Cortex,gauss_order);
 
-            //  Construct P: the null-space projector.
+            //  Construct P: the null-space projector (only a basis of the row space of mat is stored).
             //  P is a projector: P^2 = P and mat*P*X = 0
 
-            P = nullspace_projector(mat);
+            P = NullSpaceProjector(mat);
             if (filename.length()!=0) {
                 std::cout << "Saving projector P (" << filename << ")." << std::endl;
                 P.save(filename);
             }
         } else {
             std::cout << "Loading projector P (" << filename << ")." << std::endl;
-            P.load(filename);
+
+            //  Older files contain the explicit Nc x Nc projector instead of the tagged basis.
+
+            P = NullSpaceProjector::load(filename);
         }
 
+        if (P.rank()!=Nc-Nl)
+            std::cerr << "Warning: the null space of the head matrix has dimension " << P.rank() << " instead of " << Nc-Nl << std::endl;
+
         // ** Get the gradient of P1&P0 elements on the meshes **
 
         SymMatrix RR(Nc,Nc);
@@ -266,9 +404,8 @@ namespace OpenMEEG {
 
         /// Choose Regularization parameter
 
-        const Matrix MM(M.transpose()*M);
+        const Matrix MM(M.tmult(M));
         SparseMatrix alphas(Nc,Nc); // diagonal matrix
-        Matrix Z;
         double alpha1 = alpha;
         double beta1  = beta;
         if (alpha1<0) { // try an automatic method... TODO find better estimation
@@ -289,16 +426,22 @@ namespace OpenMEEG {
                 for (const auto& triangle : mesh.triangles())
                     alphas(triangle.index(),triangle.index()) = beta1;
 
-        Z = P.transpose()*(MM+alphas*RR)*P;
+        const Matrix A = MM+alphas*RR;
 
         // ** PseudoInverse and return **
         // X = P * { (M*P)' * (M*P) + (R*P)' * (R*P) }¡(-1) * (M*P)'m
         // X = P * { P'*M'*M*P + P'*R'*R*P }¡(-1) * P'*M'm
         // X = P * { P'*(MM + a*RR)*P }¡(-1) * P'*M'm
         // X = P * Z¡(-1) * P' * M'm
+        //
+        // Z = P'*A*P has the rank of P: its pseudo inverse is obtained from a randomized SVD of that rank,
+        // Z being only applied to blocks of vectors (neither P nor Z is formed).
+
+        const BlockOperator Z = [&P,&A](const Matrix& X) { return P*(A*(P*X)); };
+        const TruncatedSVD& Zsvd = randomized_svd(Nc,Nc,Z,Z,P.rank(),Nc*std::numeric_limits<double>::epsilon());
 
-        Matrix rhs = P.transpose()*M.transpose();
-        mat = P*Z.pinverse()*rhs;
+        const Matrix& rhs = P.multt(Matrix(M));
+        mat = P*Zsvd.solve(rhs);
     }
 
     CorticalMat2::CorticalMat2(const Geometry& geo,const Head2EEGMat& M,const std::string& domain_name,
@@ -372,7 +515,11 @@ namespace OpenMEEG {
         std::cout << "gamma = " << gamma << std::endl;
 
         G.invert();
-        mat = (G*H.transpose()*(H*G*H.transpose()).inverse()).submat(0,Nc,Nl,M.nlin());
+
+        //  G is symmetric: G*H^T = (H*G)^T. Only the last M.nlin() columns of the inverse are needed.
+
+        const Matrix& HG = H*G;
+        mat = HG.tmult(HG.multt(H).inverse().submat(0,H.nlin(),Nl,M.nlin()));
     }
 
     Surf2VolMat::Surf2VolMat(const Geometry& geo,const Matrix& points) {
@@ -381,8 +528,9 @@ namespace OpenMEEG {
 
         std::map<const Domain*,Vertices> m_points;
         unsigned index = 0;
+        const Geometry::DomainsReference& domains = geo.domains(points);
         for (unsigned i=0;i<points.nlin();++i) {
-            const Domain& domain = geo.domain(Vect3(points(i,0),points(i,1),points(i,2))); // TODO: see Vertex below....
+            const Domain& domain = *domains[i]; // TODO: see Vertex below....
             if (domain.conductivity()==0.0) {
                 std::cerr << " Surf2Vol: Point [ " << points.getlin(i);
                 std::cerr << "] is inside a non-conductive domain. Point is dropped." << std::endl;
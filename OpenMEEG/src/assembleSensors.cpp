@@ -43,6 +43,7 @@ knowledge of the CeCILL-B license and that you accept its terms.
 #include <sensors.h>
 
 #include <constants.h>
+#include <GeometryExceptions.H>
 #include <sparse_matrix.h>
 
 namespace OpenMEEG {
@@ -60,15 +61,10 @@ namespace OpenMEEG {
 
         mat = SparseMatrix(positions.nlin(),(geo.nb_parameters()-geo.nb_current_barrier_triangles()));
 
-        for (unsigned i=0;i<positions.nlin();++i) {
-            const Vect3 current_position(positions(i,0),positions(i,1),positions(i,2));
-            double dist;
-            Vect3 current_alphas;
-            Triangle current_triangle;
-            dist_point_geom(current_position,geo,current_alphas,current_triangle,dist);
+        const ClosestPoints& closest = dist_points_geom(positions,geo);
+        for (unsigned i=0;i<positions.nlin();++i)
             for (unsigned j=0;j<3;++j)
-                mat(i,current_triangle.vertex(j).index()) = current_alphas(j);
-        }
+                mat(i,closest[i].triangle->vertex(j).index()) = closest[i].alphas(j);
     }
 
     // ECoG positions are reported line by line in the positions Matrix
@@ -83,16 +79,10 @@ namespace OpenMEEG {
 
         mat = SparseMatrix(positions.nlin(),(geo.nb_parameters()-geo.nb_current_barrier_triangles()));
 
-        for (unsigned it=0;it<positions.nlin();++it) {
-            Vect3 current_position;
-            for (unsigned k=0;k<3;++k)
-                current_position(k) = positions(it,k);
-            Vect3 current_alphas;
-            Triangle current_triangle;
-            dist_point_interface(current_position,i,current_alphas,current_triangle);
+        const ClosestPoints& closest = dist_points_interface(positions,i);
+        for (unsigned it=0;it<positions.nlin();++it)
             for (unsigned j=0;j<3;++j)
-                mat(it,current_triangle.vertex(j).index()) = current_alphas(j);
-        }
+                mat(it,closest[it].triangle->vertex(j).index()) = closest[it].alphas(j);
     }
 
     // MEG patches positions are reported line by line in the positions Matrix (same for positions)
@@ -171,13 +161,29 @@ namespace OpenMEEG {
         const Matrix& positions    = sensors.getPositions();
         const Matrix& orientations = sensors.getOrientations();
 
-        if ( dipoles.ncol() != 6) {
-            std::cerr << "Dipoles File Format Error" << std::endl;
-            exit(1);
-        }
+        if ( dipoles.ncol() != 6 && dipoles.ncol() != 3)
+            throw OpenMEEG::BadData("dipoles");
 
         // this Matrix will contain the field generated at the location of the i-th squid by the j-th source
-        mat = Matrix(positions.nlin(),dipoles.nlin());
+        const unsigned nc = DipSourceMat::components(dipoles);
+        mat = Matrix(positions.nlin(),nc*dipoles.nlin());
+
+        // Free orientation: (e_k^d).u = (d^u)_k, so the 3 columns of a location are given by the vector d^u.
+
+        if (nc==3) {
+            for (unsigned i=0;i<mat.nlin();++i)
+                for (unsigned j=0;j<dipoles.nlin();++j) {
+                    const Vect3 r(dipoles(j,0),dipoles(j,1),dipoles(j,2));
+                    const Vect3& diff = Vect3(positions(i,0),positions(i,1),positions(i,2))-r;
+                    const double norm_diff = diff.norm();
+                    const Vect3 direction(orientations(i,0),orientations(i,1),orientations(i,2));
+                    const Vect3& field = (diff^direction)*(MagFactor/(direction.norm()*norm_diff*norm_diff*norm_diff));
+                    for (unsigned k=0;k<3;++k)
+                        mat(i,3*j+k) = field(k);
+                }
+            mat = sensors.getWeightsMatrix()*mat; // Apply weights
+            return;
+        }
 
         // The following routine is the equivalent of operatorFerguson for point-like dipoles.
 
@@ -194,4 +200,36 @@ namespace OpenMEEG {
 
         mat = sensors.getWeightsMatrix()*mat; // Apply weights
     }
+
+    DipSource2MEGGradMat::DipSource2MEGGradMat(const Matrix& dipoles_,const Sensors& sensors) {
+
+        Matrix& mat = *this;
+
+        const Matrix& positions    = sensors.getPositions();
+        const Matrix& orientations = sensors.getOrientations();
+
+        if ( dipoles_.ncol() != 6 && dipoles_.ncol() != 3)
+            throw OpenMEEG::BadData("dipoles");
+        const Matrix& dipoles = DipSourceMat::oriented(dipoles_);
+
+        mat = Matrix(positions.nlin(),3*dipoles.nlin());
+
+        // The field of DipSource2MEGMat is (q^d).u/||d||^3 = (u^q).d/||d||^3 with d = x-r,
+        // so its derivative with respect to r is -(u^q)/||d||^3 + 3((u^q).d)d/||d||^5.
+
+        for (unsigned i=0;i<mat.nlin();++i)
+            for (unsigned j=0;j<dipoles.nlin();++j) {
+                const Vect3 r(dipoles(j,0),dipoles(j,1),dipoles(j,2));
+                const Vect3 q(dipoles(j,3),dipoles(j,4),dipoles(j,5));
+                const Vect3& diff = Vect3(positions(i,0),positions(i,1),positions(i,2))-r;
+                const double norm2_diff = diff.norm2();
+                const Vect3 direction(orientations(i,0),orientations(i,1),orientations(i,2));
+                const Vect3& uq = direction^q;
+                const Vect3& grad = (3*dotprod(uq,diff)/norm2_diff*diff-uq)/(norm2_diff*sqrt(norm2_diff));
+                for (unsigned k=0;k<3;++k)
+                    mat(i,3*j+k) = grad(k)*MagFactor/direction.norm();
+            }
+
+        mat = sensors.getWeightsMatrix()*mat; // Apply weights
+    }
 }
@@ -45,6 +45,7 @@ knowledge of the CeCILL-B license and that you accept its terms.
 #include <sensors.h>
 
 #include <constants.h>
+#include <GeometryExceptions.H>
 
 namespace OpenMEEG {
 
@@ -91,47 +92,188 @@ namespace OpenMEEG {
         }
     }
 
+    //  Right hand side of a single dipole.
+
+    namespace {
+        void dipole_rhs(const Vect3& r,const Vect3& q,const Domain& domain,const VectorView& rhs,
+                        const unsigned gauss_order,const bool adapt_rhs)
+        {
+            const double cond = domain.conductivity();
+            const double K = 1.0/(4*Pi);
+            for (const auto& boundary : domain.boundaries()) { //  Iterate over the domain's interfaces (half-spaces)
+                const double factorD = (boundary.inside()) ? K : -K;
+                for (const auto& oriented_mesh : boundary.interface().oriented_meshes()) { //  Iterate over the meshes of the interface
+                    //  Treat the mesh.
+                    const double coeffD = factorD*oriented_mesh.orientation();
+                    const Mesh&  mesh   = oriented_mesh.mesh();
+                    operatorDipolePotDer(r,q,mesh,rhs,coeffD,gauss_order,adapt_rhs);
+
+                    if (!mesh.current_barrier()) {
+                        const double coeff = -coeffD/cond;
+                        operatorDipolePot(r,q,mesh,rhs,coeff,gauss_order,adapt_rhs);
+                    }
+                }
+            }
+        }
+    }
+
+    //  Same for the three unit dipoles (along x, y and z) at location r, written to the 3 columns of rhs.
+    //  Distances and adaptive refinements are shared by the three orientations.
+
+    namespace {
+        void location_rhs(const Vect3& r,const Domain& domain,const MatrixView& rhs,
+                          const unsigned gauss_order,const bool adapt_rhs)
+        {
+            Integrator<Vect3array<3>,analyticDipPotDerFree>         DPD_gauss;
+            AdaptiveIntegrator<Vect3array<3>,analyticDipPotDerFree> DPD_adaptive(0.001);
+            Integrator<Vect3,analyticDipPotFree>                    DP_gauss;
+            AdaptiveIntegrator<Vect3,analyticDipPotFree>            DP_adaptive(0.001);
+
+            Integrator<Vect3array<3>,analyticDipPotDerFree>& DPD = (adapt_rhs) ? DPD_adaptive : DPD_gauss;
+            Integrator<Vect3,analyticDipPotFree>&            DP  = (adapt_rhs) ? DP_adaptive  : DP_gauss;
+            DPD.setOrder(gauss_order);
+            DP.setOrder(gauss_order);
+
+            analyticDipPotDerFree anaDPD;
+            analyticDipPotFree    anaDP;
+            anaDP.init(r);
+
+            const double cond = domain.conductivity();
+            const double K = 1.0/(4*Pi);
+            for (const auto& boundary : domain.boundaries()) {
+                const double factorD = (boundary.inside()) ? K : -K;
+                for (const auto& oriented_mesh : boundary.interface().oriented_meshes()) {
+                    const double coeffD = factorD*oriented_mesh.orientation();
+                    const Mesh&  mesh   = oriented_mesh.mesh();
+                    for (const auto& triangle : mesh.triangles()) {
+                        anaDPD.init(triangle,r);
+                        const Vect3array<3>& v = DPD.integrate(anaDPD,triangle);
+                        for (unsigned i=0;i<3;++i)
+                            for (unsigned j=0;j<3;++j)
+                                rhs(triangle.vertex(i).index(),j) += v(j)(i)*coeffD;
+                    }
+
+                    if (!mesh.current_barrier()) {
+                        const double coeff = -coeffD/cond;
+                        for (const auto& triangle : mesh.triangles()) {
+                            const Vect3& d = DP.integrate(anaDP,triangle);
+                            for (unsigned j=0;j<3;++j)
+                                rhs(triangle.index(),j) += d(j)*coeff;
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    void DipSourceMat::assemble(const Geometry& geo,const Matrix& dipoles,const size_t first,const MatrixView& rhs,
+                                const unsigned gauss_order,const bool adapt_rhs,const std::string& domain_name)
+    {
+        const unsigned nc = components(dipoles);
+        om_assert(rhs.nlin()==geo.nb_parameters()-geo.nb_current_barrier_triangles() && rhs.ncol()%nc==0 &&
+                  first+rhs.ncol()/nc<=dipoles.nlin());
+
+        for (size_t j=0; j<rhs.ncol()/nc; ++j) {
+            const size_t s = first+j;
+            const Vect3 r(dipoles(s,0),dipoles(s,1),dipoles(s,2));
+
+            const MatrixView columns = rhs.submat(0,rhs.nlin(),nc*j,nc);
+            for (size_t k=0; k<nc; ++k)
+                for (size_t i=0; i<columns.nlin(); ++i)
+                    columns(i,k) = 0.0;
+
+            const Domain& domain = (domain_name=="") ? geo.domain(r) : geo.domain(domain_name);
+
+            //  Only consider dipoles in non-zero conductivity domain.
+
+            if (domain.conductivity()==0.0)
+                continue;
+
+            if (nc==3) {
+                location_rhs(r,domain,columns,gauss_order,adapt_rhs);
+            } else {
+                const Vect3 q(dipoles(s,3),dipoles(s,4),dipoles(s,5));
+                dipole_rhs(r,q,domain,columns.getcol(0),gauss_order,adapt_rhs);
+            }
+        }
+    }
+
+    Matrix DipSourceMat::oriented(const Matrix& dipoles) {
+        if (components(dipoles)==1)
+            return dipoles;
+        Matrix res(3*dipoles.nlin(),6);
+        res.set(0.0);
+        for (unsigned s=0; s<dipoles.nlin(); ++s)
+            for (unsigned k=0; k<3; ++k) {
+                for (unsigned j=0; j<3; ++j)
+                    res(3*s+k,j) = dipoles(s,j);
+                res(3*s+k,3+k) = 1.0;
+            }
+        return res;
+    }
+
     DipSourceMat::DipSourceMat(const Geometry& geo,const Matrix& dipoles,const unsigned gauss_order,
                                const bool adapt_rhs,const std::string& domain_name)
     {
         Matrix& rhs = *this;
 
+        const size_t   size      = geo.nb_parameters()-geo.nb_current_barrier_triangles();
+        const size_t   n_dipoles = dipoles.nlin();
+        const unsigned nc        = components(dipoles);
+
+        rhs = Matrix(size,nc*n_dipoles);
+
+        ProgressBar pb(n_dipoles);
+        #pragma omp parallel for schedule(dynamic)
+        for (std::ptrdiff_t s=0; s<static_cast<std::ptrdiff_t>(n_dipoles); ++s) {
+            assemble(geo,dipoles,s,rhs.view(0,size,nc*s,nc),gauss_order,adapt_rhs,domain_name);
+            #pragma omp critical
+            ++pb;
+        }
+    }
+
+    DipSourceGradMat::DipSourceGradMat(const Geometry& geo,const Matrix& dipoles_,const unsigned gauss_order,
+                                       const bool adapt_rhs,const std::string& domain_name)
+    {
+        Matrix& rhs = *this;
+        const Matrix& dipoles = DipSourceMat::oriented(dipoles_);
+
         const size_t size      = geo.nb_parameters()-geo.nb_current_barrier_triangles();
         const size_t n_dipoles = dipoles.nlin();
 
-        rhs = Matrix(size,n_dipoles);
+        rhs = Matrix(size,3*n_dipoles);
         rhs.set(0.0);
 
+        //  Same loops as DipSourceMat, the 3 derivatives of each dipole being computed in a single pass.
+
         ProgressBar pb(n_dipoles);
-        Vector rhs_col(rhs.nlin());
-        for (unsigned s=0; s<n_dipoles; ++s,++pb) {
+        #pragma omp parallel for schedule(dynamic)
+        for (std::ptrdiff_t s=0; s<static_cast<std::ptrdiff_t>(n_dipoles); ++s) {
             const Vect3 r(dipoles(s,0),dipoles(s,1),dipoles(s,2));
             const Vect3 q(dipoles(s,3),dipoles(s,4),dipoles(s,5));
 
-            const Domain domain = (domain_name=="") ? geo.domain(r) : geo.domain(domain_name);
-
-            //  Only consider dipoles in non-zero conductivity domain.
+            const Domain& domain = (domain_name=="") ? geo.domain(r) : geo.domain(domain_name);
 
             const double cond = domain.conductivity();
             if (cond!=0.0) {
-                rhs_col.set(0.0);
+                const MatrixView rhs_cols = rhs.view(0,size,3*s,3);
                 const double K = 1.0/(4*Pi);
-                for (const auto& boundary : domain.boundaries()) { //  Iterate over the domain's interfaces (half-spaces)
+                for (const auto& boundary : domain.boundaries()) {
                     const double factorD = (boundary.inside()) ? K : -K;
-                    for (const auto& oriented_mesh : boundary.interface().oriented_meshes()) { //  Iterate over the meshes of the interface
-                        //  Treat the mesh.
+                    for (const auto& oriented_mesh : boundary.interface().oriented_meshes()) {
                         const double coeffD = factorD*oriented_mesh.orientation();
                         const Mesh&  mesh   = oriented_mesh.mesh();
-                        operatorDipolePotDer(r,q,mesh,rhs_col,coeffD,gauss_order,adapt_rhs);
+                        operatorDipolePotDerGrad(r,q,mesh,rhs_cols,coeffD,gauss_order,adapt_rhs);
 
                         if (!oriented_mesh.mesh().current_barrier()) {
-                            const double coeff = -coeffD/cond;;
-                            operatorDipolePot(r,q,mesh,rhs_col,coeff,gauss_order,adapt_rhs);
+                            const double coeff = -coeffD/cond;
+                            operatorDipolePotGrad(r,q,mesh,rhs_cols,coeff,gauss_order,adapt_rhs);
                         }
                     }
                 }
-                rhs.setcol(s,rhs_col);
             }
+            #pragma omp critical
+            ++pb;
         }
     }
 
@@ -194,8 +336,9 @@ namespace OpenMEEG {
 
         std::vector<const Domain*> points_domain;
         std::vector<Vect3>   points_;
+        const Geometry::DomainsReference& domains = geo.domains(points);
         for (unsigned i=0; i<points.nlin(); ++i) {
-            const Domain& domain = geo.domain(Vect3(points(i,0),points(i,1),points(i,2)));
+            const Domain& domain = *domains[i];
             if (domain.conductivity()!=0.0) {
                 points_domain.push_back(&domain);
                 points_.push_back(Vect3(points(i,0),points(i,1),points(i,2)));
@@ -205,16 +348,30 @@ namespace OpenMEEG {
             }
         }
         const double K = 1.0/(4*Pi);
-        mat = Matrix(points_.size(), dipoles.nlin());
+        const unsigned nc = DipSourceMat::components(dipoles);
+        mat = Matrix(points_.size(), nc*dipoles.nlin());
         mat.set(0.0);
 
         for (unsigned iDIP=0; iDIP<dipoles.nlin(); ++iDIP) {
             const Vect3 r0(dipoles(iDIP,0), dipoles(iDIP,1), dipoles(iDIP,2));
-            const Vect3  q(dipoles(iDIP,3), dipoles(iDIP,4), dipoles(iDIP,5));
 
             const Domain& domain = (domain_name=="") ? geo.domain(r0) : geo.domain(domain_name);
             const double  cond   = domain.conductivity();
 
+            if (nc==3) {
+                //  Free orientation: the 3 columns of the location.
+                analyticDipPotFree anaDP;
+                anaDP.init(r0);
+                for (unsigned iPTS=0; iPTS<points_.size(); ++iPTS)
+                    if (points_domain[iPTS]==&domain) {
+                        const Vect3& v = anaDP.f(points_[iPTS]);
+                        for (unsigned j=0; j<3; ++j)
+                            mat(iPTS,3*iDIP+j) += K/cond*v(j);
+                    }
+                continue;
+            }
+
+            const Vect3  q(dipoles(iDIP,3), dipoles(iDIP,4), dipoles(iDIP,5));
             static analyticDipPot anaDP;
             anaDP.init(q, r0);
             for (unsigned iPTS=0; iPTS<points_.size(); ++iPTS)
@@ -222,4 +379,49 @@ namespace OpenMEEG {
                     mat(iPTS, iDIP) += K/cond*anaDP.f(points_[iPTS]);
         }
     }
+
+    DipSource2InternalPotGradMat::DipSource2InternalPotGradMat(const Geometry& geo,const Matrix& dipoles_,const Matrix& points,const std::string& domain_name) {
+
+        Matrix& mat = *this;
+
+        if (dipoles_.ncol()!=6 && dipoles_.ncol()!=3)
+            throw OpenMEEG::BadData("dipoles");
+        const Matrix& dipoles = DipSourceMat::oriented(dipoles_);
+
+        //  Points are selected as in DipSource2InternalPotMat.
+
+        std::vector<const Domain*> points_domain;
+        std::vector<Vect3>   points_;
+        const Geometry::DomainsReference& domains = geo.domains(points);
+        for (unsigned i=0; i<points.nlin(); ++i) {
+            const Domain& domain = *domains[i];
+            if (domain.conductivity()!=0.0) {
+                points_domain.push_back(&domain);
+                points_.push_back(Vect3(points(i,0),points(i,1),points(i,2)));
+            } else {
+                std::cerr << " DipSource2InternalPotGrad: Point [ " << points.getlin(i);
+                std::cerr << "] is outside the head. Point is dropped." << std::endl;
+            }
+        }
+        const double K = 1.0/(4*Pi);
+        mat = Matrix(points_.size(),3*dipoles.nlin());
+        mat.set(0.0);
+
+        for (unsigned iDIP=0; iDIP<dipoles.nlin(); ++iDIP) {
+            const Vect3 r0(dipoles(iDIP,0), dipoles(iDIP,1), dipoles(iDIP,2));
+            const Vect3  q(dipoles(iDIP,3), dipoles(iDIP,4), dipoles(iDIP,5));
+
+            const Domain& domain = (domain_name=="") ? geo.domain(r0) : geo.domain(domain_name);
+            const double  cond   = domain.conductivity();
+
+            analyticDipPotGrad anaDPG;
+            anaDPG.init(q, r0);
+            for (unsigned iPTS=0; iPTS<points_.size(); ++iPTS)
+                if (points_domain[iPTS]==&domain) {
+                    const Vect3& grad = anaDPG.f(points_[iPTS]);
+                    for (unsigned j=0; j<3; ++j)
+                        mat(iPTS,3*iDIP+j) += K/cond*grad(j);
+                }
+        }
+    }
 }
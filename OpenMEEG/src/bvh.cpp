@@ -0,0 +1,307 @@
+/*
+Project Name : OpenMEEG
+
+© INRIA and ENPC (contributors: Geoffray ADDE, Maureen CLERC, Alexandre 
+GRAMFORT, Renaud KERIVEN, Jan KYBIC, Perrine LANDREAU, Théodore PAPADOPOULO,
+Emmanuel OLIVI
+Maureen.Clerc.AT.inria.fr, keriven.AT.certis.enpc.fr,
+kybic.AT.fel.cvut.cz, papadop.AT.inria.fr)
+
+The OpenMEEG software is a C++ package for solving the forward/inverse
+problems of electroencephalography and magnetoencephalography.
+
+This software is governed by the CeCILL-B license under French law and
+abiding by the rules of distribution of free software.  You can  use,
+modify and/ or redistribute the software under the terms of the CeCILL-B
+license as circulated by CEA, CNRS and INRIA at the following URL
+"http://www.cecill.info".
+
+As a counterpart to the access to the source code and  rights to copy,
+modify and redistribute granted by the license, users are provided only
+with a limited warranty  and the software's authors,  the holders of the
+economic rights,  and the successive licensors  have only  limited
+liability.
+
+In this respect, the user's attention is drawn to the risks associated
+with loading,  using,  modifying and/or developing or reproducing the
+software by the user in light of its specific status of free software,
+that may mean  that it is complicated to manipulate,  and  that  also
+therefore means  that it is reserved for developers  and  experienced
+professionals having in-depth computer knowledge. Users are therefore
+encouraged to load and test the software's suitability as regards their
+requirements in conditions enabling the security of their systems and/or
+data to be ensured and,  more generally, to use and operate it in the
+same conditions as regards security.
+
+The fact that you are presently reading this means that you have had
+knowledge of the CeCILL-B license and that you accept its terms.
+*/
+
+#include <algorithm>
+#include <limits>
+
+#include <bvh.h>
+#include <danielsson.h>
+
+namespace OpenMEEG {
+
+    namespace {
+
+        Vect3 centroid(const TriangleBVH::Item& item) { return item.triangle->center(); }
+
+        //  Oriented area vector of a triangle.
+
+        Vect3 area_vector(const TriangleBVH::Item& item) {
+            const Triangle& t = *item.triangle;
+            return ((t.vertex(1)-t.vertex(0))^(t.vertex(2)-t.vertex(0)))*(0.5*item.orientation);
+        }
+
+        bool overlap(const Vect3& lo1,const Vect3& hi1,const Vect3& lo2,const Vect3& hi2) {
+            for (unsigned k=0; k<3; ++k)
+                if (lo1(k)>hi2(k) || lo2(k)>hi1(k))
+                    return false;
+            return true;
+        }
+
+        bool overlap(const Triangle& t1,const Triangle& t2) {
+            for (unsigned k=0; k<3; ++k) {
+                const double lo1 = std::min(std::min(t1.vertex(0)(k),t1.vertex(1)(k)),t1.vertex(2)(k));
+                const double hi1 = std::max(std::max(t1.vertex(0)(k),t1.vertex(1)(k)),t1.vertex(2)(k));
+                const double lo2 = std::min(std::min(t2.vertex(0)(k),t2.vertex(1)(k)),t2.vertex(2)(k));
+                const double hi2 = std::max(std::max(t2.vertex(0)(k),t2.vertex(1)(k)),t2.vertex(2)(k));
+                if (lo1>hi2 || lo2>hi1)
+                    return false;
+            }
+            return true;
+        }
+
+        double diagonal(const TriangleBVH::Node& node) { return (node.hi-node.lo).norm2(); }
+
+        //  Distance from p to the bounding box of a node.
+
+        double box_distance(const TriangleBVH::Node& node,const Vect3& p) {
+            double d2 = 0.0;
+            for (unsigned k=0; k<3; ++k) {
+                const double d = std::max(std::max(node.lo(k)-p(k),p(k)-node.hi(k)),0.0);
+                d2 += d*d;
+            }
+            return sqrt(d2);
+        }
+    }
+
+    TriangleBVH::TriangleBVH(const Items& items): tree_items(items) {
+        for (unsigned i=0; i<tree_items.size(); ++i)
+            tree_items[i].rank = i;
+        tree_nodes.reserve(2*(items.size()/LeafSize+1));
+        if (!tree_items.empty())
+            build(0,tree_items.size());
+    }
+
+    unsigned TriangleBVH::build(const unsigned first,const unsigned last) {
+
+        const unsigned index = tree_nodes.size();
+        tree_nodes.push_back(Node());
+
+        //  Bounds and far field expansion of the cluster.
+
+        const double inf = std::numeric_limits<double>::max();
+        Vect3 lo(inf),hi(-inf),clo(inf),chi(-inf),center(0.0),normal(0.0);
+        double weight = 0.0;
+        for (unsigned i=first; i<last; ++i) {
+            const Triangle& t = *tree_items[i].triangle;
+            for (unsigned j=0; j<3; ++j)
+                for (unsigned k=0; k<3; ++k) {
+                    lo(k) = std::min(lo(k),t.vertex(j)(k));
+                    hi(k) = std::max(hi(k),t.vertex(j)(k));
+                }
+            const Vect3& c = centroid(tree_items[i]);
+            for (unsigned k=0; k<3; ++k) {
+                clo(k) = std::min(clo(k),c(k));
+                chi(k) = std::max(chi(k),c(k));
+            }
+            const Vect3& n = area_vector(tree_items[i]);
+            const double w = n.norm();
+            center.multadd(w,c);
+            normal  += n;
+            weight  += w;
+        }
+        center = (weight>0.0) ? center/weight : 0.5*(lo+hi);
+
+        double radius = 0.0;
+        for (unsigned i=first; i<last; ++i)
+            for (unsigned j=0; j<3; ++j)
+                radius = std::max(radius,(tree_items[i].triangle->vertex(j)-center).norm());
+
+        Node& node = tree_nodes[index];
+        node.lo     = lo;
+        node.hi     = hi;
+        node.center = center;
+        node.normal = normal;
+        node.radius = radius;
+        node.first  = first;
+        node.count  = 0;
+        node.right  = 0;
+
+        if (last-first<=LeafSize) {
+            node.count = last-first;
+            return index;
+        }
+
+        //  Median split along the largest extent of the triangle centers.
+
+        unsigned axis = 0;
+        for (unsigned k=1; k<3; ++k)
+            if (chi(k)-clo(k)>chi(axis)-clo(axis))
+                axis = k;
+
+        const unsigned middle = (first+last)/2;
+        std::nth_element(tree_items.begin()+first,tree_items.begin()+middle,tree_items.begin()+last,
+                         [axis](const Item& a,const Item& b) { return centroid(a)(axis)<centroid(b)(axis); });
+
+        build(first,middle);
+        const unsigned right = build(middle,last);
+        tree_nodes[index].right = right; // The node vector may have been reallocated.
+        return index;
+    }
+
+    double TriangleBVH::solid_angle(const Vect3& p) const {
+
+        if (tree_nodes.empty())
+            return 0.0;
+
+        double solangle = 0.0;
+        std::vector<unsigned> stack(1,0);
+        while (!stack.empty()) {
+            const unsigned index = stack.back();
+            const Node&    node  = tree_nodes[index];
+            stack.pop_back();
+
+            //  Far field: the solid angle of a small surface element dS seen from p is (c-p).dS/|c-p|^3.
+
+            const Vect3& r = node.center-p;
+            const double d = r.norm();
+            if (d>FarField*node.radius) {
+                solangle += dotprod(r,node.normal)/(d*d*d);
+                continue;
+            }
+
+            if (node.leaf()) {
+                for (unsigned i=node.first; i<node.first+node.count; ++i) {
+                    const Triangle& t = *tree_items[i].triangle;
+                    solangle += tree_items[i].orientation*p.solid_angle(t.vertex(0),t.vertex(1),t.vertex(2));
+                }
+                continue;
+            }
+
+            stack.push_back(node.right);
+            stack.push_back(index+1);
+        }
+        return solangle;
+    }
+
+    const TriangleBVH::Item& TriangleBVH::closest(const Vect3& p,Vect3& alphas,double& distance) const {
+
+        om_error(!tree_nodes.empty());
+
+        //  Boxes are pruned with a small tolerance so that rounding errors in the distances never discard the
+        //  triangle an exhaustive search would have found.
+
+        const Node& root = tree_nodes.front();
+        const double size = (root.hi-root.lo).norm();
+
+        const Item* best = nullptr;
+        distance = std::numeric_limits<double>::max();
+        std::vector<unsigned> stack(1,0);
+        while (!stack.empty()) {
+            const unsigned index = stack.back();
+            const Node&    node  = tree_nodes[index];
+            stack.pop_back();
+
+            if (best!=nullptr && box_distance(node,p)>distance+1e-10*(distance+size))
+                continue;
+
+            if (node.leaf()) {
+                for (unsigned i=node.first; i<node.first+node.count; ++i) {
+                    bool  inside;
+                    Vect3 alphas_triangle;
+                    const double d = dist_point_triangle(p,*tree_items[i].triangle,alphas_triangle,inside);
+                    if (best==nullptr || d<distance || (d==distance && tree_items[i].rank<best->rank)) {
+                        best     = &tree_items[i];
+                        distance = d;
+                        alphas   = alphas_triangle;
+                    }
+                }
+                continue;
+            }
+
+            //  Visit the nearest child first.
+
+            const unsigned left  = index+1;
+            const unsigned right = node.right;
+            if (box_distance(tree_nodes[left],p)<=box_distance(tree_nodes[right],p)) {
+                stack.push_back(right);
+                stack.push_back(left);
+            } else {
+                stack.push_back(left);
+                stack.push_back(right);
+            }
+        }
+        return *best;
+    }
+
+    TriangleBVH::Pairs TriangleBVH::overlapping(const TriangleBVH& bvh) const {
+
+        Pairs pairs;
+        if (tree_nodes.empty() || bvh.tree_nodes.empty())
+            return pairs;
+
+        //  Simultaneous traversal of both hierarchies. For a self traversal, only the pairs (a,b) of nodes with
+        //  b not in the left of a are visited, so that each pair of items is seen once.
+
+        const bool self = (&bvh==this);
+        std::vector<std::pair<unsigned,unsigned>> stack(1,{ 0, 0 });
+        while (!stack.empty()) {
+            const unsigned a = stack.back().first;
+            const unsigned b = stack.back().second;
+            stack.pop_back();
+
+            const Node& na = tree_nodes[a];
+            const Node& nb = bvh.tree_nodes[b];
+            if (!overlap(na.lo,na.hi,nb.lo,nb.hi))
+                continue;
+
+            if (self && a==b) {
+                if (na.leaf()) {
+                    for (unsigned i=na.first; i<na.first+na.count; ++i)
+                        for (unsigned j=i+1; j<na.first+na.count; ++j)
+                            if (overlap(*tree_items[i].triangle,*tree_items[j].triangle))
+                                pairs.push_back((tree_items[i].rank<tree_items[j].rank) ? std::make_pair(i,j) : std::make_pair(j,i));
+                } else {
+                    stack.push_back({ a+1,      a+1      });
+                    stack.push_back({ a+1,      na.right });
+                    stack.push_back({ na.right, na.right });
+                }
+                continue;
+            }
+
+            if (na.leaf() && nb.leaf()) {
+                for (unsigned i=na.first; i<na.first+na.count; ++i)
+                    for (unsigned j=nb.first; j<nb.first+nb.count; ++j)
+                        if (overlap(*tree_items[i].triangle,*bvh.tree_items[j].triangle))
+                            pairs.push_back((self && tree_items[j].rank<tree_items[i].rank) ? std::make_pair(j,i) : std::make_pair(i,j));
+                continue;
+            }
+
+            //  Descend into the largest node.
+
+            if (nb.leaf() || (!na.leaf() && diagonal(na)>=diagonal(nb))) {
+                stack.push_back({ a+1,      b });
+                stack.push_back({ na.right, b });
+            } else {
+                stack.push_back({ a, b+1      });
+                stack.push_back({ a, nb.right });
+            }
+        }
+        return pairs;
+    }
+}
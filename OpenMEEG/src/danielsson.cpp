@@ -117,44 +117,72 @@ namespace OpenMEEG
         return ( s > 0 ) ? 1 : ( s < 0 ) ? -1: 0;
     }
 
+    //  The closest triangle is found using the bounding volume hierarchy of the interface.
+
     double dist_point_interface(const Vect3& p,const Interface& interface,Vect3& alphas,Triangle& nearestTriangle) {
-        double distmin = std::numeric_limits<double>::max();
-
-        for (const auto& omesh : interface.oriented_meshes())
-            for (const auto& triangle : omesh.mesh().triangles()) {
-                bool  inside;
-                Vect3 alphasLoop;
-                const double distance = dist_point_triangle(p,triangle,alphasLoop,inside);
-                if (distance<distmin) {
-                    distmin = distance;
-                    alphas  = alphasLoop;
-                    nearestTriangle = triangle;
-                }
-            }
+        double distmin;
+        nearestTriangle = *interface.bvh().closest(p,alphas,distmin).triangle;
         return distmin;
     }
 
+    //  Interfaces that touch 0 conductivity domains.
+
+    static std::vector<const Interface*> isolating_interfaces(const Geometry& g) {
+        std::vector<const Interface*> interfaces;
+        for (const auto& domain : g.domains())
+            if (domain.conductivity()==0.0)
+                for (const auto& boundary : domain.boundaries())
+                    interfaces.push_back(&boundary.interface());
+        return interfaces;
+    }
+
+    static ClosestPoint closest_point(const Vect3& p,const std::vector<const Interface*>& interfaces) {
+        ClosestPoint result = { nullptr, nullptr, Vect3(0.0), std::numeric_limits<double>::max() };
+        for (const auto& interface : interfaces) {
+            Vect3  alphas;
+            double distance;
+            const Triangle* triangle = interface->bvh().closest(p,alphas,distance).triangle;
+            if (distance<result.distance)
+                result = { interface, triangle, alphas, distance };
+        }
+        return result;
+    }
+
     //find the closest triangle on the interfaces that touches 0 conductivity
 
     std::string dist_point_geom(const Vect3& p,const Geometry& g,Vect3& alphas,Triangle& nearestTriangle,double& dist) {
+        const ClosestPoint& closest = closest_point(p,isolating_interfaces(g));
+        if (closest.interface==nullptr) {
+            dist = std::numeric_limits<double>::max();
+            return "";
+        }
+        alphas          = closest.alphas;
+        nearestTriangle = *closest.triangle;
+        dist            = closest.distance;
+        return closest.interface->name();
+    }
 
-        double distmin = std::numeric_limits<double>::max();
-        std::string name_nearest_interface;
+    static ClosestPoints dist_points(const Matrix& points,const std::vector<const Interface*>& interfaces) {
 
-        for(const auto& domain : g.domains())
-            if (domain.conductivity()==0.0)
-                for (const auto& boundary : domain.boundaries()) {
-                    Triangle local_nearest_triangle;
-                    const double distance = dist_point_interface(p,boundary.interface(),alphas,local_nearest_triangle);
-                    if (distance<distmin) {
-                        name_nearest_interface = boundary.interface().name();
-                        distmin = distance;
-                        nearestTriangle = local_nearest_triangle;
-                    }
-                }
-
-        dist = distmin;
-        return name_nearest_interface;
+        //  Build the trees before entering the parallel loop.
+
+        for (const auto& interface : interfaces)
+            interface->bvh();
+
+        const std::ptrdiff_t n = points.nlin();
+        ClosestPoints result(n);
+        #pragma omp parallel for schedule(dynamic,64)
+        for (std::ptrdiff_t i=0; i<n; ++i)
+            result[i] = closest_point(Vect3(points(i,0),points(i,1),points(i,2)),interfaces);
+        return result;
+    }
+
+    ClosestPoints dist_points_interface(const Matrix& points,const Interface& interface) {
+        return dist_points(points,{ &interface });
+    }
+
+    ClosestPoints dist_points_geom(const Matrix& points,const Geometry& g) {
+        return dist_points(points,isolating_interfaces(g));
     }
 
 } // end namespace OpenMEEG
@@ -0,0 +1,196 @@
+/*
+Project Name : OpenMEEG
+
+© INRIA and ENPC (contributors: Geoffray ADDE, Maureen CLERC, Alexandre 
+GRAMFORT, Renaud KERIVEN, Jan KYBIC, Perrine LANDREAU, Théodore PAPADOPOULO,
+Emmanuel OLIVI
+Maureen.Clerc.AT.inria.fr, keriven.AT.certis.enpc.fr,
+kybic.AT.fel.cvut.cz, papadop.AT.inria.fr)
+
+The OpenMEEG software is a C++ package for solving the forward/inverse
+problems of electroencephalography and magnetoencephalography.
+
+This software is governed by the CeCILL-B license under French law and
+abiding by the rules of distribution of free software.  You can  use,
+modify and/ or redistribute the software under the terms of the CeCILL-B
+license as circulated by CEA, CNRS and INRIA at the following URL
+"http://www.cecill.info".
+
+As a counterpart to the access to the source code and  rights to copy,
+modify and redistribute granted by the license, users are provided only
+with a limited warranty  and the software's authors,  the holders of the
+economic rights,  and the successive licensors  have only  limited
+liability.
+
+In this respect, the user's attention is drawn to the risks associated
+with loading,  using,  modifying and/or developing or reproducing the
+software by the user in light of its specific status of free software,
+that may mean  that it is complicated to manipulate,  and  that  also
+therefore means  that it is reserved for developers  and  experienced
+professionals having in-depth computer knowledge. Users are therefore
+encouraged to load and test the software's suitability as regards their
+requirements in conditions enabling the security of their systems and/or
+data to be ensured and,  more generally, to use and operate it in the
+same conditions as regards security.
+
+The fact that you are presently reading this means that you have had
+knowledge of the CeCILL-B license and that you accept its terms.
+*/
+
+#include <map>
+#include <algorithm>
+
+#include <decimation.h>
+
+namespace OpenMEEG {
+
+    void decimate(const Mesh& mesh,const std::set<const Vertex*>& locked,const double ratio,
+                  Vertices& points,std::vector<TriangleIndices>& triangles)
+    {
+        // Local copy of the mesh.
+
+        std::map<const Vertex*,unsigned> vindex;
+        std::vector<Vect3> positions;
+        std::vector<bool>  fixed;
+        for (const auto& vertex : mesh.vertices()) {
+            vindex[vertex] = positions.size();
+            positions.push_back(*vertex);
+            fixed.push_back(locked.count(vertex)!=0);
+        }
+
+        std::vector<TriangleIndices> tris;
+        for (const auto& triangle : mesh.triangles())
+            tris.push_back(TriangleIndices(vindex.at(&triangle.vertex(0)),vindex.at(&triangle.vertex(1)),vindex.at(&triangle.vertex(2))));
+
+        std::vector<bool> alive(tris.size(),true);
+        unsigned nb_alive = tris.size();
+        const unsigned target = std::max(4u,static_cast<unsigned>(ratio*tris.size()));
+
+        const auto normal = [](const Vect3& p0,const Vect3& p1,const Vect3& p2) { return crossprod(p1-p0,p2-p0); };
+
+        //  Each pass collapses the shortest edges first. Within a pass, the neighbourhoods of the collapsed
+        //  edges are frozen so that the adjacency computed at the beginning of the pass remains valid.
+
+        while (nb_alive>target) {
+
+            std::vector<std::vector<unsigned>> vertex_triangles(positions.size());
+            for (unsigned i=0;i<tris.size();++i)
+                if (alive[i])
+                    for (unsigned k=0;k<3;++k)
+                        vertex_triangles[tris[i][k]].push_back(i);
+
+            std::vector<std::pair<double,std::pair<unsigned,unsigned>>> edges;
+            for (unsigned i=0;i<tris.size();++i)
+                if (alive[i])
+                    for (unsigned k=0;k<3;++k) {
+                        const unsigned a = tris[i][k];
+                        const unsigned b = tris[i][(k+1)%3];
+                        if (a<b)
+                            edges.push_back({ (positions[a]-positions[b]).norm(),{ a,b } });
+                    }
+            std::sort(edges.begin(),edges.end());
+
+            std::vector<bool> touched(positions.size(),false);
+            unsigned nb_collapses = 0;
+            for (const auto& edge : edges) {
+                if (nb_alive<=target)
+                    break;
+
+                const unsigned a = edge.second.first;
+                const unsigned b = edge.second.second;
+                if (touched[a] || touched[b] || fixed[a] || fixed[b])
+                    continue;
+
+                // Link condition: the edge is shared by two triangles and the endpoints have
+                // exactly two common neighbours (the opposite vertices of these triangles).
+
+                std::vector<unsigned> shared;
+                std::set<unsigned> neighbours_a;
+                std::set<unsigned> neighbours_b;
+                for (const auto& t : vertex_triangles[a]) {
+                    const TriangleIndices& tri = tris[t];
+                    if (tri[0]==b || tri[1]==b || tri[2]==b)
+                        shared.push_back(t);
+                    neighbours_a.insert(tri.indices,tri.indices+3);
+                }
+                for (const auto& t : vertex_triangles[b])
+                    neighbours_b.insert(tris[t].indices,tris[t].indices+3);
+
+                if (shared.size()!=2)
+                    continue;
+
+                std::vector<unsigned> common;
+                std::set_intersection(neighbours_a.begin(),neighbours_a.end(),neighbours_b.begin(),neighbours_b.end(),std::back_inserter(common));
+                if (common.size()!=4) // a, b and the two opposite vertices.
+                    continue;
+
+                bool valid = true;
+                for (const auto& c : common)
+                    if (c!=a && c!=b && vertex_triangles[c].size()<=3)
+                        valid = false;
+
+                // Reject collapses which flip or degenerate a triangle.
+
+                const Vect3 middle = 0.5*(positions[a]+positions[b]);
+                for (const unsigned v : { a, b })
+                    for (const auto& t : vertex_triangles[v]) {
+                        if (!valid)
+                            break;
+                        if (t==shared[0] || t==shared[1])
+                            continue;
+                        Vect3 p[3];
+                        for (unsigned k=0;k<3;++k)
+                            p[k] = (tris[t][k]==v) ? middle : positions[tris[t][k]];
+                        const Vect3& n1 = normal(positions[tris[t][0]],positions[tris[t][1]],positions[tris[t][2]]);
+                        const Vect3& n2 = normal(p[0],p[1],p[2]);
+                        if (dotprod(n1,n2)<=0.5*n1.norm()*n2.norm())
+                            valid = false;
+                    }
+
+                if (!valid)
+                    continue;
+
+                // Collapse b onto a.
+
+                positions[a] = middle;
+                for (const auto& t : shared) {
+                    alive[t] = false;
+                    --nb_alive;
+                }
+                for (const auto& t : vertex_triangles[b])
+                    if (alive[t])
+                        for (unsigned k=0;k<3;++k)
+                            if (tris[t][k]==b)
+                                tris[t][k] = a;
+
+                for (const auto& v : neighbours_a)
+                    touched[v] = true;
+                for (const auto& v : neighbours_b)
+                    touched[v] = true;
+                ++nb_collapses;
+            }
+
+            if (nb_collapses==0)
+                break;
+        }
+
+        // Renumber the remaining vertices.
+
+        std::vector<unsigned> new_index(positions.size(),unsigned(-1));
+        points.clear();
+        triangles.clear();
+        for (unsigned i=0;i<tris.size();++i)
+            if (alive[i]) {
+                TriangleIndices triangle;
+                for (unsigned k=0;k<3;++k) {
+                    const unsigned v = tris[i][k];
+                    if (new_index[v]==unsigned(-1)) {
+                        new_index[v] = points.size();
+                        points.push_back(Vertex(positions[v]));
+                    }
+                    triangle[k] = new_index[v];
+                }
+                triangles.push_back(triangle);
+            }
+    }
+}
@@ -0,0 +1,321 @@
+/*
+Project Name : OpenMEEG
+
+© INRIA and ENPC (contributors: Geoffray ADDE, Maureen CLERC, Alexandre 
+GRAMFORT, Renaud KERIVEN, Jan KYBIC, Perrine LANDREAU, Théodore PAPADOPOULO,
+Emmanuel OLIVI
+Maureen.Clerc.AT.inria.fr, keriven.AT.certis.enpc.fr,
+kybic.AT.fel.cvut.cz, papadop.AT.inria.fr)
+
+The OpenMEEG software is a C++ package for solving the forward/inverse
+problems of electroencephalography and magnetoencephalography.
+
+This software is governed by the CeCILL-B license under French law and
+abiding by the rules of distribution of free software.  You can  use,
+modify and/ or redistribute the software under the terms of the CeCILL-B
+license as circulated by CEA, CNRS and INRIA at the following URL
+"http://www.cecill.info".
+
+As a counterpart to the access to the source code and  rights to copy,
+modify and redistribute granted by the license, users are provided only
+with a limited warranty  and the software's authors,  the holders of the
+economic rights,  and the successive licensors  have only  limited
+liability.
+
+In this respect, the user's attention is drawn to the risks associated
+with loading,  using,  modifying and/or developing or reproducing the
+software by the user in light of its specific status of free software,
+that may mean  that it is complicated to manipulate,  and  that  also
+therefore means  that it is reserved for developers  and  experienced
+professionals having in-depth computer knowledge. Users are therefore
+encouraged to load and test the software's suitability as regards their
+requirements in conditions enabling the security of their systems and/or
+data to be ensured and,  more generally, to use and operate it in the
+same conditions as regards security.
+
+The fact that you are presently reading this means that you have had
+knowledge of the CeCILL-B license and that you accept its terms.
+*/
+
+#include <map>
+#include <algorithm>
+
+#include <forward_evaluator.h>
+#include <integrator.h>
+#include <constants.h>
+
+namespace OpenMEEG {
+
+    namespace {
+
+        //  Transfer matrix Head2Sensors*HeadMat^{-1}, obtained as the solution X of X*HeadMat = Head2Sensors.
+
+        Matrix transfer_matrix(const SymMatrix& HeadMat,const SparseMatrix& Head2Sensors) {
+            Matrix res(Head2Sensors);
+            factorize(HeadMat).solve_transposed(res);
+            return res;
+        }
+
+        Matrix transfer_matrix(const SymMatrix& HeadMat,const Matrix& Head2Sensors) {
+            Matrix res(Head2Sensors,DEEP_COPY);
+            factorize(HeadMat).solve_transposed(res);
+            return res;
+        }
+    }
+
+    ForwardEvaluator::ForwardEvaluator(const Geometry& g,const Matrix& transfer,const unsigned gauss_order,const std::string& domain_name):
+        geo(g)
+    {
+        init(transfer,gauss_order,domain_name,nullptr);
+    }
+
+    ForwardEvaluator::ForwardEvaluator(const Geometry& g,const Matrix& transfer,const Sensors& squids,const unsigned gauss_order,const std::string& domain_name):
+        geo(g)
+    {
+        init(transfer,gauss_order,domain_name,&squids);
+    }
+
+    ForwardEvaluator::ForwardEvaluator(const Geometry& g,const SymMatrix& HeadMat,const SparseMatrix& Head2EEGMat,
+                                       const unsigned gauss_order,const std::string& domain_name):
+        ForwardEvaluator(g,transfer_matrix(HeadMat,Head2EEGMat),gauss_order,domain_name)
+    { }
+
+    ForwardEvaluator::ForwardEvaluator(const Geometry& g,const SymMatrix& HeadMat,const Matrix& Head2MEGMat,const Sensors& squids,
+                                       const unsigned gauss_order,const std::string& domain_name):
+        ForwardEvaluator(g,transfer_matrix(HeadMat,Head2MEGMat),squids,gauss_order,domain_name)
+    { }
+
+    void ForwardEvaluator::init(const Matrix& transfer,const unsigned gauss_order,const std::string& domain_name,const Sensors* squids) {
+
+        om_assert(transfer.ncol()==geo.nb_parameters()-geo.nb_current_barrier_triangles());
+
+        std::shared_ptr<Precomputed> data = std::make_shared<Precomputed>();
+        Precomputed& d = *data;
+
+        d.n_sensors = transfer.nlin();
+
+        //  Same quadrature rule as Integrator (order clamped to the available ones).
+
+        const unsigned order = std::min(gauss_order,3U);
+        d.n_points = nbPts[order];
+        for (unsigned k=0; k<d.n_points; ++k)
+            d.barycentrics.push_back(Vect3(cordBars[order][k][0],cordBars[order][k][1],cordBars[order][k][2]));
+
+        //  Quadrature points of all the triangles of the geometry (meshes may bound several domains).
+
+        std::map<const Mesh*,size_t> first_triangle;
+        for (const auto& mesh : geo.meshes()) {
+            first_triangle[&mesh] = d.quadrature.size();
+            for (const auto& triangle : mesh.triangles()) {
+                const Vect3 p[3] = { triangle.vertex(0), triangle.vertex(1), triangle.vertex(2) };
+                const Vect3& n = (p[1]-p[0])^(p[2]-p[0]);
+                const double S = n.norm();
+                d.quadrature.push_back({ d.points.size(), n/S });
+                for (unsigned k=0; k<d.n_points; ++k) {
+                    Vect3 x(0.0,0.0,0.0);
+                    for (unsigned j=0; j<3; ++j)
+                        x.multadd(cordBars[order][k][j],p[j]);
+                    d.points.push_back(x);
+                    d.weights.push_back(cordBars[order][k][3]*S);
+                }
+            }
+        }
+
+        //  For each domain, the boundary meshes with the coefficients of DipSourceMat, and the transfer
+        //  matrix restricted to the unknowns they reach (renumbered locally).
+
+        const double K = 1.0/(4*Pi);
+        d.work_size = 0;
+        d.domain_index = -1;
+        for (const auto& domain : geo.domains()) {
+            if (domain.name()==domain_name)
+                d.domain_index = d.domains.size();
+
+            //  Build the interface trees used to locate the dipoles now, rather than in the first evaluation.
+
+            for (const auto& boundary : domain.boundaries())
+                boundary.interface().bvh();
+
+            d.domains.push_back(DomainData());
+            DomainData& data = d.domains.back();
+            data.conductivity = domain.conductivity();
+            if (data.conductivity==0.0)
+                continue;
+
+            std::map<unsigned,unsigned> local;
+            const auto local_index = [&local](const unsigned i) {
+                return local.insert(std::make_pair(i,static_cast<unsigned>(local.size()))).first->second;
+            };
+
+            for (const auto& boundary : domain.boundaries()) {
+                const double factorD = (boundary.inside()) ? K : -K;
+                for (const auto& oriented_mesh : boundary.interface().oriented_meshes()) {
+                    const Mesh& mesh = oriented_mesh.mesh();
+                    BoundaryMesh bm;
+                    bm.first_triangle = first_triangle[&mesh];
+                    bm.nb_triangles   = mesh.triangles().size();
+                    bm.coeffD         = factorD*oriented_mesh.orientation();
+                    bm.coeffS         = (mesh.current_barrier()) ? 0.0 : -bm.coeffD/data.conductivity;
+                    for (const auto& triangle : mesh.triangles()) {
+                        for (unsigned i=0; i<3; ++i)
+                            bm.vertices.push_back(local_index(triangle.vertex(i).index()));
+                        if (!mesh.current_barrier())
+                            bm.triangles.push_back(local_index(triangle.index()));
+                    }
+                    data.meshes.push_back(bm);
+                }
+            }
+
+            data.transfer = Matrix(d.n_sensors,local.size());
+            for (const auto& unknown : local)
+                copy(transfer.col_view(unknown.first),data.transfer.col_view(unknown.second));
+            d.work_size = std::max(d.work_size,local.size());
+        }
+
+        if (domain_name!="" && d.domain_index==-1)
+            throw OpenMEEG::BadDomain(domain_name);
+
+        //  MEG: squids data for the direct field.
+
+        if (squids!=nullptr) {
+            const Matrix& positions    = squids->getPositions();
+            const Matrix& orientations = squids->getOrientations();
+
+            d.squid_positions  = Matrix(positions,DEEP_COPY);
+            d.squid_directions = Matrix(orientations.nlin(),3);
+            for (unsigned i=0; i<orientations.nlin(); ++i) {
+                const Vect3 direction(orientations(i,0),orientations(i,1),orientations(i,2));
+                const double scale = MagFactor/direction.norm();
+                for (unsigned j=0; j<3; ++j)
+                    d.squid_directions(i,j) = direction(j)*scale;
+            }
+            d.squid_weights = Matrix(squids->getWeightsMatrix());
+            om_assert(d.squid_weights.nlin()==d.n_sensors && d.squid_weights.ncol()==positions.nlin());
+            direct.resize(4*positions.nlin());
+        }
+
+        work.resize(4*d.work_size);
+        shared = data;
+    }
+
+    //  Right hand side of the dipole restricted to the unknowns of its domain (as in DipSourceMat), and optionally
+    //  its derivatives with respect to r0 (as in DipSourceGradMat) in the next 3 columns of the work buffer.
+
+    const ForwardEvaluator::DomainData& ForwardEvaluator::rhs(const Vect3& r0,const Vect3& q,const bool gradient) {
+
+        const Precomputed& d = *shared;
+
+        //  The domain is only located (with the interface trees) when the dipole moves.
+
+        if (d.domain_index==-1 && (last_domain==-1 || !(r0==last_location))) {
+            last_domain   = &geo.domain(r0)-&geo.domains().front();
+            last_location = r0;
+        }
+        const DomainData& data = d.domains[(d.domain_index!=-1) ? d.domain_index : last_domain];
+        if (data.conductivity==0.0)
+            return data;
+
+        const size_t n = data.transfer.ncol();
+        std::fill(work.begin(),work.begin()+((gradient) ? 4*n : n),0.0);
+        double* dwork[3] = { work.data()+n, work.data()+2*n, work.data()+3*n };
+
+        //  Integrals of analyticDipPotDer (P1 basis) and analyticDipPot (P0 basis) over each boundary triangle,
+        //  and of analyticDipPotDerGrad and analyticDipPotGrad.
+
+        for (const auto& bm : data.meshes) {
+            const bool potential = !bm.triangles.empty();
+            for (size_t t=0; t<bm.nb_triangles; ++t) {
+                const QuadratureTriangle& triangle = d.quadrature[bm.first_triangle+t];
+                const Vect3& n = triangle.normal;
+                Vect3  der(0.0,0.0,0.0);
+                double pot = 0.0;
+                Vect3  dder[3] = { Vect3(0.0), Vect3(0.0), Vect3(0.0) };
+                Vect3  dpot(0.0,0.0,0.0);
+                for (unsigned k=0; k<d.n_points; ++k) {
+                    const Vect3& r     = d.points[triangle.first+k]-r0;
+                    const double rn2   = r.norm2();
+                    const double inv   = d.weights[triangle.first+k]/(rn2*sqrt(rn2));
+                    const double qr    = dotprod(q,r);
+                    const double EMpart = dotprod(n,q-3*qr*r/rn2)*inv;
+                    der.multadd(-EMpart,d.barycentrics[k]);
+                    pot += qr*inv;
+                    if (gradient) {
+                        const double nr = dotprod(n,r);
+                        const Vect3& gradB = (15*qr*nr/rn2*r-3*(dotprod(n,q)*r+nr*q+qr*n))*(inv/rn2);
+                        for (unsigned j=0; j<3; ++j)
+                            dder[j].multadd(gradB(j),d.barycentrics[k]);
+                        dpot.multadd(inv,3*qr*r/rn2-q);
+                    }
+                }
+                for (unsigned i=0; i<3; ++i) {
+                    const unsigned v = bm.vertices[3*t+i];
+                    work[v] += bm.coeffD*der(i);
+                    if (gradient)
+                        for (unsigned j=0; j<3; ++j)
+                            dwork[j][v] += bm.coeffD*dder[j](i);
+                }
+                if (potential) {
+                    const unsigned tr = bm.triangles[t];
+                    work[tr] += bm.coeffS*pot;
+                    if (gradient)
+                        for (unsigned j=0; j<3; ++j)
+                            dwork[j][tr] += bm.coeffS*dpot(j);
+                }
+            }
+        }
+        return data;
+    }
+
+    void ForwardEvaluator::evaluate(const Vect3& r0,const Vect3& q,double* field) {
+        const DomainData& data = rhs(r0,q,false);
+        const size_t n_sensors = shared->n_sensors;
+        const VectorView result(field,n_sensors);
+        if (data.conductivity==0.0) {
+            std::fill(field,field+n_sensors,0.0);
+        } else {
+            gemv(false,1.0,data.transfer.view(),VectorView(work.data(),data.transfer.ncol()),0.0,result);
+        }
+
+        if (shared->squid_positions.nlin()!=0)
+            direct_field(r0,q,field,nullptr);
+    }
+
+    void ForwardEvaluator::evaluate(const Vect3& r0,const Vect3& q,double* field,double* jacobian) {
+        const DomainData& data = rhs(r0,q,true);
+        const size_t n_sensors = shared->n_sensors;
+        if (data.conductivity==0.0) {
+            std::fill(field,field+n_sensors,0.0);
+            std::fill(jacobian,jacobian+3*n_sensors,0.0);
+        } else {
+            const size_t n = data.transfer.ncol();
+            gemv(false,1.0,data.transfer.view(),VectorView(work.data(),n),0.0,VectorView(field,n_sensors));
+            gemm(false,false,1.0,data.transfer.view(),MatrixView(work.data()+n,n,3,n),0.0,MatrixView(jacobian,n_sensors,3,n_sensors));
+        }
+
+        if (shared->squid_positions.nlin()!=0)
+            direct_field(r0,q,field,jacobian);
+    }
+
+    //  Same computation as DipSource2MEGMat (and DipSource2MEGGradMat if jacobian is not null) for a single dipole.
+
+    void ForwardEvaluator::direct_field(const Vect3& r,const Vect3& q,double* field,double* jacobian) {
+        const Precomputed& d = *shared;
+        const size_t n = d.squid_positions.nlin();
+        for (unsigned i=0; i<n; ++i) {
+            const Vect3& diff = Vect3(d.squid_positions(i,0),d.squid_positions(i,1),d.squid_positions(i,2))-r;
+            const Vect3 direction(d.squid_directions(i,0),d.squid_directions(i,1),d.squid_directions(i,2));
+            const double norm2_diff = diff.norm2();
+            const double inv = 1.0/(norm2_diff*sqrt(norm2_diff));
+            const Vect3& uq = direction^q;
+            direct[i] = dotprod(uq,diff)*inv;
+            if (jacobian!=nullptr) {
+                const Vect3& grad = (3*dotprod(uq,diff)/norm2_diff*diff-uq)*inv;
+                for (unsigned j=0; j<3; ++j)
+                    direct[(j+1)*n+i] = grad(j);
+            }
+        }
+        gemv(false,1.0,d.squid_weights.view(),VectorView(direct.data(),n),1.0,VectorView(field,d.n_sensors));
+        if (jacobian!=nullptr)
+            gemm(false,false,1.0,d.squid_weights.view(),MatrixView(direct.data()+n,n,3,n),1.0,MatrixView(jacobian,d.n_sensors,3,d.n_sensors));
+    }
+}
@@ -38,6 +38,7 @@ knowledge of the CeCILL-B license and that you accept its terms.
 */
 
 #include <geometry.h>
+#include <decimation.h>
 #include <MeshIO.h>
 #include <GeometryIO.h>
 #include <PropertiesSpecialized.h>
@@ -175,6 +176,35 @@ namespace OpenMEEG {
         throw OpenMEEG::BadDomain("Impossible");
     }
 
+    Geometry::DomainsReference Geometry::domains(const Matrix& points) const {
+
+        //  Build the interface trees before entering the parallel loop.
+
+        for (const auto& domain : domains())
+            for (const auto& boundary : domain.boundaries())
+                boundary.interface().bvh();
+
+        const std::ptrdiff_t n = points.nlin();
+        DomainsReference result(n,nullptr);
+        #pragma omp parallel for schedule(dynamic,256)
+        for (std::ptrdiff_t i=0; i<n; ++i) {
+            const Vect3 p(points(i,0),points(i,1),points(i,2));
+            for (const auto& domain : domains())
+                if (domain.contains(p)) {
+                    result[i] = &domain;
+                    break;
+                }
+        }
+
+        // Should never append
+
+        for (const auto& domainptr : result)
+            if (domainptr==nullptr)
+                throw OpenMEEG::BadDomain("Impossible");
+
+        return result;
+    }
+
     const Domain& Geometry::domain(const std::string& name) const {
         for (const auto& domain : domains())
             if (domain.name()==name)
@@ -246,6 +276,62 @@ namespace OpenMEEG {
             delete desc.io;
     }
 
+    void Geometry::coarsen(const Geometry& geo,const double ratio) {
+
+        clear();
+
+        // Vertices shared by several meshes are kept so that the coarse meshes still share them.
+
+        std::map<const Vertex*,unsigned> nb_meshes;
+        for (const auto& mesh : geo.meshes())
+            for (const auto& vertex : mesh.vertices())
+                ++nb_meshes[vertex];
+
+        std::set<const Vertex*> locked;
+        for (const auto& item : nb_meshes)
+            if (item.second>1)
+                locked.insert(item.first);
+
+        // First create all the vertices, then the meshes (as in import).
+
+        const unsigned n = geo.meshes().size();
+        std::vector<std::vector<TriangleIndices>> triangles(n);
+        std::vector<IndexMap> indmaps(n);
+        for (unsigned i=0;i<n;++i) {
+            Vertices points;
+            decimate(geo.meshes()[i],locked,ratio,points,triangles[i]);
+            indmaps[i] = add_vertices(points);
+        }
+
+        meshes().reserve(n);
+        for (unsigned i=0;i<n;++i) {
+            Mesh& mesh = add_mesh(geo.meshes()[i].name());
+            mesh.reference_vertices(indmaps[i]);
+            mesh.add(triangles[i],indmaps[i]);
+            mesh.update(true);
+        }
+
+        // Same domains, with interfaces made of the coarse meshes.
+
+        for (const auto& domain : geo.domains()) {
+            domains().push_back(Domain(domain.name()));
+            Domain& coarse_domain = domains().back();
+            coarse_domain.set_conductivity(domain.conductivity());
+            for (const auto& boundary : domain.boundaries()) {
+                Interface interface(boundary.interface().name());
+                for (const auto& omesh : boundary.interface().oriented_meshes()) {
+                    const OrientedMesh::Orientation orientation = static_cast<OrientedMesh::Orientation>(omesh.orientation());
+                    interface.oriented_meshes().push_back(OrientedMesh(mesh(omesh.mesh().name()),orientation));
+                }
+                const SimpleDomain::Side side = (boundary.inside()) ? SimpleDomain::Inside : SimpleDomain::Outside;
+                coarse_domain.boundaries().push_back(SimpleDomain(interface,side));
+            }
+        }
+
+        conductivities = geo.has_conductivities();
+        finalize();
+    }
+
     void Geometry::read_conductivity_file(const std::string& filename) {
         try {
             typedef Utils::Properties::Named<std::string,Conductivity<double>> HeadProperties;
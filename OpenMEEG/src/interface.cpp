@@ -38,6 +38,7 @@ knowledge of the CeCILL-B license and that you accept its terms.
 */
 
 #include <algorithm>
+#include <cmath>
 
 #include <constants.h>
 #include <boundingbox.h>
@@ -48,6 +49,18 @@ namespace OpenMEEG {
     /// Computes the total solid angle of a surface for a point p and tells whether p is inside the mesh or not.
 
     bool Interface::contains(const Vect3& p) const {
+
+        //  The solid angle of a closed interface is a multiple of 4*Pi. The hierarchical evaluation is only
+        //  approximate, but it is enough to decide when it is close to -4*Pi or 0.
+
+        constexpr double tolerance = 0.1;
+        const double winding = bvh().solid_angle(p)/(4*Pi);
+        const double rounded = std::round(winding);
+        if (std::abs(winding-rounded)<tolerance && (rounded==-1.0 || rounded==0.0))
+            return rounded==-1.0;
+
+        //  Otherwise use the exact solid angle to diagnose the problem.
+
         const double solangle = solid_angle(p);
 
         if (almost_equal(solangle,-4*Pi))
@@ -76,6 +89,24 @@ namespace OpenMEEG {
         return solangle;
     }
 
+    const TriangleBVH& Interface::bvh() const {
+        std::shared_ptr<const TriangleBVH> current = std::atomic_load(&tree);
+        if (!current) {
+            TriangleBVH::Items items;
+            items.reserve(nb_triangles());
+            for (const auto& omesh : oriented_meshes())
+                for (const auto& triangle : omesh.mesh().triangles())
+                    items.push_back({ &triangle, omesh.orientation() });
+
+            //  If another thread built the tree concurrently, keep its version.
+
+            std::shared_ptr<const TriangleBVH> built = std::make_shared<const TriangleBVH>(items);
+            if (std::atomic_compare_exchange_strong(&tree,&current,built))
+                current = built;
+        }
+        return *current;
+    }
+
     void Interface::set_to_outermost() {
         for (auto& omesh : oriented_meshes())
             omesh.mesh().outermost() = true;
@@ -115,6 +146,7 @@ namespace OpenMEEG {
             std::cout << "Global reorientation of interface " << name() << std::endl;
             for (auto& omesh : oriented_meshes())
                 omesh.change_orientation();
+            std::atomic_store(&tree,std::shared_ptr<const TriangleBVH>());
             solangle = -solangle;
         }
 
@@ -0,0 +1,212 @@
+/*
+Project Name : OpenMEEG
+
+© INRIA and ENPC (contributors: Geoffray ADDE, Maureen CLERC, Alexandre 
+GRAMFORT, Renaud KERIVEN, Jan KYBIC, Perrine LANDREAU, Théodore PAPADOPOULO,
+Emmanuel OLIVI
+Maureen.Clerc.AT.inria.fr, keriven.AT.certis.enpc.fr,
+kybic.AT.fel.cvut.cz, papadop.AT.inria.fr)
+
+The OpenMEEG software is a C++ package for solving the forward/inverse
+problems of electroencephalography and magnetoencephalography.
+
+This software is governed by the CeCILL-B license under French law and
+abiding by the rules of distribution of free software.  You can  use,
+modify and/ or redistribute the software under the terms of the CeCILL-B
+license as circulated by CEA, CNRS and INRIA at the following URL
+"http://www.cecill.info".
+
+As a counterpart to the access to the source code and  rights to copy,
+modify and redistribute granted by the license, users are provided only
+with a limited warranty  and the software's authors,  the holders of the
+economic rights,  and the successive licensors  have only  limited
+liability.
+
+In this respect, the user's attention is drawn to the risks associated
+with loading,  using,  modifying and/or developing or reproducing the
+software by the user in light of its specific status of free software,
+that may mean  that it is complicated to manipulate,  and  that  also
+therefore means  that it is reserved for developers  and  experienced
+professionals having in-depth computer knowledge. Users are therefore
+encouraged to load and test the software's suitability as regards their
+requirements in conditions enabling the security of their systems and/or
+data to be ensured and,  more generally, to use and operate it in the
+same conditions as regards security.
+
+The fact that you are presently reading this means that you have had
+knowledge of the CeCILL-B license and that you accept its terms.
+*/
+
+#include <cmath>
+
+#include <inverse.h>
+#include <forward.h>
+#include <svd.h>
+
+namespace OpenMEEG {
+
+    namespace {
+
+        //  Whitener W = diag(1/sqrt(s))*U' of a covariance C = U*diag(s)*U' (rank deficient covariances are truncated).
+
+        Matrix whitener(const SymMatrix& C) {
+            const TruncatedSVD& svd = truncated_svd(Matrix(C),1e-12);
+            Matrix W = svd.U.transpose();
+            for (size_t i=0; i<W.nlin(); ++i) {
+                const double scale = 1.0/std::sqrt(svd.s(i));
+                for (size_t j=0; j<W.ncol(); ++j)
+                    W(i,j) *= scale;
+            }
+            return W;
+        }
+
+        //  Divide each group of components lines of K by sqrt(sum over the group of sum_k (Vt(k,i)*f(k))^2).
+
+        void normalize(Matrix& K,const Matrix& Vt,const Vector& f,const unsigned components) {
+            const size_t n_locations = K.nlin()/components;
+            #pragma omp parallel for
+            for (std::ptrdiff_t l=0; l<static_cast<std::ptrdiff_t>(n_locations); ++l) {
+                double norm2 = 0.0;
+                for (size_t c=0; c<components; ++c)
+                    for (size_t k=0; k<Vt.nlin(); ++k) {
+                        const double v = Vt(k,components*l+c)*f(k);
+                        norm2 += v*v;
+                    }
+                const double scale = 1.0/std::sqrt(norm2);
+                for (size_t c=0; c<components; ++c)
+                    for (size_t j=0; j<K.ncol(); ++j)
+                        K(components*l+c,j) *= scale;
+            }
+        }
+
+        //  Inverse of a 1x1 or 3x3 matrix (row major), by cofactors.
+
+        void invert_small(const double* M,const unsigned n,double* inv) {
+            if (n==1) {
+                inv[0] = 1.0/M[0];
+                return;
+            }
+            inv[0] = M[4]*M[8]-M[5]*M[7];
+            inv[1] = M[2]*M[7]-M[1]*M[8];
+            inv[2] = M[1]*M[5]-M[2]*M[4];
+            inv[3] = M[5]*M[6]-M[3]*M[8];
+            inv[4] = M[0]*M[8]-M[2]*M[6];
+            inv[5] = M[2]*M[3]-M[0]*M[5];
+            inv[6] = M[3]*M[7]-M[4]*M[6];
+            inv[7] = M[1]*M[6]-M[0]*M[7];
+            inv[8] = M[0]*M[4]-M[1]*M[3];
+            const double det = M[0]*inv[0]+M[1]*inv[3]+M[2]*inv[6];
+            for (unsigned i=0; i<9; ++i)
+                inv[i] /= det;
+        }
+    }
+
+    Matrix InverseOperator::apply(const Matrix& data,const size_t chunk) const {
+        return ForwardSimulator<Matrix>(*this,0.0,0,chunk)(data);
+    }
+
+    void InverseOperator::apply(const std::string& data_file,const std::string& estimates_file,const size_t chunk) const {
+        ForwardSimulator<Matrix>(*this,0.0,0,chunk)(data_file,estimates_file);
+    }
+
+    MinimumNormOperator::MinimumNormOperator(const Matrix& G,const double lambda2,const Method method,const unsigned components) {
+        compute(G,Matrix(),lambda2,method,components);
+    }
+
+    MinimumNormOperator::MinimumNormOperator(const Matrix& G,const SymMatrix& noise_covariance,const double lambda2,
+                                             const Method method,const unsigned components)
+    {
+        om_assert(noise_covariance.nlin()==G.nlin());
+        compute(G,whitener(noise_covariance),lambda2,method,components);
+    }
+
+    void MinimumNormOperator::compute(const Matrix& G,const Matrix& W,const double lambda2,const Method method,const unsigned components) {
+        om_assert(components==1 || components==3);
+        om_assert(G.ncol()%components==0);
+
+        //  An empty whitener stands for the identity.
+
+        const bool whiten = W.nlin()!=0;
+        const TruncatedSVD& svd = truncated_svd((whiten) ? W*G : G,1e-12);
+        const size_t rank = svd.rank();
+
+        double power = 0.0;
+        for (size_t k=0; k<rank; ++k)
+            power += svd.s(k)*svd.s(k);
+        const double l2 = lambda2*power/rank;
+
+        //  K = V*(diag(s/(s^2+l2))*U'*W): the small rank x sensors factor first, then one GEMM.
+
+        Vector d(rank);
+        for (size_t k=0; k<rank; ++k)
+            d(k) = svd.s(k)/(svd.s(k)*svd.s(k)+l2);
+
+        Matrix A = (whiten) ? svd.U.tmult(W) : svd.U.transpose();
+        for (size_t k=0; k<rank; ++k)
+            for (size_t j=0; j<A.ncol(); ++j)
+                A(k,j) *= d(k);
+
+        Matrix& K = *this;
+        K = svd.Vt.tmult(A);
+
+        //  Noise normalizations: the whitened noise covariance being the identity, the noise variance of the line i of
+        //  K is ||(V*diag(d))_i||^2 (dSPM), and the variance of the estimate of unit sources plus noise is
+        //  ||(V*diag(s/sqrt(s^2+l2)))_i||^2 (sLORETA).
+
+        if (method==dSPM)
+            normalize(K,svd.Vt,d,components);
+
+        if (method==sLORETA) {
+            Vector f(rank);
+            for (size_t k=0; k<rank; ++k)
+                f(k) = svd.s(k)/std::sqrt(svd.s(k)*svd.s(k)+l2);
+            normalize(K,svd.Vt,f,components);
+        }
+    }
+
+    LCMVOperator::LCMVOperator(const Matrix& G,const SymMatrix& data_covariance,const double reg,const unsigned components) {
+        om_assert(components==1 || components==3);
+        om_assert(G.ncol()%components==0 && data_covariance.nlin()==G.nlin());
+
+        const size_t m = G.nlin();
+
+        SymMatrix C(data_covariance,DEEP_COPY);
+        double trace = 0.0;
+        for (size_t i=0; i<m; ++i)
+            trace += C(i,i);
+        for (size_t i=0; i<m; ++i)
+            C(i,i) += reg*trace/m;
+
+        Matrix X(G,DEEP_COPY);
+        factorize(std::move(C)).solve(X); // X = C^{-1}*G
+
+        Matrix& K = *this;
+        K = Matrix(G.ncol(),m);
+
+        const size_t n_locations = G.ncol()/components;
+        #pragma omp parallel for
+        for (std::ptrdiff_t l=0; l<static_cast<std::ptrdiff_t>(n_locations); ++l) {
+            const size_t first = components*l;
+
+            //  K_l = (G_l'*C^{-1}*G_l)^{-1}*(C^{-1}*G_l)'.
+
+            double M[9];
+            for (size_t a=0; a<components; ++a)
+                for (size_t b=0; b<components; ++b) {
+                    double v = 0.0;
+                    for (size_t i=0; i<m; ++i)
+                        v += G(i,first+a)*X(i,first+b);
+                    M[a*components+b] = v;
+                }
+            double Minv[9];
+            invert_small(M,components,Minv);
+            for (size_t a=0; a<components; ++a)
+                for (size_t j=0; j<m; ++j) {
+                    double v = 0.0;
+                    for (size_t b=0; b<components; ++b)
+                        v += Minv[a*components+b]*X(j,first+b);
+                    K(first+a,j) = v;
+                }
+        }
+    }
+}
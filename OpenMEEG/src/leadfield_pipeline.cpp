@@ -0,0 +1,236 @@
+/*
+Project Name : OpenMEEG
+
+© INRIA and ENPC (contributors: Geoffray ADDE, Maureen CLERC, Alexandre 
+GRAMFORT, Renaud KERIVEN, Jan KYBIC, Perrine LANDREAU, Théodore PAPADOPOULO,
+Emmanuel OLIVI
+Maureen.Clerc.AT.inria.fr, keriven.AT.certis.enpc.fr,
+kybic.AT.fel.cvut.cz, papadop.AT.inria.fr)
+
+The OpenMEEG software is a C++ package for solving the forward/inverse
+problems of electroencephalography and magnetoencephalography.
+
+This software is governed by the CeCILL-B license under French law and
+abiding by the rules of distribution of free software.  You can  use,
+modify and/ or redistribute the software under the terms of the CeCILL-B
+license as circulated by CEA, CNRS and INRIA at the following URL
+"http://www.cecill.info".
+
+As a counterpart to the access to the source code and  rights to copy,
+modify and redistribute granted by the license, users are provided only
+with a limited warranty  and the software's authors,  the holders of the
+economic rights,  and the successive licensors  have only  limited
+liability.
+
+In this respect, the user's attention is drawn to the risks associated
+with loading,  using,  modifying and/or developing or reproducing the
+software by the user in light of its specific status of free software,
+that may mean  that it is complicated to manipulate,  and  that  also
+therefore means  that it is reserved for developers  and  experienced
+professionals having in-depth computer knowledge. Users are therefore
+encouraged to load and test the software's suitability as regards their
+requirements in conditions enabling the security of their systems and/or
+data to be ensured and,  more generally, to use and operate it in the
+same conditions as regards security.
+
+The fact that you are presently reading this means that you have had
+knowledge of the CeCILL-B license and that you accept its terms.
+*/
+
+#include <memory>
+
+#include <leadfield_pipeline.h>
+#include <out_of_core.h>
+#include <assemble.h>
+#include <gain.h>
+
+namespace OpenMEEG {
+
+    namespace {
+
+        //  Lines first,...,first+n-1 of the dipoles matrix.
+
+        Matrix dipole_lines(const Matrix& dipoles,const size_t first,const size_t n) {
+            Matrix res(n,dipoles.ncol());
+            copy(dipoles.view(first,n,0,dipoles.ncol()),res.view());
+            return res;
+        }
+
+        //  G = M*X for a sparse M (Head2EEGMat has a few non-zeros per line).
+
+        void sparse_product(const SparseMatrix& M,const ConstMatrixView& X,const MatrixView& G) {
+            for (size_t j=0; j<G.ncol(); ++j)
+                for (size_t i=0; i<G.nlin(); ++i)
+                    G(i,j) = 0.0;
+            for (const auto& entry : M)
+                for (size_t j=0; j<G.ncol(); ++j)
+                    G(entry.first.first,j) += entry.second*X(entry.first.second,j);
+        }
+
+        //  Blocks are computed in parallel and written in completion order.
+
+        void write_block(MatrixFile& file,const size_t first,const Matrix& block) {
+            #pragma omp critical(leadfield_output)
+            file.write_panel(first,first+block.ncol(),block.data());
+        }
+    }
+
+    const char* LeadfieldPipeline::name(const Method method) {
+        switch (method) {
+            case DIRECT:  return "direct";
+            case ADJOINT: return "adjoint";
+            default:      return "auto";
+        }
+    }
+
+    double LeadfieldPipeline::cost(const Method method,const size_t N,const size_t n_sensors,const size_t n_sources) {
+        const double n   = static_cast<double>(N);
+        const double rhs = static_cast<double>((method==ADJOINT) ? n_sensors : n_sources);
+        return n*n*n/3+2*n*n*rhs+2*n*static_cast<double>(n_sensors)*static_cast<double>(n_sources);
+    }
+
+    LeadfieldPipeline::SystemMatrices
+    LeadfieldPipeline::assemble(const Geometry& geo,const Matrix& dipoles,const Sensors* electrodes,const Sensors* squids,
+                                const Method method,const std::string& intermediates)
+    {
+        om_assert(electrodes!=nullptr || squids!=nullptr);
+
+        const bool   save      = intermediates!="";
+        const size_t N         = geo.nb_parameters()-geo.nb_current_barrier_triangles();
+        const size_t n_sensors = ((electrodes!=nullptr) ? electrodes->getNumberOfSensors() : 0)+
+                                 ((squids!=nullptr)     ? squids->getNumberOfSensors()     : 0);
+        const size_t n_sources = DipSourceMat::components(dipoles)*dipoles.nlin();
+
+        used_method = (method==AUTO) ? choose(N,n_sensors,n_sources) : method;
+
+        SystemMatrices matrices;
+        matrices.HM = HeadMat(geo);
+        if (save)
+            matrices.HM.save(intermediates+"HeadMat.bin");
+
+        if (electrodes!=nullptr) {
+            matrices.H2EM = Head2EEGMat(geo,*electrodes);
+            if (save)
+                matrices.H2EM.save(intermediates+"Head2EEGMat.bin");
+        }
+        if (squids!=nullptr) {
+            matrices.H2MM = Head2MEGMat(geo,*squids);
+            if (save)
+                matrices.H2MM.save(intermediates+"Head2MEGMat.bin");
+        }
+        return matrices;
+    }
+
+    LeadfieldPipeline::LeadfieldPipeline(const Geometry& geo,const Matrix& dipoles,const Sensors* electrodes,const Sensors* squids,
+                                         const Method method,const std::string& intermediates)
+    {
+        SystemMatrices matrices = assemble(geo,dipoles,electrodes,squids,method,intermediates);
+
+        Matrix DS2MM;
+        if (squids!=nullptr) {
+            DS2MM = DipSource2MEGMat(dipoles,*squids);
+            if (intermediates!="")
+                DS2MM.save(intermediates+"DipSource2MEGMat.bin");
+        }
+
+        if (used_method==ADJOINT) {
+            if (electrodes!=nullptr && squids!=nullptr) {
+                const GainEEGMEGadjoint gains(geo,dipoles,std::move(matrices.HM),matrices.H2EM,matrices.H2MM,DS2MM);
+                EEGleadfield = gains.EEG();
+                MEGleadfield = gains.MEG();
+            } else if (electrodes!=nullptr) {
+                EEGleadfield = GainEEGadjoint(geo,dipoles,std::move(matrices.HM),matrices.H2EM);
+            } else {
+                MEGleadfield = GainMEGadjoint(geo,dipoles,std::move(matrices.HM),matrices.H2MM,DS2MM);
+            }
+            return;
+        }
+
+        //  Direct formulation: the source matrix is overwritten by HeadMat^{-1}*DipSourceMat.
+
+        Matrix X = DipSourceMat(geo,dipoles);
+        if (intermediates!="")
+            X.save(intermediates+"DipSourceMat.bin");
+        factorize(std::move(matrices.HM)).solve(X);
+
+        if (electrodes!=nullptr)
+            EEGleadfield = matrices.H2EM*X;
+
+        if (squids!=nullptr) {
+            MEGleadfield = Matrix(DS2MM,DEEP_COPY);
+            gemm(false,false,1.0,matrices.H2MM.view(),X.view(),1.0,MEGleadfield.view());
+        }
+    }
+
+    LeadfieldPipeline::LeadfieldPipeline(const Geometry& geo,const Matrix& dipoles,const Sensors* electrodes,const Sensors* squids,
+                                         const std::string& eeg_file,const std::string& meg_file,const Method method,
+                                         const std::string& intermediates)
+    {
+        SystemMatrices matrices = assemble(geo,dipoles,electrodes,squids,method,intermediates);
+
+        const size_t   N         = matrices.HM.nlin();
+        const unsigned nc        = DipSourceMat::components(dipoles);
+        const size_t   n_sources = nc*dipoles.nlin();
+        const size_t   n_eeg     = matrices.H2EM.nlin();
+        const size_t   n_meg     = matrices.H2MM.nlin();
+
+        std::unique_ptr<MatrixFile> eeg;
+        std::unique_ptr<MatrixFile> meg;
+        if (electrodes!=nullptr)
+            eeg = std::make_unique<MatrixFile>(eeg_file,LinOpInfo::FULL,n_eeg,n_sources);
+        if (squids!=nullptr)
+            meg = std::make_unique<MatrixFile>(meg_file,LinOpInfo::FULL,n_meg,n_sources);
+
+        //  The MEG direct term of a block only depends on the dipoles of the block.
+
+        const auto meg_block = [&](const size_t first,const size_t n) {
+            return Matrix(DipSource2MEGMat(dipole_lines(dipoles,first/nc,n/nc),*squids));
+        };
+
+        if (used_method==ADJOINT) {
+
+            //  Adjoint solutions of the EEG lines followed by the MEG ones.
+
+            Matrix RHS(n_eeg+n_meg,N);
+            for (size_t i=0; i<n_eeg; ++i)
+                RHS.setlin(i,matrices.H2EM.getlin(i));
+            for (size_t i=0; i<n_meg; ++i)
+                RHS.setlin(n_eeg+i,matrices.H2MM.getlin(i));
+            matrices.H2MM = Matrix();
+
+            const Matrix& Hinv = linsolve(std::move(matrices.HM),RHS);
+
+            adjoint_blocks(geo,dipoles,N,[&](const size_t first,const size_t n,const MatrixView& rhs) {
+                if (eeg) {
+                    Matrix block(n_eeg,n);
+                    gemm(false,false,1.0,Hinv.view(0,n_eeg,0,N),rhs,0.0,block.view());
+                    write_block(*eeg,first,block);
+                }
+                if (meg) {
+                    Matrix block = meg_block(first,n);
+                    gemm(false,false,1.0,Hinv.view(n_eeg,n_meg,0,N),rhs,1.0,block.view());
+                    write_block(*meg,first,block);
+                }
+            });
+            return;
+        }
+
+        //  Direct formulation: each block of the source matrix is solved in place.
+
+        const SymMatrixFactorization& factorization = factorize(std::move(matrices.HM));
+
+        adjoint_blocks(geo,dipoles,N,[&](const size_t first,const size_t n,const MatrixView& rhs) {
+            factorization.solve(rhs);
+            if (eeg) {
+                Matrix block(n_eeg,n);
+                sparse_product(matrices.H2EM,rhs,block.view());
+                write_block(*eeg,first,block);
+            }
+            if (meg) {
+                Matrix block = meg_block(first,n);
+                gemm(false,false,1.0,matrices.H2MM.view(),rhs,1.0,block.view());
+                write_block(*meg,first,block);
+            }
+        });
+    }
+}
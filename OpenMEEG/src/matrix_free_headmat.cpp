@@ -0,0 +1,297 @@
+/*
+Project Name : OpenMEEG
+
+© INRIA and ENPC (contributors: Geoffray ADDE, Maureen CLERC, Alexandre 
+GRAMFORT, Renaud KERIVEN, Jan KYBIC, Perrine LANDREAU, Théodore PAPADOPOULO,
+Emmanuel OLIVI
+Maureen.Clerc.AT.inria.fr, keriven.AT.certis.enpc.fr,
+kybic.AT.fel.cvut.cz, papadop.AT.inria.fr)
+
+The OpenMEEG software is a C++ package for solving the forward/inverse
+problems of electroencephalography and magnetoencephalography.
+
+This software is governed by the CeCILL-B license under French law and
+abiding by the rules of distribution of free software.  You can  use,
+modify and/ or redistribute the software under the terms of the CeCILL-B
+license as circulated by CEA, CNRS and INRIA at the following URL
+"http://www.cecill.info".
+
+As a counterpart to the access to the source code and  rights to copy,
+modify and redistribute granted by the license, users are provided only
+with a limited warranty  and the software's authors,  the holders of the
+economic rights,  and the successive licensors  have only  limited
+liability.
+
+In this respect, the user's attention is drawn to the risks associated
+with loading,  using,  modifying and/or developing or reproducing the
+software by the user in light of its specific status of free software,
+that may mean  that it is complicated to manipulate,  and  that  also
+therefore means  that it is reserved for developers  and  experienced
+professionals having in-depth computer knowledge. Users are therefore
+encouraged to load and test the software's suitability as regards their
+requirements in conditions enabling the security of their systems and/or
+data to be ensured and,  more generally, to use and operate it in the
+same conditions as regards security.
+
+The fact that you are presently reading this means that you have had
+knowledge of the CeCILL-B license and that you accept its terms.
+*/
+
+#if WIN32
+#define _USE_MATH_DEFINES
+#endif
+
+#include <om_common.h>
+#include <operators.h>
+#include <assemble.h>
+#include <matrix_free_headmat.h>
+
+#include <constants.h>
+
+namespace OpenMEEG {
+
+    static double radius(const Triangle& T) {
+        const Vect3& center = T.center();
+        double r = 0.0;
+        for (unsigned i=0;i<3;++i)
+            r = std::max(r,(T.vertex(i)-center).norm());
+        return r;
+    }
+
+    MatrixFreeHeadMat::MatrixFreeHeadMat(const Geometry& g,const unsigned order,const double eta):
+        ImplicitOperator(g.nb_parameters()-g.nb_current_barrier_triangles(),g.nb_parameters()-g.nb_current_barrier_triangles()),
+        geo(g),gauss_order(order),near_field(eta),diag(nlin())
+    {
+        om_error(near_field>=1.0);
+
+        constexpr double K = 1.0/(4*Pi);
+
+        // Same coefficients as in HeadMat::HeadMat. Note that the coefficient of the N block is the same
+        // whether the S block is computed or not (sigma/inv_cond*(orientation*inv_cond*K)).
+
+        for (const auto& mp : geo.communicating_mesh_pairs()) {
+            const Mesh& mesh1 = mp(0);
+            const Mesh& mesh2 = mp(1);
+
+            const int orientation = mp.relative_orientation();
+
+            Block block;
+            block.mesh1     = &mesh1;
+            block.mesh2     = &mesh2;
+            block.same_mesh = &mesh1==&mesh2;
+            block.S         = !mesh1.current_barrier() && !mesh2.current_barrier();
+            block.D         = !mesh1.current_barrier();
+            block.Dstar     = !block.same_mesh && !mesh2.current_barrier();
+            block.Scoeff    = (block.S) ? orientation*geo.sigma_inv(mesh1,mesh2)*K : 0.0;
+            block.Dcoeff    = -orientation*geo.indicator(mesh1,mesh2)*K;
+            block.Ncoeff    = orientation*geo.sigma(mesh1,mesh2)*K;
+
+            // Collect the near-field pairs of triangles and compute their integrals once for all.
+
+            const Triangles& triangles1 = mesh1.triangles();
+            const Triangles& triangles2 = mesh2.triangles();
+            for (unsigned i1=0;i1<triangles1.size();++i1)
+                for (unsigned i2=(block.same_mesh) ? i1 : 0;i2<triangles2.size();++i2)
+                    if (is_near(triangles1[i1],triangles2[i2]))
+                        block.near.push_back({ &triangles1[i1],&triangles2[i2],Kernel() });
+
+            std::vector<NearInteraction>& near = block.near;
+            #pragma omp parallel for schedule(dynamic,64)
+            for (int i=0;i<static_cast<int>(near.size());++i)
+                near[i].kernel = kernel(block,*near[i].T1,*near[i].T2);
+
+            blocks.push_back(block);
+        }
+
+        // Only pairs of triangles sharing a vertex contribute to the diagonal and those are in the near field.
+
+        diag.set(0.0);
+        const auto diagonal_terms = [this](const unsigned i,const unsigned j,const double c) { if (i==j) diag(i) += c; };
+        for (const auto& block : blocks)
+            for (const auto& interact : block.near)
+                interaction(block,*interact.T1,*interact.T2,interact.kernel,diagonal_terms);
+
+        // Deflation of the current barriers (see deflate(M,geo)), applied implicitly.
+
+        deflation = deflation_operator(geo,diag);
+        diag += deflation->diagonal();
+
+        std::cout << "MATRIX FREE HEADMAT ... (" << nlin() << " unknowns, " << near_field_size() << " near field interactions)" << std::endl;
+    }
+
+    void MatrixFreeHeadMat::info() const {
+        std::cout << "Matrix-free head matrix" << std::endl;
+        std::cout << "Dimensions : " << nlin() << " x " << ncol() << std::endl;
+        std::cout << "Near field interactions : " << near_field_size() << std::endl;
+    }
+
+    size_t MatrixFreeHeadMat::near_field_size() const {
+        size_t res = 0;
+        for (const auto& block : blocks)
+            res += block.near.size();
+        return res;
+    }
+
+    bool MatrixFreeHeadMat::is_near(const Triangle& T1,const Triangle& T2) const {
+        return (T1.center()-T2.center()).norm()<=near_field*(radius(T1)+radius(T2));
+    }
+
+    MatrixFreeHeadMat::Kernel MatrixFreeHeadMat::kernel(const Block& block,const Triangle& T1,const Triangle& T2) const {
+        Kernel res;
+        res.S = _operatorS(T1,T2,gauss_order);
+        Integrator<Vect3,analyticD3> gauss(gauss_order);
+        if (block.D)
+            res.D12 = gauss.integrate(analyticD3(T2),T1);
+        if (block.Dstar || (block.D && block.same_mesh && &T1!=&T2))
+            res.D21 = gauss.integrate(analyticD3(T1),T2);
+        return res;
+    }
+
+    //  Add the contributions of the pair of triangles (T1,T2) to the entries of the head matrix.
+    //  acc(i,j,c) adds c to the entry (i,j) only, the symmetric entry being handled here.
+
+    template <typename Accumulator>
+    void MatrixFreeHeadMat::interaction(const Block& block,const Triangle& T1,const Triangle& T2,const Kernel& kernel,Accumulator& acc) const {
+
+        // Same semantic as SymMatrix::operator()(i,j) += c.
+
+        const auto add = [&acc](const unsigned i,const unsigned j,const double c) {
+            acc(i,j,c);
+            if (i!=j)
+                acc(j,i,c);
+        };
+
+        const bool same_triangle = &T1==&T2;
+
+        if (block.S)
+            add(T1.index(),T2.index(),block.Scoeff*kernel.S);
+
+        if (block.D) {
+            for (unsigned i=0;i<3;++i)
+                add(T1.index(),T2.vertex(i).index(),block.Dcoeff*kernel.D12(i));
+            if (block.same_mesh && !same_triangle)
+                for (unsigned i=0;i<3;++i)
+                    add(T2.index(),T1.vertex(i).index(),block.Dcoeff*kernel.D21(i));
+        }
+
+        if (block.Dstar)
+            for (unsigned i=0;i<3;++i)
+                add(T2.index(),T1.vertex(i).index(),block.Dcoeff*kernel.D21(i));
+
+        // N block (see _operatorN).
+
+        const double coeff = -block.Ncoeff*kernel.S/(T1.area()*T2.area());
+        for (const auto& V1 : T1) {
+            const Edge& edge1 = T1.edge(*V1);
+            const Vect3& CB1 = edge1.vertex(0)-edge1.vertex(1);
+            for (const auto& V2 : T2) {
+                const Edge& edge2 = T2.edge(*V2);
+                const Vect3& CB2 = edge2.vertex(0)-edge2.vertex(1);
+                if (block.same_mesh) {
+                    const double c = 0.25*coeff*dotprod(CB1,CB2);
+                    acc(V1->index(),V2->index(),c);
+                    if (!same_triangle)
+                        acc(V2->index(),V1->index(),c);
+                } else {
+                    const double factor = (*V1==*V2) ? 0.5 : 0.25;
+                    add(V1->index(),V2->index(),factor*coeff*dotprod(CB1,CB2));
+                }
+            }
+        }
+    }
+
+    template <typename Accumulator>
+    void MatrixFreeHeadMat::interactions(Accumulator& acc) const {
+        for (const auto& block : blocks) {
+
+            // Near field from the cache.
+
+            const std::vector<NearInteraction>& near = block.near;
+            #pragma omp for schedule(dynamic,64) nowait
+            for (int i=0;i<static_cast<int>(near.size());++i)
+                interaction(block,*near[i].T1,*near[i].T2,near[i].kernel,acc);
+
+            // Far field is recomputed.
+
+            const Triangles& triangles1 = block.mesh1->triangles();
+            const Triangles& triangles2 = block.mesh2->triangles();
+            #pragma omp for schedule(dynamic) nowait
+            for (int i1=0;i1<static_cast<int>(triangles1.size());++i1) {
+                const Triangle& T1 = triangles1[i1];
+                for (unsigned i2=(block.same_mesh) ? i1 : 0;i2<triangles2.size();++i2) {
+                    const Triangle& T2 = triangles2[i2];
+                    if (!is_near(T1,T2))
+                        interaction(block,T1,T2,kernel(block,T1,T2),acc);
+                }
+            }
+        }
+    }
+
+    Vector MatrixFreeHeadMat::operator*(const Vector& x) const {
+
+        om_assert(x.size()==ncol());
+
+        Vector y(nlin());
+        y.set(0.0);
+
+        #pragma omp parallel
+        {
+            Vector yt(nlin());
+            yt.set(0.0);
+            const auto product = [&yt,&x](const unsigned i,const unsigned j,const double c) { yt(i) += c*x(j); };
+            interactions(product);
+
+            #pragma omp critical
+            y += yt;
+        }
+
+        y += (*deflation)*x;
+
+        return y;
+    }
+
+    SymMatrix MatrixFreeHeadMat::galerkin(const SparseMatrix& P) const {
+
+        om_assert(P.nlin()==nlin());
+
+        // The entry (i,j) of H contributes to the entries (a,b) of P'*H*P for the non-zeros P(i,a) and P(j,b).
+
+        std::vector<std::vector<std::pair<size_t,double>>> rows(P.nlin());
+        for (const auto& entry : P)
+            rows[entry.first.first].push_back({ entry.first.second,entry.second });
+
+        SymMatrix G(P.ncol());
+        G.set(0.0);
+
+        #pragma omp parallel
+        {
+            const auto project = [&rows,&G](const unsigned i,const unsigned j,const double c) {
+                for (const auto& pa : rows[i])
+                    for (const auto& pb : rows[j])
+                        if (pa.first<=pb.first) {
+                            double& g = G(pa.first,pb.first);
+                            #pragma omp atomic
+                            g += c*pa.second*pb.second;
+                        }
+            };
+            interactions(project);
+        }
+
+        // Deflation: P'*U*C*V'*P.
+
+        const SparseMatrix& R = P.transpose();
+        const Matrix& D = (R*deflation->left())*(deflation->middle()*(R*deflation->right()).transpose());
+        for (size_t b=0;b<G.ncol();++b)
+            for (size_t a=0;a<=b;++a)
+                G(a,b) += D(a,b);
+
+        return G;
+    }
+
+    Matrix MatrixFreeHeadMat::apply(const Matrix& X) const {
+        Matrix Y(nlin(),X.ncol());
+        for (size_t j=0;j<X.ncol();++j)
+            Y.setcol(j,(*this)*X.getcol(j));
+        return Y;
+    }
+}
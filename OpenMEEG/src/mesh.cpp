@@ -45,9 +45,54 @@ knowledge of the CeCILL-B license and that you accept its terms.
 #include <mesh.h>
 #include <MeshIO.h>
 #include <geometry.h>
+#include <bvh.h>
 
 namespace OpenMEEG {
 
+    namespace {
+
+        TriangleBVH bvh(const Mesh& mesh) {
+            TriangleBVH::Items items;
+            items.reserve(mesh.triangles().size());
+            for (const auto& triangle : mesh.triangles())
+                items.push_back({ &triangle, 1 });
+            return TriangleBVH(items);
+        }
+
+        bool adjacent(const Triangle& t1,const Triangle& t2) {
+            return t1.contains(t2.vertex(0)) || t1.contains(t2.vertex(1)) || t1.contains(t2.vertex(2));
+        }
+
+        //  Narrow phase (in parallel) on the pairs of triangles with overlapping bounding boxes.
+
+        Mesh::TrianglePairs intersecting(const TriangleBVH& bvh1,const TriangleBVH& bvh2,const bool exclude_adjacent) {
+            const TriangleBVH::Pairs& candidates = bvh1.overlapping(bvh2);
+            const std::ptrdiff_t n = candidates.size();
+            std::vector<char> intersects(n,0);
+            #pragma omp parallel for schedule(dynamic,256)
+            for (std::ptrdiff_t k=0; k<n; ++k) {
+                const Triangle& t1 = *bvh1.items()[candidates[k].first].triangle;
+                const Triangle& t2 = *bvh2.items()[candidates[k].second].triangle;
+                intersects[k] = !(exclude_adjacent && adjacent(t1,t2)) && t1.intersects(t2);
+            }
+
+            Mesh::TrianglePairs pairs;
+            for (std::ptrdiff_t k=0; k<n; ++k)
+                if (intersects[k])
+                    pairs.push_back({ bvh1.items()[candidates[k].first].triangle,bvh2.items()[candidates[k].second].triangle });
+
+            //  Report the pairs in the order of the triangles.
+
+            std::sort(pairs.begin(),pairs.end());
+            return pairs;
+        }
+
+        void report(const Mesh::TrianglePairs& pairs) {
+            for (const auto& pair : pairs)
+                std::cout << "Triangles " << pair.first->index() << " and " << pair.second->index() << " are intersecting." << std::endl;
+        }
+    }
+
     //  We need a shared_ptr TODO
 
     Geometry* Mesh::create_geometry(Geometry* geom) {
@@ -265,16 +310,19 @@ namespace OpenMEEG {
             A(vertex->index(),vertex->index()) = -A.getlin(vertex->index()).sum();
     }
 
+    Mesh::TrianglePairs Mesh::self_intersections() const {
+        const TriangleBVH& tree = bvh(*this);
+        return intersecting(tree,tree,true);
+    }
+
+    Mesh::TrianglePairs Mesh::intersections(const Mesh& m) const {
+        return intersecting(bvh(*this),bvh(m),false);
+    }
+
     bool Mesh::has_self_intersection() const {
-        bool selfIntersects = false;
-        for (auto tit1=triangles().begin();tit1!=triangles().end();++tit1)
-            for (auto tit2=tit1;tit2!=triangles().end();++tit2)
-                if (!tit1->contains(tit2->vertex(0)) && !tit1->contains(tit2->vertex(1)) && !tit1->contains(tit1->vertex(2)))
-                    if (tit1->intersects(*tit2)) {
-                        selfIntersects = true;
-                        std::cout << "Triangles " << tit1->index() << " and " << tit2->index() << " are intersecting." << std::endl;
-                    }
-        return selfIntersects;
+        const TrianglePairs& pairs = self_intersections();
+        report(pairs);
+        return !pairs.empty();
     }
 
     double Mesh::solid_angle(const Vect3& p) const {
@@ -284,12 +332,11 @@ namespace OpenMEEG {
         return solangle;
     }
 
-    bool Mesh::intersection(const Mesh& m) const {
-        bool intersects = false;
-        for (const auto& triangle1 : triangles())
-            for (const auto& triangle2 : m.triangles())
-                intersects = intersects | triangle1.intersects(triangle2);
-        return intersects;
+    bool Mesh::intersection(const Mesh& m,const bool verbose) const {
+        const TrianglePairs& pairs = intersections(m);
+        if (verbose)
+            report(pairs);
+        return !pairs.empty();
     }
 
     void Mesh::load(const std::string& filename,const bool verbose) {
@@ -0,0 +1,167 @@
+/*
+Project Name : OpenMEEG
+
+© INRIA and ENPC (contributors: Geoffray ADDE, Maureen CLERC, Alexandre 
+GRAMFORT, Renaud KERIVEN, Jan KYBIC, Perrine LANDREAU, Théodore PAPADOPOULO,
+Emmanuel OLIVI
+Maureen.Clerc.AT.inria.fr, keriven.AT.certis.enpc.fr,
+kybic.AT.fel.cvut.cz, papadop.AT.inria.fr)
+
+The OpenMEEG software is a C++ package for solving the forward/inverse
+problems of electroencephalography and magnetoencephalography.
+
+This software is governed by the CeCILL-B license under French law and
+abiding by the rules of distribution of free software.  You can  use,
+modify and/ or redistribute the software under the terms of the CeCILL-B
+license as circulated by CEA, CNRS and INRIA at the following URL
+"http://www.cecill.info".
+
+As a counterpart to the access to the source code and  rights to copy,
+modify and redistribute granted by the license, users are provided only
+with a limited warranty  and the software's authors,  the holders of the
+economic rights,  and the successive licensors  have only  limited
+liability.
+
+In this respect, the user's attention is drawn to the risks associated
+with loading,  using,  modifying and/or developing or reproducing the
+software by the user in light of its specific status of free software,
+that may mean  that it is complicated to manipulate,  and  that  also
+therefore means  that it is reserved for developers  and  experienced
+professionals having in-depth computer knowledge. Users are therefore
+encouraged to load and test the software's suitability as regards their
+requirements in conditions enabling the security of their systems and/or
+data to be ensured and,  more generally, to use and operate it in the
+same conditions as regards security.
+
+The fact that you are presently reading this means that you have had
+knowledge of the CeCILL-B license and that you accept its terms.
+*/
+
+#include <vector>
+
+#include <danielsson.h>
+#include <multigrid.h>
+
+namespace OpenMEEG {
+
+    //  Galerkin projection P'*H*P of an assembled head matrix: as in MatrixFreeHeadMat::galerkin, each entry (i,j)
+    //  of H is projected on the entries (a,b) for the non-zeros P(i,a) and P(j,b) (H*P is not formed).
+
+    static SymMatrix galerkin(const SymMatrix& H,const SparseMatrix& P) {
+        std::vector<std::vector<std::pair<size_t,double>>> rows(P.nlin());
+        for (const auto& entry : P)
+            rows[entry.first.first].push_back({ entry.first.second,entry.second });
+
+        SymMatrix G(P.ncol());
+        G.set(0.0);
+        const auto project = [&rows,&G](const size_t i,const size_t j,const double c) {
+            for (const auto& pa : rows[i])
+                for (const auto& pb : rows[j])
+                    if (pa.first<=pb.first)
+                        G(pa.first,pb.first) += c*pa.second*pb.second;
+        };
+
+        for (size_t j=0;j<H.ncol();++j)
+            for (size_t i=0;i<=j;++i) {
+                const double c = H(i,j);
+                if (c==0.0)
+                    continue;
+                project(i,j,c);
+                if (i!=j)
+                    project(j,i,c);
+            }
+        return G;
+    }
+
+    TwoLevelPreconditioner::TwoLevelPreconditioner(const MatrixFreeHeadMat& H,const double ratio):
+        product([&H](const Vector& x) { return H*x; })
+    {
+        prolongation(H.geometry(),H.diagonal(),ratio);
+        coarse_solver = std::make_shared<const SymMatrixFactorization>(H.galerkin(P));
+    }
+
+    TwoLevelPreconditioner::TwoLevelPreconditioner(const Geometry& geo,const SymMatrix& H,const double ratio):
+        product([&H](const Vector& x) { return H*x; })
+    {
+        Vector diagonal(H.nlin());
+        for (unsigned i=0;i<H.nlin();++i)
+            diagonal(i) = H(i,i);
+        prolongation(geo,diagonal,ratio);
+        coarse_solver = std::make_shared<const SymMatrixFactorization>(galerkin(H,P));
+    }
+
+    void TwoLevelPreconditioner::prolongation(const Geometry& geo,const Vector& diagonal,const double ratio) {
+        const unsigned nfine = geo.nb_parameters()-geo.nb_current_barrier_triangles();
+        om_error(diagonal.nlin()==nfine);
+
+        coarse.coarsen(geo,ratio);
+        const unsigned ncoarse = coarse.nb_parameters()-coarse.nb_current_barrier_triangles();
+
+        std::cout << "TWO LEVEL PRECONDITIONER ... (" << nfine << " -> " << ncoarse << " unknowns)" << std::endl;
+
+        invdiag = Vector(nfine);
+        for (unsigned i=0;i<nfine;++i)
+            invdiag(i) = Damping/diagonal(i);
+
+        // Prolongation: P1 unknowns are interpolated (as potentials at EEG electrodes),
+        // P0 unknowns take the value of the closest coarse triangle.
+        // Closest points are obtained by batches using the bounding volume hierarchy of the coarse meshes.
+
+        P = SparseMatrix(nfine,ncoarse);
+        for (const auto& mesh : geo.meshes()) {
+            if (mesh.isolated())
+                continue;
+
+            Interface interface(mesh.name());
+            interface.oriented_meshes().push_back(OrientedMesh(coarse.mesh(mesh.name()),OrientedMesh::Normal));
+
+            Matrix positions(mesh.vertices().size(),3);
+            unsigned i = 0;
+            for (const auto& vertex : mesh.vertices()) {
+                for (unsigned k=0;k<3;++k)
+                    positions(i,k) = (*vertex)(k);
+                ++i;
+            }
+
+            const ClosestPoints& vertex_points = dist_points_interface(positions,interface);
+            i = 0;
+            for (const auto& vertex : mesh.vertices()) {
+                const ClosestPoint& cp = vertex_points[i++];
+                for (unsigned j=0;j<3;++j)
+                    P(vertex->index(),cp.triangle->vertex(j).index()) = cp.alphas(j);
+            }
+
+            if (!mesh.current_barrier()) {
+                Matrix centers(mesh.triangles().size(),3);
+                i = 0;
+                for (const auto& triangle : mesh.triangles()) {
+                    const Vect3& center = triangle.center();
+                    for (unsigned k=0;k<3;++k)
+                        centers(i,k) = center(k);
+                    ++i;
+                }
+
+                const ClosestPoints& center_points = dist_points_interface(centers,interface);
+                i = 0;
+                for (const auto& triangle : mesh.triangles())
+                    P(triangle.index(),center_points[i++].triangle->index()) = 1.0;
+            }
+        }
+        R = P.transpose();
+    }
+
+    //  V-cycle: z = S*r, z += P*Hc^-1*R*(r-H*z), z += S*(r-H*z) with the damped Jacobi smoother S.
+
+    Vector TwoLevelPreconditioner::operator()(const Vector& r) const {
+        Vector z(r.nlin());
+        for (unsigned i=0;i<z.nlin();++i)
+            z(i) = invdiag(i)*r(i);
+
+        z += P*coarse_solver->solve(R*(r-product(z)));
+
+        const Vector& residual = r-product(z);
+        for (unsigned i=0;i<z.nlin();++i)
+            z(i) += invdiag(i)*residual(i);
+        return z;
+    }
+}
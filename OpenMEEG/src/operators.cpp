@@ -81,8 +81,8 @@ namespace OpenMEEG {
         }
     }
 
-    void operatorDipolePotDer(const Vect3& r0,const Vect3& q,const Mesh& m,Vector& rhs,const double& coeff,const unsigned gauss_order,const bool adapt_rhs) {
-        static analyticDipPotDer anaDPD;
+    void operatorDipolePotDer(const Vect3& r0,const Vect3& q,const Mesh& m,const VectorView& rhs,const double& coeff,const unsigned gauss_order,const bool adapt_rhs) {
+        analyticDipPotDer anaDPD;
 
         Integrator<Vect3,analyticDipPotDer>* gauss = (adapt_rhs) ? new AdaptiveIntegrator<Vect3,analyticDipPotDer>(0.001) :
                                                                    new Integrator<Vect3,analyticDipPotDer>;
@@ -109,8 +109,8 @@ namespace OpenMEEG {
         delete gauss;
     }
 
-    void operatorDipolePot(const Vect3& r0,const Vect3& q,const Mesh& m,Vector& rhs,const double& coeff,const unsigned gauss_order,const bool adapt_rhs) {
-        static analyticDipPot anaDP;
+    void operatorDipolePot(const Vect3& r0,const Vect3& q,const Mesh& m,const VectorView& rhs,const double& coeff,const unsigned gauss_order,const bool adapt_rhs) {
+        analyticDipPot anaDP;
 
         anaDP.init(q,r0);
         Integrator<double,analyticDipPot>* gauss = (adapt_rhs) ? new AdaptiveIntegrator<double,analyticDipPot>(0.001) :
@@ -133,4 +133,61 @@ namespace OpenMEEG {
         }
         delete gauss;
     }
+
+    void operatorDipolePotDerGrad(const Vect3& r0,const Vect3& q,const Mesh& m,const MatrixView& rhs,const double& coeff,const unsigned gauss_order,const bool adapt_rhs) {
+        analyticDipPotDerGrad anaDPDG;
+
+        Integrator<Vect3array<3>,analyticDipPotDerGrad>* gauss = (adapt_rhs) ? new AdaptiveIntegrator<Vect3array<3>,analyticDipPotDerGrad>(0.001) :
+                                                                               new Integrator<Vect3array<3>,analyticDipPotDerGrad>;
+
+        gauss->setOrder(gauss_order);
+        #pragma omp parallel for private(anaDPDG)
+        #if defined NO_OPENMP || defined OPENMP_RANGEFOR
+        for (const auto& triangle : m.triangles()) {
+        #elif defined OPENMP_ITERATOR
+        for (Triangles::const_iterator tit=m.triangles().begin();tit<m.triangles().end();++tit) {
+            const Triangle& triangle = *tit;
+        #else
+        for (int i=0;i<m.triangles().size();++i) {
+            const Triangle& triangle = *(m.triangles().begin()+i);
+        #endif
+            anaDPDG.init(triangle,q,r0);
+            const Vect3array<3>& v = gauss->integrate(anaDPDG,triangle);
+            #pragma omp critical
+            {
+                for (unsigned i=0;i<3;++i)
+                    for (unsigned j=0;j<3;++j)
+                        rhs(triangle.vertex(i).index(),j) += v(j)(i)*coeff;
+            }
+        }
+        delete gauss;
+    }
+
+    void operatorDipolePotGrad(const Vect3& r0,const Vect3& q,const Mesh& m,const MatrixView& rhs,const double& coeff,const unsigned gauss_order,const bool adapt_rhs) {
+        analyticDipPotGrad anaDPG;
+
+        anaDPG.init(q,r0);
+        Integrator<Vect3,analyticDipPotGrad>* gauss = (adapt_rhs) ? new AdaptiveIntegrator<Vect3,analyticDipPotGrad>(0.001) :
+                                                                    new Integrator<Vect3,analyticDipPotGrad>;
+        gauss->setOrder(gauss_order);
+
+        #pragma omp parallel for
+        #if defined NO_OPENMP || defined OPENMP_RANGEFOR
+        for (const auto& triangle : m.triangles()) {
+        #elif defined OPENMP_ITERATOR
+        for (Triangles::const_iterator tit=m.triangles().begin();tit<m.triangles().end();++tit) {
+            const Triangle& triangle = *tit;
+        #else
+        for (int i=0;i<m.triangles().size();++i) {
+            const Triangle& triangle = *(m.triangles().begin()+i);
+        #endif
+            const Vect3& d = gauss->integrate(anaDPG,triangle);
+            #pragma omp critical
+            {
+                for (unsigned j=0;j<3;++j)
+                    rhs(triangle.index(),j) += d(j)*coeff;
+            }
+        }
+        delete gauss;
+    }
 }
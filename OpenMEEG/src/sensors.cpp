@@ -233,14 +233,13 @@ namespace OpenMEEG {
         Strings ci_mesh_names;
         std::vector<size_t>      ci_triangles;
 
+        const ClosestPoints& closest = dist_points_geom(m_positions,*m_geo);
         for (size_t idx=0; idx<m_positions.nlin(); ++idx) {
             Triangles triangles;
             const Vect3 current_position(m_positions(idx, 0), m_positions(idx, 1), m_positions(idx, 2));
-            Vect3 current_alphas; //not used here
-            Triangle current_nearest_triangle; // to hold the closest triangle to electrode.
+            Triangle current_nearest_triangle = *closest[idx].triangle; // to hold the closest triangle to electrode.
 
-            double dist;
-            std::string s_map=dist_point_geom(current_position, *m_geo, current_alphas, current_nearest_triangle, dist);
+            std::string s_map=closest[idx].interface->name();
             Strings::iterator sit=std::find(ci_mesh_names.begin(),ci_mesh_names.end(),s_map);
             if (sit!=ci_mesh_names.end()){
                 size_t idx2=std::distance(ci_mesh_names.begin(),sit);
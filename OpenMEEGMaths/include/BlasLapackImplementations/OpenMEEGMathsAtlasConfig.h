@@ -16,4 +16,5 @@ extern "C" {
 
 #define DGETRF(X1,X2,X3,X4,X5) LAPACK(dgetrf,DGETRF)(CblasColMajor,X1,X2,X3,X4,X5)
 #define DGETRI(X1,X2,X3,X4)    LAPACK(dgetri,DGETRI)(CblasColMajor,X1,X2,X3,X4)
+#define DGETRS(X1,X2,X3,X4,X5,X6,X7,X8,X9) X9 = LAPACK(dgetrs,DGETRS)(CblasColMajor,((X1)=='N') ? CblasNoTrans : CblasTrans,X2,X3,X4,X5,X6,X7,X8)
 
@@ -35,4 +35,5 @@
 #define DGETRF LAPACK(dgetrf,DGETRF)
 
 #define DGETRI LAPACK(dgetri,DGETRI)
+#define DGETRS LAPACK(dgetrs,DGETRS)
 #define DSPTRI LAPACK(dsptri,DSPTRI)
@@ -16,3 +16,4 @@
 
 #define DGETRF(X1,X2,X3,X4,X5,X6) LAPACK(dgetrf,DGETRF)(&X1,&X2,X3,&X4,X5,&X6)
 #define DGETRI(X1,X2,X3,X4,X5,X6,X7) LAPACK(dgetri,DGETRI)(&X1,X2,&X3,X4,X5,&X6,&X7)
+#define DGETRS(X1,X2,X3,X4,X5,X6,X7,X8,X9) LAPACK(dgetrs,DGETRS)(&X1,&X2,&X3,X4,&X5,X6,X7,&X8,&X9)
@@ -3,4 +3,5 @@
 extern "C" {
     void LAPACK(dgetrf,DGETRF)(const int&,const int&,double*,const int&,int*,int&);
     void LAPACK(dgetri,DGETRI)(const int&,double*,const int&,int*,double*,const int&,int&);
+    void LAPACK(dgetrs,DGETRS)(const char&,const int&,const int&,const double*,const int&,const int*,double*,const int&,int&);
 }
@@ -0,0 +1,97 @@
+/*
+Project Name : OpenMEEG
+
+© INRIA and ENPC (contributors: Geoffray ADDE, Maureen CLERC, Alexandre 
+GRAMFORT, Renaud KERIVEN, Jan KYBIC, Perrine LANDREAU, Théodore PAPADOPOULO,
+Emmanuel OLIVI
+Maureen.Clerc.AT.inria.fr, keriven.AT.certis.enpc.fr,
+kybic.AT.fel.cvut.cz, papadop.AT.inria.fr)
+
+The OpenMEEG software is a C++ package for solving the forward/inverse
+problems of electroencephalography and magnetoencephalography.
+
+This software is governed by the CeCILL-B license under French law and
+abiding by the rules of distribution of free software.  You can  use,
+modify and/ or redistribute the software under the terms of the CeCILL-B
+license as circulated by CEA, CNRS and INRIA at the following URL
+"http://www.cecill.info".
+
+As a counterpart to the access to the source code and  rights to copy,
+modify and redistribute granted by the license, users are provided only
+with a limited warranty  and the software's authors,  the holders of the
+economic rights,  and the successive licensors  have only  limited
+liability.
+
+In this respect, the user's attention is drawn to the risks associated
+with loading,  using,  modifying and/or developing or reproducing the
+software by the user in light of its specific status of free software,
+that may mean  that it is complicated to manipulate,  and  that  also
+therefore means  that it is reserved for developers  and  experienced
+professionals having in-depth computer knowledge. Users are therefore
+encouraged to load and test the software's suitability as regards their
+requirements in conditions enabling the security of their systems and/or
+data to be ensured and,  more generally, to use and operate it in the
+same conditions as regards security.
+
+The fact that you are presently reading this means that you have had
+knowledge of the CeCILL-B license and that you accept its terms.
+*/
+
+#pragma once
+
+#include <string>
+
+#include <OpenMEEGMathsConfig.h>
+
+namespace OpenMEEG {
+
+    /// \brief Directory holding the intermediate results of a long computation, so that it can be resumed after a crash.
+    /// Each result is saved under a name, atomically (it is written to a temporary file which is then renamed), so that
+    /// a saved result is always complete. The directory is tagged with a signature describing the computation: checkpoints
+    /// left by a different computation are discarded. A default constructed Checkpoint is disabled and saves nothing.
+
+    class OPENMEEGMATHS_EXPORT Checkpoint {
+    public:
+
+        Checkpoint() { }
+        Checkpoint(const std::string& dir,const std::string& signature);
+
+        bool enabled() const { return directory!=""; }
+
+        /// Description of an input file (name, size and modification time), to be included in a signature so that
+        /// the checkpoints are discarded whenever an input changes.
+
+        static std::string stamp(const std::string& filename);
+
+        /// Checkpoint files are prefixed so that clear() only removes them.
+
+        std::string path(const std::string& name) const { return directory+"/"+prefix+name; }
+        bool        exists(const std::string& name) const;
+
+        /// Save (atomically) or load a matrix or vector.
+
+        template <typename T>
+        void save(const std::string& name,const T& linop) const {
+            if (!enabled())
+                return;
+            const std::string& tmp = path(name+".tmp.bin");
+            linop.save(tmp);
+            commit(tmp,name);
+        }
+
+        template <typename T>
+        void load(const std::string& name,T& linop) const { linop.load(path(name)); }
+
+        /// Remove all the checkpoints (once the computation is over).
+
+        void clear() const;
+
+    private:
+
+        void commit(const std::string& tmp,const std::string& name) const;
+
+        static constexpr const char* prefix = "checkpoint_";
+
+        std::string directory;
+    };
+}
@@ -0,0 +1,145 @@
+/*
+Project Name : OpenMEEG
+
+© INRIA and ENPC (contributors: Geoffray ADDE, Maureen CLERC, Alexandre 
+GRAMFORT, Renaud KERIVEN, Jan KYBIC, Perrine LANDREAU, Théodore PAPADOPOULO,
+Emmanuel OLIVI
+Maureen.Clerc.AT.inria.fr, keriven.AT.certis.enpc.fr,
+kybic.AT.fel.cvut.cz, papadop.AT.inria.fr)
+
+The OpenMEEG software is a C++ package for solving the forward/inverse
+problems of electroencephalography and magnetoencephalography.
+
+This software is governed by the CeCILL-B license under French law and
+abiding by the rules of distribution of free software.  You can  use,
+modify and/ or redistribute the software under the terms of the CeCILL-B
+license as circulated by CEA, CNRS and INRIA at the following URL
+"http://www.cecill.info".
+
+As a counterpart to the access to the source code and  rights to copy,
+modify and redistribute granted by the license, users are provided only
+with a limited warranty  and the software's authors,  the holders of the
+economic rights,  and the successive licensors  have only  limited
+liability.
+
+In this respect, the user's attention is drawn to the risks associated
+with loading,  using,  modifying and/or developing or reproducing the
+software by the user in light of its specific status of free software,
+that may mean  that it is complicated to manipulate,  and  that  also
+therefore means  that it is reserved for developers  and  experienced
+professionals having in-depth computer knowledge. Users are therefore
+encouraged to load and test the software's suitability as regards their
+requirements in conditions enabling the security of their systems and/or
+data to be ensured and,  more generally, to use and operate it in the
+same conditions as regards security.
+
+The fact that you are presently reading this means that you have had
+knowledge of the CeCILL-B license and that you accept its terms.
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <OpenMEEGMathsConfig.h>
+#include <vector.h>
+#include <matrix.h>
+#include <linop_algebra.h>
+
+namespace OpenMEEG {
+
+    /// \brief Block low-rank compression of a leadfield (gain matrix) G, sensors x sources.
+    /// The columns (sources) are split in consecutive blocks (patches of the source space, a multiple of 3 columns
+    /// for free orientations), each block being replaced by a truncated SVD G_b ~ U_b*W_b (W_b = diag(s_b)*Vt_b).
+    /// The ranks are chosen so that ||G-Gc||_F <= tol*||G||_F (each block discards at most tol^2 of its energy).
+    /// A single block (block_size=0) gives a global truncated SVD with the same bound.
+    /// The products G*X and G'*Y only use the factors, which are stored contiguously (all the U_b form one m x R matrix),
+    /// so that they are made of one large GEMM and of small independent products per block.
+    /// The compressed leadfield is saved in its own binary format (native endianness): a header made of a tag,
+    /// the sizes m, n and the number of blocks (64 bits integers), the energy and discarded energy (doubles) and the
+    /// (width,rank) of each block (64 bits integers), followed by the values of U and of the W_b.
+
+    class OPENMEEGMATHS_EXPORT CompressedLeadfield: public ImplicitOperator {
+    public:
+
+        CompressedLeadfield(): ImplicitOperator(0,0) { }
+        CompressedLeadfield(const Matrix& G,const size_t block_size,const double tol);
+
+        /// Compress the leadfield stored in a file. Raw binary (.bin) files are read block by block,
+        /// so that the dense leadfield is never fully loaded; other formats are loaded first.
+
+        static CompressedLeadfield compress(const std::string& filename,const size_t block_size,const double tol);
+
+        /// True if the file holds a compressed leadfield (and not a dense matrix). Only the tag is read.
+
+        static bool stored_in(const std::string& filename);
+
+        size_t      size() const override { return storage.size(); }
+        std::string name() const override { return "compressed leadfield"; }
+        void        info() const override;
+
+        /// G*X and G'*Y.
+
+        Matrix apply(const Matrix& X) const override;
+        Matrix tmult(const Matrix& Y) const;
+        Vector tmult(const Vector& y) const;
+
+        /// Dense approximation of G.
+
+        Matrix decompress() const;
+
+        size_t nblocks() const { return blocks.size(); }
+        size_t rank(const size_t b) const { return blocks[b].rank; }
+        size_t total_rank() const { return R; }
+
+        /// Bound on ||G-Gc||_F/||G||_F (computed from the discarded singular values).
+
+        double relative_error() const;
+
+        void save(const std::string& filename) const;
+        void load(const std::string& filename);
+
+    private:
+
+        static constexpr char tag[8] = { 'O', 'M', 'C', 'L', 'F', 'L', 'D', '1' }; // Marks the files of compressed leadfields.
+
+        struct Block {
+            size_t col;    // first column of the block in G
+            size_t width;
+            size_t rank;
+            size_t u;      // first column of U_b in U
+            size_t w;      // offset of W_b in the values
+        };
+
+        struct Factors {
+            Matrix U;
+            Matrix W;
+            double energy;
+            double discarded;
+        };
+
+        typedef std::vector<Factors> BlockFactors;
+
+        CompressedLeadfield(const size_t m,const size_t n,const BlockFactors& factors);
+
+        static Factors      compress_block(const ConstMatrixView& B,const double tol);
+        static BlockFactors compress_blocks(const ConstMatrixView& G,const size_t block_size,const double tol);
+
+        /// Set the blocks from their widths and ranks, return the number of values (of U and of the W_b).
+
+        size_t set_blocks(const std::vector<size_t>& widths,const std::vector<size_t>& ranks);
+
+        MatrixView      U()                       { return MatrixView(storage.data(),nlin(),R,nlin()); }
+        MatrixView      W(const Block& blk)       { return MatrixView(storage.data()+blk.w,blk.rank,blk.width,blk.rank); }
+        ConstMatrixView U()                 const { return ConstMatrixView(storage.data(),nlin(),R,nlin()); }
+        ConstMatrixView W(const Block& blk) const { return ConstMatrixView(storage.data()+blk.w,blk.rank,blk.width,blk.rank); }
+
+        std::vector<Block> blocks;
+        size_t             R = 0;
+        double             energy = 0.0;
+        double             discarded = 0.0;
+        Matrix             storage; // U then the W_b, as a one column matrix
+    };
+}
@@ -0,0 +1,107 @@
+/*
+Project Name : OpenMEEG
+
+© INRIA and ENPC (contributors: Geoffray ADDE, Maureen CLERC, Alexandre 
+GRAMFORT, Renaud KERIVEN, Jan KYBIC, Perrine LANDREAU, Théodore PAPADOPOULO,
+Emmanuel OLIVI
+Maureen.Clerc.AT.inria.fr, keriven.AT.certis.enpc.fr,
+kybic.AT.fel.cvut.cz, papadop.AT.inria.fr)
+
+The OpenMEEG software is a C++ package for solving the forward/inverse
+problems of electroencephalography and magnetoencephalography.
+
+This software is governed by the CeCILL-B license under French law and
+abiding by the rules of distribution of free software.  You can  use,
+modify and/ or redistribute the software under the terms of the CeCILL-B
+license as circulated by CEA, CNRS and INRIA at the following URL
+"http://www.cecill.info".
+
+As a counterpart to the access to the source code and  rights to copy,
+modify and redistribute granted by the license, users are provided only
+with a limited warranty  and the software's authors,  the holders of the
+economic rights,  and the successive licensors  have only  limited
+liability.
+
+In this respect, the user's attention is drawn to the risks associated
+with loading,  using,  modifying and/or developing or reproducing the
+software by the user in light of its specific status of free software,
+that may mean  that it is complicated to manipulate,  and  that  also
+therefore means  that it is reserved for developers  and  experienced
+professionals having in-depth computer knowledge. Users are therefore
+encouraged to load and test the software's suitability as regards their
+requirements in conditions enabling the security of their systems and/or
+data to be ensured and,  more generally, to use and operate it in the
+same conditions as regards security.
+
+The fact that you are presently reading this means that you have had
+knowledge of the CeCILL-B license and that you accept its terms.
+*/
+
+#pragma once
+
+#include <string>
+
+#include <OpenMEEGMathsConfig.h>
+
+namespace OpenMEEG {
+
+    /// \brief Sharing of the cores between the OpenMP loops of OpenMEEG and the threads of the BLAS library.
+    /// threads is the number of threads of the OpenMP loops (operators, assembly, blocked products) and blas_threads
+    /// the number of threads of the dense BLAS/LAPACK calls (factorizations, inversions, large products) made outside
+    /// of these loops. Zero means the default (the OpenMP default for threads, threads for blas_threads).
+    /// With a binding, the OpenMP threads are pinned to the cores, either packed (CLOSE) or evenly distributed (SPREAD).
+    /// Binding is done by the OpenMP runtime, which reads it from its environment when it starts (see set_thread_binding).
+
+    struct OPENMEEGMATHS_EXPORT ExecutionPolicy {
+
+        enum Binding { NO_BINDING, CLOSE, SPREAD };
+
+        unsigned threads      = 0;
+        unsigned blas_threads = 0;
+        Binding  binding      = NO_BINDING;
+
+        /// Binding from its name ("none", "close" or "spread"), throws std::invalid_argument for other names.
+
+        static Binding binding_from_string(const std::string& name);
+    };
+
+    /// Apply the policy to the process and keep it for the execution stages. The returned policy has its defaults resolved.
+
+    OPENMEEGMATHS_EXPORT const ExecutionPolicy& set_execution_policy(const ExecutionPolicy& policy);
+    OPENMEEGMATHS_EXPORT const ExecutionPolicy& execution_policy();
+
+    /// Set OMP_PROC_BIND and OMP_PLACES (cores) for the binding, unless they are defined by the user, and return true
+    /// if the OpenMP runtime binds its threads. Runtimes which read their environment when the program is loaded
+    /// (GNU OpenMP) must then be restarted for the binding to be applied (as done by execution_options).
+
+    OPENMEEGMATHS_EXPORT bool set_thread_binding(const ExecutionPolicy::Binding binding);
+
+    /// Number of threads of the BLAS library (0 if it cannot be controlled, e.g. with vecLib or a non threaded BLAS).
+
+    OPENMEEGMATHS_EXPORT unsigned blas_threads();
+    OPENMEEGMATHS_EXPORT bool     set_blas_threads(const unsigned n);
+
+    /// \brief Scope of a stage of computation, switching the BLAS threads for its duration.
+    /// OPENMP_LOOPS: stage running its own OpenMP loops which may call BLAS, which is made sequential.
+    /// DENSE_ALGEBRA: stage made of large BLAS/LAPACK calls, which get the blas_threads of the policy, or are
+    /// made sequential when the stage is itself run inside a parallel region (MKL only, the other libraries are
+    /// left sequential by the enclosing OPENMP_LOOPS stage).
+
+    class OPENMEEGMATHS_EXPORT ExecutionStage {
+    public:
+
+        enum Kind { OPENMP_LOOPS, DENSE_ALGEBRA };
+
+        ExecutionStage(const Kind kind);
+        ~ExecutionStage();
+
+        ExecutionStage(const ExecutionStage&) = delete;
+        ExecutionStage& operator=(const ExecutionStage&) = delete;
+
+    private:
+
+        unsigned previous;
+        bool     restore;
+        bool     local;
+    };
+}
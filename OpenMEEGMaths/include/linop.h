@@ -41,6 +41,7 @@ knowledge of the CeCILL-B license and that you accept its terms.
 
 #include <cstdlib>
 #include <cmath>
+#include <memory>
 
 #ifdef HAVE_SHARED_PTR_ARRAY_SUPPORT
 #include <memory>
@@ -121,16 +122,78 @@ namespace OpenMEEG {
 
     typedef enum { DEEP_COPY } DeepCopy;
 
+    /// Memory provider for the values of vectors and dense matrices.
+    /// Allocation returns uninitialized memory: pages are physically placed on first write,
+    /// which is why values are initialized by first_touch with the same static schedule
+    /// as the OpenMP loops that later use them.
+    /// The allocator can be replaced with Allocator::use (before any computation, this is not thread safe).
+    /// Each block of values keeps a reference to the allocator that created it.
+
+    class OPENMEEGMATHS_EXPORT Allocator {
+    public:
+
+        typedef enum { NO_HUGE_PAGES, TRANSPARENT_HUGE_PAGES, EXPLICIT_HUGE_PAGES } HugePages;
+
+        virtual ~Allocator() { }
+
+        virtual double* allocate(const size_t n) = 0;
+        virtual void    deallocate(double* ptr,const size_t n) = 0;
+
+        static const std::shared_ptr<Allocator>& current() { return allocator(); }
+        static void use(const std::shared_ptr<Allocator>& alloc) { allocator() = alloc; }
+
+    private:
+
+        static std::shared_ptr<Allocator>& allocator();
+    };
+
+    /// Default allocator: 64 bytes (cache line and AVX-512) aligned memory.
+    /// Blocks larger than threshold bytes may be backed by huge pages, either transparent
+    /// (madvise) or explicit (hugetlbfs pages, falling back to normal pages when none is available).
+    /// Huge pages are only available on Linux and are silently ignored elsewhere.
+
+    class OPENMEEGMATHS_EXPORT AlignedAllocator: public Allocator {
+    public:
+
+        static constexpr size_t alignment = 64;
+
+        AlignedAllocator(const HugePages hp=NO_HUGE_PAGES,const size_t thresh=(1<<21)): huge_pages(hp),threshold(thresh) { }
+
+        double* allocate(const size_t n) override;
+        void    deallocate(double* ptr,const size_t n) override;
+
+        HugePages huge_page_mode() const { return huge_pages; }
+
+    private:
+
+        bool use_huge_pages(const size_t n) const { return huge_pages!=NO_HUGE_PAGES && n*sizeof(double)>=threshold; }
+
+        const HugePages huge_pages;
+        const size_t    threshold;
+    };
+
+    /// Parallel initialization of freshly allocated values.
+
+    OPENMEEGMATHS_EXPORT void first_touch(double* ptr,const size_t n,const double val);
+    OPENMEEGMATHS_EXPORT void first_touch(double* ptr,const size_t n,const double* initval);
+
     struct OPENMEEGMATHS_EXPORT LinOpValue: public SharedPtr<double[]> {
         typedef SharedPtr<double[]> base;
 
         LinOpValue(): base(0) { }
-        LinOpValue(const size_t n): base(new double[n]) { }
-        LinOpValue(const size_t n,const double* initval): LinOpValue(n) { std::copy(initval,initval+n,&(*this)[0]); }
+        LinOpValue(const size_t n): base(allocate(n)) { }
+        LinOpValue(const size_t n,const double* initval): LinOpValue(n) { first_touch(&(*this)[0],n,initval); }
         LinOpValue(const size_t n,const LinOpValue& v):   LinOpValue(n,&(v[0])) { }
 
         ~LinOpValue() { }
 
         bool empty() const { return static_cast<bool>(*this); }
+
+    private:
+
+        static base allocate(const size_t n) {
+            const std::shared_ptr<Allocator>& alloc = Allocator::current();
+            return base(alloc->allocate(n),[alloc,n](double* ptr) { alloc->deallocate(ptr,n); });
+        }
     };
 }
@@ -0,0 +1,378 @@
+/*
+Project Name : OpenMEEG
+
+© INRIA and ENPC (contributors: Geoffray ADDE, Maureen CLERC, Alexandre 
+GRAMFORT, Renaud KERIVEN, Jan KYBIC, Perrine LANDREAU, Théodore PAPADOPOULO,
+Emmanuel OLIVI
+Maureen.Clerc.AT.inria.fr, keriven.AT.certis.enpc.fr,
+kybic.AT.fel.cvut.cz, papadop.AT.inria.fr)
+
+The OpenMEEG software is a C++ package for solving the forward/inverse
+problems of electroencephalography and magnetoencephalography.
+
+This software is governed by the CeCILL-B license under French law and
+abiding by the rules of distribution of free software.  You can  use,
+modify and/ or redistribute the software under the terms of the CeCILL-B
+license as circulated by CEA, CNRS and INRIA at the following URL
+"http://www.cecill.info".
+
+As a counterpart to the access to the source code and  rights to copy,
+modify and redistribute granted by the license, users are provided only
+with a limited warranty  and the software's authors,  the holders of the
+economic rights,  and the successive licensors  have only  limited
+liability.
+
+In this respect, the user's attention is drawn to the risks associated
+with loading,  using,  modifying and/or developing or reproducing the
+software by the user in light of its specific status of free software,
+that may mean  that it is complicated to manipulate,  and  that  also
+therefore means  that it is reserved for developers  and  experienced
+professionals having in-depth computer knowledge. Users are therefore
+encouraged to load and test the software's suitability as regards their
+requirements in conditions enabling the security of their systems and/or
+data to be ensured and,  more generally, to use and operate it in the
+same conditions as regards security.
+
+The fact that you are presently reading this means that you have had
+knowledge of the CeCILL-B license and that you accept its terms.
+*/
+
+#pragma once
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <OpenMEEGMathsConfig.h>
+#include <linop.h>
+#include <vector.h>
+#include <matrix.h>
+#include <symmatrix.h>
+#include <sparse_matrix.h>
+
+namespace OpenMEEG {
+
+    class ImplicitOperator;
+
+    typedef std::shared_ptr<const ImplicitOperator> Operator;
+
+    /// \brief Linear operator only known through its action on blocks of vectors (the columns of a matrix)
+    /// and, when available, through the solution of the corresponding linear systems.
+    /// Operators are combined (sums, products, scaling, rank-k updates, block structures) without ever
+    /// forming the matrix of the combination: composite operators keep handles to their terms and apply them in turn.
+
+    class OPENMEEGMATHS_EXPORT ImplicitOperator: public LinOp {
+    public:
+
+        ImplicitOperator(const size_t m,const size_t n): LinOp(m,n,FULL,2) { }
+        virtual ~ImplicitOperator() { }
+
+        /// Number of values stored by the operator (including those of its terms).
+
+        size_t size() const override { return 0; }
+        void   info() const override;
+
+        virtual std::string name() const = 0;
+
+        /// Return A*X.
+
+        virtual Matrix apply(const Matrix& X) const = 0;
+
+        /// Return the solution X of A*X = B (only when invertible() is true, otherwise maths::NotInvertible is thrown).
+
+        virtual bool   invertible() const { return false; }
+        virtual Matrix apply_inverse(const Matrix& B) const;
+
+        Matrix operator*(const Matrix& X) const {
+            om_assert(X.nlin()==ncol());
+            return apply(X);
+        }
+
+        Vector operator*(const Vector& x) const;
+
+        Matrix solve(const Matrix& B) const {
+            om_assert(nlin()==ncol() && B.nlin()==nlin());
+            return apply_inverse(B);
+        }
+
+        Vector solve(const Vector& b) const;
+    };
+
+    /// Operators of stored matrices. Full and symmetric matrices share their values with the operator,
+    /// sparse matrices are referenced and must outlive it.
+    /// The first solve factorizes a copy of the matrix (LU for full matrices, Bunch-Kaufman for symmetric ones),
+    /// the factorization is then reused.
+
+    class OPENMEEGMATHS_EXPORT MatrixOperator: public ImplicitOperator {
+    public:
+
+        MatrixOperator(const Matrix& M): ImplicitOperator(M.nlin(),M.ncol()),A(M) { }
+
+        size_t      size() const override { return A.size()+LU.size()+pivots.size(); }
+        std::string name() const override { return "full matrix"; }
+
+        Matrix apply(const Matrix& X) const override { return A*X; }
+
+        bool   invertible() const override { return nlin()==ncol(); }
+        Matrix apply_inverse(const Matrix& B) const override;
+
+    private:
+
+        void factorize() const;
+
+        const Matrix                  A;
+        mutable Matrix                LU;
+        mutable std::vector<BLAS_INT> pivots;
+        mutable std::once_flag        factorized;
+    };
+
+    class OPENMEEGMATHS_EXPORT SymMatrixOperator: public ImplicitOperator {
+    public:
+
+        SymMatrixOperator(const SymMatrix& M): ImplicitOperator(M.nlin(),M.ncol()),A(M) { }
+
+        size_t      size() const override { return (factorization) ? 2*A.size() : A.size(); }
+        std::string name() const override { return "symmetric matrix"; }
+
+        Matrix apply(const Matrix& X) const override { return A*X; }
+
+        bool   invertible() const override { return true; }
+        Matrix apply_inverse(const Matrix& B) const override;
+
+    private:
+
+        const SymMatrix                                 A;
+        mutable std::shared_ptr<SymMatrixFactorization> factorization;
+        mutable std::once_flag                          factorized;
+    };
+
+    class OPENMEEGMATHS_EXPORT SparseMatrixOperator: public ImplicitOperator {
+    public:
+
+        SparseMatrixOperator(const SparseMatrix& M): ImplicitOperator(M.nlin(),M.ncol()),A(M) { }
+
+        size_t      size() const override { return A.size(); }
+        std::string name() const override { return "sparse matrix"; }
+
+        Matrix apply(const Matrix& X) const override { return A*X; }
+
+    private:
+
+        const SparseMatrix& A;
+    };
+
+    class OPENMEEGMATHS_EXPORT DiagonalOperator: public ImplicitOperator {
+    public:
+
+        DiagonalOperator(const Vector& d): ImplicitOperator(d.nlin(),d.nlin()),diag(d) { }
+
+        size_t      size() const override { return diag.size(); }
+        std::string name() const override { return "diagonal"; }
+
+        Matrix apply(const Matrix& X) const override;
+
+        bool   invertible() const override { return true; }
+        Matrix apply_inverse(const Matrix& B) const override;
+
+        const Vector& diagonal() const { return diag; }
+
+    private:
+
+        const Vector diag;
+    };
+
+    /// alpha*A.
+
+    class OPENMEEGMATHS_EXPORT ScaledOperator: public ImplicitOperator {
+    public:
+
+        ScaledOperator(const double a,const Operator& op): ImplicitOperator(op->nlin(),op->ncol()),alpha(a),A(op) { }
+
+        size_t      size() const override { return A->size(); }
+        std::string name() const override { return "scaled "+A->name(); }
+
+        Matrix apply(const Matrix& X) const override;
+
+        bool   invertible() const override { return alpha!=0.0 && A->invertible(); }
+        Matrix apply_inverse(const Matrix& B) const override;
+
+    private:
+
+        const double   alpha;
+        const Operator A;
+    };
+
+    /// A1+A2+...+An.
+
+    class OPENMEEGMATHS_EXPORT SumOperator: public ImplicitOperator {
+    public:
+
+        SumOperator(const std::vector<Operator>& ops);
+
+        size_t      size() const override;
+        std::string name() const override { return "sum"; }
+
+        Matrix apply(const Matrix& X) const override;
+
+    private:
+
+        const std::vector<Operator> terms;
+    };
+
+    /// A1*A2*...*An (An is applied first). The product is invertible when all its factors are.
+
+    class OPENMEEGMATHS_EXPORT ProductOperator: public ImplicitOperator {
+    public:
+
+        ProductOperator(const std::vector<Operator>& ops);
+
+        size_t      size() const override;
+        std::string name() const override { return "product"; }
+
+        Matrix apply(const Matrix& X) const override;
+
+        bool   invertible() const override;
+        Matrix apply_inverse(const Matrix& B) const override;
+
+    private:
+
+        const std::vector<Operator> factors;
+    };
+
+    /// U*C*V' with U (m x k), C (k x l) and V (n x l): O((m+n)k) values instead of the m x n matrix.
+
+    class OPENMEEGMATHS_EXPORT LowRankOperator: public ImplicitOperator {
+    public:
+
+        LowRankOperator(const Matrix& u,const Matrix& c,const Matrix& v);
+
+        size_t      size() const override { return U.size()+C.size()+((V.data()==U.data()) ? 0 : V.size()); }
+        std::string name() const override { return "low rank"; }
+
+        Matrix apply(const Matrix& X) const override { return U*(C*V.tmult(X)); }
+
+        /// Diagonal of U*C*V' (square operators only).
+
+        Vector diagonal() const;
+
+        const Matrix& left()   const { return U; }
+        const Matrix& middle() const { return C; }
+        const Matrix& right()  const { return V; }
+
+    private:
+
+        const Matrix U;
+        const Matrix C;
+        const Matrix V;
+    };
+
+    /// A+U*C*V'. Systems are solved with the Sherman-Morrison-Woodbury formula
+    /// (A+UCV')^-1 = A^-1-W*(I+CV'W)^-1*C*V'*A^-1 with W = A^-1*U, which only requires solves with A.
+    /// W and the small k x k matrix are computed at the first solve.
+
+    class OPENMEEGMATHS_EXPORT RankUpdateOperator: public ImplicitOperator {
+    public:
+
+        RankUpdateOperator(const Operator& op,const std::shared_ptr<const LowRankOperator>& upd);
+
+        size_t      size() const override { return A->size()+update->size()+W.size()+K.size(); }
+        std::string name() const override { return "rank updated "+A->name(); }
+
+        Matrix apply(const Matrix& X) const override;
+
+        bool   invertible() const override { return A->invertible(); }
+        Matrix apply_inverse(const Matrix& B) const override;
+
+    private:
+
+        const Operator                               A;
+        const std::shared_ptr<const LowRankOperator> update;
+        mutable Matrix                               W;
+        mutable Matrix                               K;
+        mutable std::once_flag                       factorized;
+    };
+
+    /// diag(A1,A2,...,An). Blocks may be rectangular. Blocks are solved independently.
+
+    class OPENMEEGMATHS_EXPORT BlockDiagonalOperator: public ImplicitOperator {
+    public:
+
+        BlockDiagonalOperator(const std::vector<Operator>& ops);
+
+        size_t      size() const override;
+        std::string name() const override { return "block diagonal"; }
+
+        Matrix apply(const Matrix& X) const override;
+
+        bool   invertible() const override;
+        Matrix apply_inverse(const Matrix& B) const override;
+
+    private:
+
+        const std::vector<Operator> blocks;
+    };
+
+    /// Operator given by blocks, null blocks being zero (each line and each column of blocks must contain
+    /// at least one non null block). Block triangular operators with invertible diagonal blocks are solved
+    /// by block substitution.
+
+    class OPENMEEGMATHS_EXPORT BlockStructuredOperator: public ImplicitOperator {
+    public:
+
+        typedef std::vector<std::vector<Operator>> Blocks;
+
+        BlockStructuredOperator(const Blocks& ops);
+
+        size_t      size() const override;
+        std::string name() const override { return "block"; }
+
+        Matrix apply(const Matrix& X) const override;
+
+        bool   invertible() const override;
+        Matrix apply_inverse(const Matrix& B) const override;
+
+    private:
+
+        bool lower_triangular() const;
+        bool upper_triangular() const;
+
+        const Blocks        blocks;
+        std::vector<size_t> line_offsets;
+        std::vector<size_t> col_offsets;
+    };
+
+    // Construction of operators.
+
+    inline Operator as_operator(const Matrix& A)       { return std::make_shared<MatrixOperator>(A);       }
+    inline Operator as_operator(const SymMatrix& A)    { return std::make_shared<SymMatrixOperator>(A);    }
+    inline Operator as_operator(const SparseMatrix& A) { return std::make_shared<SparseMatrixOperator>(A); }
+
+    inline Operator diagonal_operator(const Vector& d) { return std::make_shared<DiagonalOperator>(d); }
+
+    inline Operator identity_operator(const size_t n) {
+        Vector ones(n);
+        ones.set(1.0);
+        return diagonal_operator(ones);
+    }
+
+    inline Operator scaled(const double alpha,const Operator& A)   { return std::make_shared<ScaledOperator>(alpha,A); }
+    inline Operator sum(const std::vector<Operator>& terms)        { return std::make_shared<SumOperator>(terms);      }
+    inline Operator product(const std::vector<Operator>& factors)  { return std::make_shared<ProductOperator>(factors); }
+
+    inline std::shared_ptr<const LowRankOperator> low_rank(const Matrix& U,const Matrix& C,const Matrix& V) {
+        return std::make_shared<LowRankOperator>(U,C,V);
+    }
+
+    inline std::shared_ptr<const LowRankOperator> low_rank(const Matrix& U,const Matrix& C) { return low_rank(U,C,U); }
+
+    inline Operator rank_update(const Operator& A,const std::shared_ptr<const LowRankOperator>& update) {
+        return std::make_shared<RankUpdateOperator>(A,update);
+    }
+
+    inline Operator rank_update(const Operator& A,const Matrix& U,const Matrix& C,const Matrix& V) { return rank_update(A,low_rank(U,C,V)); }
+    inline Operator rank_update(const Operator& A,const Matrix& U,const Matrix& C)                 { return rank_update(A,low_rank(U,C));   }
+
+    inline Operator block_diagonal(const std::vector<Operator>& blocks) { return std::make_shared<BlockDiagonalOperator>(blocks); }
+    inline Operator block_operator(const BlockStructuredOperator::Blocks& blocks) { return std::make_shared<BlockStructuredOperator>(blocks); }
+}
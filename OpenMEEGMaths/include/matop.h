@@ -39,26 +39,157 @@ knowledge of the CeCILL-B license and that you accept its terms.
 
 #pragma once
 
+#include <limits>
+#include <string>
+#include <cstdint>
+#include <fstream>
+#include <algorithm>
+
+#include "Exceptions.H"
 #include "matrix.h"
 #include "sparse_matrix.h"
+#include "svd.h"
 
 namespace OpenMEEG {
 
-    inline Matrix
-    nullspace_projector(const Matrix& M) {
-        const size_t Nl = M.nlin();
-        const size_t Nc = M.ncol();
+    /// \brief Orthogonal projector on the null space of M: P = I-V*V^T with V an orthonormal basis of
+    /// the row space of M (obtained by a thin SVD of M).
+    /// P is applied without being formed: P*X costs O(n*r*p) instead of O(n^2*p), and V (n x r) is
+    /// stored instead of the n x n projector. An explicit projector matrix can also be wrapped.
+
+    class NullSpaceProjector {
+    public:
+
+        NullSpaceProjector() { }
+
+        /// Singular values below reltol*s_max (default: max(m,n)*epsilon) are considered as zero.
+
+        explicit NullSpaceProjector(const Matrix& M,double reltol=0.0) {
+            if (reltol==0.0)
+                reltol = std::max(M.nlin(),M.ncol())*std::numeric_limits<double>::epsilon();
+            Vt = truncated_svd(M,reltol).Vt;
+        }
+
+        /// Wrap a projector given either as the basis V^T (r x n) or as an explicit n x n matrix.
+
+        static NullSpaceProjector from_basis(const Matrix& Vt)  { NullSpaceProjector P; P.Vt = Vt; return P; }
+        static NullSpaceProjector from_matrix(const Matrix& Pm) { NullSpaceProjector P; P.P  = Pm; return P; }
+
+        bool   explicit_matrix() const { return P.nlin()!=0;                      }
+        size_t size()            const { return explicit_matrix() ? P.nlin() : Vt.ncol(); }
+
+        /// \brief Dimension of the null space.
+
+        size_t rank() const;
+
+        /// \brief The row space basis V^T (empty for a wrapped explicit matrix).
+
+        const Matrix& basis() const { return Vt; }
+
+        /// \brief P*X (P is symmetric: this is also (X^T*P)^T).
+
+        Matrix operator*(const Matrix& X) const {
+            if (explicit_matrix())
+                return P*X;
+            Matrix res(X,DEEP_COPY);
+            gemm(true,false,-1.0,Vt.view(),(Vt*X).view(),1.0,res.view());
+            return res;
+        }
+
+        /// \brief Save the projector. The basis is stored in its own binary format (native endianness): tag,
+        /// version, r and n (64 bits unsigned integers), then V^T (column major). A wrapped explicit matrix is
+        /// saved as a matrix (the legacy format).
 
-        Matrix U,V;
-        SparseMatrix D;
-        M.svd(U,D,V);
+        void save(const std::string& filename) const;
 
-        // Set S to 0 everywhere, except in the last part of the diag:
+        /// \brief Load a projector saved by save() or, if the file does not start with the tag, a legacy
+        /// explicit n x n projector.
 
-        SparseMatrix S(Nc,Nc);
-        for (unsigned i=Nl;i<Nc;++i)
-            S(i,i) = 1.0;
+        static NullSpaceProjector load(const std::string& filename);
 
-        return (V.transpose()*S)*V; // P is a projector: P^2 = P and mat*P*X = 0
+        /// \brief P*X^T, for a X given by lines (X^T is formed by the blocked transposition).
+
+        Matrix multt(const Matrix& X) const {
+            if (explicit_matrix())
+                return P.multt(X);
+            Matrix res = X.transpose();
+            gemm(true,false,-1.0,Vt.view(),Vt.multt(X).view(),1.0,res.view());
+            return res;
+        }
+
+        /// \brief The explicit projector matrix (n x n).
+
+        Matrix matrix() const {
+            if (explicit_matrix())
+                return P;
+            Matrix res(size(),size());
+            res.set(0.0);
+            for (size_t i=0;i<size();++i)
+                res(i,i) = 1.0;
+            gemm(true,false,-1.0,Vt.view(),Vt.view(),1.0,res.view());
+            return res;
+        }
+
+        static constexpr char     tag[8]  = { 'O', 'M', 'N', 'S', 'P', 'R', 'O', 'J' }; // Marks the files of projectors stored by their basis.
+        static constexpr uint64_t version = 1;
+
+    private:
+
+        Matrix Vt;
+        Matrix P;
+    };
+
+    inline void NullSpaceProjector::save(const std::string& filename) const {
+        if (explicit_matrix()) {
+            P.save(filename);
+            return;
+        }
+        std::ofstream ofs(filename.c_str(),std::ios::binary);
+        if (!ofs)
+            throw maths::BadFileOpening(filename,maths::BadFileOpening::WRITE);
+        const uint64_t header[3] = { version, Vt.nlin(), Vt.ncol() };
+        ofs.write(tag,sizeof tag);
+        ofs.write(reinterpret_cast<const char*>(header),sizeof header);
+        ofs.write(reinterpret_cast<const char*>(Vt.data()),Vt.size()*sizeof(double));
+        if (!ofs)
+            throw maths::BadFileOpening(filename,maths::BadFileOpening::WRITE);
+    }
+
+    inline NullSpaceProjector NullSpaceProjector::load(const std::string& filename) {
+        std::ifstream ifs(filename.c_str(),std::ios::binary);
+        if (!ifs)
+            throw maths::BadFileOpening(filename,maths::BadFileOpening::READ);
+        char file_tag[sizeof tag];
+        if (!ifs.read(file_tag,sizeof tag) || !std::equal(file_tag,file_tag+sizeof tag,tag)) {
+            const Matrix stored(filename);
+            if (stored.nlin()!=stored.ncol())
+                throw maths::BadContent(filename,"null space projector");
+            return from_matrix(stored);
+        }
+
+        uint64_t header[3];
+        if (!ifs.read(reinterpret_cast<char*>(header),sizeof header) || header[0]!=version || header[1]>header[2])
+            throw maths::BadContent(filename,"null space projector");
+        Matrix basis(header[1],header[2]);
+        ifs.read(reinterpret_cast<char*>(basis.data()),basis.size()*sizeof(double));
+        if (!ifs || ifs.peek()!=std::char_traits<char>::eof())
+            throw maths::BadContent(filename,"null space projector");
+        return from_basis(basis);
+    }
+
+    //  For an explicit projector, the null space dimension is its trace.
+
+    inline size_t NullSpaceProjector::rank() const {
+        if (!explicit_matrix())
+            return Vt.ncol()-Vt.nlin();
+        double trace = 0.0;
+        for (size_t i=0;i<P.nlin();++i)
+            trace += P(i,i);
+        return static_cast<size_t>(trace+0.5);
+    }
+
+    inline Matrix
+    nullspace_projector(const Matrix& M) {
+        return NullSpaceProjector(M).matrix(); // P is a projector: P^2 = P and mat*P*X = 0
     }
 }
@@ -45,6 +45,7 @@ knowledge of the CeCILL-B license and that you accept its terms.
 #include <string>
 
 #include <linop.h>
+#include <views.h>
 #include <MathsIO.H>
 #include <symmatrix.h>
 
@@ -77,6 +78,7 @@ namespace OpenMEEG {
 
         explicit Matrix(const SymMatrix& A);
         explicit Matrix(const SparseMatrix& A);
+        explicit Matrix(const ConstMatrixView& A);
 
         Matrix(const Vector& v,const size_t M,const size_t N);
 
@@ -108,6 +110,19 @@ namespace OpenMEEG {
 
         inline double& operator()(size_t i,size_t j) ;
 
+        /// \brief Get (non-owning) views of the Matrix, of a block, of a column or of a line.
+        /// Contrarily to submat, getcol and getlin, no value is copied. Views of a const Matrix are read-only.
+
+        MatrixView view() { return MatrixView(data(),nlin(),ncol(),nlin()); }
+        MatrixView view(size_t istart, size_t isize, size_t jstart, size_t jsize) { return view().submat(istart,isize,jstart,jsize); }
+        VectorView col_view(size_t j) { return view().getcol(j); }
+        VectorView lin_view(size_t i) { return view().getlin(i); }
+
+        ConstMatrixView view() const { return ConstMatrixView(data(),nlin(),ncol(),nlin()); }
+        ConstMatrixView view(size_t istart, size_t isize, size_t jstart, size_t jsize) const { return view().submat(istart,isize,jstart,jsize); }
+        ConstVectorView col_view(size_t j) const { return view().getcol(j); }
+        ConstVectorView lin_view(size_t i) const { return view().getlin(i); }
+
         Matrix submat(size_t istart, size_t isize, size_t jstart, size_t jsize) const;
         void insertmat(size_t istart, size_t jstart, const Matrix& B);
         Vector getcol(size_t j) const;
@@ -131,9 +146,14 @@ namespace OpenMEEG {
 
         Vector operator*(const Vector& v) const;
         Vector tmult(const Vector &v) const;
-        Matrix tmult(const Matrix &m) const;
-        Matrix multt(const Matrix &m) const;
-        Matrix tmultt(const Matrix &m) const;
+
+        /// \brief Products with transposed operands: op(*this)*op(B) with op(X) = X^T when the
+        /// corresponding flag is set. Transposes are handled by BLAS and never formed.
+
+        Matrix mult(const Matrix& B,const bool transA,const bool transB) const;
+        Matrix tmult(const Matrix& B)  const { return mult(B,true,false); } ///< (*this)^T*B
+        Matrix multt(const Matrix& B)  const { return mult(B,false,true); } ///< (*this)*B^T
+        Matrix tmultt(const Matrix& B) const { return mult(B,true,true);  } ///< (*this)^T*B^T
 
         Vector mean() const;
         Vector tmean() const;
@@ -208,72 +228,132 @@ namespace OpenMEEG {
         return y;
     }
 
-    inline Matrix Matrix::submat(size_t istart, size_t isize, size_t jstart, size_t jsize) const {
-        om_assert (istart+isize<=nlin() && jstart+jsize<=ncol());
+    //  BLAS-backed operations on views.
 
-        Matrix a(isize,jsize);
-        const int sz = sizet_to_int(isize);
-        
-        for (size_t j=0; j<jsize; j++) {
+    inline void copy(const ConstVectorView& x,const VectorView& y) {
+        om_assert(x.size()==y.size());
     #ifdef HAVE_BLAS
-            BLAS(dcopy,DCOPY)(sz,data()+istart+(jstart+j)*nlin(),1,a.data()+j*isize,1);
+        BLAS(dcopy,DCOPY)(sizet_to_int(x.size()),x.data(),sizet_to_int(x.inc()),y.data(),sizet_to_int(y.inc()));
     #else
-            for (size_t i=0; i<isize; i++)
-                a(i,j) = (*this)(istart+i,jstart+j);
+        for (size_t i=0;i<x.size();++i) y(i) = x(i);
     #endif
-        }
-        return a;
     }
 
-    inline void Matrix::insertmat(size_t istart, size_t jstart, const Matrix& B) {
-        om_assert (istart+B.nlin()<=nlin() && jstart+B.ncol()<=ncol() );
-        for (size_t j=0; j<B.ncol(); j++) {
-            for (size_t i=0; i<B.nlin(); i++) {
-                (*this)(istart+i,jstart+j)=B(i,j);
-            }
-        }
+    inline void copy(const ConstMatrixView& A,const MatrixView& B) {
+        om_assert(A.nlin()==B.nlin() && A.ncol()==B.ncol());
+        for (size_t j=0;j<A.ncol();++j)
+            copy(A.getcol(j),B.getcol(j));
     }
 
-    inline Vector Matrix::getcol(size_t j) const {
-        om_assert(j<ncol());
-        Vector v(nlin());
+    inline double dot(const ConstVectorView& x,const ConstVectorView& y) {
+        om_assert(x.size()==y.size());
     #ifdef HAVE_BLAS
-        BLAS(dcopy,DCOPY)(sizet_to_int(nlin()),data()+nlin()*j,1,v.data(),1);
+        return BLAS(ddot,DDOT)(sizet_to_int(x.size()),x.data(),sizet_to_int(x.inc()),y.data(),sizet_to_int(y.inc()));
     #else
-        for (size_t i=0;i<nlin();i++) v.data()[i]=data()[i+nlin()*j];
+        double s = 0.0;
+        for (size_t i=0;i<x.size();++i) s += x(i)*y(i);
+        return s;
     #endif
-        return v;
     }
 
-    inline Vector Matrix::getlin(size_t i) const {
-        om_assert(i<nlin());
-        Vector v(ncol());
+    /// \brief y = alpha*x+y
+
+    inline void axpy(const double alpha,const ConstVectorView& x,const VectorView& y) {
+        om_assert(x.size()==y.size());
     #ifdef HAVE_BLAS
-        BLAS(dcopy,DCOPY)(sizet_to_int(ncol()),data()+i,sizet_to_int(nlin()),v.data(),1);
+        BLAS(daxpy,DAXPY)(sizet_to_int(x.size()),alpha,x.data(),sizet_to_int(x.inc()),y.data(),sizet_to_int(y.inc()));
     #else
-        for (size_t j=0;j<ncol();j++) v.data()[j]=data()[i+nlin()*j];
+        for (size_t i=0;i<x.size();++i) y(i) += alpha*x(i);
     #endif
-        return v;
     }
 
-    inline void Matrix::setcol(size_t j,const Vector& v) {
-        om_assert(v.size()==nlin() && j<ncol());
+    /// \brief y = alpha*op(A)*x+beta*y, with op(A) = A^T if transA and A otherwise.
+
+    inline void gemv(const bool transA,const double alpha,const ConstMatrixView& A,const ConstVectorView& x,const double beta,const VectorView& y) {
+        om_assert(x.size()==(transA ? A.nlin() : A.ncol()) && y.size()==(transA ? A.ncol() : A.nlin()));
+        if (A.nlin()==0 || A.ncol()==0) { // Nothing for BLAS (and the leading dimension of A may be 0).
+            for (size_t i=0;i<y.size();++i) y(i) = (beta==0.0) ? 0.0 : beta*y(i);
+            return;
+        }
     #ifdef HAVE_BLAS
-        BLAS(dcopy,DCOPY)(sizet_to_int(nlin()),v.data(),1,data()+nlin()*j,1);
+        DGEMV((transA ? CblasTrans : CblasNoTrans),sizet_to_int(A.nlin()),sizet_to_int(A.ncol()),
+              alpha,A.data(),sizet_to_int(A.ld()),x.data(),sizet_to_int(x.inc()),beta,y.data(),sizet_to_int(y.inc()));
     #else
-        for (size_t i=0;i<nlin();i++) data()[i+nlin()*j]=v.data()[i];
+        for (size_t i=0;i<y.size();++i) {
+            double s = 0.0;
+            for (size_t k=0;k<x.size();++k)
+                s += (transA ? A(k,i) : A(i,k))*x(k);
+            y(i) = alpha*s+beta*y(i);
+        }
     #endif
     }
 
-    inline void Matrix::setlin(size_t i,const Vector& v) {
-        om_assert(v.size()==ncol() && i<nlin());
+    /// \brief C = alpha*op(A)*op(B)+beta*C, with op(X) = X^T if transX and X otherwise.
+
+    inline void gemm(const bool transA,const bool transB,const double alpha,const ConstMatrixView& A,const ConstMatrixView& B,const double beta,const MatrixView& C) {
+        const size_t p = transA ? A.nlin() : A.ncol();
+        om_assert(C.nlin()==(transA ? A.ncol() : A.nlin()));
+        om_assert(C.ncol()==(transB ? B.nlin() : B.ncol()));
+        om_assert(p==(transB ? B.ncol() : B.nlin()));
+        if (C.nlin()==0 || C.ncol()==0)
+            return;
+        if (p==0) { // op(A)*op(B) = 0, and the leading dimension of A or B may be 0 (which BLAS rejects).
+            for (size_t j=0;j<C.ncol();++j)
+                for (size_t i=0;i<C.nlin();++i)
+                    C(i,j) = (beta==0.0) ? 0.0 : beta*C(i,j);
+            return;
+        }
     #ifdef HAVE_BLAS
-        BLAS(dcopy,DCOPY)(sizet_to_int(ncol()),v.data(),1,data()+i,sizet_to_int(nlin()));
+        DGEMM((transA ? CblasTrans : CblasNoTrans),(transB ? CblasTrans : CblasNoTrans),
+              sizet_to_int(C.nlin()),sizet_to_int(C.ncol()),sizet_to_int(p),
+              alpha,A.data(),sizet_to_int(A.ld()),B.data(),sizet_to_int(B.ld()),
+              beta,C.data(),sizet_to_int(C.ld()));
     #else
-        for (size_t j=0;j<ncol();j++) data()[i+nlin()*j]=v.data()[j];
+        for (size_t j=0;j<C.ncol();++j)
+            for (size_t i=0;i<C.nlin();++i) {
+                double s = 0.0;
+                for (size_t k=0;k<p;++k)
+                    s += (transA ? A(k,i) : A(i,k))*(transB ? B(j,k) : B(k,j));
+                C(i,j) = alpha*s+((beta==0.0) ? 0.0 : beta*C(i,j));
+            }
     #endif
     }
 
+    inline Vector operator*(const ConstMatrixView& A,const ConstVectorView& x) {
+        Vector y(A.nlin());
+        gemv(false,1.0,A,x,0.0,y.view());
+        return y;
+    }
+
+    inline Matrix operator*(const ConstMatrixView& A,const ConstMatrixView& B) {
+        Matrix C(A.nlin(),B.ncol());
+        gemm(false,false,1.0,A,B,0.0,C.view());
+        return C;
+    }
+
+    inline Matrix::Matrix(const ConstMatrixView& A): LinOp(A.nlin(),A.ncol(),FULL,2),value(A.nlin()*A.ncol()) {
+        copy(A,view());
+    }
+
+    inline Matrix Matrix::submat(size_t istart, size_t isize, size_t jstart, size_t jsize) const {
+        return Matrix(view(istart,isize,jstart,jsize));
+    }
+
+    inline void Matrix::insertmat(size_t istart, size_t jstart, const Matrix& B) {
+        om_assert (istart+B.nlin()<=nlin() && jstart+B.ncol()<=ncol() );
+        for (size_t j=0; j<B.ncol(); j++) {
+            for (size_t i=0; i<B.nlin(); i++) {
+                (*this)(istart+i,jstart+j)=B(i,j);
+            }
+        }
+    }
+
+    inline Vector Matrix::getcol(size_t j) const { return Vector(col_view(j)); }
+    inline Vector Matrix::getlin(size_t i) const { return Vector(lin_view(i)); }
+
+    inline void Matrix::setcol(size_t j,const Vector& v) { copy(v.view(),col_view(j)); }
+    inline void Matrix::setlin(size_t i,const Vector& v) { copy(v.view(),lin_view(i)); }
+
     inline Vector Matrix::tmult(const Vector &v) const {
         om_assert(nlin()==v.nlin());
         Vector y(ncol());
@@ -292,6 +372,7 @@ namespace OpenMEEG {
 
     inline Matrix Matrix::inverse() const {
     #ifdef HAVE_LAPACK
+        const ExecutionStage stage(ExecutionStage::DENSE_ALGEBRA);
         om_assert(nlin()==ncol());
         Matrix invA(*this,DEEP_COPY);
         // LU
@@ -354,67 +435,10 @@ namespace OpenMEEG {
             return C;
     }
     
-    inline Matrix Matrix::tmult(const Matrix &B) const {
-        om_assert(nlin()==B.nlin());
-        size_t p=nlin();
-        Matrix C(ncol(),B.ncol());
-    #ifdef HAVE_BLAS
-        DGEMM(CblasTrans,CblasNoTrans,
-            sizet_to_int(C.nlin()),sizet_to_int(C.ncol()),sizet_to_int(p),
-            1.,data(),sizet_to_int(nlin()),
-            B.data(),sizet_to_int(B.nlin()),
-            0.,C.data(),sizet_to_int(C.nlin()));
-    #else
-        for (size_t i=0;i<C.nlin();i++)
-            for (size_t j=0;j<C.ncol();j++) {
-                C(i,j)=0;
-                for (size_t k=0;k<p;k++)
-                    C(i,j)+=(*this)(k,i)*B(k,j);
-            }
-    #endif
-            return C;
-    }
-
-    inline Matrix Matrix::multt(const Matrix &B) const {
-        om_assert(ncol()==B.ncol());
-        size_t p=ncol();
-        Matrix C(nlin(),B.nlin());
-    #ifdef HAVE_BLAS
-        DGEMM(CblasNoTrans,CblasTrans,
-            sizet_to_int(C.nlin()),sizet_to_int(C.ncol()),sizet_to_int(p),
-            1.,data(),sizet_to_int(nlin()),
-            B.data(),sizet_to_int(B.nlin()),
-            0.,C.data(),sizet_to_int(C.nlin()));
-    #else
-        for (size_t i=0;i<C.nlin();i++)
-            for (size_t j=0;j<C.ncol();j++) {
-                C(i,j)=0;
-                for (size_t k=0;k<p;k++)
-                    C(i,j)+=(*this)(i,k)*B(j,k);
-            }
-    #endif
-            return C;
-    }
-
-    inline Matrix Matrix::tmultt(const Matrix &B) const {
-        om_assert(nlin()==B.ncol());
-        size_t p=nlin();
-        Matrix C(ncol(),B.nlin());
-    #ifdef HAVE_BLAS
-        DGEMM(CblasTrans,CblasTrans,
-            sizet_to_int(C.nlin()),sizet_to_int(C.ncol()),sizet_to_int(p),
-            1.,data(),sizet_to_int(nlin()),
-            B.data(),sizet_to_int(B.nlin()),
-            0.,C.data(),sizet_to_int(C.nlin()));
-    #else
-        for (size_t i=0;i<C.nlin();i++)
-            for (size_t j=0;j<C.ncol();j++) {
-                C(i,j)=0;
-                for (size_t k=0;k<p;k++)
-                    C(i,j)+=(*this)(k,i)*B(j,k);
-            }
-    #endif
-            return C;
+    inline Matrix Matrix::mult(const Matrix& B,const bool transA,const bool transB) const {
+        Matrix C(transA ? ncol() : nlin(),transB ? B.nlin() : B.ncol());
+        gemm(transA,transB,1.0,view(),B.view(),0.0,C.view());
+        return C;
     }
 
     inline Matrix Matrix::operator*(const SymMatrix &B) const {
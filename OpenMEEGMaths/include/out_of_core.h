@@ -0,0 +1,122 @@
+/*
+Project Name : OpenMEEG
+
+© INRIA and ENPC (contributors: Geoffray ADDE, Maureen CLERC, Alexandre 
+GRAMFORT, Renaud KERIVEN, Jan KYBIC, Perrine LANDREAU, Théodore PAPADOPOULO,
+Emmanuel OLIVI
+Maureen.Clerc.AT.inria.fr, keriven.AT.certis.enpc.fr,
+kybic.AT.fel.cvut.cz, papadop.AT.inria.fr)
+
+The OpenMEEG software is a C++ package for solving the forward/inverse
+problems of electroencephalography and magnetoencephalography.
+
+This software is governed by the CeCILL-B license under French law and
+abiding by the rules of distribution of free software.  You can  use,
+modify and/ or redistribute the software under the terms of the CeCILL-B
+license as circulated by CEA, CNRS and INRIA at the following URL
+"http://www.cecill.info".
+
+As a counterpart to the access to the source code and  rights to copy,
+modify and redistribute granted by the license, users are provided only
+with a limited warranty  and the software's authors,  the holders of the
+economic rights,  and the successive licensors  have only  limited
+liability.
+
+In this respect, the user's attention is drawn to the risks associated
+with loading,  using,  modifying and/or developing or reproducing the
+software by the user in light of its specific status of free software,
+that may mean  that it is complicated to manipulate,  and  that  also
+therefore means  that it is reserved for developers  and  experienced
+professionals having in-depth computer knowledge. Users are therefore
+encouraged to load and test the software's suitability as regards their
+requirements in conditions enabling the security of their systems and/or
+data to be ensured and,  more generally, to use and operate it in the
+same conditions as regards security.
+
+The fact that you are presently reading this means that you have had
+knowledge of the CeCILL-B license and that you accept its terms.
+*/
+
+#pragma once
+
+#include <string>
+#include <fstream>
+
+#include <OpenMEEGMathsConfig.h>
+#include <linop.h>
+#include <checkpoint.h>
+
+namespace OpenMEEG {
+
+    /// \brief Raw binary (.bin) matrix file accessed by blocks of values, without ever loading the whole matrix.
+    /// Full matrices are stored column by column and symmetric matrices as their packed upper part (as in SymMatrix),
+    /// so that the values of a panel of consecutive columns are contiguous in both cases.
+
+    class OPENMEEGMATHS_EXPORT MatrixFile {
+    public:
+
+        typedef LinOpInfo::StorageType StorageType;
+
+        /// Open an existing file (whose size must match the storage type) for reading (and writing if update is true).
+
+        MatrixFile(const std::string& filename,const StorageType st,const bool update=false);
+
+        /// Create a file for a m x n full matrix or for a n x n symmetric matrix (m is then ignored).
+        /// The file can be read back once written.
+
+        MatrixFile(const std::string& filename,const StorageType st,const size_t m,const size_t n);
+
+        size_t nlin() const { return num_lines; }
+        size_t ncol() const { return num_cols;  }
+
+        bool symmetric() const { return storage==LinOpInfo::SYMMETRIC; }
+
+        /// Lines [i0,i1) of column j (for symmetric matrices, i1 must be at most j+1).
+
+        void read(const size_t i0,const size_t i1,const size_t j,double* values);
+        void write(const size_t i0,const size_t i1,const size_t j,const double* values);
+
+        /// Panel of columns [j0,j1): lines 0 to j of each column j for symmetric matrices, all lines otherwise.
+
+        size_t panel_size(const size_t j0,const size_t j1) const { return position(0,j1)-position(0,j0); }
+
+        void read_panel(const size_t j0,const size_t j1,double* values)        { read_values(position(0,j0),panel_size(j0,j1),values);  }
+        void write_panel(const size_t j0,const size_t j1,const double* values) { write_values(position(0,j0),panel_size(j0,j1),values); }
+
+        void flush() { file.flush(); }
+
+    private:
+
+        // Position of the value (i,j) in values (not bytes) from the beginning of the data.
+
+        size_t position(const size_t i,const size_t j) const { return (symmetric()) ? i+j*(j+1)/2 : i+j*num_lines; }
+
+        std::streamoff header_size() const { return (symmetric()) ? sizeof(unsigned) : 2*sizeof(unsigned); }
+
+        void read_values(const size_t pos,const size_t n,double* values);
+        void write_values(const size_t pos,const size_t n,const double* values);
+
+        const std::string name;
+        const StorageType storage;
+        std::fstream      file;
+        size_t            num_lines;
+        size_t            num_cols;
+    };
+
+    /// \brief Out-of-core inversion of the symmetric matrix stored in the binary file input, the inverse being
+    /// written (as a symmetric matrix) in the binary file output.
+    /// The matrix is processed by square tiles of t x t values, only the lower tiles being stored (symmetry). It is first
+    /// transformed by a random butterfly transformation U (Ut*A*U), which allows a block LDLt factorization without
+    /// pivoting between tiles even for indefinite matrices with null leading blocks (the diagonal blocks of D being
+    /// factored with Bunch-Kaufman pivoting). inv(L) and then inv(Ut*A*U) = inv(L)t*inv(D)*inv(L) are computed in
+    /// place, and the inverse U*inv(Ut*A*U)*Ut is finally written tile by tile. The tiles are stored in the scratch file
+    /// output.lu (removed at the end).
+    /// About max_memory bytes are used (five tiles, so t is about sqrt(max_memory/40)). With T = n/t tiles per line,
+    /// the whole process reads about 4T^3/3 tiles, i.e. 4n^3/(3t) values: the I/O decreases as the square root of the memory.
+    /// With an enabled checkpoint, the tiles are stored in the checkpoint directory and the progress (tile size, phase
+    /// and processed tiles) is saved after each tile: a new call after a crash only redoes the unfinished tiles.
+    /// The checkpoint is cleared once the inverse is written.
+
+    OPENMEEGMATHS_EXPORT void invert_out_of_core(const std::string& input,const std::string& output,const size_t max_memory,
+                                                 const Checkpoint& checkpoint=Checkpoint());
+}
@@ -0,0 +1,140 @@
+/*
+Project Name : OpenMEEG
+
+© INRIA and ENPC (contributors: Geoffray ADDE, Maureen CLERC, Alexandre 
+GRAMFORT, Renaud KERIVEN, Jan KYBIC, Perrine LANDREAU, Théodore PAPADOPOULO,
+Emmanuel OLIVI
+Maureen.Clerc.AT.inria.fr, keriven.AT.certis.enpc.fr,
+kybic.AT.fel.cvut.cz, papadop.AT.inria.fr)
+
+The OpenMEEG software is a C++ package for solving the forward/inverse
+problems of electroencephalography and magnetoencephalography.
+
+This software is governed by the CeCILL-B license under French law and
+abiding by the rules of distribution of free software.  You can  use,
+modify and/ or redistribute the software under the terms of the CeCILL-B
+license as circulated by CEA, CNRS and INRIA at the following URL
+"http://www.cecill.info".
+
+As a counterpart to the access to the source code and  rights to copy,
+modify and redistribute granted by the license, users are provided only
+with a limited warranty  and the software's authors,  the holders of the
+economic rights,  and the successive licensors  have only  limited
+liability.
+
+In this respect, the user's attention is drawn to the risks associated
+with loading,  using,  modifying and/or developing or reproducing the
+software by the user in light of its specific status of free software,
+that may mean  that it is complicated to manipulate,  and  that  also
+therefore means  that it is reserved for developers  and  experienced
+professionals having in-depth computer knowledge. Users are therefore
+encouraged to load and test the software's suitability as regards their
+requirements in conditions enabling the security of their systems and/or
+data to be ensured and,  more generally, to use and operate it in the
+same conditions as regards security.
+
+The fact that you are presently reading this means that you have had
+knowledge of the CeCILL-B license and that you accept its terms.
+*/
+
+#pragma once
+
+#include <vector>
+#include <string>
+
+#include <OpenMEEGMathsConfig.h>
+#include <linop.h>
+#include <matrix.h>
+#include <symmatrix.h>
+#include <sparse_matrix.h>
+
+namespace OpenMEEG {
+
+    /// \brief Lazy product A1*A2*...*An (+C) of full, symmetric or sparse matrices.
+    /// Nothing is computed before evaluation, which chooses the parenthesization with the least flops
+    /// (matrix chain ordering, taking the sparsity of sparse factors into account) and accumulates the
+    /// optional addend C in the last product (GEMM with beta=1) instead of adding a full size temporary.
+    /// Only the parenthesizations whose temporaries (intermediate products alive at the same time) fit in
+    /// a memory bound are considered: by default, the size of the largest factor, so that evaluating the
+    /// chain never needs more memory than its operands. If none fits, the one with the smallest temporaries is used.
+    /// Symmetric factors are unpacked by panels of columns: they are never duplicated as full matrices.
+    /// Factors are referenced: they must outlive the chain.
+    ///
+    /// Usage: const Matrix G = chain(Head2MEGMat)*HeadMatInv*SourceMat+Source2MEGMat;
+
+    class OPENMEEGMATHS_EXPORT ProductChain {
+    public:
+
+        ProductChain(const Matrix& A)       { append(LinOpInfo::FULL,A);      }
+        ProductChain(const SymMatrix& A)    { append(LinOpInfo::SYMMETRIC,A); }
+        ProductChain(const SparseMatrix& A) { append(LinOpInfo::SPARSE,A);    }
+
+        ProductChain operator*(const Matrix& A)       const { return ProductChain(*this).append(LinOpInfo::FULL,A);      }
+        ProductChain operator*(const SymMatrix& A)    const { return ProductChain(*this).append(LinOpInfo::SYMMETRIC,A); }
+        ProductChain operator*(const SparseMatrix& A) const { return ProductChain(*this).append(LinOpInfo::SPARSE,A);    }
+
+        ProductChain operator+(const Matrix& C) const {
+            om_assert(addend==nullptr && C.nlin()==nlin() && C.ncol()==ncol());
+            ProductChain res(*this);
+            res.addend = &C;
+            return res;
+        }
+
+        /// \brief Set the memory bound (in bytes) for the temporaries.
+
+        ProductChain& memory_bound(const size_t bytes) {
+            max_memory = bytes;
+            return *this;
+        }
+
+        size_t nlin() const { return factors.front().op->nlin(); }
+        size_t ncol() const { return factors.back().op->ncol();  }
+
+        /// \brief Number of flops of the evaluation and the chosen parenthesization (e.g. "((A0*A1)*A2)").
+
+        double      flops() const;
+        double      temporaries() const; // Peak memory (in bytes) of the temporaries.
+        std::string parenthesization() const;
+
+        Matrix eval() const;
+        operator Matrix() const { return eval(); }
+
+    private:
+
+        typedef LinOpInfo::StorageType StorageType;
+
+        struct Factor {
+            StorageType   storage;
+            const LinOp*  op;
+        };
+
+        struct Plan {
+            std::vector<double> cost;
+            std::vector<double> memory; // Peak number of values of the temporaries.
+            std::vector<size_t> split;
+            size_t n;
+
+            size_t index(const size_t i,const size_t j) const { return i*n+j; }
+        };
+
+        ProductChain& append(const StorageType st,const LinOp& A) {
+            om_assert(factors.empty() || factors.back().op->ncol()==A.nlin());
+            factors.push_back({ st, &A });
+            return *this;
+        }
+
+        double multiplication_cost(const size_t i,const size_t k,const size_t j) const;
+        Plan   plan() const;
+
+        std::string parenthesization(const Plan& p,const size_t i,const size_t j) const;
+        Matrix eval(const Plan& p,const size_t i,const size_t j,const Matrix* C) const;
+
+        std::vector<Factor> factors;
+        const Matrix*       addend = nullptr;
+        size_t              max_memory = 0; // 0: the size of the largest factor.
+    };
+
+    inline ProductChain chain(const Matrix& A)       { return ProductChain(A); }
+    inline ProductChain chain(const SymMatrix& A)    { return ProductChain(A); }
+    inline ProductChain chain(const SparseMatrix& A) { return ProductChain(A); }
+}
@@ -0,0 +1,226 @@
+/*
+Project Name : OpenMEEG
+
+© INRIA and ENPC (contributors: Geoffray ADDE, Maureen CLERC, Alexandre 
+GRAMFORT, Renaud KERIVEN, Jan KYBIC, Perrine LANDREAU, Théodore PAPADOPOULO,
+Emmanuel OLIVI
+Maureen.Clerc.AT.inria.fr, keriven.AT.certis.enpc.fr,
+kybic.AT.fel.cvut.cz, papadop.AT.inria.fr)
+
+The OpenMEEG software is a C++ package for solving the forward/inverse
+problems of electroencephalography and magnetoencephalography.
+
+This software is governed by the CeCILL-B license under French law and
+abiding by the rules of distribution of free software.  You can  use,
+modify and/ or redistribute the software under the terms of the CeCILL-B
+license as circulated by CEA, CNRS and INRIA at the following URL
+"http://www.cecill.info".
+
+As a counterpart to the access to the source code and  rights to copy,
+modify and redistribute granted by the license, users are provided only
+with a limited warranty  and the software's authors,  the holders of the
+economic rights,  and the successive licensors  have only  limited
+liability.
+
+In this respect, the user's attention is drawn to the risks associated
+with loading,  using,  modifying and/or developing or reproducing the
+software by the user in light of its specific status of free software,
+that may mean  that it is complicated to manipulate,  and  that  also
+therefore means  that it is reserved for developers  and  experienced
+professionals having in-depth computer knowledge. Users are therefore
+encouraged to load and test the software's suitability as regards their
+requirements in conditions enabling the security of their systems and/or
+data to be ensured and,  more generally, to use and operate it in the
+same conditions as regards security.
+
+The fact that you are presently reading this means that you have had
+knowledge of the CeCILL-B license and that you accept its terms.
+*/
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <OpenMEEGMathsConfig.h>
+#include <matrix.h>
+#include <execution_policy.h>
+
+namespace OpenMEEG {
+
+    /// \brief Lock-free single producer / single consumer ring buffer of preallocated slots.
+    /// The producer fills the slot given by write_slot() and publishes it with push(), the consumer reads the slot
+    /// given by read_slot() and releases it with pop(). Slots are used in place and never reallocated. Each index
+    /// is only written by one side, and published with release/acquire ordering.
+
+    template <typename T>
+    class SPSCRingBuffer {
+    public:
+
+        template <typename Init>
+        SPSCRingBuffer(const size_t capacity,Init init): slots(capacity) {
+            for (T& slot : slots)
+                init(slot);
+        }
+
+        size_t capacity() const { return slots.size(); }
+
+        /// Free slot for the producer, nullptr if the buffer is full.
+
+        T* write_slot() {
+            const size_t h = head.load(std::memory_order_relaxed);
+            return (h-tail.load(std::memory_order_acquire)==slots.size()) ? nullptr : &slots[h%slots.size()];
+        }
+
+        void push() { head.store(head.load(std::memory_order_relaxed)+1,std::memory_order_release); }
+
+        /// Oldest published slot for the consumer, nullptr if the buffer is empty.
+
+        T* read_slot() {
+            const size_t t = tail.load(std::memory_order_relaxed);
+            return (head.load(std::memory_order_acquire)==t) ? nullptr : &slots[t%slots.size()];
+        }
+
+        void pop() { tail.store(tail.load(std::memory_order_relaxed)+1,std::memory_order_release); }
+
+    private:
+
+        std::vector<T> slots;
+        alignas(64) std::atomic<size_t> head{0}; // Written by the producer only.
+        alignas(64) std::atomic<size_t> tail{0}; // Written by the consumer only.
+    };
+
+    /// \brief Latency statistics. Percentiles come from a histogram of 1 microsecond bins up to 100 ms (larger
+    /// latencies fall in the last bin), so that recording a latency never allocates.
+
+    class OPENMEEGMATHS_EXPORT LatencyStatistics {
+    public:
+
+        LatencyStatistics(): histogram(bins,0) { reset(); }
+
+        void record(const double seconds);
+        void reset();
+
+        size_t count() const { return n;   }
+        double min()   const { return low;  }
+        double max()   const { return high; }
+        double mean()  const { return (n==0) ? 0.0 : sum/n; }
+
+        /// Latency (in seconds, to the microsecond) below which p percent of the latencies fall.
+
+        double percentile(const double p) const;
+
+    private:
+
+        static constexpr size_t bins = 100000;
+
+        std::vector<size_t> histogram;
+        size_t n;
+        double sum;
+        double low;
+        double high;
+    };
+
+    /// \brief Real-time application of a precomputed linear operator (a gain matrix mapping source time courses to
+    /// sensors, or an inverse operator mapping sensor data to sources) to a stream of blocks of samples (columns).
+    /// Each worker thread owns an input and an output SPSCRingBuffer. The producer thread hands the blocks to the
+    /// workers in turn and the consumer thread collects the results in the same order: blocks come back in
+    /// submission order and every buffer has exactly one producer and one consumer. The workers are pinned to
+    /// consecutive cores from first_cpu (Linux only, no pinning if first_cpu<0) and compute one sequential GEMM
+    /// per block: BLAS is made sequential (for the whole process) once by the constructor and restored by the
+    /// destructor. Idle workers sleep on a condition variable, which submit() and retrieve() only signal when the
+    /// worker is actually sleeping: otherwise they take no lock. The latency of a block runs from its submission to
+    /// the end of its product. Nothing is allocated after the construction.
+    /// submit() must always be called from the same thread, and so must retrieve() (possibly the same thread).
+
+    class OPENMEEGMATHS_EXPORT StreamingOperator {
+    public:
+
+        typedef std::chrono::steady_clock Clock;
+
+        StreamingOperator(const Matrix& op,const size_t block_size,const unsigned workers=1,const size_t capacity=16,
+                          const int first_cpu=-1);
+        ~StreamingOperator();
+
+        StreamingOperator(const StreamingOperator&) = delete;
+        StreamingOperator& operator=(const StreamingOperator&) = delete;
+
+        size_t input_size()  const { return op.ncol(); }
+        size_t output_size() const { return op.nlin(); }
+        size_t block_size()  const { return block;     }
+
+        /// Copy a block of input_size() x block_size() samples to the queue of the next worker.
+        /// Returns false (the block is not taken) if this queue is full.
+
+        bool submit(const ConstMatrixView& samples);
+        bool submit(const Matrix& samples) { return submit(samples.view()); }
+
+        /// Copy the next result (output_size() x block_size()), in submission order.
+        /// Returns false if it is not available yet.
+
+        bool retrieve(const MatrixView& result);
+        bool retrieve(Matrix& result) { return retrieve(result.view()); }
+
+        /// Latencies of the retrieved blocks (updated by retrieve()).
+
+        const LatencyStatistics& latencies() const { return statistics; }
+
+    private:
+
+        struct Input {
+            Matrix            samples;
+            Clock::time_point submitted;
+        };
+
+        struct Output {
+            Matrix samples;
+            double latency;
+        };
+
+        struct Worker {
+            Worker(const size_t capacity,const size_t m,const size_t n,const size_t block):
+                input(capacity,[&](Input& slot) { slot.samples = Matrix(n,block); }),
+                output(capacity,[&](Output& slot) { slot.samples = Matrix(m,block); })
+            { }
+
+            /// Wake the worker after a change of its queues, if it is sleeping. The fence orders the change of the
+            /// queue before the test of sleeping, as the worker orders sleeping before its test of the queues: one of
+            /// the two sides sees the other. The lock prevents the loss of the notification.
+
+            void notify() {
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                if (sleeping.load(std::memory_order_relaxed))
+                    wake();
+            }
+
+            void wake() {
+                { const std::lock_guard<std::mutex> lock(mutex); }
+                ready.notify_one();
+            }
+
+            SPSCRingBuffer<Input>   input;
+            SPSCRingBuffer<Output>  output;
+            std::atomic<bool>       sleeping{false};
+            std::mutex              mutex;
+            std::condition_variable ready;
+            std::thread             thread;
+        };
+
+        void run(Worker& worker,const int cpu);
+        void stop();
+
+        const Matrix                         op;
+        const size_t                         block;
+        const unsigned                       previous_blas_threads; // Restored by the destructor (0 if not controllable).
+        std::vector<std::unique_ptr<Worker>> workers;
+        std::atomic<bool>                    stopping;
+        size_t                               next_submit;   // Producer side.
+        size_t                               next_retrieve; // Consumer side.
+        LatencyStatistics                    statistics;    // Consumer side.
+    };
+}
@@ -116,6 +116,10 @@ namespace OpenMEEG {
         SparseMatrix operator*( const SparseMatrix &m ) const;
         SparseMatrix operator+( const SparseMatrix &m ) const;
 
+        /// \brief (*this)^T*B, computed line by line without forming the transpose.
+
+        SparseMatrix tmult(const SparseMatrix& B) const;
+
     private:
 
         Tank m_tank;
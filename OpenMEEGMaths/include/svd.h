@@ -0,0 +1,91 @@
+/*
+Project Name : OpenMEEG
+
+© INRIA and ENPC (contributors: Geoffray ADDE, Maureen CLERC, Alexandre 
+GRAMFORT, Renaud KERIVEN, Jan KYBIC, Perrine LANDREAU, Théodore PAPADOPOULO,
+Emmanuel OLIVI
+Maureen.Clerc.AT.inria.fr, keriven.AT.certis.enpc.fr,
+kybic.AT.fel.cvut.cz, papadop.AT.inria.fr)
+
+The OpenMEEG software is a C++ package for solving the forward/inverse
+problems of electroencephalography and magnetoencephalography.
+
+This software is governed by the CeCILL-B license under French law and
+abiding by the rules of distribution of free software.  You can  use,
+modify and/ or redistribute the software under the terms of the CeCILL-B
+license as circulated by CEA, CNRS and INRIA at the following URL
+"http://www.cecill.info".
+
+As a counterpart to the access to the source code and  rights to copy,
+modify and redistribute granted by the license, users are provided only
+with a limited warranty  and the software's authors,  the holders of the
+economic rights,  and the successive licensors  have only  limited
+liability.
+
+In this respect, the user's attention is drawn to the risks associated
+with loading,  using,  modifying and/or developing or reproducing the
+software by the user in light of its specific status of free software,
+that may mean  that it is complicated to manipulate,  and  that  also
+therefore means  that it is reserved for developers  and  experienced
+professionals having in-depth computer knowledge. Users are therefore
+encouraged to load and test the software's suitability as regards their
+requirements in conditions enabling the security of their systems and/or
+data to be ensured and,  more generally, to use and operate it in the
+same conditions as regards security.
+
+The fact that you are presently reading this means that you have had
+knowledge of the CeCILL-B license and that you accept its terms.
+*/
+
+#pragma once
+
+#include <functional>
+
+#include <OpenMEEGMathsConfig.h>
+#include <vector.h>
+#include <matrix.h>
+
+namespace OpenMEEG {
+
+    /// \brief Truncated singular value decomposition A ~ U*diag(s)*Vt, U being m x r and Vt r x n,
+    /// singular values in decreasing order.
+
+    struct OPENMEEGMATHS_EXPORT TruncatedSVD {
+
+        size_t rank() const { return s.size(); }
+
+        /// \brief Pseudo inverse applied to B: V*diag(s)^{-1}*U^T*B.
+
+        Matrix solve(const Matrix& B) const;
+
+        Matrix U;
+        Vector s;
+        Matrix Vt;
+    };
+
+    /// \brief Thin SVD (DGESDD) keeping the singular values above reltol*s_max, and at most max_rank of them
+    /// (max_rank=0 means no limit). U and Vt are only min(m,n) wide: no m x m or n x n matrix is created.
+
+    OPENMEEGMATHS_EXPORT TruncatedSVD truncated_svd(const Matrix& A,const double reltol=0.0,const size_t max_rank=0);
+
+    /// \brief Operator only known through its products with blocks of vectors.
+
+    typedef std::function<Matrix(const Matrix&)> BlockOperator;
+
+    /// \brief Randomized SVD (Halko, Martinsson and Tropp, SIAM Review 2011) of target rank rank:
+    /// the range of A is sampled with rank+oversampling gaussian vectors (refined by power iterations),
+    /// and only a (rank+oversampling) x n matrix is decomposed exactly. For a matrix of rank at most rank,
+    /// the result is exact up to rounding. Singular values below reltol*s_max are dropped.
+    /// The random vectors only depend on seed, so that results are reproducible.
+
+    OPENMEEGMATHS_EXPORT TruncatedSVD randomized_svd(const size_t m,const size_t n,const BlockOperator& A,const BlockOperator& At,
+                                                     const size_t rank,const double reltol=0.0,const size_t oversampling=10,
+                                                     const unsigned power_iterations=1,const unsigned seed=0);
+
+    inline TruncatedSVD randomized_svd(const Matrix& A,const size_t rank,const double reltol=0.0,const size_t oversampling=10,
+                                       const unsigned power_iterations=1,const unsigned seed=0)
+    {
+        return randomized_svd(A.nlin(),A.ncol(),[&A](const Matrix& X) { return A*X; },[&A](const Matrix& X) { return A.tmult(X); },
+                              rank,reltol,oversampling,power_iterations,seed);
+    }
+}
@@ -42,9 +42,12 @@ knowledge of the CeCILL-B license and that you accept its terms.
 #include <iostream>
 #include <cstdlib>
 #include <string>
+#include <vector>
+#include <utility>
 
 #include <vector.h>
 #include <linop.h>
+#include <execution_policy.h>
 
 namespace OpenMEEG {
 
@@ -88,10 +91,11 @@ namespace OpenMEEG {
         Matrix    submat(size_t istart, size_t isize, size_t jstart, size_t jsize) const;
         SymMatrix submat(size_t istart, size_t iend) const;
         Vector    getlin(size_t i) const;
+        void      getlin(size_t i, const VectorView& v) const;
         void      setlin(size_t i, const Vector& v);
         Vector    solveLin(const Vector &B) const;
         void      solveLin(Vector* B,const int nbvect);
-        Matrix    solveLin(Matrix& B) const;
+        Matrix    solveLin(Matrix& B,const bool transposed=false) const;
 
         const SymMatrix& operator=(const double d);
 
@@ -120,8 +124,56 @@ namespace OpenMEEG {
         void load(const std::string& s)       { load(s.c_str()); }
 
         friend class Matrix;
+        friend class SymMatrixFactorization;
     };
 
+    /// \brief Bunch-Kaufman factorization (DSPTRF) of a symmetric matrix, reusable for many solves.
+    /// Constructing it from an rvalue (see factorize(SymMatrix&&)) factors the matrix in place when its
+    /// data is not shared with another matrix, which avoids a copy of the whole matrix.
+
+    class OPENMEEGMATHS_EXPORT SymMatrixFactorization {
+    public:
+
+        explicit SymMatrixFactorization(const SymMatrix& A);
+        explicit SymMatrixFactorization(SymMatrix&& A);
+
+        size_t nlin() const { return LDLt.nlin(); }
+
+        Vector solve(const Vector& B) const;
+
+        /// Replace B by the solution X of A*X = B.
+
+        void solve(Matrix& B) const;
+
+        /// Same, for a block of columns whose leading dimension may exceed nlin() (no copy).
+
+        void solve(const MatrixView& B) const;
+
+        /// Replace B by the solution X of X*A = B (i.e. each line of B is a right hand side).
+        /// The lines are processed by panels, so that B is never transposed as a whole.
+
+        void solve_transposed(Matrix& B) const;
+
+        /// Same as above, the side being chosen at run time (X*A = B if transposed).
+
+        void solve(Matrix& B,const bool transposed) const {
+            if (transposed)
+                solve_transposed(B);
+            else
+                solve(B);
+        }
+
+    private:
+
+        void factorize();
+
+        SymMatrix             LDLt;
+        std::vector<BLAS_INT> pivots;
+    };
+
+    inline SymMatrixFactorization factorize(const SymMatrix& A) { return SymMatrixFactorization(A); }
+    inline SymMatrixFactorization factorize(SymMatrix&& A)      { return SymMatrixFactorization(std::move(A)); }
+
     inline double SymMatrix::operator()(size_t i,size_t j) const {
         om_assert(i<nlin() && j<nlin());
         if(i<=j)
@@ -301,6 +353,7 @@ namespace OpenMEEG {
 
     inline SymMatrix SymMatrix::inverse() const {
     #ifdef HAVE_LAPACK
+        const ExecutionStage stage(ExecutionStage::DENSE_ALGEBRA);
         SymMatrix invA(*this, DEEP_COPY);
         // LU
         BLAS_INT *pivots = new BLAS_INT[nlin()];
@@ -322,6 +375,7 @@ namespace OpenMEEG {
 
     inline void SymMatrix::invert() {
     #ifdef HAVE_LAPACK
+        const ExecutionStage stage(ExecutionStage::DENSE_ALGEBRA);
         // LU
         BLAS_INT *pivots = new BLAS_INT[nlin()];
         int Info = 0;
@@ -356,12 +410,26 @@ namespace OpenMEEG {
     }
 
     inline Vector SymMatrix::getlin(size_t i) const {
-        om_assert(i<nlin());
         Vector v(ncol());
-        for ( size_t j = 0; j < ncol(); ++j) v.data()[j] = this->operator()(i,j);
+        getlin(i,v.view());
         return v;
     }
 
+    //  Copy line i into v without any temporary: with packed upper storage, the values (i,j) for j<i
+    //  are contiguous (they are the column i), the others are read one by one.
+
+    inline void SymMatrix::getlin(size_t i,const VectorView& v) const {
+        om_assert(i<nlin() && v.size()==ncol());
+        const double* col = data()+i*(i+1)/2;
+    #ifdef HAVE_BLAS
+        if (i!=0)
+            BLAS(dcopy,DCOPY)(sizet_to_int(i),col,1,v.data(),sizet_to_int(v.inc()));
+    #else
+        for (size_t j=0; j<i; ++j) v(j) = col[j];
+    #endif
+        for (size_t j=i; j<ncol(); ++j) v(j) = data()[i+j*(j+1)/2];
+    }
+
     inline void SymMatrix::setlin(size_t i,const Vector& v) {
         om_assert(v.size()==nlin() && i<nlin());
         for ( size_t j = 0; j < ncol(); ++j) this->operator()(i,j) = v(j);
@@ -45,6 +45,7 @@ knowledge of the CeCILL-B license and that you accept its terms.
 
 #include <OpenMEEGMathsConfig.h>
 #include <linop.h>
+#include <views.h>
 #include <MathsIO.H>
 
 namespace OpenMEEG {
@@ -65,6 +66,7 @@ namespace OpenMEEG {
 
         explicit Vector(Matrix& A);
         explicit Vector(SymMatrix& A);
+        explicit Vector(const ConstVectorView& v);
 
         void alloc_data() { value = LinOpValue(size()); }
         void reference_data(const double* array) { value = LinOpValue(size(),array); }
@@ -75,6 +77,11 @@ namespace OpenMEEG {
 
         double* data() const { return value.get(); }
 
+        /// \brief Get a (non-owning) view of the Vector values, read-only for a const Vector.
+
+        VectorView      view()       { return VectorView(data(),nlin());      }
+        ConstVectorView view() const { return ConstVectorView(data(),nlin()); }
+
         inline double operator()(const size_t i) const {
             om_assert(i<nlin());
             return value[i];
@@ -135,6 +142,15 @@ namespace OpenMEEG {
     OPENMEEGMATHS_EXPORT std::ostream& operator<<(std::ostream& f,const Vector &M);
     OPENMEEGMATHS_EXPORT std::istream& operator>>(std::istream& f,Vector &M);
 
+    inline Vector::Vector(const ConstVectorView& v): LinOp(v.size(),1,FULL,1),value(v.size()) {
+    #ifdef HAVE_BLAS
+        BLAS(dcopy,DCOPY)(sizet_to_int(v.size()),v.data(),sizet_to_int(v.inc()),data(),1);
+    #else
+        for (size_t i=0; i<v.size(); i++)
+            data()[i] = v(i);
+    #endif
+    }
+
     inline Vector Vector::subvect(size_t istart, size_t isize) const {
         om_assert (istart+isize<=nlin());
         Vector a(isize);
@@ -0,0 +1,138 @@
+/*
+Project Name : OpenMEEG
+
+© INRIA and ENPC (contributors: Geoffray ADDE, Maureen CLERC, Alexandre 
+GRAMFORT, Renaud KERIVEN, Jan KYBIC, Perrine LANDREAU, Théodore PAPADOPOULO,
+Emmanuel OLIVI
+Maureen.Clerc.AT.inria.fr, keriven.AT.certis.enpc.fr,
+kybic.AT.fel.cvut.cz, papadop.AT.inria.fr)
+
+The OpenMEEG software is a C++ package for solving the forward/inverse
+problems of electroencephalography and magnetoencephalography.
+
+This software is governed by the CeCILL-B license under French law and
+abiding by the rules of distribution of free software.  You can  use,
+modify and/ or redistribute the software under the terms of the CeCILL-B
+license as circulated by CEA, CNRS and INRIA at the following URL
+"http://www.cecill.info".
+
+As a counterpart to the access to the source code and  rights to copy,
+modify and redistribute granted by the license, users are provided only
+with a limited warranty  and the software's authors,  the holders of the
+economic rights,  and the successive licensors  have only  limited
+liability.
+
+In this respect, the user's attention is drawn to the risks associated
+with loading,  using,  modifying and/or developing or reproducing the
+software by the user in light of its specific status of free software,
+that may mean  that it is complicated to manipulate,  and  that  also
+therefore means  that it is reserved for developers  and  experienced
+professionals having in-depth computer knowledge. Users are therefore
+encouraged to load and test the software's suitability as regards their
+requirements in conditions enabling the security of their systems and/or
+data to be ensured and,  more generally, to use and operate it in the
+same conditions as regards security.
+
+The fact that you are presently reading this means that you have had
+knowledge of the CeCILL-B license and that you accept its terms.
+*/
+
+#pragma once
+
+#include <cstdlib>
+#include <type_traits>
+
+#include <OpenMEEGMathsConfig.h>
+#include <OMassert.H>
+
+namespace OpenMEEG {
+
+    /// \brief Non-owning view of a strided sequence of values (a vector, a line or a column of a matrix).
+    /// Views do not keep the viewed values alive: the viewed object must outlive them.
+    /// T is double for a view allowing modifications, const double for a read-only view (ConstVectorView).
+    /// Modifiable views convert to read-only ones.
+
+    template <typename T>
+    class BasicVectorView {
+    public:
+
+        BasicVectorView(T* ptr,const size_t n,const size_t inc=1): values(ptr),num_values(n),increment(inc) { }
+
+        template <typename U,typename=std::enable_if_t<std::is_convertible_v<U*,T*>>>
+        BasicVectorView(const BasicVectorView<U>& v): BasicVectorView(v.data(),v.size(),v.inc()) { }
+
+        size_t nlin() const { return num_values; }
+        size_t size() const { return num_values; }
+        size_t inc()  const { return increment;  }
+        T*     data() const { return values;     }
+
+        T& operator()(const size_t i) const {
+            om_assert(i<nlin());
+            return values[i*increment];
+        }
+
+        BasicVectorView subvect(const size_t istart,const size_t isize) const {
+            om_assert(istart+isize<=nlin());
+            return BasicVectorView(values+istart*increment,isize,increment);
+        }
+
+    private:
+
+        T*     values;
+        size_t num_values;
+        size_t increment;
+    };
+
+    /// \brief Non-owning view of a column major block of values with leading dimension ld (as in BLAS).
+    /// Views do not keep the viewed values alive: the viewed object must outlive them.
+    /// As for vectors, T is double or const double (ConstMatrixView).
+
+    template <typename T>
+    class BasicMatrixView {
+    public:
+
+        BasicMatrixView(T* ptr,const size_t m,const size_t n,const size_t ldim): values(ptr),num_lines(m),num_cols(n),leading_dim(ldim) {
+            om_assert(ldim>=m);
+        }
+
+        template <typename U,typename=std::enable_if_t<std::is_convertible_v<U*,T*>>>
+        BasicMatrixView(const BasicMatrixView<U>& M): BasicMatrixView(M.data(),M.nlin(),M.ncol(),M.ld()) { }
+
+        size_t nlin() const { return num_lines;   }
+        size_t ncol() const { return num_cols;    }
+        size_t ld()   const { return leading_dim; }
+        T*     data() const { return values;      }
+
+        T& operator()(const size_t i,const size_t j) const {
+            om_assert(i<nlin() && j<ncol());
+            return values[i+j*leading_dim];
+        }
+
+        BasicMatrixView submat(const size_t istart,const size_t isize,const size_t jstart,const size_t jsize) const {
+            om_assert(istart+isize<=nlin() && jstart+jsize<=ncol());
+            return BasicMatrixView(values+istart+jstart*leading_dim,isize,jsize,leading_dim);
+        }
+
+        BasicVectorView<T> getcol(const size_t j) const {
+            om_assert(j<ncol());
+            return BasicVectorView<T>(values+j*leading_dim,num_lines);
+        }
+
+        BasicVectorView<T> getlin(const size_t i) const {
+            om_assert(i<nlin());
+            return BasicVectorView<T>(values+i,num_cols,leading_dim);
+        }
+
+    private:
+
+        T*     values;
+        size_t num_lines;
+        size_t num_cols;
+        size_t leading_dim;
+    };
+
+    using VectorView      = BasicVectorView<double>;
+    using ConstVectorView = BasicVectorView<const double>;
+    using MatrixView      = BasicMatrixView<double>;
+    using ConstMatrixView = BasicMatrixView<const double>;
+}
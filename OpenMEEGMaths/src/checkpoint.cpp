@@ -0,0 +1,113 @@
+/*
+Project Name : OpenMEEG
+
+© INRIA and ENPC (contributors: Geoffray ADDE, Maureen CLERC, Alexandre 
+GRAMFORT, Renaud KERIVEN, Jan KYBIC, Perrine LANDREAU, Théodore PAPADOPOULO,
+Emmanuel OLIVI
+Maureen.Clerc.AT.inria.fr, keriven.AT.certis.enpc.fr,
+kybic.AT.fel.cvut.cz, papadop.AT.inria.fr)
+
+The OpenMEEG software is a C++ package for solving the forward/inverse
+problems of electroencephalography and magnetoencephalography.
+
+This software is governed by the CeCILL-B license under French law and
+abiding by the rules of distribution of free software.  You can  use,
+modify and/ or redistribute the software under the terms of the CeCILL-B
+license as circulated by CEA, CNRS and INRIA at the following URL
+"http://www.cecill.info".
+
+As a counterpart to the access to the source code and  rights to copy,
+modify and redistribute granted by the license, users are provided only
+with a limited warranty  and the software's authors,  the holders of the
+economic rights,  and the successive licensors  have only  limited
+liability.
+
+In this respect, the user's attention is drawn to the risks associated
+with loading,  using,  modifying and/or developing or reproducing the
+software by the user in light of its specific status of free software,
+that may mean  that it is complicated to manipulate,  and  that  also
+therefore means  that it is reserved for developers  and  experienced
+professionals having in-depth computer knowledge. Users are therefore
+encouraged to load and test the software's suitability as regards their
+requirements in conditions enabling the security of their systems and/or
+data to be ensured and,  more generally, to use and operate it in the
+same conditions as regards security.
+
+The fact that you are presently reading this means that you have had
+knowledge of the CeCILL-B license and that you accept its terms.
+*/
+
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <filesystem>
+#include <vector>
+
+#include <Exceptions.H>
+#include <checkpoint.h>
+
+namespace OpenMEEG {
+
+    static const char* signature_file = "signature.txt";
+
+    Checkpoint::Checkpoint(const std::string& dir,const std::string& signature): directory(dir) {
+        if (!enabled())
+            return;
+
+        std::filesystem::create_directories(directory);
+
+        std::string previous;
+        std::ifstream ifs(path(signature_file).c_str());
+        std::getline(ifs,previous);
+        if (ifs.is_open() && previous==signature) {
+            std::cout << "Resuming from the checkpoints in " << directory << std::endl;
+            return;
+        }
+
+        if (ifs.is_open())
+            std::cerr << "Warning: the checkpoints in " << directory << " belong to another computation, they are discarded." << std::endl;
+        clear();
+
+        // As the results, the signature is written to a temporary file which is then renamed, so that an
+        // interrupted run never leaves a truncated signature.
+
+        const std::string& tmp = path(std::string(signature_file)+".tmp");
+        std::ofstream ofs(tmp.c_str());
+        ofs << signature << std::endl;
+        ofs.close();
+        if (!ofs)
+            throw maths::BadFileOpening(tmp,maths::BadFileOpening::WRITE);
+        commit(tmp,signature_file);
+    }
+
+    std::string Checkpoint::stamp(const std::string& filename) {
+        std::error_code ec;
+        const auto size  = std::filesystem::file_size(filename,ec);
+        const auto mtime = std::filesystem::last_write_time(filename,ec);
+        if (ec)
+            throw maths::BadFileOpening(filename,maths::BadFileOpening::READ);
+        std::ostringstream oss;
+        oss << filename << ' ' << size << ' ' << mtime.time_since_epoch().count();
+        return oss.str();
+    }
+
+    bool Checkpoint::exists(const std::string& name) const {
+        return enabled() && std::filesystem::exists(path(name));
+    }
+
+    void Checkpoint::commit(const std::string& tmp,const std::string& name) const {
+        std::filesystem::rename(tmp,path(name));
+    }
+
+    void Checkpoint::clear() const {
+        if (!enabled())
+            return;
+        const std::string pref(prefix);
+        std::vector<std::filesystem::path> files;
+        for (const auto& entry : std::filesystem::directory_iterator(directory))
+            if (entry.is_regular_file() && entry.path().filename().string().compare(0,pref.size(),pref)==0)
+                files.push_back(entry.path());
+        for (const auto& file : files)
+            std::filesystem::remove(file);
+    }
+}
@@ -0,0 +1,319 @@
+/*
+Project Name : OpenMEEG
+
+© INRIA and ENPC (contributors: Geoffray ADDE, Maureen CLERC, Alexandre 
+GRAMFORT, Renaud KERIVEN, Jan KYBIC, Perrine LANDREAU, Théodore PAPADOPOULO,
+Emmanuel OLIVI
+Maureen.Clerc.AT.inria.fr, keriven.AT.certis.enpc.fr,
+kybic.AT.fel.cvut.cz, papadop.AT.inria.fr)
+
+The OpenMEEG software is a C++ package for solving the forward/inverse
+problems of electroencephalography and magnetoencephalography.
+
+This software is governed by the CeCILL-B license under French law and
+abiding by the rules of distribution of free software.  You can  use,
+modify and/ or redistribute the software under the terms of the CeCILL-B
+license as circulated by CEA, CNRS and INRIA at the following URL
+"http://www.cecill.info".
+
+As a counterpart to the access to the source code and  rights to copy,
+modify and redistribute granted by the license, users are provided only
+with a limited warranty  and the software's authors,  the holders of the
+economic rights,  and the successive licensors  have only  limited
+liability.
+
+In this respect, the user's attention is drawn to the risks associated
+with loading,  using,  modifying and/or developing or reproducing the
+software by the user in light of its specific status of free software,
+that may mean  that it is complicated to manipulate,  and  that  also
+therefore means  that it is reserved for developers  and  experienced
+professionals having in-depth computer knowledge. Users are therefore
+encouraged to load and test the software's suitability as regards their
+requirements in conditions enabling the security of their systems and/or
+data to be ensured and,  more generally, to use and operate it in the
+same conditions as regards security.
+
+The fact that you are presently reading this means that you have had
+knowledge of the CeCILL-B license and that you accept its terms.
+*/
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+
+#include <Exceptions.H>
+#include <svd.h>
+#include <execution_policy.h>
+#include <out_of_core.h>
+#include <compressed_leadfield.h>
+
+namespace OpenMEEG {
+
+    //  Truncated SVD of a block, the smallest singular values being dropped as long as their energy
+    //  remains below tol^2 times the energy of the block.
+
+    CompressedLeadfield::Factors CompressedLeadfield::compress_block(const ConstMatrixView& B,const double tol) {
+        const TruncatedSVD& svd = truncated_svd(Matrix(B));
+
+        Factors factors;
+        factors.energy = 0.0;
+        for (size_t i=0;i<svd.rank();++i)
+            factors.energy += svd.s(i)*svd.s(i);
+
+        size_t r = svd.rank();
+        factors.discarded = 0.0;
+        while (r>0 && factors.discarded+svd.s(r-1)*svd.s(r-1)<=tol*tol*factors.energy) {
+            factors.discarded += svd.s(r-1)*svd.s(r-1);
+            --r;
+        }
+
+        factors.U = svd.U.submat(0,B.nlin(),0,r);
+        factors.W = Matrix(r,B.ncol());
+        for (size_t j=0;j<B.ncol();++j)
+            for (size_t i=0;i<r;++i)
+                factors.W(i,j) = svd.s(i)*svd.Vt(i,j);
+        return factors;
+    }
+
+    CompressedLeadfield::BlockFactors CompressedLeadfield::compress_blocks(const ConstMatrixView& G,const size_t block_size,const double tol) {
+        const size_t width = (block_size==0) ? std::max<size_t>(1,G.ncol()) : block_size;
+        const std::ptrdiff_t nb = (G.ncol()+width-1)/width;
+        BlockFactors factors(nb);
+        const ExecutionStage stage(ExecutionStage::OPENMP_LOOPS);
+        #pragma omp parallel for schedule(dynamic)
+        for (std::ptrdiff_t b=0;b<nb;++b) {
+            const size_t j0 = b*width;
+            factors[b] = compress_block(G.submat(0,G.nlin(),j0,std::min(width,G.ncol()-j0)),tol);
+        }
+        return factors;
+    }
+
+    //  Values: U (m x R, column major) and the W_b (rank x width, column major) one after the other.
+
+    size_t CompressedLeadfield::set_blocks(const std::vector<size_t>& widths,const std::vector<size_t>& ranks) {
+        blocks.resize(widths.size());
+        R = 0;
+        for (const size_t r : ranks)
+            R += r;
+
+        size_t col = 0;
+        size_t u   = 0;
+        size_t w   = nlin()*R;
+        for (size_t b=0;b<blocks.size();++b) {
+            blocks[b] = { col, widths[b], ranks[b], u, w };
+            col += widths[b];
+            u   += ranks[b];
+            w   += ranks[b]*widths[b];
+        }
+        return w;
+    }
+
+    CompressedLeadfield::CompressedLeadfield(const size_t m,const size_t n,const BlockFactors& factors): ImplicitOperator(m,n) {
+        std::vector<size_t> widths;
+        std::vector<size_t> ranks;
+        for (const auto& f : factors) {
+            widths.push_back(f.W.ncol());
+            ranks.push_back(f.W.nlin());
+            energy    += f.energy;
+            discarded += f.discarded;
+        }
+
+        storage = Matrix(set_blocks(widths,ranks),1);
+
+        const MatrixView& Uall = U();
+        for (size_t b=0;b<blocks.size();++b) {
+            const Block& blk = blocks[b];
+            if (blk.rank==0)
+                continue;
+            copy(factors[b].U.view(),Uall.submat(0,m,blk.u,blk.rank));
+            copy(factors[b].W.view(),W(blk));
+        }
+    }
+
+    CompressedLeadfield::CompressedLeadfield(const Matrix& G,const size_t block_size,const double tol):
+        CompressedLeadfield(G.nlin(),G.ncol(),compress_blocks(G.view(),block_size,tol))
+    { }
+
+    CompressedLeadfield CompressedLeadfield::compress(const std::string& filename,const size_t block_size,const double tol) {
+        const std::string::size_type pos = filename.rfind('.');
+        if (pos==std::string::npos || filename.substr(pos)!=".bin") {
+            Matrix G;
+            G.load(filename);
+            return CompressedLeadfield(G,block_size,tol);
+        }
+
+        // Raw binary files: panels of (about) 16 blocks are read and compressed in turn.
+
+        MatrixFile file(filename,LinOpInfo::FULL);
+        const size_t m = file.nlin();
+        const size_t n = file.ncol();
+        const size_t width = (block_size==0) ? std::max<size_t>(1,n) : block_size;
+        const size_t panel = (block_size==0) ? width : 16*width;
+
+        BlockFactors factors;
+        Matrix P(m,std::min(panel,n));
+        for (size_t j0=0;j0<n;j0+=panel) {
+            const size_t j1 = std::min(n,j0+panel);
+            const MatrixView& Pj = P.view(0,m,0,j1-j0);
+            file.read_panel(j0,j1,Pj.data());
+            const BlockFactors& panel_factors = compress_blocks(Pj,width,tol);
+            factors.insert(factors.end(),panel_factors.begin(),panel_factors.end());
+        }
+        return CompressedLeadfield(m,n,factors);
+    }
+
+    bool CompressedLeadfield::stored_in(const std::string& filename) {
+        std::ifstream ifs(filename.c_str(),std::ios::binary);
+        char file_tag[sizeof tag];
+        return ifs.read(file_tag,sizeof tag) && std::equal(file_tag,file_tag+sizeof tag,tag);
+    }
+
+    Matrix CompressedLeadfield::apply(const Matrix& X) const {
+        om_assert(X.nlin()==ncol());
+        const size_t k = X.ncol();
+        Matrix Y(nlin(),k);
+        if (R==0) {
+            Y.set(0.0);
+            return Y;
+        }
+
+        // T_b = W_b*X_b for each block (disjoint lines of T), then G*X = U*T.
+
+        Matrix T(R,k);
+        {
+            const ExecutionStage stage(ExecutionStage::OPENMP_LOOPS);
+            #pragma omp parallel for schedule(dynamic)
+            for (std::ptrdiff_t b=0;b<static_cast<std::ptrdiff_t>(blocks.size());++b) {
+                const Block& blk = blocks[b];
+                if (blk.rank!=0)
+                    gemm(false,false,1.0,W(blk),X.view(blk.col,blk.width,0,k),0.0,T.view(blk.u,blk.rank,0,k));
+            }
+        }
+        gemm(false,false,1.0,U(),T.view(),0.0,Y.view());
+        return Y;
+    }
+
+    Matrix CompressedLeadfield::tmult(const Matrix& Y) const {
+        om_assert(Y.nlin()==nlin());
+        const size_t k = Y.ncol();
+        Matrix X(ncol(),k);
+        X.set(0.0);
+        if (R==0)
+            return X;
+
+        // S = U'*Y, then X_b = W_b'*S_b for each block (disjoint lines of X).
+
+        Matrix S(R,k);
+        gemm(true,false,1.0,U(),Y.view(),0.0,S.view());
+
+        const ExecutionStage stage(ExecutionStage::OPENMP_LOOPS);
+        #pragma omp parallel for schedule(dynamic)
+        for (std::ptrdiff_t b=0;b<static_cast<std::ptrdiff_t>(blocks.size());++b) {
+            const Block& blk = blocks[b];
+            if (blk.rank!=0)
+                gemm(true,false,1.0,W(blk),S.view(blk.u,blk.rank,0,k),0.0,X.view(blk.col,blk.width,0,k));
+        }
+        return X;
+    }
+
+    Vector CompressedLeadfield::tmult(const Vector& y) const {
+        return tmult(Matrix(y,y.nlin(),1)).getcol(0);
+    }
+
+    Matrix CompressedLeadfield::decompress() const {
+        Matrix G(nlin(),ncol());
+        G.set(0.0);
+        const ConstMatrixView& Uall = U();
+        for (const auto& blk : blocks)
+            if (blk.rank!=0)
+                gemm(false,false,1.0,Uall.submat(0,nlin(),blk.u,blk.rank),W(blk),0.0,G.view(0,nlin(),blk.col,blk.width));
+        return G;
+    }
+
+    double CompressedLeadfield::relative_error() const {
+        return (energy==0.0) ? 0.0 : std::sqrt(discarded/energy);
+    }
+
+    void CompressedLeadfield::info() const {
+        const size_t dense = nlin()*ncol();
+        std::cout << "Compressed leadfield " << nlin() << " x " << ncol() << ": " << blocks.size() << " blocks, total rank " << R
+                  << ", " << storage.size() << " values (" << ((dense==0) ? 0.0 : 100.0*storage.size()/dense)
+                  << "% of the dense matrix), relative error <= " << relative_error() << std::endl;
+    }
+
+    //  File layout: tag, m, n, number of blocks, (energy, discarded energy), (width,rank) of each block, values.
+
+    namespace {
+
+        void write_uint(std::ostream& os,const size_t n) {
+            const uint64_t value = n;
+            os.write(reinterpret_cast<const char*>(&value),sizeof value);
+        }
+
+        size_t read_uint(std::istream& is) {
+            uint64_t value = 0;
+            is.read(reinterpret_cast<char*>(&value),sizeof value);
+            return value;
+        }
+    }
+
+    void CompressedLeadfield::save(const std::string& filename) const {
+        std::ofstream ofs(filename.c_str(),std::ios::binary);
+        if (!ofs)
+            throw maths::BadFileOpening(filename,maths::BadFileOpening::WRITE);
+
+        ofs.write(tag,sizeof tag);
+        write_uint(ofs,nlin());
+        write_uint(ofs,ncol());
+        write_uint(ofs,blocks.size());
+        const double energies[2] = { energy, discarded };
+        ofs.write(reinterpret_cast<const char*>(energies),sizeof energies);
+        for (const auto& blk : blocks) {
+            write_uint(ofs,blk.width);
+            write_uint(ofs,blk.rank);
+        }
+        ofs.write(reinterpret_cast<const char*>(storage.data()),storage.size()*sizeof(double));
+        if (!ofs)
+            throw maths::BadFileOpening(filename,maths::BadFileOpening::WRITE);
+    }
+
+    void CompressedLeadfield::load(const std::string& filename) {
+        std::ifstream ifs(filename.c_str(),std::ios::binary);
+        if (!ifs)
+            throw maths::BadFileOpening(filename,maths::BadFileOpening::READ);
+        char file_tag[sizeof tag];
+        if (!ifs.read(file_tag,sizeof tag) || !std::equal(file_tag,file_tag+sizeof tag,tag))
+            throw maths::BadContent(filename,"compressed leadfield");
+
+        const size_t m  = read_uint(ifs);
+        const size_t n  = read_uint(ifs);
+        const size_t nb = read_uint(ifs);
+        double energies[2];
+        ifs.read(reinterpret_cast<char*>(energies),sizeof energies);
+        if (!ifs || nb>n)
+            throw maths::BadContent(filename,"compressed leadfield");
+
+        std::vector<size_t> widths(nb);
+        std::vector<size_t> ranks(nb);
+        size_t width = 0;
+        for (size_t b=0;b<nb;++b) {
+            widths[b] = read_uint(ifs);
+            ranks[b]  = read_uint(ifs);
+            width += widths[b];
+        }
+        if (!ifs || width!=n)
+            throw maths::BadContent(filename,"compressed leadfield");
+
+        nlin()    = m;
+        ncol()    = n;
+        energy    = energies[0];
+        discarded = energies[1];
+        storage   = Matrix(set_blocks(widths,ranks),1);
+        ifs.read(reinterpret_cast<char*>(storage.data()),storage.size()*sizeof(double));
+        if (!ifs || ifs.peek()!=std::char_traits<char>::eof())
+            throw maths::BadContent(filename,"compressed leadfield");
+    }
+}
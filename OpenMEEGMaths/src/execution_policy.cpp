@@ -0,0 +1,218 @@
+/*
+Project Name : OpenMEEG
+
+© INRIA and ENPC (contributors: Geoffray ADDE, Maureen CLERC, Alexandre 
+GRAMFORT, Renaud KERIVEN, Jan KYBIC, Perrine LANDREAU, Théodore PAPADOPOULO,
+Emmanuel OLIVI
+Maureen.Clerc.AT.inria.fr, keriven.AT.certis.enpc.fr,
+kybic.AT.fel.cvut.cz, papadop.AT.inria.fr)
+
+The OpenMEEG software is a C++ package for solving the forward/inverse
+problems of electroencephalography and magnetoencephalography.
+
+This software is governed by the CeCILL-B license under French law and
+abiding by the rules of distribution of free software.  You can  use,
+modify and/ or redistribute the software under the terms of the CeCILL-B
+license as circulated by CEA, CNRS and INRIA at the following URL
+"http://www.cecill.info".
+
+As a counterpart to the access to the source code and  rights to copy,
+modify and redistribute granted by the license, users are provided only
+with a limited warranty  and the software's authors,  the holders of the
+economic rights,  and the successive licensors  have only  limited
+liability.
+
+In this respect, the user's attention is drawn to the risks associated
+with loading,  using,  modifying and/or developing or reproducing the
+software by the user in light of its specific status of free software,
+that may mean  that it is complicated to manipulate,  and  that  also
+therefore means  that it is reserved for developers  and  experienced
+professionals having in-depth computer knowledge. Users are therefore
+encouraged to load and test the software's suitability as regards their
+requirements in conditions enabling the security of their systems and/or
+data to be ensured and,  more generally, to use and operate it in the
+same conditions as regards security.
+
+The fact that you are presently reading this means that you have had
+knowledge of the CeCILL-B license and that you accept its terms.
+*/
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <stdexcept>
+
+#include <execution_policy.h>
+
+#ifndef NO_OPENMP
+#include <omp.h>
+#endif
+
+//  Control of the BLAS threads: MKL and OpenBLAS have their own calls. The reference Blas/Lapack configuration
+//  is often linked against OpenBLAS: its calls are then used if they are found at link time.
+
+#if defined(USE_MKL)
+    #define BLAS_THREADS_MKL
+#elif defined(USE_OPENBLAS)
+    #define BLAS_THREADS_OPENBLAS
+#elif defined(__GNUC__) && defined(__linux__)
+    extern "C" {
+        void openblas_set_num_threads(int) __attribute__((weak));
+        int  openblas_get_num_threads()    __attribute__((weak));
+    }
+    #define BLAS_THREADS_OPENBLAS
+    #define BLAS_THREADS_WEAK
+#endif
+
+namespace OpenMEEG {
+
+    static bool blas_controllable() {
+        #if defined(BLAS_THREADS_WEAK)
+        return openblas_set_num_threads!=nullptr && openblas_get_num_threads!=nullptr;
+        #elif defined(BLAS_THREADS_MKL) || defined(BLAS_THREADS_OPENBLAS)
+        return true;
+        #else
+        return false;
+        #endif
+    }
+
+    static bool in_parallel() {
+        #ifndef NO_OPENMP
+        return omp_in_parallel();
+        #else
+        return false;
+        #endif
+    }
+
+    static ExecutionPolicy resolve(const ExecutionPolicy& policy) {
+        ExecutionPolicy resolved = policy;
+        if (resolved.threads==0) {
+            #ifndef NO_OPENMP
+            resolved.threads = omp_get_max_threads();
+            #else
+            resolved.threads = 1;
+            #endif
+        }
+        if (resolved.blas_threads==0) {
+            #ifndef NO_OPENMP
+            resolved.blas_threads = resolved.threads;
+            #else
+            resolved.blas_threads = std::max(blas_threads(),1U); // Without OpenMP loops, keep the BLAS default.
+            #endif
+        }
+        return resolved;
+    }
+
+    static ExecutionPolicy& current_policy() {
+        static ExecutionPolicy policy = resolve(ExecutionPolicy());
+        return policy;
+    }
+
+    // Set an environment variable unless it is already defined (by the user).
+
+    static void set_default_env(const char* name,const char* value) {
+        if (std::getenv(name)!=nullptr)
+            return;
+        #ifdef _WIN32
+        _putenv_s(name,value);
+        #else
+        setenv(name,value,0);
+        #endif
+    }
+
+    ExecutionPolicy::Binding ExecutionPolicy::binding_from_string(const std::string& name) {
+        if (name=="none")
+            return NO_BINDING;
+        if (name=="close")
+            return CLOSE;
+        if (name=="spread")
+            return SPREAD;
+        throw std::invalid_argument("Unknown thread binding "+name+" (expected none, close or spread).");
+    }
+
+    const ExecutionPolicy& set_execution_policy(const ExecutionPolicy& policy) {
+        ExecutionPolicy& current = current_policy();
+        current = resolve(policy);
+        #ifndef NO_OPENMP
+        omp_set_num_threads(current.threads);
+        #endif
+        set_blas_threads(current.blas_threads);
+        if (!set_thread_binding(current.binding))
+            std::cerr << "Warning: the OpenMP runtime was started without thread binding, which is thus ignored "
+                      << "(set OMP_PROC_BIND before starting the program)." << std::endl;
+        return current;
+    }
+
+    bool set_thread_binding(const ExecutionPolicy::Binding binding) {
+        if (binding==ExecutionPolicy::NO_BINDING)
+            return true;
+        #ifndef NO_OPENMP
+        set_default_env("OMP_PROC_BIND",(binding==ExecutionPolicy::CLOSE) ? "close" : "spread");
+        set_default_env("OMP_PLACES","cores");
+        return omp_get_proc_bind()!=omp_proc_bind_false;
+        #else
+        return false;
+        #endif
+    }
+
+    const ExecutionPolicy& execution_policy() { return current_policy(); }
+
+    unsigned blas_threads() {
+        if (!blas_controllable())
+            return 0;
+        #if defined(BLAS_THREADS_MKL)
+        return mkl_get_max_threads();
+        #elif defined(BLAS_THREADS_OPENBLAS)
+        return openblas_get_num_threads();
+        #else
+        return 0;
+        #endif
+    }
+
+    bool set_blas_threads(const unsigned n) {
+        if (!blas_controllable())
+            return false;
+        #if defined(BLAS_THREADS_MKL)
+        mkl_set_num_threads(n);
+        #elif defined(BLAS_THREADS_OPENBLAS)
+        openblas_set_num_threads(n);
+        #endif
+        return true;
+    }
+
+    // Inside a parallel region, only the thread local setting of MKL can be changed safely.
+
+    ExecutionStage::ExecutionStage([[maybe_unused]] const Kind kind): previous(0),restore(false),local(false) {
+        if (!blas_controllable())
+            return;
+
+        if (in_parallel()) {
+            #ifdef BLAS_THREADS_MKL
+            previous = mkl_set_num_threads_local(1);
+            restore = local = true;
+            #endif
+            return;
+        }
+
+        #ifndef NO_OPENMP
+        const unsigned wanted = (kind==OPENMP_LOOPS) ? 1 : execution_policy().blas_threads;
+        #else
+        const unsigned wanted = execution_policy().blas_threads;
+        #endif
+        previous = blas_threads();
+        if (previous!=wanted)
+            restore = set_blas_threads(wanted);
+    }
+
+    ExecutionStage::~ExecutionStage() {
+        if (!restore)
+            return;
+        #ifdef BLAS_THREADS_MKL
+        if (local) {
+            mkl_set_num_threads_local(previous);
+            return;
+        }
+        #endif
+        set_blas_threads(previous);
+    }
+}
@@ -0,0 +1,152 @@
+/*
+Project Name : OpenMEEG
+
+© INRIA and ENPC (contributors: Geoffray ADDE, Maureen CLERC, Alexandre 
+GRAMFORT, Renaud KERIVEN, Jan KYBIC, Perrine LANDREAU, Théodore PAPADOPOULO,
+Emmanuel OLIVI
+Maureen.Clerc.AT.inria.fr, keriven.AT.certis.enpc.fr,
+kybic.AT.fel.cvut.cz, papadop.AT.inria.fr)
+
+The OpenMEEG software is a C++ package for solving the forward/inverse
+problems of electroencephalography and magnetoencephalography.
+
+This software is governed by the CeCILL-B license under French law and
+abiding by the rules of distribution of free software.  You can  use,
+modify and/ or redistribute the software under the terms of the CeCILL-B
+license as circulated by CEA, CNRS and INRIA at the following URL
+"http://www.cecill.info".
+
+As a counterpart to the access to the source code and  rights to copy,
+modify and redistribute granted by the license, users are provided only
+with a limited warranty  and the software's authors,  the holders of the
+economic rights,  and the successive licensors  have only  limited
+liability.
+
+In this respect, the user's attention is drawn to the risks associated
+with loading,  using,  modifying and/or developing or reproducing the
+software by the user in light of its specific status of free software,
+that may mean  that it is complicated to manipulate,  and  that  also
+therefore means  that it is reserved for developers  and  experienced
+professionals having in-depth computer knowledge. Users are therefore
+encouraged to load and test the software's suitability as regards their
+requirements in conditions enabling the security of their systems and/or
+data to be ensured and,  more generally, to use and operate it in the
+same conditions as regards security.
+
+The fact that you are presently reading this means that you have had
+knowledge of the CeCILL-B license and that you accept its terms.
+*/
+
+#include <new>
+#include <cstddef>
+
+#ifdef _WIN32
+#include <malloc.h>
+#else
+#include <sys/mman.h>
+#endif
+
+#include "OpenMEEGMathsConfig.h"
+#include "linop.h"
+
+namespace OpenMEEG {
+
+    namespace {
+
+        // Below this size, thread creation costs more than it brings.
+
+        constexpr std::ptrdiff_t parallel_touch_threshold = 1<<15;
+
+        constexpr size_t huge_page_size = 1<<21;
+
+        #if defined(__linux__) && defined(MAP_HUGETLB)
+        constexpr bool explicit_huge_pages = true;
+        #else
+        constexpr bool explicit_huge_pages = false;
+        #endif
+
+        inline size_t mapped_size(const size_t n) {
+            return ((n*sizeof(double)+huge_page_size-1)/huge_page_size)*huge_page_size;
+        }
+
+        double* aligned_alloc(const size_t n,const size_t alignment) {
+            const size_t sz = (n==0) ? alignment : n*sizeof(double);
+            #ifdef _WIN32
+            void* ptr = _aligned_malloc(sz,alignment);
+            if (ptr==nullptr)
+                throw std::bad_alloc();
+            #else
+            void* ptr = nullptr;
+            if (posix_memalign(&ptr,alignment,sz)!=0)
+                throw std::bad_alloc();
+            #endif
+            return static_cast<double*>(ptr);
+        }
+
+        void aligned_free(double* ptr) {
+            #ifdef _WIN32
+            _aligned_free(ptr);
+            #else
+            free(ptr);
+            #endif
+        }
+    }
+
+    std::shared_ptr<Allocator>& Allocator::allocator() {
+        static std::shared_ptr<Allocator> alloc = std::make_shared<AlignedAllocator>();
+        return alloc;
+    }
+
+    double* AlignedAllocator::allocate(const size_t n) {
+        if (!use_huge_pages(n))
+            return aligned_alloc(n,alignment);
+
+        #if defined(__linux__) && defined(MAP_HUGETLB)
+        if (huge_pages==EXPLICIT_HUGE_PAGES) {
+
+            //  Mappings are always huge page sized, so that deallocate does not need to know
+            //  whether the huge page pool was exhausted.
+
+            const size_t sz = mapped_size(n);
+            void* ptr = mmap(nullptr,sz,PROT_READ|PROT_WRITE,MAP_PRIVATE|MAP_ANONYMOUS|MAP_HUGETLB,-1,0);
+            if (ptr==MAP_FAILED)
+                ptr = mmap(nullptr,sz,PROT_READ|PROT_WRITE,MAP_PRIVATE|MAP_ANONYMOUS,-1,0);
+            if (ptr==MAP_FAILED)
+                throw std::bad_alloc();
+            return static_cast<double*>(ptr);
+        }
+        #endif
+
+        double* ptr = aligned_alloc(n,huge_page_size);
+        #if defined(__linux__) && defined(MADV_HUGEPAGE)
+        madvise(ptr,n*sizeof(double),MADV_HUGEPAGE);
+        #endif
+        return ptr;
+    }
+
+    void AlignedAllocator::deallocate(double* ptr,const size_t n) {
+        if (ptr==nullptr)
+            return;
+        if (explicit_huge_pages && huge_pages==EXPLICIT_HUGE_PAGES && use_huge_pages(n)) {
+            #if defined(__linux__) && defined(MAP_HUGETLB)
+            munmap(ptr,mapped_size(n));
+            #endif
+            return;
+        }
+        aligned_free(ptr);
+    }
+
+    void first_touch(double* ptr,const size_t n,const double val) {
+        const std::ptrdiff_t sz = n;
+        #pragma omp parallel for schedule(static) if(sz>parallel_touch_threshold)
+        for (std::ptrdiff_t i=0;i<sz;++i)
+            ptr[i] = val;
+    }
+
+    void first_touch(double* ptr,const size_t n,const double* initval) {
+        const std::ptrdiff_t sz = n;
+        #pragma omp parallel for schedule(static) if(sz>parallel_touch_threshold)
+        for (std::ptrdiff_t i=0;i<sz;++i)
+            ptr[i] = initval[i];
+    }
+}
@@ -0,0 +1,398 @@
+/*
+Project Name : OpenMEEG
+
+© INRIA and ENPC (contributors: Geoffray ADDE, Maureen CLERC, Alexandre 
+GRAMFORT, Renaud KERIVEN, Jan KYBIC, Perrine LANDREAU, Théodore PAPADOPOULO,
+Emmanuel OLIVI
+Maureen.Clerc.AT.inria.fr, keriven.AT.certis.enpc.fr,
+kybic.AT.fel.cvut.cz, papadop.AT.inria.fr)
+
+The OpenMEEG software is a C++ package for solving the forward/inverse
+problems of electroencephalography and magnetoencephalography.
+
+This software is governed by the CeCILL-B license under French law and
+abiding by the rules of distribution of free software.  You can  use,
+modify and/ or redistribute the software under the terms of the CeCILL-B
+license as circulated by CEA, CNRS and INRIA at the following URL
+"http://www.cecill.info".
+
+As a counterpart to the access to the source code and  rights to copy,
+modify and redistribute granted by the license, users are provided only
+with a limited warranty  and the software's authors,  the holders of the
+economic rights,  and the successive licensors  have only  limited
+liability.
+
+In this respect, the user's attention is drawn to the risks associated
+with loading,  using,  modifying and/or developing or reproducing the
+software by the user in light of its specific status of free software,
+that may mean  that it is complicated to manipulate,  and  that  also
+therefore means  that it is reserved for developers  and  experienced
+professionals having in-depth computer knowledge. Users are therefore
+encouraged to load and test the software's suitability as regards their
+requirements in conditions enabling the security of their systems and/or
+data to be ensured and,  more generally, to use and operate it in the
+same conditions as regards security.
+
+The fact that you are presently reading this means that you have had
+knowledge of the CeCILL-B license and that you accept its terms.
+*/
+
+#include <cstddef>
+#include <iostream>
+
+#include <Exceptions.H>
+#include <linop_algebra.h>
+
+namespace OpenMEEG {
+
+    // Y(i0:i0+m,:) += Z
+
+    static void add_lines(Matrix& Y,const size_t i0,const Matrix& Z) {
+        const MatrixView& Yb = Y.view(i0,Z.nlin(),0,Z.ncol());
+        for (size_t j=0;j<Z.ncol();++j)
+            axpy(1.0,Z.col_view(j),Yb.getcol(j));
+    }
+
+    void ImplicitOperator::info() const {
+        std::cout << "Implicit operator (" << name() << ")" << std::endl;
+        std::cout << "Dimensions : " << nlin() << " x " << ncol() << std::endl;
+        std::cout << "Stored values : " << size() << std::endl;
+    }
+
+    Matrix ImplicitOperator::apply_inverse(const Matrix&) const {
+        throw maths::NotInvertible(name());
+    }
+
+    Vector ImplicitOperator::operator*(const Vector& x) const {
+        om_assert(x.nlin()==ncol());
+        Matrix Y = apply(Matrix(x,x.nlin(),1));
+        return Vector(Y);
+    }
+
+    Vector ImplicitOperator::solve(const Vector& b) const {
+        om_assert(nlin()==ncol() && b.nlin()==nlin());
+        Matrix X = apply_inverse(Matrix(b,b.nlin(),1));
+        return Vector(X);
+    }
+
+    // LU factorization with partial pivoting (DGETRF) of a copy of the matrix.
+
+    void MatrixOperator::factorize() const {
+    #ifdef HAVE_LAPACK
+        const ExecutionStage stage(ExecutionStage::DENSE_ALGEBRA);
+        Matrix M(A,DEEP_COPY);
+        pivots.resize(nlin());
+        BLAS_INT n = sizet_to_int(nlin());
+        #if defined(CLAPACK_INTERFACE) && !(defined(__APPLE__) && defined(USE_VECLIB))
+            const BLAS_INT Info = DGETRF(n,n,M.data(),n,pivots.data());
+        #else
+            BLAS_INT Info = 0;
+            DGETRF(n,n,M.data(),n,pivots.data(),Info);
+        #endif
+        if (Info!=0)
+            throw maths::NotInvertible(name());
+        LU = M;
+    #else
+        throw maths::NotInvertible(name());
+    #endif
+    }
+
+    Matrix MatrixOperator::apply_inverse(const Matrix& B) const {
+        std::call_once(factorized,[this]() { factorize(); });
+        Matrix X(B,DEEP_COPY);
+    #ifdef HAVE_LAPACK
+        const ExecutionStage stage(ExecutionStage::DENSE_ALGEBRA);
+        char     trans = 'N';
+        BLAS_INT n     = sizet_to_int(nlin());
+        BLAS_INT nrhs  = sizet_to_int(X.ncol());
+        BLAS_INT Info  = 0;
+        DGETRS(trans,n,nrhs,LU.data(),n,pivots.data(),X.data(),n,Info);
+        om_error(Info==0);
+    #endif
+        return X;
+    }
+
+    Matrix SymMatrixOperator::apply_inverse(const Matrix& B) const {
+        std::call_once(factorized,[this]() { factorization = std::make_shared<SymMatrixFactorization>(A); });
+        Matrix X(B,DEEP_COPY);
+        factorization->solve(X);
+        return X;
+    }
+
+    Matrix DiagonalOperator::apply(const Matrix& X) const {
+        Matrix Y(X.nlin(),X.ncol());
+        #pragma omp parallel for
+        for (std::ptrdiff_t j=0;j<static_cast<std::ptrdiff_t>(X.ncol());++j)
+            for (size_t i=0;i<X.nlin();++i)
+                Y(i,j) = diag(i)*X(i,j);
+        return Y;
+    }
+
+    Matrix DiagonalOperator::apply_inverse(const Matrix& B) const {
+        Matrix X(B.nlin(),B.ncol());
+        #pragma omp parallel for
+        for (std::ptrdiff_t j=0;j<static_cast<std::ptrdiff_t>(B.ncol());++j)
+            for (size_t i=0;i<B.nlin();++i)
+                X(i,j) = B(i,j)/diag(i);
+        return X;
+    }
+
+    Matrix ScaledOperator::apply(const Matrix& X) const {
+        Matrix Y = A->apply(X);
+        Y *= alpha;
+        return Y;
+    }
+
+    Matrix ScaledOperator::apply_inverse(const Matrix& B) const {
+        Matrix X = A->apply_inverse(B);
+        X *= 1.0/alpha;
+        return X;
+    }
+
+    SumOperator::SumOperator(const std::vector<Operator>& ops): ImplicitOperator(ops.front()->nlin(),ops.front()->ncol()),terms(ops) {
+        for (const auto& term : terms)
+            om_assert(term->nlin()==nlin() && term->ncol()==ncol());
+    }
+
+    size_t SumOperator::size() const {
+        size_t res = 0;
+        for (const auto& term : terms)
+            res += term->size();
+        return res;
+    }
+
+    Matrix SumOperator::apply(const Matrix& X) const {
+        Matrix Y = terms.front()->apply(X);
+        for (auto it=terms.begin()+1;it!=terms.end();++it)
+            Y += (*it)->apply(X);
+        return Y;
+    }
+
+    ProductOperator::ProductOperator(const std::vector<Operator>& ops): ImplicitOperator(ops.front()->nlin(),ops.back()->ncol()),factors(ops) {
+        for (size_t i=1;i<factors.size();++i)
+            om_assert(factors[i-1]->ncol()==factors[i]->nlin());
+    }
+
+    size_t ProductOperator::size() const {
+        size_t res = 0;
+        for (const auto& factor : factors)
+            res += factor->size();
+        return res;
+    }
+
+    Matrix ProductOperator::apply(const Matrix& X) const {
+        Matrix Y = factors.back()->apply(X);
+        for (auto it=factors.rbegin()+1;it!=factors.rend();++it)
+            Y = (*it)->apply(Y);
+        return Y;
+    }
+
+    bool ProductOperator::invertible() const {
+        for (const auto& factor : factors)
+            if (factor->nlin()!=factor->ncol() || !factor->invertible())
+                return false;
+        return true;
+    }
+
+    Matrix ProductOperator::apply_inverse(const Matrix& B) const {
+        Matrix X = factors.front()->apply_inverse(B);
+        for (auto it=factors.begin()+1;it!=factors.end();++it)
+            X = (*it)->apply_inverse(X);
+        return X;
+    }
+
+    LowRankOperator::LowRankOperator(const Matrix& u,const Matrix& c,const Matrix& v):
+        ImplicitOperator(u.nlin(),v.nlin()),U(u),C(c),V(v)
+    {
+        om_assert(C.nlin()==U.ncol() && C.ncol()==V.ncol());
+    }
+
+    Vector LowRankOperator::diagonal() const {
+        om_assert(nlin()==ncol());
+        const Matrix& UC = U*C;
+        Vector d(nlin());
+        #pragma omp parallel for
+        for (std::ptrdiff_t i=0;i<static_cast<std::ptrdiff_t>(nlin());++i)
+            d(i) = dot(UC.lin_view(i),V.lin_view(i));
+        return d;
+    }
+
+    RankUpdateOperator::RankUpdateOperator(const Operator& op,const std::shared_ptr<const LowRankOperator>& upd):
+        ImplicitOperator(op->nlin(),op->ncol()),A(op),update(upd)
+    {
+        om_assert(update->nlin()==nlin() && update->ncol()==ncol());
+    }
+
+    Matrix RankUpdateOperator::apply(const Matrix& X) const {
+        Matrix Y = A->apply(X);
+        Y += update->apply(X);
+        return Y;
+    }
+
+    Matrix RankUpdateOperator::apply_inverse(const Matrix& B) const {
+
+        // X = Y-W*K*V'*Y with Y = A^-1*B, W = A^-1*U and K = (I+C*V'*W)^-1*C.
+
+        std::call_once(factorized,[this]() {
+            const Matrix& C = update->middle();
+            W = A->apply_inverse(update->left());
+            Matrix S = C*update->right().tmult(W);
+            for (size_t i=0;i<S.nlin();++i)
+                S(i,i) += 1.0;
+            K = S.inverse()*C;
+        });
+
+        Matrix X = A->apply_inverse(B);
+        X -= W*(K*update->right().tmult(X));
+        return X;
+    }
+
+    BlockDiagonalOperator::BlockDiagonalOperator(const std::vector<Operator>& ops): ImplicitOperator(0,0),blocks(ops) {
+        for (const auto& block : blocks) {
+            nlin() += block->nlin();
+            ncol() += block->ncol();
+        }
+    }
+
+    size_t BlockDiagonalOperator::size() const {
+        size_t res = 0;
+        for (const auto& block : blocks)
+            res += block->size();
+        return res;
+    }
+
+    Matrix BlockDiagonalOperator::apply(const Matrix& X) const {
+        Matrix Y(nlin(),X.ncol());
+        size_t i0 = 0;
+        size_t j0 = 0;
+        for (const auto& block : blocks) {
+            Y.insertmat(i0,0,block->apply(X.submat(j0,block->ncol(),0,X.ncol())));
+            i0 += block->nlin();
+            j0 += block->ncol();
+        }
+        return Y;
+    }
+
+    bool BlockDiagonalOperator::invertible() const {
+        for (const auto& block : blocks)
+            if (block->nlin()!=block->ncol() || !block->invertible())
+                return false;
+        return true;
+    }
+
+    Matrix BlockDiagonalOperator::apply_inverse(const Matrix& B) const {
+        Matrix X(ncol(),B.ncol());
+        size_t i0 = 0;
+        for (const auto& block : blocks) {
+            X.insertmat(i0,0,block->apply_inverse(B.submat(i0,block->nlin(),0,B.ncol())));
+            i0 += block->nlin();
+        }
+        return X;
+    }
+
+    BlockStructuredOperator::BlockStructuredOperator(const Blocks& ops): ImplicitOperator(0,0),blocks(ops) {
+
+        // The sizes of the lines and columns of blocks are given by their non null blocks.
+
+        const size_t nl = blocks.size();
+        const size_t nc = blocks.front().size();
+        std::vector<size_t> heights(nl,0);
+        std::vector<size_t> widths(nc,0);
+        for (size_t i=0;i<nl;++i) {
+            om_assert(blocks[i].size()==nc);
+            for (size_t j=0;j<nc;++j) {
+                const Operator& block = blocks[i][j];
+                if (block==nullptr)
+                    continue;
+                om_assert(heights[i]==0 || heights[i]==block->nlin());
+                om_assert(widths[j]==0  || widths[j]==block->ncol());
+                heights[i] = block->nlin();
+                widths[j]  = block->ncol();
+            }
+        }
+
+        line_offsets.push_back(0);
+        for (const auto& h : heights) {
+            om_assert(h!=0);
+            line_offsets.push_back(line_offsets.back()+h);
+        }
+
+        col_offsets.push_back(0);
+        for (const auto& w : widths) {
+            om_assert(w!=0);
+            col_offsets.push_back(col_offsets.back()+w);
+        }
+
+        nlin() = line_offsets.back();
+        ncol() = col_offsets.back();
+    }
+
+    size_t BlockStructuredOperator::size() const {
+        size_t res = 0;
+        for (const auto& line : blocks)
+            for (const auto& block : line)
+                if (block!=nullptr)
+                    res += block->size();
+        return res;
+    }
+
+    Matrix BlockStructuredOperator::apply(const Matrix& X) const {
+        Matrix Y(nlin(),X.ncol());
+        Y.set(0.0);
+        for (size_t j=0;j<col_offsets.size()-1;++j) {
+            const Matrix& Xj = X.submat(col_offsets[j],col_offsets[j+1]-col_offsets[j],0,X.ncol());
+            for (size_t i=0;i<blocks.size();++i)
+                if (blocks[i][j]!=nullptr)
+                    add_lines(Y,line_offsets[i],blocks[i][j]->apply(Xj));
+        }
+        return Y;
+    }
+
+    bool BlockStructuredOperator::lower_triangular() const {
+        for (size_t i=0;i<blocks.size();++i)
+            for (size_t j=i+1;j<blocks[i].size();++j)
+                if (blocks[i][j]!=nullptr)
+                    return false;
+        return true;
+    }
+
+    bool BlockStructuredOperator::upper_triangular() const {
+        for (size_t i=0;i<blocks.size();++i)
+            for (size_t j=0;j<i && j<blocks[i].size();++j)
+                if (blocks[i][j]!=nullptr)
+                    return false;
+        return true;
+    }
+
+    bool BlockStructuredOperator::invertible() const {
+        if (blocks.size()!=blocks.front().size() || !(lower_triangular() || upper_triangular()))
+            return false;
+        for (size_t i=0;i<blocks.size();++i)
+            if (blocks[i][i]==nullptr || blocks[i][i]->nlin()!=blocks[i][i]->ncol() || !blocks[i][i]->invertible())
+                return false;
+        return true;
+    }
+
+    Matrix BlockStructuredOperator::apply_inverse(const Matrix& B) const {
+        if (!invertible())
+            throw maths::NotInvertible(name());
+
+        // Block substitution: X_i = A_ii^-1 (B_i - sum_j A_ij X_j), forward for lower triangular operators,
+        // backward for upper triangular ones.
+
+        const size_t n     = blocks.size();
+        const bool   lower = lower_triangular();
+
+        Matrix X(ncol(),B.ncol());
+        for (size_t k=0;k<n;++k) {
+            const size_t i  = (lower) ? k : n-1-k;
+            const size_t mi = line_offsets[i+1]-line_offsets[i];
+            Matrix Bi = B.submat(line_offsets[i],mi,0,B.ncol());
+            for (size_t j=0;j<n;++j)
+                if (j!=i && blocks[i][j]!=nullptr)
+                    Bi -= blocks[i][j]->apply(X.submat(col_offsets[j],col_offsets[j+1]-col_offsets[j],0,B.ncol()));
+            X.insertmat(col_offsets[i],0,blocks[i][i]->apply_inverse(Bi));
+        }
+        return X;
+    }
+}
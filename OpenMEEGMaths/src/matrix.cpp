@@ -48,11 +48,12 @@ knowledge of the CeCILL-B license and that you accept its terms.
 #include <symmatrix.h>
 #include <sparse_matrix.h>
 #include <vector.h>
+#include <svd.h>
 
 namespace OpenMEEG {
 
     const Matrix& Matrix::set(const double d) {
-        for(size_t i=0;i<size();i++) data()[i]=d;
+        first_touch(data(),size(),d);
         return *this;
     }
 
@@ -76,44 +77,45 @@ namespace OpenMEEG {
 
     /// pseudo inverse
     Matrix Matrix::pinverse(double tolrel) const {
-        if (ncol() > nlin()) {
-            return transpose().pinverse().transpose();
-        } else {
+        // following LAPACK The singular values of A, sorted so that S(i) >= S(i+1).
+        // A thin SVD is sufficient: neither the complete U nor the complete V is needed.
+        if ( tolrel == 0 ) tolrel = std::numeric_limits<double>::epsilon();
+        const TruncatedSVD& svd = truncated_svd(*this,std::max(nlin(),ncol())*tolrel);
+        if ( svd.rank() == 0 ) {
             Matrix result(ncol(), nlin());
-            result.set(0.0);
-            Matrix U, V;
-            SparseMatrix S;
-            svd(U, S, V, false);
-            double maxs = 0;
-            unsigned mimi = std::min(S.nlin(), S.ncol());
-            // following LAPACK The singular values of A, sorted so that S(i) >= S(i+1).
-            maxs = S(0,0);
-            if ( tolrel == 0 ) tolrel = std::numeric_limits<double>::epsilon();
-            double tol = std::max(nlin(), ncol()) * maxs * tolrel;
-            unsigned r = 0;
-            for ( size_t i = 0; i < mimi; i++) {
-                if ( S(i, i) > tol ) r++;
-            }
-            if ( r == 0 ) {
-                result.set(0.);
-                return result;
-            } else {
-                Matrix s(r, r); s.set(0);
-                for ( size_t i = 0; i < r; i++) {
-                    s(i, i) = 1.0 / S(i, i);
-                }
-                const Matrix Vbis(V.transpose(),r); // keep only the first r columns
-                const Matrix Ubis(U,r);
-                return Vbis * s * Ubis.transpose();
-            }
+            result.set(0.);
+            return result;
         }
+        // result = V*s^{-1}*U^T = (s^{-1}*Vt)^T*U^T
+        Matrix Vbis(svd.Vt,DEEP_COPY);
+        for (size_t j=0; j<Vbis.ncol(); j++)
+            for (size_t i=0; i<svd.rank(); i++)
+                Vbis(i,j) /= svd.s(i);
+        return Vbis.tmultt(svd.U);
     }
 
+    //  Cache blocked transposition: tiles of the result are filled by all threads, each tile
+    //  reading and writing a small number of cache lines.
+
     Matrix Matrix::transpose() const {
+        constexpr size_t tile = 32;
         Matrix result(ncol(),nlin());
-        for (size_t i=0; i<nlin(); i++)
-            for ( size_t j=0; j<ncol(); j++)
-                result(j,i)=(*this)(i,j);
+        const double* src = data();
+        double*       dst = result.data();
+        const size_t m = nlin();
+        const size_t n = ncol();
+        const size_t ntiles_i = (m+tile-1)/tile;
+        const std::ptrdiff_t ntiles = ntiles_i*((n+tile-1)/tile);
+        #pragma omp parallel for schedule(static)
+        for (std::ptrdiff_t t=0; t<ntiles; ++t) {
+            const size_t i0 = (t%ntiles_i)*tile;
+            const size_t j0 = (t/ntiles_i)*tile;
+            const size_t i1 = std::min(i0+tile,m);
+            const size_t j1 = std::min(j0+tile,n);
+            for (size_t i=i0; i<i1; ++i)
+                for (size_t j=j0; j<j1; ++j)
+                    dst[j+n*i] = src[i+m*j];
+        }
         return result;
     }
 
@@ -0,0 +1,504 @@
+/*
+Project Name : OpenMEEG
+
+© INRIA and ENPC (contributors: Geoffray ADDE, Maureen CLERC, Alexandre 
+GRAMFORT, Renaud KERIVEN, Jan KYBIC, Perrine LANDREAU, Théodore PAPADOPOULO,
+Emmanuel OLIVI
+Maureen.Clerc.AT.inria.fr, keriven.AT.certis.enpc.fr,
+kybic.AT.fel.cvut.cz, papadop.AT.inria.fr)
+
+The OpenMEEG software is a C++ package for solving the forward/inverse
+problems of electroencephalography and magnetoencephalography.
+
+This software is governed by the CeCILL-B license under French law and
+abiding by the rules of distribution of free software.  You can  use,
+modify and/ or redistribute the software under the terms of the CeCILL-B
+license as circulated by CEA, CNRS and INRIA at the following URL
+"http://www.cecill.info".
+
+As a counterpart to the access to the source code and  rights to copy,
+modify and redistribute granted by the license, users are provided only
+with a limited warranty  and the software's authors,  the holders of the
+economic rights,  and the successive licensors  have only  limited
+liability.
+
+In this respect, the user's attention is drawn to the risks associated
+with loading,  using,  modifying and/or developing or reproducing the
+software by the user in light of its specific status of free software,
+that may mean  that it is complicated to manipulate,  and  that  also
+therefore means  that it is reserved for developers  and  experienced
+professionals having in-depth computer knowledge. Users are therefore
+encouraged to load and test the software's suitability as regards their
+requirements in conditions enabling the security of their systems and/or
+data to be ensured and,  more generally, to use and operate it in the
+same conditions as regards security.
+
+The fact that you are presently reading this means that you have had
+knowledge of the CeCILL-B license and that you accept its terms.
+*/
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdio>
+#include <filesystem>
+#include <optional>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include <Exceptions.H>
+#include <matrix.h>
+#include <symmatrix.h>
+#include <out_of_core.h>
+
+namespace OpenMEEG {
+
+    MatrixFile::MatrixFile(const std::string& filename,const StorageType st,const bool update):
+        name(filename),storage(st),file(filename.c_str(),(update) ? std::ios::in|std::ios::out|std::ios::binary : std::ios::in|std::ios::binary)
+    {
+        if (!file.is_open())
+            throw maths::BadFileOpening(name,(update) ? maths::BadFileOpening::WRITE : maths::BadFileOpening::READ);
+
+        unsigned ui;
+        file.read(reinterpret_cast<char*>(&ui),sizeof(unsigned));
+        num_lines = num_cols = ui;
+        if (!symmetric()) {
+            file.read(reinterpret_cast<char*>(&ui),sizeof(unsigned));
+            num_cols = ui;
+        }
+
+        file.seekg(0,std::ios::end);
+        if (!file || file.tellg()!=header_size()+static_cast<std::streamoff>(position(0,num_cols)*sizeof(double)))
+            throw maths::BadContent("binary",(symmetric()) ? "symmetric matrix" : "matrix");
+    }
+
+    MatrixFile::MatrixFile(const std::string& filename,const StorageType st,const size_t m,const size_t n):
+        name(filename),storage(st),file(filename.c_str(),std::ios::in|std::ios::out|std::ios::trunc|std::ios::binary),
+        num_lines((st==LinOpInfo::SYMMETRIC) ? n : m),num_cols(n)
+    {
+        if (!file.is_open())
+            throw maths::BadFileOpening(name,maths::BadFileOpening::WRITE);
+
+        const unsigned header[2] = { static_cast<unsigned>(num_lines),static_cast<unsigned>(num_cols) };
+        file.write(reinterpret_cast<const char*>(header),header_size());
+        file.flush();
+
+        // The file is given its final size, so that it can be reopened (to resume a computation) before being complete.
+
+        std::filesystem::resize_file(name,header_size()+static_cast<std::streamoff>(position(0,num_cols)*sizeof(double)));
+    }
+
+    void MatrixFile::read(const size_t i0,const size_t i1,const size_t j,double* values) {
+        om_assert(i0<=i1 && i1<=((symmetric()) ? j+1 : num_lines));
+        read_values(position(i0,j),i1-i0,values);
+    }
+
+    void MatrixFile::write(const size_t i0,const size_t i1,const size_t j,const double* values) {
+        om_assert(i0<=i1 && i1<=((symmetric()) ? j+1 : num_lines));
+        write_values(position(i0,j),i1-i0,values);
+    }
+
+    void MatrixFile::read_values(const size_t pos,const size_t n,double* values) {
+        file.seekg(header_size()+static_cast<std::streamoff>(pos*sizeof(double)));
+        file.read(reinterpret_cast<char*>(values),n*sizeof(double));
+        if (!file)
+            throw maths::BadFile(name);
+    }
+
+    void MatrixFile::write_values(const size_t pos,const size_t n,const double* values) {
+        file.seekp(header_size()+static_cast<std::streamoff>(pos*sizeof(double)));
+        file.write(reinterpret_cast<const char*>(values),n*sizeof(double));
+        if (!file)
+            throw maths::BadFileOpening(name,maths::BadFileOpening::WRITE);
+    }
+
+    namespace {
+
+        // Depth 2 random butterfly transformation U = B1*B2 (Baboulin, Dongarra et al.) of size N (a multiple of 4).
+        // B1 is a butterfly of half size h = N/2 and B2 is made of two butterflies of half size N/4, a butterfly
+        // being [ R0 R1 ; R0 -R1 ]/sqrt(2) with random diagonal matrices R0 and R1 close to the identity.
+        // Ut*A*U can be factored with a block LDLt factorization without pivoting between blocks (with a high
+        // probability), even when A has (as the head matrix) null or tiny leading blocks.
+        // Each line and each column of U has 4 non zero values.
+
+        class Butterflies {
+        public:
+
+            struct Entry {
+                size_t index;
+                double value;
+            };
+
+            typedef std::array<Entry,4> Entries;
+
+            // The random generator is seeded with a constant, so that a resumed computation uses the same transformation.
+
+            Butterflies(const size_t size): N(size),r1(size),r2(size) {
+                std::mt19937 generator(12345);
+                for (std::vector<double>* r : { &r1,&r2 })
+                    for (double& value : *r)
+                        value = std::exp((generator()/4294967296.0-0.5)/10.0)/std::sqrt(2.0);
+            }
+
+            // Non zero values of the column i of U (with their line numbers).
+
+            Entries column(const size_t i) const {
+                Entries entries;
+                size_t m = 0;
+                for (const size_t k : { i,partner(i,N/4) })
+                    for (const size_t p : { k,partner(k,N/2) })
+                        entries[m++] = { p,butterfly(p,k,N/2,r1)*butterfly(k,i,N/4,r2) };
+                return entries;
+            }
+
+            // Non zero values of the line p of U (with their column numbers).
+
+            Entries line(const size_t p) const {
+                Entries entries;
+                size_t m = 0;
+                for (const size_t k : { p,partner(p,N/2) })
+                    for (const size_t i : { k,partner(k,N/4) })
+                        entries[m++] = { i,butterfly(p,k,N/2,r1)*butterfly(k,i,N/4,r2) };
+                return entries;
+            }
+
+        private:
+
+            static size_t partner(const size_t i,const size_t h) { return (i%(2*h)<h) ? i+h : i-h; }
+
+            static double butterfly(const size_t i,const size_t j,const size_t h,const std::vector<double>& r) {
+                return (i%(2*h)>=h && j%(2*h)>=h) ? -r[j] : r[j];
+            }
+
+            const size_t        N;
+            std::vector<double> r1;
+            std::vector<double> r2;
+        };
+
+        // The non zero values of the lines (or columns) of U for a range of indices are split in four branches (the
+        // m-th non zero value of each line), each branch being made of runs of consecutive indices.
+
+        struct Run {
+            size_t first;  // Offset in the range.
+            size_t index;  // First index of the run.
+            size_t length;
+        };
+
+        struct Branch {
+            std::vector<Run>    runs;
+            std::vector<double> values;
+        };
+
+        template <typename ENTRIES>
+        std::array<Branch,4> branches(const size_t i0,const size_t i1,const ENTRIES& entries) {
+            std::array<Branch,4> result;
+            for (size_t i=i0;i<i1;++i) {
+                const Butterflies::Entries& e = entries(i);
+                for (size_t m=0;m<4;++m) {
+                    Branch& branch = result[m];
+                    branch.values.push_back(e[m].value);
+                    if (!branch.runs.empty() && branch.runs.back().index+branch.runs.back().length==e[m].index)
+                        ++branch.runs.back().length;
+                    else
+                        branch.runs.push_back({ i-i0,e[m].index,1 });
+                }
+            }
+            return result;
+        }
+
+        // Block [i0,i1)x[j0,j1) of Vt*S*V, the non zero values of the columns of V being given by entries and the blocks
+        // of S being obtained by read(i,j,B) (which fills B with the block of S starting at line i and column j).
+        // Each block read is at most as large as the result.
+
+        template <typename ENTRIES,typename READ>
+        Matrix transform(const size_t i0,const size_t i1,const size_t j0,const size_t j1,const ENTRIES& entries,const READ& read) {
+            const std::array<Branch,4>& lines   = branches(i0,i1,entries);
+            const std::array<Branch,4>& columns = branches(j0,j1,entries);
+            Matrix result(i1-i0,j1-j0);
+            Matrix block(i1-i0,j1-j0);
+            result.set(0.0);
+            for (const Branch& bl : lines)
+                for (const Branch& bc : columns)
+                    for (const Run& rl : bl.runs)
+                        for (const Run& rc : bc.runs) {
+                            const MatrixView& B = block.view(0,rl.length,0,rc.length);
+                            read(rl.index,rc.index,B);
+                            for (size_t c=0;c<rc.length;++c) {
+                                const double vc = bc.values[rc.first+c];
+                                for (size_t r=0;r<rl.length;++r)
+                                    result(rl.first+r,rc.first+c) += bl.values[rl.first+r]*B(r,c)*vc;
+                            }
+                        }
+            return result;
+        }
+
+        // Block of the symmetric matrix A (packed in a file) starting at line i0 and column j0. The matrix is extended
+        // by the identity beyond its size.
+
+        void read_block(MatrixFile& A,const size_t i0,const size_t j0,const MatrixView& B) {
+            const size_t n  = A.nlin();
+            const size_t i1 = i0+B.nlin();
+            const size_t j1 = j0+B.ncol();
+            for (size_t j=0;j<B.ncol();++j)
+                for (size_t i=0;i<B.nlin();++i)
+                    B(i,j) = (i0+i==j0+j && i0+i>=n) ? 1.0 : 0.0;
+
+            // The upper part is stored in the columns, the lower part in the lines (i.e. in the columns i).
+
+            std::vector<double> values(std::max(B.nlin(),B.ncol()));
+            for (size_t j=j0;j<std::min(j1,n);++j)
+                if (i0<std::min(i1,j+1)) {
+                    A.read(i0,std::min(i1,j+1),j,values.data());
+                    for (size_t i=i0;i<std::min(i1,j+1);++i)
+                        B(i-i0,j-j0) = values[i-i0];
+                }
+            for (size_t i=i0;i<std::min(i1,n);++i)
+                if (j0<std::min(j1,i)) {
+                    A.read(j0,std::min(j1,i),i,values.data());
+                    for (size_t j=j0;j<std::min(j1,i);++j)
+                        B(i-i0,j-j0) = values[j-j0];
+                }
+        }
+
+        // Tiles (I,J) with I>=J (i.e. the lower part) of a N x N matrix, stored in a file as the columns of a full
+        // matrix (one tile of t x t values per column, the last tiles being smaller).
+
+        class Tiles {
+        public:
+
+            Tiles(const std::string& filename,const size_t size,const size_t tile_size,const bool create):
+                N(size),t(tile_size),T((N+t-1)/t),
+                file((create) ? MatrixFile(filename,LinOpInfo::FULL,t*t,T*(T+1)/2) : MatrixFile(filename,LinOpInfo::FULL,true))
+            {
+                if (file.nlin()!=t*t || file.ncol()!=T*(T+1)/2)
+                    throw maths::BadContent(filename,"tiled matrix");
+            }
+
+            size_t number()              const { return T;                    }
+            size_t first(const size_t I) const { return I*t;                  }
+            size_t size(const size_t I)  const { return std::min(t,N-first(I)); }
+
+            Matrix tile(const size_t I,const size_t J) {
+                Matrix M(size(I),size(J));
+                file.read(0,M.size(),slot(I,J),M.data());
+                return M;
+            }
+
+            void store(const size_t I,const size_t J,const Matrix& M) {
+                om_assert(M.nlin()==size(I) && M.ncol()==size(J));
+                file.write(0,M.size(),slot(I,J),M.data());
+                file.flush();
+            }
+
+            // Block of the (symmetric) matrix starting at line i0 and column j0.
+
+            void read(const size_t i0,const size_t j0,const MatrixView& B) {
+                const size_t i1 = i0+B.nlin();
+                const size_t j1 = j0+B.ncol();
+                for (size_t I=i0/t;first(I)<i1;++I)
+                    for (size_t J=j0/t;first(J)<j1;++J) {
+                        const bool lower = I>=J;
+                        const Matrix& M = (lower) ? tile(I,J) : tile(J,I);
+                        for (size_t j=std::max(j0,first(J));j<std::min(j1,first(J)+size(J));++j)
+                            for (size_t i=std::max(i0,first(I));i<std::min(i1,first(I)+size(I));++i)
+                                B(i-i0,j-j0) = (lower) ? M(i-first(I),j-first(J)) : M(j-first(J),i-first(I));
+                    }
+            }
+
+        private:
+
+            size_t slot(const size_t I,const size_t J) const { return I*(I+1)/2+J; }
+
+            const size_t N;
+            const size_t t;
+            const size_t T;
+            MatrixFile   file;
+        };
+
+        SymMatrixFactorization factorize_tile(Tiles& tiles,const size_t K) { return SymMatrixFactorization(SymMatrix(tiles.tile(K,K))); }
+    }
+
+    void invert_out_of_core(const std::string& input,const std::string& output,const size_t max_memory,const Checkpoint& checkpoint) {
+
+        const ExecutionStage stage(ExecutionStage::DENSE_ALGEBRA);
+
+        MatrixFile A(input,LinOpInfo::SYMMETRIC);
+        const size_t n = A.nlin();
+        const size_t N = 4*((n+3)/4);
+
+        // At most about five tiles of t x t values are in memory at once.
+
+        size_t t = std::max<size_t>(1,std::min<size_t>(N,std::sqrt(max_memory/(5*sizeof(double)))));
+
+        // Progress: tile size, current phase, number of tiles of this phase already processed and whether the next tile
+        // is saved (as tile.bin) but possibly not yet stored (see below).
+
+        enum Phase { FACTORIZATION=1, TRIANGULAR_INVERSE, PRODUCT, OUTPUT };
+
+        const std::string scratch = (checkpoint.enabled()) ? checkpoint.path("factors.bin") : output+".lu";
+        Matrix state(4,1);
+        const bool resume = checkpoint.exists("state.bin");
+        if (resume) {
+            checkpoint.load("state.bin",state);
+            om_error(state.nlin()==4 && state.ncol()==1);
+            t = state(0,0);
+        } else {
+            state.set(0.0);
+            state(0,0) = t;
+        }
+
+        const auto save_state = [&](const Phase phase,const size_t position,const bool pending) {
+            state(1,0) = phase;
+            state(2,0) = position;
+            state(3,0) = pending;
+            checkpoint.save("state.bin",state);
+        };
+
+        typedef std::pair<size_t,size_t> Tile;
+
+        // Tiles are processed one after the other in the given order. A phase working in place (its tiles overwriting
+        // values it reads) cannot redo an interrupted tile: the tile is saved in the checkpoint before being stored.
+
+        const auto process = [&](const Phase phase,const std::vector<Tile>& tiles,const bool in_place,const auto& compute,const auto& store) {
+            if (state(1,0)>phase)
+                return;
+            size_t position = 0;
+            if (state(1,0)==phase) {
+                position = state(2,0);
+                if (state(3,0)!=0.0) {
+                    Matrix M;
+                    checkpoint.load("tile.bin",M);
+                    store(tiles[position++],M);
+                }
+            }
+            for (;position<tiles.size();++position) {
+                const Matrix& M = compute(tiles[position]);
+                if (in_place && checkpoint.enabled()) {
+                    checkpoint.save("tile.bin",M);
+                    save_state(phase,position,true);
+                }
+                store(tiles[position],M);
+                save_state(phase,position+1,false);
+            }
+        };
+
+        {
+            const Butterflies U(N);
+            Tiles tiles(scratch,N,t,!resume);
+            const size_t T = tiles.number();
+            const auto store_tile = [&](const Tile& tile,const Matrix& M) { tiles.store(tile.first,tile.second,M); };
+
+            // Left looking block LDLt factorization of Ut*A*U: the tiles (I,K) of the column K are computed from the
+            // transformed matrix and the previous columns of L, D_K being stored in the diagonal tile. Tiles are never
+            // read before being final (and the input is never modified), so an interrupted tile is simply redone.
+
+            std::vector<Tile> tiles_order;
+            for (size_t K=0;K<T;++K)
+                for (size_t I=K;I<T;++I)
+                    tiles_order.push_back({ I,K });
+
+            std::optional<SymMatrixFactorization> DK;
+            size_t factored = T;
+            process(FACTORIZATION,tiles_order,false,
+                    [&](const Tile& tile) {
+                        const auto [I,K] = tile;
+                        Matrix C = transform(tiles.first(I),tiles.first(I)+tiles.size(I),tiles.first(K),tiles.first(K)+tiles.size(K),
+                                             [&](const size_t i) { return U.column(i); },
+                                             [&](const size_t i,const size_t j,const MatrixView& B) { read_block(A,i,j,B); });
+                        for (size_t L=0;L<K;++L) {
+                            Matrix W(tiles.size(L),tiles.size(K));
+                            gemm(false,true,1.0,tiles.tile(L,L).view(),tiles.tile(K,L).view(),0.0,W.view());
+                            gemm(false,false,-1.0,tiles.tile(I,L).view(),W.view(),1.0,C.view());
+                        }
+                        if (I==K) {
+                            for (size_t j=0;j<C.ncol();++j)
+                                for (size_t i=j+1;i<C.nlin();++i)
+                                    C(i,j) = C(j,i);
+                            DK.emplace(SymMatrix(C));
+                        } else {
+                            if (factored!=K)
+                                DK.emplace(factorize_tile(tiles,K));
+                            DK->solve_transposed(C);
+                        }
+                        factored = K;
+                        return C;
+                    },store_tile);
+            DK.reset();
+
+            // M = inv(L) in place: M_IJ = -(L_IJ+sum_{J<K<I} M_IK L_KJ), columns and lines being processed backwards
+            // so that L_KJ is not yet overwritten.
+
+            tiles_order.clear();
+            for (size_t J=T;J-->0;)
+                for (size_t I=T;I-->J+1;)
+                    tiles_order.push_back({ I,J });
+
+            process(TRIANGULAR_INVERSE,tiles_order,true,
+                    [&](const Tile& tile) {
+                        const auto [I,J] = tile;
+                        Matrix C = tiles.tile(I,J);
+                        for (size_t K=J+1;K<I;++K)
+                            gemm(false,false,1.0,tiles.tile(I,K).view(),tiles.tile(K,J).view(),1.0,C.view());
+                        C *= -1.0;
+                        return C;
+                    },store_tile);
+
+            // X = inv(Ut*A*U) = Mt inv(D) M in place: X_JI = sum_{K>=J} M_KJt inv(D_K) M_KI (M_KK being the identity),
+            // lines being processed forwards and the diagonal tile (holding D_J) last.
+
+            tiles_order.clear();
+            for (size_t J=0;J<T;++J)
+                for (size_t I=0;I<=J;++I)
+                    tiles_order.push_back({ J,I });
+
+            process(PRODUCT,tiles_order,true,
+                    [&](const Tile& tile) {
+                        const auto [J,I] = tile;
+                        Matrix C(tiles.size(J),tiles.size(I));
+                        if (I<J) {
+                            C = tiles.tile(J,I);
+                        } else {
+                            C.set(0.0);
+                            for (size_t i=0;i<C.nlin();++i)
+                                C(i,i) = 1.0;
+                        }
+                        factorize_tile(tiles,J).solve(C);
+                        for (size_t K=J+1;K<T;++K) {
+                            Matrix Y = tiles.tile(K,I);
+                            factorize_tile(tiles,K).solve(Y);
+                            gemm(true,false,1.0,tiles.tile(K,J).view(),Y.view(),1.0,C.view());
+                        }
+                        return C;
+                    },store_tile);
+
+            // Inverse U*X*Ut, written tile by tile (upper tiles, as the output is packed by columns).
+
+            tiles_order.clear();
+            for (size_t J=0;J<T && tiles.first(J)<n;++J)
+                for (size_t I=0;I<=J;++I)
+                    tiles_order.push_back({ I,J });
+
+            MatrixFile Ainv = (state(1,0)==OUTPUT) ? MatrixFile(output,LinOpInfo::SYMMETRIC,true) : MatrixFile(output,LinOpInfo::SYMMETRIC,n,n);
+            process(OUTPUT,tiles_order,false,
+                    [&](const Tile& tile) {
+                        const auto [I,J] = tile;
+                        return transform(tiles.first(I),std::min(n,tiles.first(I)+tiles.size(I)),
+                                         tiles.first(J),std::min(n,tiles.first(J)+tiles.size(J)),
+                                         [&](const size_t i) { return U.line(i); },
+                                         [&](const size_t i,const size_t j,const MatrixView& B) { tiles.read(i,j,B); });
+                    },
+                    [&](const Tile& tile,const Matrix& M) {
+                        const size_t i0 = tiles.first(tile.first);
+                        const size_t j0 = tiles.first(tile.second);
+                        for (size_t j=0;j<M.ncol();++j)
+                            Ainv.write(i0,std::min(i0+M.nlin(),j0+j+1),j0+j,M.data()+j*M.nlin());
+                        Ainv.flush();
+                    });
+        }
+
+        std::remove(scratch.c_str());
+        checkpoint.clear();
+    }
+}
@@ -0,0 +1,310 @@
+/*
+Project Name : OpenMEEG
+
+© INRIA and ENPC (contributors: Geoffray ADDE, Maureen CLERC, Alexandre 
+GRAMFORT, Renaud KERIVEN, Jan KYBIC, Perrine LANDREAU, Théodore PAPADOPOULO,
+Emmanuel OLIVI
+Maureen.Clerc.AT.inria.fr, keriven.AT.certis.enpc.fr,
+kybic.AT.fel.cvut.cz, papadop.AT.inria.fr)
+
+The OpenMEEG software is a C++ package for solving the forward/inverse
+problems of electroencephalography and magnetoencephalography.
+
+This software is governed by the CeCILL-B license under French law and
+abiding by the rules of distribution of free software.  You can  use,
+modify and/ or redistribute the software under the terms of the CeCILL-B
+license as circulated by CEA, CNRS and INRIA at the following URL
+"http://www.cecill.info".
+
+As a counterpart to the access to the source code and  rights to copy,
+modify and redistribute granted by the license, users are provided only
+with a limited warranty  and the software's authors,  the holders of the
+economic rights,  and the successive licensors  have only  limited
+liability.
+
+In this respect, the user's attention is drawn to the risks associated
+with loading,  using,  modifying and/or developing or reproducing the
+software by the user in light of its specific status of free software,
+that may mean  that it is complicated to manipulate,  and  that  also
+therefore means  that it is reserved for developers  and  experienced
+professionals having in-depth computer knowledge. Users are therefore
+encouraged to load and test the software's suitability as regards their
+requirements in conditions enabling the security of their systems and/or
+data to be ensured and,  more generally, to use and operate it in the
+same conditions as regards security.
+
+The fact that you are presently reading this means that you have had
+knowledge of the CeCILL-B license and that you accept its terms.
+*/
+
+#include <limits>
+#include <algorithm>
+
+#include <product_chain.h>
+
+namespace OpenMEEG {
+
+    namespace {
+
+        //  Width of the panels of unpacked symmetric matrices and of the blocks distributed over threads.
+
+        constexpr size_t panel = 256;
+
+        void scale(const double beta,const MatrixView& C) {
+            if (beta==1.0)
+                return;
+            for (size_t j=0;j<C.ncol();++j)
+                for (size_t i=0;i<C.nlin();++i)
+                    C(i,j) = (beta==0.0) ? 0.0 : beta*C(i,j);
+        }
+
+        //  Columns [j0,j0+W.ncol()) of S (packed upper storage) unpacked into W.
+
+        void unpack_columns(const SymMatrix& S,const size_t j0,const MatrixView& W) {
+            const double* values = S.data();
+            const std::ptrdiff_t ncols = W.ncol();
+            #pragma omp parallel for
+            for (std::ptrdiff_t jj=0;jj<ncols;++jj) {
+                const size_t j = j0+jj;
+                const double* col = values+j*(j+1)/2;
+                for (size_t i=0;i<=j;++i)
+                    W(i,jj) = col[i];
+                for (size_t i=j+1;i<S.nlin();++i)
+                    W(i,jj) = values[j+i*(i+1)/2];
+            }
+        }
+
+        //  y += alpha*S(j,:) (which is also S(:,j)), read in place from packed storage.
+
+        void axpy_line(const double alpha,const SymMatrix& S,const size_t j,const VectorView& y) {
+            const double* values = S.data();
+            axpy(alpha,ConstVectorView(values+j*(j+1)/2,j+1),y.subvect(0,j+1));
+            for (size_t k=j+1;k<S.nlin();++k)
+                y(k) += alpha*values[j+k*(k+1)/2];
+        }
+
+        //  C = A*S+beta*C
+
+        void times_sym(const ConstMatrixView& A,const SymMatrix& S,const double beta,const MatrixView& C) {
+            Matrix W(S.nlin(),std::min(panel,S.ncol()));
+            for (size_t j0=0;j0<S.ncol();j0+=panel) {
+                const size_t w = std::min(panel,S.ncol()-j0);
+                const MatrixView& Wj = W.view(0,S.nlin(),0,w);
+                unpack_columns(S,j0,Wj);
+                gemm(false,false,1.0,A,Wj,beta,C.submat(0,C.nlin(),j0,w));
+            }
+        }
+
+        //  C = S*B+beta*C (lines of S are its columns).
+
+        void sym_times(const SymMatrix& S,const ConstMatrixView& B,const double beta,const MatrixView& C) {
+            Matrix W(S.nlin(),std::min(panel,S.nlin()));
+            for (size_t i0=0;i0<S.nlin();i0+=panel) {
+                const size_t w = std::min(panel,S.nlin()-i0);
+                const MatrixView& Wi = W.view(0,S.nlin(),0,w);
+                unpack_columns(S,i0,Wi);
+                gemm(true,false,1.0,Wi,B,beta,C.submat(i0,w,0,C.ncol()));
+            }
+        }
+
+        //  C = S1*S2+beta*C, S2 being unpacked by panels of columns.
+
+        void sym_times_sym(const SymMatrix& S1,const SymMatrix& S2,const double beta,const MatrixView& C) {
+            Matrix W(S2.nlin(),std::min(panel,S2.ncol()));
+            for (size_t j0=0;j0<S2.ncol();j0+=panel) {
+                const size_t w = std::min(panel,S2.ncol()-j0);
+                const MatrixView& Wj = W.view(0,S2.nlin(),0,w);
+                unpack_columns(S2,j0,Wj);
+                sym_times(S1,Wj,beta,C.submat(0,C.nlin(),j0,w));
+            }
+        }
+
+        //  C = Sp*B+beta*C, threads work on disjoint blocks of columns of C.
+
+        void sparse_times(const SparseMatrix& Sp,const ConstMatrixView& B,const double beta,const MatrixView& C) {
+            scale(beta,C);
+            const ExecutionStage stage(ExecutionStage::OPENMP_LOOPS);
+            const size_t nblocks = (C.ncol()+panel-1)/panel;
+            const std::ptrdiff_t nb = nblocks;
+            #pragma omp parallel for
+            for (std::ptrdiff_t b=0;b<nb;++b) {
+                const size_t j0 = b*panel;
+                const size_t w  = std::min(panel,C.ncol()-j0);
+                const ConstMatrixView& Bb = B.submat(0,B.nlin(),j0,w);
+                const MatrixView& Cb = C.submat(0,C.nlin(),j0,w);
+                for (const auto& nz : Sp)
+                    axpy(nz.second,Bb.getlin(nz.first.second),Cb.getlin(nz.first.first));
+            }
+        }
+
+        //  C = Sp*S+beta*C
+
+        void sparse_times_sym(const SparseMatrix& Sp,const SymMatrix& S,const double beta,const MatrixView& C) {
+            scale(beta,C);
+            for (const auto& nz : Sp)
+                axpy_line(nz.second,S,nz.first.second,C.getlin(nz.first.first));
+        }
+
+        //  C = A*Sp+beta*C, threads work on disjoint blocks of lines of C.
+
+        void times_sparse(const ConstMatrixView& A,const SparseMatrix& Sp,const double beta,const MatrixView& C) {
+            scale(beta,C);
+            const ExecutionStage stage(ExecutionStage::OPENMP_LOOPS);
+            const size_t nblocks = (C.nlin()+panel-1)/panel;
+            const std::ptrdiff_t nb = nblocks;
+            #pragma omp parallel for
+            for (std::ptrdiff_t b=0;b<nb;++b) {
+                const size_t i0 = b*panel;
+                const size_t w  = std::min(panel,C.nlin()-i0);
+                const ConstMatrixView& Ab = A.submat(i0,w,0,A.ncol());
+                const MatrixView& Cb = C.submat(i0,w,0,C.ncol());
+                for (const auto& nz : Sp)
+                    axpy(nz.second,Ab.getcol(nz.first.first),Cb.getcol(nz.first.second));
+            }
+        }
+
+        //  C = S*Sp+beta*C
+
+        void sym_times_sparse(const SymMatrix& S,const SparseMatrix& Sp,const double beta,const MatrixView& C) {
+            scale(beta,C);
+            for (const auto& nz : Sp)
+                axpy_line(nz.second,S,nz.first.first,C.getcol(nz.first.second));
+        }
+    }
+
+    double ProductChain::multiplication_cost(const size_t i,const size_t k,const size_t j) const {
+        const double m = factors[i].op->nlin();
+        const double p = factors[k].op->ncol();
+        const double n = factors[j].op->ncol();
+        if (i==k && factors[i].storage==LinOpInfo::SPARSE)
+            return 2*static_cast<double>(factors[i].op->size())*n;
+        if (k+1==j && factors[j].storage==LinOpInfo::SPARSE)
+            return 2*m*static_cast<double>(factors[j].op->size());
+        return 2*m*p*n;
+    }
+
+    ProductChain::Plan ProductChain::plan() const {
+        double bound = static_cast<double>(max_memory)/sizeof(double);
+        if (max_memory==0)
+            for (const auto& factor : factors)
+                bound = std::max(bound,static_cast<double>(factor.op->size()));
+
+        Plan p;
+        p.n = factors.size();
+        p.cost.assign(p.n*p.n,0.0);
+        p.memory.assign(p.n*p.n,0.0);
+        p.split.assign(p.n*p.n,0);
+        for (size_t len=2;len<=p.n;++len)
+            for (size_t i=0;i+len<=p.n;++i) {
+                const size_t j = i+len-1;
+                double& best   = p.cost[p.index(i,j)];
+                double& memory = p.memory[p.index(i,j)];
+                best   = std::numeric_limits<double>::max();
+                memory = std::numeric_limits<double>::max();
+                for (size_t k=i;k<j;++k) {
+
+                    //  The left operand is kept while the right one is evaluated.
+
+                    const double left  = (i==k)   ? 0.0 : static_cast<double>(factors[i].op->nlin())*factors[k].op->ncol();
+                    const double right = (k+1==j) ? 0.0 : static_cast<double>(factors[k].op->ncol())*factors[j].op->ncol();
+                    const double peak  = std::max({ p.memory[p.index(i,k)], left+p.memory[p.index(k+1,j)], left+right });
+                    const double cost  = p.cost[p.index(i,k)]+p.cost[p.index(k+1,j)]+multiplication_cost(i,k,j);
+
+                    const bool fits = peak<=bound;
+                    const bool better = (fits) ? (memory>bound || cost<best) : (memory>bound && peak<memory);
+                    if (better) {
+                        best   = cost;
+                        memory = peak;
+                        p.split[p.index(i,j)] = k;
+                    }
+                }
+            }
+        return p;
+    }
+
+    double ProductChain::flops() const {
+        const Plan& p = plan();
+        return p.cost[p.index(0,p.n-1)];
+    }
+
+    double ProductChain::temporaries() const {
+        const Plan& p = plan();
+        return p.memory[p.index(0,p.n-1)]*sizeof(double);
+    }
+
+    std::string ProductChain::parenthesization() const {
+        return parenthesization(plan(),0,factors.size()-1);
+    }
+
+    std::string ProductChain::parenthesization(const Plan& p,const size_t i,const size_t j) const {
+        if (i==j)
+            return "A"+std::to_string(i);
+        const size_t k = p.split[p.index(i,j)];
+        return "("+parenthesization(p,i,k)+"*"+parenthesization(p,k+1,j)+")";
+    }
+
+    Matrix ProductChain::eval() const {
+        if (factors.size()==1) {
+            const Factor& f = factors.front();
+            Matrix res = (f.storage==LinOpInfo::FULL)      ? Matrix(*static_cast<const Matrix*>(f.op),DEEP_COPY) :
+                         (f.storage==LinOpInfo::SYMMETRIC) ? Matrix(*static_cast<const SymMatrix*>(f.op)) :
+                                                  Matrix(*static_cast<const SparseMatrix*>(f.op));
+            if (addend!=nullptr)
+                res += *addend;
+            return res;
+        }
+        return eval(plan(),0,factors.size()-1,addend);
+    }
+
+    Matrix ProductChain::eval(const Plan& p,const size_t i,const size_t j,const Matrix* C) const {
+        const size_t k = p.split[p.index(i,j)];
+
+        //  Sub-chains are evaluated as full matrices, single factors are used as they are.
+
+        const Matrix& L = (i==k) ? Matrix() : eval(p,i,k,nullptr);
+        const Matrix& R = (k+1==j) ? Matrix() : eval(p,k+1,j,nullptr);
+        const StorageType lst = (i==k)   ? factors[i].storage : LinOpInfo::FULL;
+        const StorageType rst = (k+1==j) ? factors[j].storage : LinOpInfo::FULL;
+        const LinOp& Lop = (i==k)   ? *factors[i].op : static_cast<const LinOp&>(L);
+        const LinOp& Rop = (k+1==j) ? *factors[j].op : static_cast<const LinOp&>(R);
+
+        //  The addend, if any, is the initial value of the result (beta=1).
+
+        Matrix res = (C!=nullptr) ? Matrix(*C,DEEP_COPY) : Matrix(Lop.nlin(),Rop.ncol());
+        const double beta = (C!=nullptr) ? 1.0 : 0.0;
+
+        //  Operands are cast to their actual types only once their storage has been checked.
+
+        switch (rst) {
+            case LinOpInfo::FULL: {
+                const ConstMatrixView& B = static_cast<const Matrix&>(Rop).view();
+                switch (lst) {
+                    case LinOpInfo::FULL:      gemm(false,false,1.0,static_cast<const Matrix&>(Lop).view(),B,beta,res.view()); break;
+                    case LinOpInfo::SYMMETRIC: sym_times(static_cast<const SymMatrix&>(Lop),B,beta,res.view());               break;
+                    case LinOpInfo::SPARSE:    sparse_times(static_cast<const SparseMatrix&>(Lop),B,beta,res.view());         break;
+                }
+                break;
+            }
+            case LinOpInfo::SYMMETRIC: {
+                const SymMatrix& S = static_cast<const SymMatrix&>(Rop);
+                switch (lst) {
+                    case LinOpInfo::FULL:      times_sym(static_cast<const Matrix&>(Lop).view(),S,beta,res.view());   break;
+                    case LinOpInfo::SYMMETRIC: sym_times_sym(static_cast<const SymMatrix&>(Lop),S,beta,res.view());   break;
+                    case LinOpInfo::SPARSE:    sparse_times_sym(static_cast<const SparseMatrix&>(Lop),S,beta,res.view()); break;
+                }
+                break;
+            }
+            case LinOpInfo::SPARSE: {
+                const SparseMatrix& Sp = static_cast<const SparseMatrix&>(Rop);
+                switch (lst) {
+                    case LinOpInfo::FULL:      times_sparse(static_cast<const Matrix&>(Lop).view(),Sp,beta,res.view()); break;
+                    case LinOpInfo::SYMMETRIC: sym_times_sparse(static_cast<const SymMatrix&>(Lop),Sp,beta,res.view()); break;
+                    case LinOpInfo::SPARSE:    sparse_times(static_cast<const SparseMatrix&>(Lop),Matrix(Sp).view(),beta,res.view()); break;
+                }
+                break;
+            }
+        }
+
+        return res;
+    }
+}
@@ -0,0 +1,189 @@
+/*
+Project Name : OpenMEEG
+
+© INRIA and ENPC (contributors: Geoffray ADDE, Maureen CLERC, Alexandre 
+GRAMFORT, Renaud KERIVEN, Jan KYBIC, Perrine LANDREAU, Théodore PAPADOPOULO,
+Emmanuel OLIVI
+Maureen.Clerc.AT.inria.fr, keriven.AT.certis.enpc.fr,
+kybic.AT.fel.cvut.cz, papadop.AT.inria.fr)
+
+The OpenMEEG software is a C++ package for solving the forward/inverse
+problems of electroencephalography and magnetoencephalography.
+
+This software is governed by the CeCILL-B license under French law and
+abiding by the rules of distribution of free software.  You can  use,
+modify and/ or redistribute the software under the terms of the CeCILL-B
+license as circulated by CEA, CNRS and INRIA at the following URL
+"http://www.cecill.info".
+
+As a counterpart to the access to the source code and  rights to copy,
+modify and redistribute granted by the license, users are provided only
+with a limited warranty  and the software's authors,  the holders of the
+economic rights,  and the successive licensors  have only  limited
+liability.
+
+In this respect, the user's attention is drawn to the risks associated
+with loading,  using,  modifying and/or developing or reproducing the
+software by the user in light of its specific status of free software,
+that may mean  that it is complicated to manipulate,  and  that  also
+therefore means  that it is reserved for developers  and  experienced
+professionals having in-depth computer knowledge. Users are therefore
+encouraged to load and test the software's suitability as regards their
+requirements in conditions enabling the security of their systems and/or
+data to be ensured and,  more generally, to use and operate it in the
+same conditions as regards security.
+
+The fact that you are presently reading this means that you have had
+knowledge of the CeCILL-B license and that you accept its terms.
+*/
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <iostream>
+
+#include <realtime.h>
+
+#if defined(__linux__)
+#include <sched.h>
+#define THREAD_BINDING
+#endif
+
+namespace OpenMEEG {
+
+    void LatencyStatistics::record(const double seconds) {
+        const size_t bin = std::min(static_cast<size_t>(seconds*1e6),bins-1);
+        ++histogram[bin];
+        ++n;
+        sum += seconds;
+        low  = std::min(low,seconds);
+        high = std::max(high,seconds);
+    }
+
+    void LatencyStatistics::reset() {
+        std::fill(histogram.begin(),histogram.end(),0);
+        n    = 0;
+        sum  = 0.0;
+        low  = (std::numeric_limits<double>::max)();
+        high = 0.0;
+    }
+
+    double LatencyStatistics::percentile(const double p) const {
+        const size_t rank = static_cast<size_t>(std::ceil(p/100.0*n));
+        size_t cumulated = 0;
+        for (size_t bin=0; bin<bins; ++bin) {
+            cumulated += histogram[bin];
+            if (cumulated>=rank && cumulated!=0)
+                return (bin+1)*1e-6;
+        }
+        return 0.0;
+    }
+
+    StreamingOperator::StreamingOperator(const Matrix& M,const size_t block_size,const unsigned nworkers,const size_t capacity,
+                                         const int first_cpu):
+        op(M),block(block_size),previous_blas_threads(blas_threads()),stopping(false),next_submit(0),next_retrieve(0)
+    {
+        om_assert(nworkers>0 && capacity>0);
+        if (previous_blas_threads!=0)
+            set_blas_threads(1);
+        for (unsigned i=0; i<nworkers; ++i)
+            workers.push_back(std::make_unique<Worker>(capacity,op.nlin(),op.ncol(),block));
+
+        //  If a thread cannot be created, the ones already started are stopped before reporting the error.
+
+        try {
+            for (unsigned i=0; i<nworkers; ++i) {
+                Worker& worker = *workers[i];
+                worker.thread = std::thread([this,&worker,first_cpu,i] { run(worker,(first_cpu<0) ? -1 : first_cpu+static_cast<int>(i)); });
+            }
+        } catch (...) {
+            stop();
+            throw;
+        }
+    }
+
+    StreamingOperator::~StreamingOperator() { stop(); }
+
+    void StreamingOperator::stop() {
+        stopping.store(true,std::memory_order_release);
+        for (auto& worker : workers) {
+            worker->wake();
+            if (worker->thread.joinable())
+                worker->thread.join();
+        }
+        if (previous_blas_threads!=0)
+            set_blas_threads(previous_blas_threads);
+    }
+
+    bool StreamingOperator::submit(const ConstMatrixView& samples) {
+        om_assert(samples.nlin()==input_size() && samples.ncol()==block_size());
+        Worker& worker = *workers[next_submit%workers.size()];
+        Input* slot = worker.input.write_slot();
+        if (slot==nullptr)
+            return false;
+        copy(samples,slot->samples.view());
+        slot->submitted = Clock::now();
+        worker.input.push();
+        worker.notify();
+        ++next_submit;
+        return true;
+    }
+
+    bool StreamingOperator::retrieve(const MatrixView& result) {
+        om_assert(result.nlin()==output_size() && result.ncol()==block_size());
+        Worker& worker = *workers[next_retrieve%workers.size()];
+        Output* slot = worker.output.read_slot();
+        if (slot==nullptr)
+            return false;
+        copy(slot->samples.view(),result);
+        statistics.record(slot->latency);
+        worker.output.pop();
+        worker.notify(); // The worker may be waiting for a free output slot.
+        ++next_retrieve;
+        return true;
+    }
+
+    void StreamingOperator::run(Worker& worker,const int cpu) {
+        if (cpu>=0) {
+            #ifdef THREAD_BINDING
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            CPU_SET(cpu,&set);
+            if (sched_setaffinity(0,sizeof(set),&set)!=0)
+                std::cerr << "Warning: cannot pin a streaming worker to core " << cpu << '.' << std::endl;
+            #else
+            std::cerr << "Warning: thread pinning is not supported on this platform." << std::endl;
+            #endif
+        }
+
+        //  The worker sleeps until a block is submitted and there is room for its result (or until stop()).
+        //  While blocks are available, it does not touch the lock.
+
+        Input*  in  = nullptr;
+        Output* out = nullptr;
+        const auto available = [&] {
+            if (stopping.load(std::memory_order_acquire))
+                return true;
+            in  = worker.input.read_slot();
+            out = (in==nullptr) ? nullptr : worker.output.write_slot();
+            return out!=nullptr;
+        };
+
+        while (true) {
+            if (!available()) {
+                std::unique_lock<std::mutex> lock(worker.mutex);
+                worker.sleeping.store(true,std::memory_order_relaxed);
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                worker.ready.wait(lock,available);
+                worker.sleeping.store(false,std::memory_order_relaxed);
+            }
+            if (stopping.load(std::memory_order_acquire))
+                return;
+
+            gemm(false,false,1.0,op.view(),in->samples.view(),0.0,out->samples.view());
+            out->latency = std::chrono::duration<double>(Clock::now()-in->submitted).count();
+            worker.input.pop();
+            worker.output.push();
+        }
+    }
+}
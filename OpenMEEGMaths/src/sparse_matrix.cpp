@@ -121,6 +121,23 @@ namespace OpenMEEG {
         return out;
     }
 
+    //  The entries of a line are contiguous in the tank: each line of *this is paired with the same line of B.
+
+    SparseMatrix SparseMatrix::tmult(const SparseMatrix& B) const {
+        om_assert(nlin()==B.nlin());
+        SparseMatrix out(ncol(),B.ncol());
+        for (size_t i=0;i<nlin();++i) {
+            const const_iterator first  = m_tank.lower_bound(std::make_pair(i,size_t(0)));
+            const const_iterator last   = m_tank.lower_bound(std::make_pair(i+1,size_t(0)));
+            const const_iterator bfirst = B.m_tank.lower_bound(std::make_pair(i,size_t(0)));
+            const const_iterator blast  = B.m_tank.lower_bound(std::make_pair(i+1,size_t(0)));
+            for (const_iterator it=first;it!=last;++it)
+                for (const_iterator jt=bfirst;jt!=blast;++jt)
+                    out(it->first.second,jt->first.second) += it->second*jt->second;
+        }
+        return out;
+    }
+
     SparseMatrix SparseMatrix::operator+(const SparseMatrix &mat) const
     {
         om_assert(nlin() == mat.nlin() && ncol() == mat.ncol());
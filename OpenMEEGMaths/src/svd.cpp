@@ -0,0 +1,154 @@
+/*
+Project Name : OpenMEEG
+
+© INRIA and ENPC (contributors: Geoffray ADDE, Maureen CLERC, Alexandre 
+GRAMFORT, Renaud KERIVEN, Jan KYBIC, Perrine LANDREAU, Théodore PAPADOPOULO,
+Emmanuel OLIVI
+Maureen.Clerc.AT.inria.fr, keriven.AT.certis.enpc.fr,
+kybic.AT.fel.cvut.cz, papadop.AT.inria.fr)
+
+The OpenMEEG software is a C++ package for solving the forward/inverse
+problems of electroencephalography and magnetoencephalography.
+
+This software is governed by the CeCILL-B license under French law and
+abiding by the rules of distribution of free software.  You can  use,
+modify and/ or redistribute the software under the terms of the CeCILL-B
+license as circulated by CEA, CNRS and INRIA at the following URL
+"http://www.cecill.info".
+
+As a counterpart to the access to the source code and  rights to copy,
+modify and redistribute granted by the license, users are provided only
+with a limited warranty  and the software's authors,  the holders of the
+economic rights,  and the successive licensors  have only  limited
+liability.
+
+In this respect, the user's attention is drawn to the risks associated
+with loading,  using,  modifying and/or developing or reproducing the
+software by the user in light of its specific status of free software,
+that may mean  that it is complicated to manipulate,  and  that  also
+therefore means  that it is reserved for developers  and  experienced
+professionals having in-depth computer knowledge. Users are therefore
+encouraged to load and test the software's suitability as regards their
+requirements in conditions enabling the security of their systems and/or
+data to be ensured and,  more generally, to use and operate it in the
+same conditions as regards security.
+
+The fact that you are presently reading this means that you have had
+knowledge of the CeCILL-B license and that you accept its terms.
+*/
+
+#include <random>
+#include <vector>
+#include <algorithm>
+#include <iostream>
+
+#include <Exceptions.H>
+#include <svd.h>
+
+namespace OpenMEEG {
+
+    namespace {
+
+        //  Thin SVD of A (destroyed): A = U*diag(s)*Vt with k = min(m,n) singular values.
+
+        void thin_svd(Matrix& A,Matrix& U,Vector& s,Matrix& Vt) {
+            const size_t m = A.nlin();
+            const size_t n = A.ncol();
+            const size_t mini = std::min(m,n);
+            const size_t maxi = std::max(m,n);
+            U  = Matrix(m,mini);
+            s  = Vector(mini);
+            Vt = Matrix(mini,n);
+            if (mini==0)
+                return;
+        #ifdef HAVE_LAPACK
+            const ExecutionStage stage(ExecutionStage::DENSE_ALGEBRA);
+            const BLAS_INT        lwork = 4*mini*mini+std::max(maxi,4*mini*mini+4*mini);
+            std::vector<BLAS_INT> iwork(8*mini);
+            std::vector<double>   work(lwork);
+            BLAS_INT Info = 0;
+            DGESDD('S',sizet_to_int(m),sizet_to_int(n),A.data(),sizet_to_int(m),s.data(),U.data(),sizet_to_int(m),
+                   Vt.data(),sizet_to_int(mini),work.data(),lwork,iwork.data(),Info);
+            if (Info!=0)
+                throw maths::UnexpectedException("thin_svd (DGESDD failed)",__FILE__,__LINE__);
+        #else
+            std::cerr << "svd not implemented without blas/lapack" << std::endl;
+            exit(1);
+        #endif
+        }
+
+        //  Keep the first r singular triplets.
+
+        TruncatedSVD truncate(const Matrix& U,const Vector& s,const Matrix& Vt,const double reltol,const size_t max_rank) {
+            const double tol = (s.size()==0) ? 0.0 : reltol*s(0);
+            size_t r = 0;
+            while (r<s.size() && s(r)>tol && (max_rank==0 || r<max_rank))
+                ++r;
+
+            TruncatedSVD res;
+            res.U  = U.submat(0,U.nlin(),0,r);
+            res.s  = s.subvect(0,r);
+            res.Vt = Vt.submat(0,r,0,Vt.ncol());
+            return res;
+        }
+
+        //  Orthonormal basis of the range of Y (its left singular vectors).
+
+        Matrix orthonormalize(Matrix& Y) {
+            Matrix Q,Vt;
+            Vector s;
+            thin_svd(Y,Q,s,Vt);
+            return Q;
+        }
+    }
+
+    Matrix TruncatedSVD::solve(const Matrix& B) const {
+        Matrix X = U.tmult(B);
+        for (size_t j=0;j<X.ncol();++j)
+            for (size_t i=0;i<X.nlin();++i)
+                X(i,j) /= s(i);
+        return Vt.tmult(X);
+    }
+
+    TruncatedSVD truncated_svd(const Matrix& A,const double reltol,const size_t max_rank) {
+        Matrix cpy(A,DEEP_COPY);
+        Matrix U,Vt;
+        Vector s;
+        thin_svd(cpy,U,s,Vt);
+        return truncate(U,s,Vt,reltol,max_rank);
+    }
+
+    TruncatedSVD randomized_svd(const size_t m,const size_t n,const BlockOperator& A,const BlockOperator& At,
+                                const size_t rank,const double reltol,const size_t oversampling,
+                                const unsigned power_iterations,const unsigned seed)
+    {
+        const size_t l = std::min(rank+oversampling,std::min(m,n));
+
+        // Gaussian test matrix.
+
+        std::mt19937_64 generator(seed);
+        std::normal_distribution<double> gaussian;
+        Matrix Omega(n,l);
+        for (size_t i=0;i<Omega.size();++i)
+            Omega.data()[i] = gaussian(generator);
+
+        // Range finder with power iterations (orthonormalized at each step for stability).
+
+        Matrix Y = A(Omega);
+        Matrix Q = orthonormalize(Y);
+        for (unsigned it=0;it<power_iterations;++it) {
+            Matrix Z = At(Q);
+            const Matrix& W = orthonormalize(Z);
+            Y = A(W);
+            Q = orthonormalize(Y);
+        }
+
+        // SVD of the small matrix B = Q^T*A = (A^T*Q)^T.
+
+        Matrix B = At(Q).transpose();
+        Matrix Ub,Vt;
+        Vector s;
+        thin_svd(B,Ub,s,Vt);
+        return truncate(Q*Ub,s,Vt,reltol,rank);
+    }
+}
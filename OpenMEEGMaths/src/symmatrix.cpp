@@ -45,6 +45,7 @@ knowledge of the CeCILL-B license and that you accept its terms.
 #include "OpenMEEGMathsConfig.h"
 #include "matrix.h"
 #include "symmatrix.h"
+#include "Exceptions.H"
 
 namespace OpenMEEG {
 
@@ -68,8 +69,7 @@ namespace OpenMEEG {
     }
 
     void SymMatrix::set(double x) {
-        for (size_t i=0;i<(nlin()*(nlin()+1))/2;i++)
-            data()[i]=x;
+        first_touch(data(),size(),x);
     }
 
     SymMatrix SymMatrix::operator *(double x) const {
@@ -152,23 +152,83 @@ namespace OpenMEEG {
         return C;
     }
 
-    Matrix SymMatrix::solveLin(Matrix &RHS) const {
+    Matrix SymMatrix::solveLin(Matrix &RHS,const bool transposed) const {
+        factorize(*this).solve(RHS,transposed);
+        return RHS;
+    }
+
+    SymMatrixFactorization::SymMatrixFactorization(const SymMatrix& A): LDLt(A,DEEP_COPY) {
+        factorize();
+    }
+
+    SymMatrixFactorization::SymMatrixFactorization(SymMatrix&& A): LDLt(A) {
+        A = SymMatrix();
+        if (LDLt.value.use_count()>1) // The data is still used by another matrix, do not destroy it.
+            LDLt = SymMatrix(LDLt,DEEP_COPY);
+        factorize();
+    }
+
+    void SymMatrixFactorization::factorize() {
     #ifdef HAVE_LAPACK
-        SymMatrix A(*this,DEEP_COPY);
-        // LU
-        BLAS_INT *pivots = new BLAS_INT[nlin()];
+        const ExecutionStage stage(ExecutionStage::DENSE_ALGEBRA);
+        pivots.resize(nlin());
         int Info = 0;
-        DSPTRF('U',sizet_to_int(A.nlin()),A.data(),pivots,Info);
-        // Solve the linear system AX=B
-        DSPTRS('U',sizet_to_int(A.nlin()),sizet_to_int(RHS.ncol()),A.data(),pivots,RHS.data(),sizet_to_int(A.nlin()),Info);
-        om_assert(Info == 0);
-        return RHS;
+        DSPTRF('U',sizet_to_int(nlin()),LDLt.data(),pivots.data(),Info);
+        if (Info!=0)
+            throw maths::NotInvertible("symmetric matrix");
     #else
-        std::cerr << "!!!!! solveLin not defined : Try a GMres !!!!!" << std::endl;
+        std::cerr << "!!!!! Factorization not defined : Try a GMres !!!!!" << std::endl;
         exit(1);
     #endif
     }
 
+    Vector SymMatrixFactorization::solve(const Vector& B) const {
+        om_assert(B.size()==nlin());
+        Vector X(B,DEEP_COPY);
+    #ifdef HAVE_LAPACK
+        int Info = 0;
+        DSPTRS('U',sizet_to_int(nlin()),1,LDLt.data(),const_cast<BLAS_INT*>(pivots.data()),X.data(),sizet_to_int(nlin()),Info);
+        om_error(Info==0);
+    #endif
+        return X;
+    }
+
+    void SymMatrixFactorization::solve(Matrix& B) const {
+        om_assert(B.nlin()==nlin());
+        solve(B.view());
+    }
+
+    void SymMatrixFactorization::solve(const MatrixView& B) const {
+        om_assert(B.nlin()==nlin());
+    #ifdef HAVE_LAPACK
+        int Info = 0;
+        DSPTRS('U',sizet_to_int(nlin()),sizet_to_int(B.ncol()),LDLt.data(),const_cast<BLAS_INT*>(pivots.data()),B.data(),sizet_to_int(B.ld()),Info);
+        om_error(Info==0);
+    #endif
+    }
+
+    void SymMatrixFactorization::solve_transposed(Matrix& B) const {
+        om_assert(B.ncol()==nlin());
+    #ifdef HAVE_LAPACK
+        const size_t n = nlin();
+        const size_t m = B.nlin();
+        const size_t panel_size = std::min(m,static_cast<size_t>(256));
+        Matrix panel(n,panel_size);
+        for (size_t i0=0;i0<m;i0+=panel_size) {
+            const size_t p = std::min(panel_size,m-i0);
+            for (size_t j=0;j<n;++j)
+                for (size_t k=0;k<p;++k)
+                    panel(j,k) = B(i0+k,j);
+            int Info = 0;
+            DSPTRS('U',sizet_to_int(n),sizet_to_int(p),LDLt.data(),const_cast<BLAS_INT*>(pivots.data()),panel.data(),sizet_to_int(n),Info);
+            om_error(Info==0);
+            for (size_t j=0;j<n;++j)
+                for (size_t k=0;k<p;++k)
+                    B(i0+k,j) = panel(j,k);
+        }
+    #endif
+    }
+
     void SymMatrix::info() const {
         if (nlin() == 0) {
             std::cout << "Matrix Empty" << std::endl;
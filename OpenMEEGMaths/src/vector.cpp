@@ -82,14 +82,12 @@ namespace OpenMEEG {
 
     Vector Vector::operator*(const Matrix& m) const {
         om_assert(nlin()==m.nlin());
-        Vector c(m.ncol());
-        return m.transpose()*(*this);
+        return m.tmult(*this);
     }
 
     void Vector::set(double x) {
         om_assert(nlin()>0);
-        for( size_t i=0; i<nlin(); i++ )
-            data()[i]=x;
+        first_touch(data(),nlin(),x);
     }
 
     double Vector::sum() const
@@ -0,0 +1,116 @@
+/*
+Project Name : OpenMEEG
+
+© INRIA and ENPC (contributors: Geoffray ADDE, Maureen CLERC, Alexandre 
+GRAMFORT, Renaud KERIVEN, Jan KYBIC, Perrine LANDREAU, Théodore PAPADOPOULO,
+Emmanuel OLIVI
+Maureen.Clerc.AT.inria.fr, keriven.AT.certis.enpc.fr,
+kybic.AT.fel.cvut.cz, papadop.AT.inria.fr)
+
+The OpenMEEG software is a C++ package for solving the forward/inverse
+problems of electroencephalography and magnetoencephalography.
+
+This software is governed by the CeCILL-B license under French law and
+abiding by the rules of distribution of free software.  You can  use,
+modify and/ or redistribute the software under the terms of the CeCILL-B
+license as circulated by CEA, CNRS and INRIA at the following URL
+"http://www.cecill.info".
+
+As a counterpart to the access to the source code and  rights to copy,
+modify and redistribute granted by the license, users are provided only
+with a limited warranty  and the software's authors,  the holders of the
+economic rights,  and the successive licensors  have only  limited
+liability.
+
+In this respect, the user's attention is drawn to the risks associated
+with loading,  using,  modifying and/or developing or reproducing the
+software by the user in light of its specific status of free software,
+that may mean  that it is complicated to manipulate,  and  that  also
+therefore means  that it is reserved for developers  and  experienced
+professionals having in-depth computer knowledge. Users are therefore
+encouraged to load and test the software's suitability as regards their
+requirements in conditions enabling the security of their systems and/or
+data to be ensured and,  more generally, to use and operate it in the
+same conditions as regards security.
+
+The fact that you are presently reading this means that you have had
+knowledge of the CeCILL-B license and that you accept its terms.
+*/
+
+#include <cmath>
+#include <chrono>
+#include <thread>
+#include <iostream>
+#include <filesystem>
+
+#include <signal.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include <symmatrix.h>
+#include <out_of_core.h>
+#include <test_utils.hpp>
+
+using namespace OpenMEEG;
+
+int main() {
+
+    bool ok = true;
+
+    const unsigned n = 400;
+    SymMatrix A(n);
+    for (unsigned i=0;i<n;++i)
+        for (unsigned j=i;j<n;++j)
+            A(i,j) = sin(1.0+i*j+j*j)+((i==j) ? 4.0 : 0.0);
+    A.save("checkpoint_input.bin");
+
+    //  Small tiles (15 x 15 values), so that the inversion is long enough to be interrupted.
+
+    const size_t memory = 3*n*sizeof(double);
+    const std::string& dir = "checkpoint_test";
+    const std::string& signature = "HeadMatInv "+Checkpoint::stamp("checkpoint_input.bin");
+    std::filesystem::remove_all(dir);
+
+    //  Uninterrupted run.
+
+    invert_out_of_core("checkpoint_input.bin","checkpoint_reference.bin",memory);
+
+    //  Run killed (SIGKILL, i.e. as by a crash) once the first tiles are checkpointed, then resumed.
+
+    const Checkpoint checkpoint(dir,signature);
+    const pid_t pid = fork();
+    if (pid==0) {
+        invert_out_of_core("checkpoint_input.bin","checkpoint_resumed.bin",memory,checkpoint);
+        _exit(0);
+    }
+
+    const std::string& state = checkpoint.path("state.bin");
+    while (!std::filesystem::exists(state) && waitpid(pid,nullptr,WNOHANG)==0)
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    kill(pid,SIGKILL);
+    waitpid(pid,nullptr,0);
+
+    ok = check(checkpoint.exists("state.bin"),"interruption of the inversion") && ok;
+
+    invert_out_of_core("checkpoint_input.bin","checkpoint_resumed.bin",memory,Checkpoint(dir,signature));
+    ok = check(!checkpoint.exists("state.bin"),"clearing of the checkpoints") && ok;
+
+    SymMatrix reference;
+    SymMatrix resumed;
+    reference.load("checkpoint_reference.bin");
+    resumed.load("checkpoint_resumed.bin");
+    double diff = 0.0;
+    for (unsigned i=0;i<n;++i)
+        for (unsigned j=i;j<n;++j)
+            diff = std::max(diff,std::abs(resumed(i,j)-reference(i,j)));
+    ok = check(diff<1e-12,"resumed inversion") && ok;
+
+    //  A modified input changes the signature (so that its checkpoints are discarded).
+
+    const std::string& stamp = Checkpoint::stamp("checkpoint_input.bin");
+    const auto mtime = std::filesystem::last_write_time("checkpoint_input.bin");
+    std::filesystem::last_write_time("checkpoint_input.bin",mtime+std::chrono::seconds(1));
+    ok = check(Checkpoint::stamp("checkpoint_input.bin")!=stamp,"stamp of a modified file") && ok;
+
+    return (ok) ? 0 : 1;
+}
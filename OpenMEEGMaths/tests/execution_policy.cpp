@@ -0,0 +1,115 @@
+/*
+Project Name : OpenMEEG
+
+© INRIA and ENPC (contributors: Geoffray ADDE, Maureen CLERC, Alexandre 
+GRAMFORT, Renaud KERIVEN, Jan KYBIC, Perrine LANDREAU, Théodore PAPADOPOULO,
+Emmanuel OLIVI
+Maureen.Clerc.AT.inria.fr, keriven.AT.certis.enpc.fr,
+kybic.AT.fel.cvut.cz, papadop.AT.inria.fr)
+
+The OpenMEEG software is a C++ package for solving the forward/inverse
+problems of electroencephalography and magnetoencephalography.
+
+This software is governed by the CeCILL-B license under French law and
+abiding by the rules of distribution of free software.  You can  use,
+modify and/ or redistribute the software under the terms of the CeCILL-B
+license as circulated by CEA, CNRS and INRIA at the following URL
+"http://www.cecill.info".
+
+As a counterpart to the access to the source code and  rights to copy,
+modify and redistribute granted by the license, users are provided only
+with a limited warranty  and the software's authors,  the holders of the
+economic rights,  and the successive licensors  have only  limited
+liability.
+
+In this respect, the user's attention is drawn to the risks associated
+with loading,  using,  modifying and/or developing or reproducing the
+software by the user in light of its specific status of free software,
+that may mean  that it is complicated to manipulate,  and  that  also
+therefore means  that it is reserved for developers  and  experienced
+professionals having in-depth computer knowledge. Users are therefore
+encouraged to load and test the software's suitability as regards their
+requirements in conditions enabling the security of their systems and/or
+data to be ensured and,  more generally, to use and operate it in the
+same conditions as regards security.
+
+The fact that you are presently reading this means that you have had
+knowledge of the CeCILL-B license and that you accept its terms.
+*/
+
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+#include <execution_policy.h>
+#include <test_utils.hpp>
+
+#ifndef NO_OPENMP
+#include <omp.h>
+#endif
+
+using namespace OpenMEEG;
+
+int main() {
+
+    bool ok = true;
+
+    //  Default policy: blas_threads defaults to threads when OpenMP is used.
+
+    const ExecutionPolicy& defaults = set_execution_policy(ExecutionPolicy());
+    ok = check(defaults.threads>=1 && defaults.blas_threads>=1,"default policy") && ok;
+    #ifndef NO_OPENMP
+    ok = check(defaults.threads==static_cast<unsigned>(omp_get_max_threads()),"default threads") && ok;
+    ok = check(defaults.blas_threads==defaults.threads,"default blas threads") && ok;
+    #endif
+
+    //  Explicit policy.
+
+    ExecutionPolicy policy;
+    policy.threads      = 3;
+    policy.blas_threads = 2;
+    const ExecutionPolicy& resolved = set_execution_policy(policy);
+    ok = check(resolved.threads==3 && resolved.blas_threads==2,"resolved policy") && ok;
+    #ifndef NO_OPENMP
+    ok = check(omp_get_max_threads()==3,"OpenMP threads") && ok;
+    #endif
+
+    //  BLAS threads in each stage (only when the BLAS library can be controlled).
+
+    if (blas_threads()!=0) {
+        ok = check(blas_threads()==2,"BLAS threads") && ok;
+        {
+            const ExecutionStage stage(ExecutionStage::DENSE_ALGEBRA);
+            ok = check(blas_threads()==2,"BLAS threads in DENSE_ALGEBRA") && ok;
+        }
+        {
+            const ExecutionStage stage(ExecutionStage::OPENMP_LOOPS);
+            #ifndef NO_OPENMP
+            ok = check(blas_threads()==1,"BLAS threads in OPENMP_LOOPS") && ok;
+            #else
+            ok = check(blas_threads()==2,"BLAS threads in OPENMP_LOOPS (no OpenMP)") && ok;
+            #endif
+        }
+        ok = check(blas_threads()==2,"BLAS threads restored") && ok;
+
+        set_blas_threads(4);
+        {
+            const ExecutionStage stage(ExecutionStage::DENSE_ALGEBRA);
+            ok = check(blas_threads()==2,"BLAS threads set by DENSE_ALGEBRA") && ok;
+        }
+        ok = check(blas_threads()==4,"BLAS threads restored after DENSE_ALGEBRA") && ok;
+    }
+
+    //  Thread binding: the environment of the OpenMP runtime is set, unless given by the user.
+
+    ok = check(set_thread_binding(ExecutionPolicy::NO_BINDING),"no binding") && ok;
+    #ifndef NO_OPENMP
+    const bool user_binding = std::getenv("OMP_PROC_BIND")!=nullptr;
+    const bool bound = set_thread_binding(ExecutionPolicy::SPREAD);
+    ok = check(user_binding || std::string(std::getenv("OMP_PROC_BIND"))=="spread","binding environment") && ok;
+    ok = check(std::getenv("OMP_PLACES")!=nullptr,"places environment") && ok;
+    ok = check(bound==(omp_get_proc_bind()!=omp_proc_bind_false),"binding reported") && ok;
+    #endif
+
+    return (ok) ? 0 : 1;
+}
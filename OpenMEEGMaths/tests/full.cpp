@@ -38,11 +38,21 @@ knowledge of the CeCILL-B license and that you accept its terms.
 */
 
 #include <cmath>
+#include <cstdint>
+#include <ctime>
+#include <chrono>
+#include <thread>
+#include <type_traits>
 #include <iostream>
 
 #include <OpenMEEGMathsConfig.h>
 #include <matrix.h>
 #include <sparse_matrix.h>
+#include <product_chain.h>
+#include <matop.h>
+#include <linop_algebra.h>
+#include <compressed_leadfield.h>
+#include <realtime.h>
 #include <generic_test.hpp>
 
 int main () {
@@ -142,5 +152,381 @@ int main () {
         std::cerr << "Error: PseudoInverse is WRONG-2" << std::endl;
         exit(1);
     }
+
+    // Views and BLAS operations on views give the same results as copies.
+
+    {
+        Matrix A(7,5);
+        for (unsigned i=0;i<A.size();++i)
+            A.data()[i] = 1.0/(1.0+i);
+        Vector x(3);
+        x(0) = 1.0; x(1) = -2.0; x(2) = 0.5;
+
+        const Matrix  B = A.submat(2,4,1,3);
+        const Vector  y = A.view(2,4,1,3)*x.view();
+        const Matrix  C = B.tmult(B);
+        Matrix D(3,3);
+        gemm(true,false,1.0,A.view(2,4,1,3),A.view(2,4,1,3),0.0,D.view());
+        if ((y-B*x).norm()>eps || (C-D).frobenius_norm()>eps || (A.getlin(3)-Vector(A.lin_view(3))).norm()>eps) {
+            std::cerr << "Error: Matrix views are WRONG" << std::endl;
+            exit(1);
+        }
+
+        SymMatrix S(6);
+        for (unsigned i=0;i<S.size();++i)
+            S.data()[i] = i;
+        Matrix L(6,6);
+        for (unsigned i=0;i<6;++i)
+            S.getlin(i,L.lin_view(i));
+        if ((L-Matrix(S)).frobenius_norm()>eps) {
+            std::cerr << "Error: SymMatrix line views are WRONG" << std::endl;
+            exit(1);
+        }
+
+        // Views of const objects are read-only.
+
+        static_assert(std::is_same_v<decltype(B.view()),ConstMatrixView>);
+        static_assert(std::is_same_v<decltype(B.col_view(0)),ConstVectorView>);
+        static_assert(std::is_same_v<decltype(y.view()),ConstVectorView>);
+        static_assert(std::is_same_v<decltype(D.view()),MatrixView>);
+        static_assert(!std::is_convertible_v<ConstMatrixView,MatrixView>);
+
+        // Products with an empty inner dimension are zero (or beta times the result).
+
+        const Matrix E1(4,0);
+        const Matrix E2(0,3);
+        Matrix Z(3,4);
+        Z.set(1.0);
+        gemm(true,true,1.0,E2.view(),E1.view(),2.0,Z.view());
+        Vector z(4);
+        z.set(1.0);
+        gemv(false,1.0,E1.view(),Vector(0).view(),0.0,z.view());
+        if ((E1*E2).frobenius_norm()!=0.0 || std::abs(Z.frobenius_norm()-2.0*sqrt(12.0))>eps || z.norm()!=0.0) {
+            std::cerr << "Error: Empty matrix products are WRONG" << std::endl;
+            exit(1);
+        }
+    }
+
+    // Blocked transposition and products with transposed operands.
+
+    {
+        Matrix A(70,45), B(70,33);
+        for (unsigned i=0;i<A.size();++i)
+            A.data()[i] = sin(1.0+i);
+        for (unsigned i=0;i<B.size();++i)
+            B.data()[i] = cos(1.0+i);
+        const Matrix At = A.transpose();
+        const Matrix Bt = B.transpose();
+        bool ok = At.nlin()==A.ncol() && At.ncol()==A.nlin();
+        for (unsigned i=0;i<A.nlin();++i)
+            for (unsigned j=0;j<A.ncol();++j)
+                ok = ok && At(j,i)==A(i,j);
+        ok = ok && (A.tmult(B)-At*B).frobenius_norm()<eps && (At.multt(Bt)-At*B).frobenius_norm()<eps &&
+                   (A.tmultt(Bt)-At*B).frobenius_norm()<eps;
+        if (!ok) {
+            std::cerr << "Error: Transposition is WRONG" << std::endl;
+            exit(1);
+        }
+    }
+
+    // Truncated and randomized SVD, null space projector applied without being formed.
+
+    {
+        Matrix L(40,6), R(6,30);
+        for (unsigned i=0;i<L.size();++i)
+            L.data()[i] = sin(1.0+i*i);
+        for (unsigned i=0;i<R.size();++i)
+            R.data()[i] = cos(2.0+i*i);
+        const Matrix A = L*R; // rank 6
+
+        const TruncatedSVD& tsvd = truncated_svd(A,1e-10);
+        const TruncatedSVD& rsvd = randomized_svd(A,6);
+        Matrix As = tsvd.U;
+        for (unsigned j=0;j<As.ncol();++j)
+            for (unsigned i=0;i<As.nlin();++i)
+                As(i,j) *= tsvd.s(j);
+        if (tsvd.rank()!=6 || rsvd.rank()!=6 || (As*tsvd.Vt-A).frobenius_norm()>1e-10*A.frobenius_norm() ||
+            (rsvd.s-tsvd.s).norm()>1e-10*tsvd.s(0)) {
+            std::cerr << "Error: Truncated SVD is WRONG" << std::endl;
+            exit(1);
+        }
+
+        const NullSpaceProjector P(R);
+        Matrix X(30,4);
+        for (unsigned i=0;i<X.size();++i)
+            X.data()[i] = sin(3.0+i);
+        const Matrix Xt = X.transpose();
+        if (P.rank()!=24 || (R*(P*X)).frobenius_norm()>1e-10 || (P.matrix()*X-P*X).frobenius_norm()>1e-10 ||
+            (P.multt(Xt)-P*X).frobenius_norm()>1e-12) {
+            std::cerr << "Error: Null space projector is WRONG" << std::endl;
+            exit(1);
+        }
+
+        //  Saved projectors are reloaded with their format, including a basis with one line less than columns
+        //  and a legacy explicit projector whose first value is the former (numeric) tag of stored bases.
+
+        Matrix Q(5,6);
+        for (unsigned i=0;i<5;++i)
+            for (unsigned j=0;j<6;++j)
+                Q(i,j) = sin(1.0+i+3*j)+((i==j) ? 6.0 : 0.0);
+        const NullSpaceProjector PQ(Q);
+        const NullSpaceProjector Pm = NullSpaceProjector::from_matrix(P.matrix());
+        P.save("projector_basis.bin");
+        PQ.save("projector_square_basis.bin");
+        Pm.save("projector_matrix.bin");
+        Matrix legacy = P.matrix();
+        legacy(0,0) = 0x4F4D4E53;
+        legacy.save("projector_legacy.bin");
+        const NullSpaceProjector& P1 = NullSpaceProjector::load("projector_basis.bin");
+        const NullSpaceProjector& P2 = NullSpaceProjector::load("projector_square_basis.bin");
+        const NullSpaceProjector& P3 = NullSpaceProjector::load("projector_matrix.bin");
+        const NullSpaceProjector& P4 = NullSpaceProjector::load("projector_legacy.bin");
+        if (P1.explicit_matrix() || P2.explicit_matrix() || !P3.explicit_matrix() || P2.rank()!=1 ||
+            !P4.explicit_matrix() || (P4.matrix()-legacy).frobenius_norm()!=0.0 ||
+            (P1*X-P*X).frobenius_norm()>1e-12 || (P2.matrix()-PQ.matrix()).frobenius_norm()>1e-12 || (P3*X-P*X).frobenius_norm()>1e-10) {
+            std::cerr << "Error: Null space projector files are WRONG" << std::endl;
+            exit(1);
+        }
+    }
+
+    // Composite operators: products and solves without forming the combined matrices.
+
+    {
+        const unsigned n = 20;
+        SymMatrix S(n);
+        Matrix    F(n,n);
+        Matrix    U(n,2);
+        Vector    d(n);
+        for (unsigned i=0;i<n;++i) {
+            d(i) = 2.0+i;
+            for (unsigned j=0;j<n;++j) {
+                F(i,j) = sin(1.0+i+3*j)+((i==j) ? n : 0.0);
+                if (i<=j)
+                    S(i,j) = cos(2.0+i*j)+((i==j) ? n : 0.0);
+            }
+            U(i,0) = 1.0;
+            U(i,1) = sin(0.5*i);
+        }
+        Matrix C(2,2);
+        C(0,0) = 3.0; C(0,1) = 1.0; C(1,0) = 0.5; C(1,1) = 2.0;
+
+        const Matrix& Sf = Matrix(S);
+        Matrix Dm(n,n);
+        Dm.set(0.0);
+        for (unsigned i=0;i<n;++i)
+            Dm(i,i) = d(i);
+
+        const Operator& Sop = as_operator(S);
+        const Operator& Fop = as_operator(F);
+        const Operator& R   = rank_update(Sop,U,C);
+        const Operator& P   = product({ scaled(2.0,Fop),sum({ Sop,diagonal_operator(d) }) });
+        const Operator& BD  = block_diagonal({ R,Fop });
+        const Operator& B   = block_operator({ { Sop,nullptr },{ Fop,R } });
+
+        const Matrix& Rm = Sf+U*C*U.transpose();
+        Matrix Bm(2*n,2*n);
+        Bm.set(0.0);
+        Bm.insertmat(0,0,Sf);
+        Bm.insertmat(n,0,F);
+        Bm.insertmat(n,n,Rm);
+
+        Vector x(n);
+        Matrix X(2*n,3);
+        for (unsigned i=0;i<n;++i)
+            x(i) = cos(1.0+i);
+        for (unsigned i=0;i<X.size();++i)
+            X.data()[i] = sin(2.0+i);
+
+        const double tol = 1e-10;
+        bool ok = ((*R)*x-Rm*x).norm()<tol*(Rm*x).norm() &&
+                  ((*P)*x-(F*2.0)*((Sf+Dm)*x)).norm()<tol*((F*2.0)*((Sf+Dm)*x)).norm() &&
+                  ((*B)*X-Bm*X).frobenius_norm()<tol*(Bm*X).frobenius_norm();
+        ok = ok && (Rm*R->solve(x)-x).norm()<tol && (F*Fop->solve(x)-x).norm()<tol;
+        ok = ok && BD->invertible() && B->invertible() && !P->invertible();
+        ok = ok && (Bm*B->solve(X)-X).frobenius_norm()<tol*X.frobenius_norm();
+        ok = ok && (((*BD)*BD->solve(X))-X).frobenius_norm()<tol*X.frobenius_norm();
+
+        // A full block operator has no block substitution.
+
+        const Operator& Bfull = block_operator({ { Sop,Fop },{ Fop,R } });
+        ok = ok && !Bfull->invertible();
+        try {
+            Bfull->solve(X);
+            ok = false;
+        } catch (const maths::NotInvertible&) { }
+        if (!ok) {
+            std::cerr << "Error: Composite operators are WRONG" << std::endl;
+            exit(1);
+        }
+    }
+
+    // Lazy product chains: cheapest parenthesization and same values as the direct products.
+
+    {
+        Matrix A(10,100), B(100,5), C(5,50), D(10,50);
+        for (Matrix* M : { &A, &B, &C, &D })
+            for (unsigned i=0;i<M->size();++i)
+                M->data()[i] = cos(1.0+i+M->nlin());
+        const ProductChain& ABC = chain(A)*B*C+D;
+        const Matrix diff = ABC.eval()-(D+(A*B)*C);
+        if (ABC.parenthesization()!="((A0*A1)*A2)" || diff.frobenius_norm()>eps*D.frobenius_norm()) {
+            std::cerr << "Error: Product chain is WRONG-1" << std::endl;
+            exit(1);
+        }
+
+        //  A memory bound excluding the cheapest parenthesization (whose temporary is 5x200).
+
+        Matrix E(5,10), F1(10,200), G(200,10);
+        const ProductChain& EFG = chain(E)*F1*G;
+        ProductChain bounded(EFG);
+        bounded.memory_bound(500*sizeof(double));
+        if (EFG.parenthesization()!="((A0*A1)*A2)" || bounded.parenthesization()!="(A0*(A1*A2))" ||
+            bounded.temporaries()!=100*sizeof(double)) {
+            std::cerr << "Error: Product chain is WRONG-3" << std::endl;
+            exit(1);
+        }
+
+        //  All the storage combinations (the symmetric matrix is large enough to be cut in several panels).
+
+        const size_t n = 300;
+        Matrix F(n,n);
+        SymMatrix S(n);
+        SparseMatrix Sp(n,n);
+        for (size_t j=0;j<n;++j)
+            for (size_t i=0;i<n;++i) {
+                F(i,j) = sin(1.0+i+2.0*j);
+                if (i<=j)
+                    S(i,j) = cos(2.0+i*j);
+            }
+        for (size_t i=0;i<n;i+=7)
+            Sp(i,(3*i)%n) = 1.0+i;
+        const Matrix FS(S);
+        const Matrix FSp(Sp);
+        const Matrix refs[] = { F, FS, FSp };
+        for (unsigned k=0;k<3;++k)
+            for (unsigned l=0;l<3;++l) {
+                const ProductChain& c = (k==0) ? ((l==0) ? chain(F)*F  : (l==1) ? chain(F)*S  : chain(F)*Sp)  :
+                                        (k==1) ? ((l==0) ? chain(S)*F  : (l==1) ? chain(S)*S  : chain(S)*Sp)  :
+                                                 ((l==0) ? chain(Sp)*F : (l==1) ? chain(Sp)*S : chain(Sp)*Sp);
+                const Matrix ref = refs[k]*refs[l]+F;
+                if ((Matrix(c+F)-ref).frobenius_norm()>1e-10*ref.frobenius_norm()) {
+                    std::cerr << "Error: Product chain is WRONG-2 (" << k << ',' << l << ')' << std::endl;
+                    exit(1);
+                }
+            }
+    }
+
+    // Compressed leadfields: exact for low rank blocks, error bound otherwise, products and save/load.
+
+    {
+        const size_t m = 20, n = 100;
+        Matrix G(m,n), H(m,n);
+        for (size_t j=0;j<n;++j)
+            for (size_t i=0;i<m;++i) {
+                G(i,j) = 0.0;
+                for (unsigned k=1;k<=3;++k)
+                    G(i,j) += cos(1.0+k*i)*sin(2.0+k*j+(j/30)*j);
+                H(i,j) = sin(1.0+i*j+j*j);
+            }
+
+        const CompressedLeadfield Gc(G,30,1e-12);
+        const CompressedLeadfield Hc(H,30,0.1);
+        const double err = (Hc.decompress()-H).frobenius_norm();
+        bool ok = Gc.nblocks()==4 && Gc.total_rank()==12 && (Gc.decompress()-G).frobenius_norm()<1e-10*G.frobenius_norm();
+        ok = ok && err<=0.1*H.frobenius_norm() && std::abs(err-Hc.relative_error()*H.frobenius_norm())<1e-10*H.frobenius_norm();
+
+        Matrix X(n,3), Y(m,3);
+        for (unsigned i=0;i<X.size();++i)
+            X.data()[i] = cos(3.0+i);
+        for (unsigned i=0;i<Y.size();++i)
+            Y.data()[i] = sin(3.0+i);
+        const Matrix& Hd = Hc.decompress();
+        ok = ok && (Hc*X-Hd*X).frobenius_norm()<1e-12*(Hd*X).frobenius_norm();
+        ok = ok && (Hc.tmult(Y)-Hd.transpose()*Y).frobenius_norm()<1e-12*(Hd.transpose()*Y).frobenius_norm();
+
+        Hc.save("compressed.bin");
+        H.save("uncompressed.bin");
+        CompressedLeadfield Hl;
+        Hl.load("compressed.bin");
+        ok = ok && CompressedLeadfield::stored_in("compressed.bin") && !CompressedLeadfield::stored_in("uncompressed.bin");
+        ok = ok && (Hl.decompress()-Hd).frobenius_norm()==0.0 && Hl.relative_error()==Hc.relative_error();
+        ok = ok && !CompressedLeadfield::stored_in("missing.bin");
+        try {
+            Hl.load("uncompressed.bin");
+            ok = false;
+        } catch (const maths::BadContent&) { }
+
+        const CompressedLeadfield& Hf = CompressedLeadfield::compress("uncompressed.bin",30,0.1);
+        ok = ok && (Hf.decompress()-Hd).frobenius_norm()<1e-12*Hd.frobenius_norm();
+        if (!ok) {
+            std::cerr << "Error: Compressed leadfield is WRONG" << std::endl;
+            exit(1);
+        }
+    }
+
+    // Values are aligned on cache lines, whatever the allocation policy.
+
+    const std::shared_ptr<Allocator> default_allocator = Allocator::current();
+    for (const Allocator::HugePages hp : { Allocator::NO_HUGE_PAGES, Allocator::TRANSPARENT_HUGE_PAGES, Allocator::EXPLICIT_HUGE_PAGES }) {
+        Allocator::use(std::make_shared<AlignedAllocator>(hp,1<<16));
+        Matrix A(300,300);
+        A.set(1.);
+        Matrix B(A,DEEP_COPY);
+        Allocator::use(default_allocator);
+        if (reinterpret_cast<uintptr_t>(A.data())%AlignedAllocator::alignment!=0 || B.frobenius_norm()!=300.) {
+            std::cerr << "Error: Matrix allocation is WRONG" << std::endl;
+            exit(1);
+        }
+    }
+
+    // Streaming operator: blocks come back in submission order, equal to the products.
+
+    {
+        Matrix G(7,5);
+        for (size_t i=0;i<G.nlin();++i)
+            for (size_t j=0;j<G.ncol();++j)
+                G(i,j) = sin(1.0+i+2.0*j);
+
+        const size_t   nblocks = 50;
+        const unsigned threads = blas_threads();
+        bool ok = true;
+        {
+            StreamingOperator streamer(G,4,3,2);
+            Matrix S(5,4);
+            Matrix R(7,4);
+            for (size_t submitted=0,retrieved=0; retrieved<nblocks;) {
+                if (submitted<nblocks) {
+                    for (size_t i=0;i<S.nlin();++i)
+                        for (size_t j=0;j<S.ncol();++j)
+                            S(i,j) = cos(0.1*submitted+i+3.0*j);
+                    if (streamer.submit(S))
+                        ++submitted;
+                }
+                if (streamer.retrieve(R)) {
+                    for (size_t i=0;i<S.nlin();++i)
+                        for (size_t j=0;j<S.ncol();++j)
+                            S(i,j) = cos(0.1*retrieved+i+3.0*j);
+                    ok = ok && (R-G*S).frobenius_norm()<1e-12*R.frobenius_norm();
+                    ++retrieved;
+                }
+            }
+            const LatencyStatistics& stats = streamer.latencies();
+            ok = ok && stats.count()==nblocks && stats.min()<=stats.mean() && stats.mean()<=stats.max() && stats.percentile(50)<=stats.percentile(99);
+
+            //  Idle workers sleep: they use (almost) no processor time while nothing is submitted. BLAS is
+            //  sequential for the lifetime of the operator.
+
+            const std::clock_t start = std::clock();
+            std::this_thread::sleep_for(std::chrono::milliseconds(300));
+            ok = ok && static_cast<double>(std::clock()-start)/CLOCKS_PER_SEC<0.1;
+            ok = ok && blas_threads()==((threads==0) ? 0 : 1);
+        }
+        ok = ok && blas_threads()==threads;
+        if (!ok) {
+            std::cerr << "Error: StreamingOperator is WRONG" << std::endl;
+            exit(1);
+        }
+    }
+
     return 0;
 }
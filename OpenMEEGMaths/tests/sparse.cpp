@@ -88,6 +88,13 @@ int main () {
         exit(1);
     }
 
+    // Transposed product
+
+    if ((Matrix(spM.tmult(spM2))-Matrix(spM.transpose()*spM2)).frobenius_norm()>eps) {
+        std::cerr << "Error: tmult is WRONG" << std::endl;
+        exit(1);
+    }
+
     std::cout << std::endl << "========== fast sparse matrices ==========" << std::endl;
     std::cout << spM;
     FastSparseMatrix fspM(spM);
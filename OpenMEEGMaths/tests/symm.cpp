@@ -38,11 +38,14 @@ knowledge of the CeCILL-B license and that you accept its terms.
 */
 
 #include <cmath>
+#include <algorithm>
 #include <iostream>
 
 #include <OpenMEEGMathsConfig.h>
 #include <symmatrix.h>
 #include <matrix.h>
+#include <out_of_core.h>
+#include <Exceptions.H>
 #include <generic_test.hpp>
 
 int main() {
@@ -64,5 +67,74 @@ int main() {
     std::cout << "Matrice R : " << std::endl;
     R.info();
 
+    // Factorization: solutions of A*X = B and X*A = B', with A factorized in place.
+
+    SymMatrix A(S,DEEP_COPY);
+    for (unsigned i=0;i<4;++i)
+        A(i,i) += 100.0;
+    const Matrix FA(A);
+
+    Matrix B(4,3);
+    for (unsigned i=0;i<4;++i)
+        for (unsigned j=0;j<3;++j)
+            B(i,j) = i+2.0*j+1.0;
+
+    Matrix X(B,DEEP_COPY);
+    factorize(A).solve(X);
+    if ((FA*X-B).frobenius_norm()>eps*B.frobenius_norm()) {
+        std::cerr << "Error: SymMatrixFactorization::solve is not correct" << std::endl;
+        exit(1);
+    }
+
+    // Same for a block of columns of a larger matrix (leading dimension > 4).
+
+    Matrix Z(6,5);
+    Z.set(0.0);
+    copy(B.view(),Z.view(1,4,1,3));
+    factorize(A).solve(Z.view(1,4,1,3));
+    double err = 0.0;
+    for (unsigned i=0;i<4;++i)
+        for (unsigned j=0;j<3;++j)
+            err = std::max(err,std::abs(Z(i+1,j+1)-X(i,j)));
+    if (err>eps*X.frobenius_norm() || Z(0,1)!=0.0 || Z(5,1)!=0.0) {
+        std::cerr << "Error: SymMatrixFactorization::solve is not correct for a view" << std::endl;
+        exit(1);
+    }
+
+    Matrix Y(B.transpose());
+    factorize(std::move(A)).solve_transposed(Y);
+    if ((Y*FA-B.transpose()).frobenius_norm()>eps*B.frobenius_norm()) {
+        std::cerr << "Error: SymMatrixFactorization::solve_transposed is not correct" << std::endl;
+        exit(1);
+    }
+
+    // A singular matrix cannot be factorized, even in place.
+
+    SymMatrix Zero(4);
+    Zero.set(0.0);
+    try {
+        factorize(std::move(Zero));
+        std::cerr << "Error: SymMatrixFactorization of a singular matrix did not throw" << std::endl;
+        exit(1);
+    } catch (const maths::NotInvertible&) { }
+
+    // Out-of-core inversion by tiles of 6 x 6 values of an indefinite matrix (with a zero leading block).
+
+    const unsigned n = 20;
+    SymMatrix C(n);
+    for (unsigned i=0;i<n;++i)
+        for (unsigned j=i;j<n;++j)
+            C(i,j) = (j<5) ? 0.0 : sin(1.0+i*j+j*j)+((i==j) ? 2.0 : 0.0);
+    C.save("ooc.bin");
+    invert_out_of_core("ooc.bin","ooc_inv.bin",3*3*n*sizeof(double));
+    const SymMatrix Cinv("ooc_inv.bin");
+    Matrix Id(Matrix(C)*Matrix(Cinv));
+    for (unsigned i=0;i<n;++i)
+        Id(i,i) -= 1.0;
+    if (Id.frobenius_norm()>1e-10) {
+        std::cerr << "Error: invert_out_of_core is not correct" << std::endl;
+        exit(1);
+    }
+
     return 0;
 }
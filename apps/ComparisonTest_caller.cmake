@@ -28,6 +28,30 @@ foreach (HEADNUM 1 2 ${HEAD3})
     OPENMEEG_COMPARISON_TEST(H2ECOGM-OLD-Head${HEADNUM} Head${HEADNUM}-old.ecog initialTest/${BASE_FILE_NAME} "-sparse")
 endforeach()
 
+#   Verify that the one-run leadfield pipeline (with the cheapest, the direct and the adjoint formulations)
+#   provides the gains of om_gain.
+
+foreach (HEADNUM 1 2 ${HEAD3})
+    set(HEAD Head${HEADNUM})
+    foreach (METHOD "" "-direct" "-adjoint")
+        OPENMEEG_COMPARISON_TEST("EEGpipeline${METHOD}-${HEAD}"
+            ${HEAD}-pipeline${METHOD}.dgem ${OpenMEEG_BINARY_DIR}/tests/${HEAD}.dgem -full
+            DEPENDS DipGainPipeline${METHOD}-${HEAD} DipGainEEG-${HEAD})
+        OPENMEEG_COMPARISON_TEST("MEGpipeline${METHOD}-${HEAD}"
+            ${HEAD}-pipeline${METHOD}.dgmm ${OpenMEEG_BINARY_DIR}/tests/${HEAD}.dgmm -full
+            DEPENDS DipGainPipeline${METHOD}-${HEAD} DipGainMEG-${HEAD})
+    endforeach()
+
+    #   Same for the gains streamed to disk by blocks of dipoles.
+
+    OPENMEEG_COMPARISON_TEST("EEGstream-${HEAD}"
+        ${HEAD}-stream.dgem.bin ${OpenMEEG_BINARY_DIR}/tests/${HEAD}.dgem -full
+        DEPENDS DipGainStream-${HEAD} DipGainEEG-${HEAD})
+    OPENMEEG_COMPARISON_TEST("MEGstream-${HEAD}"
+        ${HEAD}-stream.dgmm.bin ${OpenMEEG_BINARY_DIR}/tests/${HEAD}.dgmm -full
+        DEPENDS DipGainStream-${HEAD} DipGainMEG-${HEAD})
+endforeach()
+
 #   TEST EEG RESULTS ON DIPOLES
 
 # defining variables for those who do not use VTK
@@ -11,11 +11,13 @@ set(ASSEMBLE  om_assemble)
 set(INVERSER  om_minverser)
 set(GAIN      om_gain)
 set(FORWARD   om_forward)
+set(LEADFIELD om_leadfield)
 
 OPENMEEG_TEST(assemble-help ${ASSEMBLE} -h)
 OPENMEEG_TEST(inverser-help ${INVERSER} -h)
 OPENMEEG_TEST(gain-help ${GAIN} -h)
 OPENMEEG_TEST(forward-help ${FORWARD} -h)
+OPENMEEG_TEST(leadfield-help ${LEADFIELD} -h)
 
 function(TESTHEAD HEADNUM)
     set(SUBJECT "Head${HEADNUM}")
@@ -64,6 +66,11 @@ function(TESTHEAD HEADNUM)
     set(DS2MMMAT               ${GENERATEDBASE}.ds2mm)
     set(DS2MMMAT-TANGENTIAL    ${GENERATEDBASE}-tangential.ds2mm)
     set(DS2MMMAT-NORADIAL      ${GENERATEDBASE}-noradial.ds2mm)
+    set(DSGMMAT                ${GENERATEDBASE}.dsgm)
+    set(DS2MGMMAT              ${GENERATEDBASE}.ds2mgm)
+    set(DS2IPGMAT              ${GENERATEDBASE}.ds2ipg)
+    set(DJEMMAT                ${GENERATEDBASE}.djem)
+    set(DJMMMAT                ${GENERATEDBASE}.djmm)
     set(DGIPMAT                ${GENERATEDBASE}.dgip)
     set(GSIPMAT                ${GENERATEDBASE}.gsip)
     set(DGEMMAT                ${GENERATEDBASE}.dgem)
@@ -73,6 +80,10 @@ function(TESTHEAD HEADNUM)
     set(DGMMMAT                ${GENERATEDBASE}.dgmm)
     set(DGMMADJOINTMAT         ${GENERATEDBASE}-adjoint.dgmm)
     set(DGMMADJOINT2MAT        ${GENERATEDBASE}-adjoint2.dgmm)
+    set(DGEMPIPELINEMAT        ${GENERATEDBASE}-pipeline.dgem)
+    set(DGMMPIPELINEMAT        ${GENERATEDBASE}-pipeline.dgmm)
+    set(DGEMSTREAMMAT          ${GENERATEDBASE}-stream.dgem.bin)
+    set(DGMMSTREAMMAT          ${GENERATEDBASE}-stream.dgmm.bin)
     set(DGMMMAT-TANGENTIAL     ${GENERATEDBASE}-tangential.dgmm)
     set(DGMMMAT-NORADIAL       ${GENERATEDBASE}-noradial.dgmm)
 
@@ -174,6 +185,16 @@ function(TESTHEAD HEADNUM)
 
     OPENMEEG_TEST(S2IPM-${SUBJECT} ${ASSEMBLE} -DS2IPM ${GEOM} ${COND} ${DIPPOS} ${POINTS} ${DS2IPMAT} DEPENDS CLEAN-TESTS)
 
+    # Derivatives with respect to the dipole positions, and the Jacobians of the EEG and MEG leadfields.
+
+    OPENMEEG_TEST(DSGM-${SUBJECT} ${ASSEMBLE} -DSGM ${GEOM} ${COND} ${DIPPOS} ${DSGMMAT} DEPENDS CLEAN-TESTS)
+    OPENMEEG_TEST(DS2MGM-${SUBJECT} ${ASSEMBLE} -DS2MGM ${DIPPOS} ${SQUIDS} ${DS2MGMMAT} DEPENDS CLEAN-TESTS)
+    OPENMEEG_TEST(DS2IPGM-${SUBJECT} ${ASSEMBLE} -DS2IPGM ${GEOM} ${COND} ${DIPPOS} ${POINTS} ${DS2IPGMAT} DEPENDS CLEAN-TESTS)
+    OPENMEEG_TEST(DipJacobianEEG-${SUBJECT} ${GAIN} -EEG ${HMINVMAT} ${DSGMMAT} ${H2EMMAT} ${DJEMMAT}
+                  DEPENDS HMInv-${SUBJECT} DSGM-${SUBJECT} H2EM-${SUBJECT})
+    OPENMEEG_TEST(DipJacobianMEG-${SUBJECT} ${GAIN} -MEG ${HMINVMAT} ${DSGMMAT} ${H2MMMAT} ${DS2MGMMAT} ${DJMMMAT}
+                  DEPENDS HMInv-${SUBJECT} DSGM-${SUBJECT} H2MM-${SUBJECT} DS2MGM-${SUBJECT})
+
     OPENMEEG_TEST(DipGainEEG-${SUBJECT} ${GAIN} -EEG ${HMINVMAT} ${DSMMAT} ${H2EMMAT} ${DGEMMAT}
                   DEPENDS HMInv-${SUBJECT} DSM-${SUBJECT} H2EM-${SUBJECT})
     OPENMEEG_TEST(DipGainEEGadjoint-${SUBJECT} ${GAIN} -EEGadjoint ${GEOM} ${COND} ${DIPPOS} ${HMMAT} ${H2EMMAT} ${DGEMADJOINTMAT}
@@ -188,6 +209,15 @@ function(TESTHEAD HEADNUM)
                   DEPENDS HMInv-${SUBJECT} DSM-${SUBJECT} H2MM-${SUBJECT}-noradial DS2MM-${SUBJECT}-noradial)
     OPENMEEG_TEST(DipGainEEGMEGadjoint-${SUBJECT} ${GAIN} -EEGMEGadjoint ${GEOM} ${COND} ${DIPPOS} ${HMMAT} ${H2EMMAT} ${H2MMMAT} ${DS2MMMAT} ${DGEMADJOINT2MAT} ${DGMMADJOINT2MAT}
                   DEPENDS HM-${SUBJECT} H2EM-${SUBJECT} H2MM-${SUBJECT} DS2MM-${SUBJECT})
+    OPENMEEG_TEST(DipGainPipeline-${SUBJECT} ${LEADFIELD} -g ${GEOM} -c ${COND} -d ${DIPPOS} -e ${PATCHES} -m ${SQUIDS}
+                  -eeg ${DGEMPIPELINEMAT} -meg ${DGMMPIPELINEMAT} DEPENDS CLEAN-TESTS)
+    foreach (METHOD direct adjoint)
+        OPENMEEG_TEST(DipGainPipeline-${METHOD}-${SUBJECT} ${LEADFIELD} -g ${GEOM} -c ${COND} -d ${DIPPOS} -e ${PATCHES} -m ${SQUIDS}
+                      -eeg ${GENERATEDBASE}-pipeline-${METHOD}.dgem -meg ${GENERATEDBASE}-pipeline-${METHOD}.dgmm -method ${METHOD}
+                      DEPENDS CLEAN-TESTS)
+    endforeach()
+    OPENMEEG_TEST(DipGainStream-${SUBJECT} ${LEADFIELD} -g ${GEOM} -c ${COND} -d ${DIPPOS} -e ${PATCHES} -m ${SQUIDS}
+                  -eeg ${DGEMSTREAMMAT} -meg ${DGMMSTREAMMAT} -stream DEPENDS CLEAN-TESTS)
     OPENMEEG_TEST(DipGainInternalPot-${SUBJECT} ${GAIN} -IP ${HMINVMAT} ${DSMMAT} ${H2IPMAT} ${DS2IPMAT} ${DGIPMAT}
                   DEPENDS HMInv-${SUBJECT} DSM-${SUBJECT} H2IPM-${SUBJECT} S2IPM-${SUBJECT})
 
@@ -195,6 +225,11 @@ function(TESTHEAD HEADNUM)
 
     OPENMEEG_TEST(EEG-dipoles-${SUBJECT} ${FORWARD} ${DGEMMAT} ${DIPSOURCES} ${ESTDIPBASE}.est_eeg 0.0
                   DEPENDS DipGainEEG-${SUBJECT})
+    OPENMEEG_TEST(EEG-dipoles-noise-${SUBJECT} ${FORWARD} ${DGEMMAT} ${DIPSOURCES} ${ESTDIPBASE}-noise.est_eeg 1e-3 42
+                  DEPENDS DipGainEEG-${SUBJECT})
+    OPENMEEG_TEST(EEG-dipoles-badseed-${SUBJECT} ${FORWARD} ${DGEMMAT} ${DIPSOURCES} ${ESTDIPBASE}-badseed.est_eeg 1e-3 -42
+                  DEPENDS DipGainEEG-${SUBJECT})
+    set_tests_properties(EEG-dipoles-badseed-${SUBJECT} PROPERTIES WILL_FAIL TRUE)
     OPENMEEG_TEST(EEGadjoint-dipoles-${SUBJECT} ${FORWARD} ${DGEMADJOINTMAT} ${DIPSOURCES} ${ESTDIPBASE}.est_eegadjoint 0.0
                   DEPENDS DipGainEEGadjoint-${SUBJECT})
     OPENMEEG_TEST(EEGadjoint2-dipoles-${SUBJECT} ${FORWARD} ${DGEMADJOINT2MAT} ${DIPSOURCES} ${ESTDIPBASE}.est_eegadjoint2 0.0
@@ -209,6 +244,12 @@ function(TESTHEAD HEADNUM)
                   DEPENDS DipGainMEG-${SUBJECT}-noradial)
     OPENMEEG_TEST(MEGadjoint2-dipoles-${SUBJECT} ${FORWARD} ${DGMMADJOINT2MAT} ${DIPSOURCES} ${ESTDIPBASE}.est_megadjoint2 0.0
                   DEPENDS DipGainEEGMEGadjoint-${SUBJECT})
+    OPENMEEG_TEST(EEGpipeline-dipoles-${SUBJECT} ${FORWARD} ${DGEMPIPELINEMAT} ${DIPSOURCES} ${ESTDIPBASE}.est_eegpipeline 0.0
+                  DEPENDS DipGainPipeline-${SUBJECT})
+    OPENMEEG_TEST(MEGpipeline-dipoles-${SUBJECT} ${FORWARD} ${DGMMPIPELINEMAT} ${DIPSOURCES} ${ESTDIPBASE}.est_megpipeline 0.0
+                  DEPENDS DipGainPipeline-${SUBJECT})
+    OPENMEEG_TEST(EEGstream-dipoles-${SUBJECT} ${FORWARD} ${DGEMSTREAMMAT} ${DIPSOURCES} ${ESTDIPBASE}.est_eegstream 0.0
+                  DEPENDS DipGainStream-${SUBJECT})
     OPENMEEG_TEST(InternalPot-dipoles-${SUBJECT} ${FORWARD} ${DGIPMAT} ${DIPSOURCES} ${ESTDIPBASE}-internal.est_eeg 0.0
                   DEPENDS DipGainInternalPot-${SUBJECT})
 
@@ -38,6 +38,7 @@ knowledge of the CeCILL-B license and that you accept its terms.
 
 #include <fstream>
 #include <cstring>
+#include <cstdint>
 #include <sstream>
 #include <stdexcept>
 #include <string>
@@ -57,21 +58,52 @@ unsigned gauss_order = 3;
 
 void getHelp(char** argv);
 
+//  Digest (FNV-1a) of the vertices and triangles of a geometry, as the mesh files are not given on the command line.
+
+std::string geometry_digest(const Geometry& geo) {
+    uint64_t hash = 14695981039346656037ULL;
+    const auto add = [&hash](const auto value) {
+        const unsigned char* bytes = reinterpret_cast<const unsigned char*>(&value);
+        for (unsigned i=0;i<sizeof(value);++i)
+            hash = (hash^bytes[i])*1099511628211ULL;
+    };
+    for (const auto& vertex : geo.vertices())
+        for (unsigned k=0;k<3;++k)
+            add(vertex(k));
+    for (const auto& mesh : geo.meshes())
+        for (const auto& triangle : mesh.triangles())
+            for (unsigned j=0;j<3;++j)
+                add(triangle.vertex(j).index());
+    std::ostringstream oss;
+    oss << std::hex << hash;
+    return oss.str();
+}
+
 bool option(const int argc, char ** argv, const Strings& options, const Strings& files);
 
 int main(int argc, char** argv)
 {
+    execution_options(argc,argv);
     print_version(argv[0]);
 
     bool OLD_ORDERING = false;
+    std::string checkpoint_dir;
     if (argc<2) {
         getHelp(argv);
         return 0;
     } else {
-        OLD_ORDERING = (strcmp(argv[argc-1], "-old-ordering") == 0);
-        if (OLD_ORDERING) {
-            argc--;
-            std::cout << "Using old ordering i.e using (V1, p1, V2, p2, V3) instead of (V1, V2, V3, p1, p2)" << std::endl;
+        // Trailing options (in any order).
+        while (argc>2) {
+            if (strcmp(argv[argc-1],"-old-ordering")==0) {
+                OLD_ORDERING = true;
+                argc--;
+                std::cout << "Using old ordering i.e using (V1, p1, V2, p2, V3) instead of (V1, V2, V3, p1, p2)" << std::endl;
+            } else if (strcmp(argv[argc-2],"-checkpoint")==0) {
+                checkpoint_dir = argv[argc-1];
+                argc -= 2;
+            } else {
+                break;
+            }
         }
     }
 
@@ -96,9 +128,16 @@ int main(int argc, char** argv)
         if (!geo.selfCheck())
             exit(1);
 
-        // Assembling Matrix from discretization.
-        HeadMat HM(geo,gauss_order);
+        // Assembling Matrix from discretization (resuming an interrupted assembly if checkpoints are available).
+
+        std::ostringstream signature;
+        signature << "HeadMat " << Checkpoint::stamp(argv[2]) << ' ' << Checkpoint::stamp(argv[3]) << ' '
+                  << geometry_digest(geo) << ' ' << gauss_order << ' ' << OLD_ORDERING;
+        const Checkpoint checkpoint(checkpoint_dir,signature.str());
+
+        HeadMat HM(geo,gauss_order,checkpoint);
         HM.save(argv[4]);
+        checkpoint.clear();
     } else if (option(argc,argv,{ "-CorticalMat","-CM","-cm" },
                                 { "geometry file","conductivity file","sensors file","domain name","output file" })) {
 
@@ -193,9 +232,9 @@ int main(int argc, char** argv)
         // Loading surfaces from geometry file.
         Geometry geo(argv[2],argv[3],OLD_ORDERING);
 
-        // Loading Matrix of dipoles.
+        // Loading Matrix of dipoles (or of locations for free orientation dipoles).
         Matrix dipoles(argv[4]);
-        if (dipoles.ncol()!=6) {
+        if (dipoles.ncol()!=6 && dipoles.ncol()!=3) {
             std::cerr << "Dipoles File Format Error" << std::endl;
             exit(1);
         }
@@ -213,6 +252,33 @@ int main(int argc, char** argv)
         dsm.save(argv[5]);
     }
 
+    /*********************************************************************************************
+    * Computation of the derivatives of the RHS with respect to the dipole positions
+    **********************************************************************************************/
+    else if (option(argc,argv,{"-DipSourceGradMat", "-DSGM", "-dsgm", "-DipSourceGradMatNoAdapt", "-DSGMNA", "-dsgmna"},
+                     {"geometry file", "conductivity file", "dipoles file", "output file"}) ) {
+
+        std::string domain_name = "";
+        if (argc==7) {
+            domain_name = argv[6];
+            std::cout << "Dipoles are considered to be in \"" << domain_name << "\" domain." << std::endl;
+        }
+
+        Geometry geo(argv[2],argv[3],OLD_ORDERING);
+
+        Matrix dipoles(argv[4]);
+        if (dipoles.ncol()!=6 && dipoles.ncol()!=3) {
+            std::cerr << "Dipoles File Format Error" << std::endl;
+            exit(1);
+        }
+
+        const bool adapt_rhs = !option(argc,argv,{"-DipSourceGradMatNoAdapt", "-DSGMNA", "-dsgmna"},
+                                       {"geometry file", "conductivity file", "dipoles file", "output file"});
+
+        DipSourceGradMat dsgm(geo, dipoles, gauss_order, adapt_rhs, domain_name);
+        dsgm.save(argv[5]);
+    }
+
     /*********************************************************************************************
     * Computation of the RHS for EIT
     **********************************************************************************************/
@@ -345,6 +411,16 @@ int main(int argc, char** argv)
         mat.save(argv[4]);
     }
 
+    else if (option(argc,argv,{"-DipSource2MEGGradMat", "-DS2MGM", "-ds2mgm"},
+                     {"dipoles file", "squids file", "output file"}) ) {
+
+        Matrix dipoles(argv[2]);
+        Sensors sensors(argv[3]);
+
+        DipSource2MEGGradMat mat( dipoles, sensors );
+        mat.save(argv[4]);
+    }
+
     /*********************************************************************************************
     * Computation of the discrete linear application which maps x (the unknown vector in a symmetric system)
     * |----> v, potential at a set of prescribed points within the 3D volume
@@ -381,6 +457,23 @@ int main(int argc, char** argv)
         DipSource2InternalPotMat mat(geo, dipoles, points, domain_name);
         mat.save(argv[6]);
     }
+    else if (option(argc,argv,{"-DipSource2InternalPotGradMat", "-DS2IPGM", "-ds2ipgm"},
+                     {"geometry file", "conductivity file", "dipole file", "point positions file", "output file"})) {
+        std::string domain_name = "";
+        if (argc==9) {
+            domain_name = argv[7];
+            std::cout << "Dipoles are considered to be in \"" << domain_name << "\" domain." << std::endl;
+        }
+        Geometry geo(argv[2],argv[3],OLD_ORDERING);
+        Matrix dipoles(argv[4]);
+        if (dipoles.ncol()!=6 && dipoles.ncol()!=3) {
+            std::cerr << "Dipoles File Format Error" << std::endl;
+            exit(1);
+        }
+        Matrix points(argv[5]);
+        DipSource2InternalPotGradMat mat(geo, dipoles, points, domain_name);
+        mat.save(argv[6]);
+    }
     else {
         std::cerr << "unknown argument: " << argv[1] << std::endl;
         exit(1);
@@ -426,7 +519,10 @@ void getHelp(char** argv) {
               << "             Arguments:" << std::endl
               << "               geometry file (.geom)" << std::endl
               << "               conductivity file (.cond)" << std::endl
-              << "               output matrix" << std::endl << std::endl;
+              << "               output matrix" << std::endl
+              << "             Optional trailing argument:" << std::endl
+              << "               -checkpoint DIR: save the blocks of the matrix in DIR as they are computed," << std::endl
+              << "                                a rerun after an interruption only computes the missing blocks." << std::endl << std::endl;
 
     std::cout << "   -CorticalMat, -CM, -cm:   " << std::endl
               << "       Compute Cortical Matrix for Symmetric BEM (left-hand side of linear system)." << std::endl
@@ -459,6 +555,22 @@ void getHelp(char** argv) {
               << "               conductivity file (.cond)" << std::endl
               << "               dipoles positions and orientations" << std::endl
               << "               output matrix" << std::endl
+              << "               (Optional) domain name where lie all dipoles." << std::endl
+              << "      If the dipoles file only contains positions (3 columns), the dipoles have free orientations:" << std::endl
+              << "      each position gives 3 columns, for the unit dipoles along x, y and z. This also holds for" << std::endl
+              << "      -DipSource2MEGMat, -DipSource2InternalPotMat and the adjoint gains of om_gain." << std::endl << std::endl;
+
+    std::cout << "   -DipSourceGradMat, -DSGM, -dsgm:    " << std::endl
+              << "      Compute the derivatives of the Dipolar Source Matrix with respect to the dipole positions" << std::endl
+              << "      (3 columns x,y,z per dipole). Used in place of the DipSourceMat, om_gain gives the Jacobian" << std::endl
+              << "      of the leadfield with respect to the dipole positions. With free orientation dipoles (3 columns" << std::endl
+              << "      file), each position gives 9 columns, the derivatives of its 3 columns. This also holds for" << std::endl
+              << "      -DipSource2MEGGradMat and -DipSource2InternalPotGradMat." << std::endl
+              << "            Arguments:" << std::endl
+              << "               geometry file (.geom)" << std::endl
+              << "               conductivity file (.cond)" << std::endl
+              << "               dipoles positions and orientations" << std::endl
+              << "               output matrix" << std::endl
               << "               (Optional) domain name where lie all dipoles." << std::endl << std::endl;
 
     std::cout << "   -EITSourceMat, -EITSM -EITsm: " << std::endl
@@ -513,6 +625,13 @@ void getHelp(char** argv) {
               << "               positions and orientations of the MEG sensors (.squids)" << std::endl
               << "               output matrix" << std::endl << std::endl;
 
+    std::cout << "   -DipSource2MEGGradMat, -DS2MGM, -ds2mgm:  " << std::endl
+              << "        Compute the derivatives of the DipSource2MEGMat with respect to the dipole positions" << std::endl
+              << "            Arguments:" << std::endl
+              << "               dipoles positions and orientations" << std::endl
+              << "               positions and orientations of the MEG sensors (.squids)" << std::endl
+              << "               output matrix" << std::endl << std::endl;
+
     std::cout << "   -Head2InternalPotMat, -H2IPM -h2ipm:  " << std::endl
               << "        Compute the linear transformation which maps the surface potential" << std::endl
               << "        and normal current to the value of the internal potential at a set of points within a volume" << std::endl
@@ -533,5 +652,17 @@ void getHelp(char** argv) {
               << "               output matrix" << std::endl
               << "               (Optional) domain name where lie all dipoles." << std::endl << std::endl;
 
+    std::cout << "   -DipSource2InternalPotGradMat, -DS2IPGM -ds2ipgm:   " << std::endl
+              << "        Compute the derivatives of the DipSource2InternalPotMat with respect to the dipole positions" << std::endl
+              << "            Arguments:" << std::endl
+              << "               geometry file (.geom)" << std::endl
+              << "               conductivity file (.cond)" << std::endl
+              << "               dipoles positions and orientations" << std::endl
+              << "               a mesh file or a file with point positions at which to evaluate the potential" << std::endl
+              << "               output matrix" << std::endl
+              << "               (Optional) domain name where lie all dipoles." << std::endl << std::endl;
+
+    std::cout << execution_options_help() << std::endl;
+
     exit(0);
 }
@@ -37,6 +37,9 @@ The fact that you are presently reading this means that you have had
 knowledge of the CeCILL-B license and that you accept its terms.
 */
 
+#include <cerrno>
+#include <cstdlib>
+
 #include <om_utils.h>
 #include <commandline.h>
 #include <forward.h>
@@ -48,8 +51,26 @@ getHelp(const char* command) {
     std::cout << command << " [-h | --help] filepaths" << std::endl << std::endl
               << "   Compute the forward problem " << std::endl
               << "   Filepaths are in order :" << std::endl
-              << "   GainMatrix (bin), RealSourcesData (txt), SimulatedData (txt), NoiseLevel (float)" << std::endl
-              << std::endl;
+              << "   GainMatrix (bin), RealSourcesData (txt), SimulatedData (txt), NoiseLevel (float) [Seed (integer)]" << std::endl
+              << "   The GainMatrix may be a compressed leadfield (see om_compress_leadfield)." << std::endl
+              << "   The noise is reproducible for a given Seed (a random seed is used otherwise), whatever the number of threads." << std::endl
+              << "   If both RealSourcesData and SimulatedData are raw binary (.bin) files, the time samples are streamed" << std::endl
+              << "   by chunks and the recordings are never fully loaded in memory." << std::endl
+              << std::endl
+              << execution_options_help() << std::endl;
+}
+
+//  Raw binary sources and data files are streamed by chunks of time samples.
+
+template <typename GAIN>
+void simulate(const GAIN& GainMatrix,const char* sources,const char* data,const double NoiseLevel,const uint64_t seed) {
+    const ForwardSimulator<GAIN> forward(GainMatrix,NoiseLevel,seed);
+    if (tolower(getFilenameExtension(sources))=="bin" && tolower(getFilenameExtension(data))=="bin") {
+        forward(sources,data);
+    } else {
+        const Matrix RealSourcesData(sources);
+        forward(RealSourcesData).save(data);
+    }
 }
 
 void error(const char* command,const bool unknown_option=false) {
@@ -58,9 +79,24 @@ void error(const char* command,const bool unknown_option=false) {
     exit(1);
 }
 
+//  The seed must be a non negative integer.
+
+uint64_t seed_argument(const char* command,const char* arg) {
+    char* end = nullptr;
+    errno = 0;
+    const unsigned long long seed = std::strtoull(arg,&end,10);
+    if (*arg=='\0' || *arg=='-' || *end!='\0' || errno==ERANGE) {
+        std::cerr << "Error: Invalid seed " << arg << " (a non negative integer is expected)." << std::endl;
+        getHelp(command);
+        exit(1);
+    }
+    return seed;
+}
+
 int
 main(int argc,char **argv) {
 
+    execution_options(argc,argv);
     print_version(argv[0]);
 
     if (argc==2 && (!strcmp(argv[1],"-h") || !strcmp(argv[1],"--help"))) {
@@ -79,16 +115,19 @@ main(int argc,char **argv) {
 
     // declaration of argument variables======================================================================
 
-    Matrix GainMatrix(argv[1]);
-    Matrix RealSourcesData(argv[2]);
+    const double   NoiseLevel = atof(argv[4]);
+    const uint64_t seed       = (argc>5) ? seed_argument(argv[0],argv[5]) : std::random_device{}();
 
-    const double NoiseLevel = atof(argv[4]);
+    // Compressed leadfields (see om_compress_leadfield) are applied without being decompressed.
 
-    Forward SimulatedData(GainMatrix,RealSourcesData,NoiseLevel);
-
-    // write output variables ===================================================================================
-
-    SimulatedData.save(argv[3]);
+    if (CompressedLeadfield::stored_in(argv[1])) {
+        CompressedLeadfield GainMatrix;
+        GainMatrix.load(argv[1]);
+        simulate(GainMatrix,argv[2],argv[3],NoiseLevel,seed);
+    } else {
+        const Matrix GainMatrix(argv[1]);
+        simulate(GainMatrix,argv[2],argv[3],NoiseLevel,seed);
+    }
 
     // Stop Chrono
 
@@ -55,6 +55,7 @@ error(const char* command,const bool unknown_option=false) {
 int
 main(int argc,char** argv) {
 
+    execution_options(argc,argv);
     print_version(argv[0]);
 
     if (argc<2)
@@ -80,14 +81,10 @@ main(int argc,char** argv) {
         if (argc<6)
             error(argv[0]);
 
-        //  Split the 2 matrix multiplications in order to spare memory.
-        //  This is why we do not use GainEEG...
-
         const SymMatrix HeadMatInv(argv[2]);
         const SparseMatrix Head2EEGMat(argv[4]);
-        const Matrix& tmp = Head2EEGMat*HeadMatInv;
         const Matrix SourceMat(argv[3]);
-        const Matrix& EEGGainMat = tmp*SourceMat;
+        const GainEEG EEGGainMat(HeadMatInv,SourceMat,Head2EEGMat);
         EEGGainMat.save(argv[5]);
 
     } else if (!strcmp(argv[1],"-EEGadjoint")) {
@@ -99,12 +96,27 @@ main(int argc,char** argv) {
 
         Geometry geo(argv[2],argv[3]);
         const Matrix dipoles(argv[4]);
-        const SymMatrix HeadMat(argv[5]);
+        SymMatrix HeadMat(argv[5]);
         const SparseMatrix Head2EEGMat(argv[6]);
 
-        const GainEEGadjoint EEGGainMat(geo, dipoles, HeadMat, Head2EEGMat);
+        const GainEEGadjoint EEGGainMat(geo, dipoles, std::move(HeadMat), Head2EEGMat);
         EEGGainMat.save(argv[7]);
 
+    } else if (!strcmp(argv[1],"-EEGadjointMatrixFree")) {
+
+        // Same as above but the head matrix is never assembled: the adjoint systems are solved iteratively.
+
+        if (argc<7)
+            error(argv[0]);
+
+        Geometry geo(argv[2],argv[3]);
+        const Matrix dipoles(argv[4]);
+        const MatrixFreeHeadMat HeadMat(geo);
+        const SparseMatrix Head2EEGMat(argv[5]);
+
+        const GainEEGadjoint EEGGainMat(geo, dipoles, HeadMat, Head2EEGMat);
+        EEGGainMat.save(argv[6]);
+
     } else if (!strcmp(argv[1],"-MEG")) {
 
         // MEG DATA
@@ -112,16 +124,15 @@ main(int argc,char** argv) {
         if (argc<7)
             error(argv[0]);
 
-        //  We split the 3 matrix multiplications in order to spare memory.
-        //  This is also why we do not use GainMEG...
+        //  The products are evaluated in the cheapest order whose temporaries are not larger than the largest
+        //  operand, the symmetric inverse is never unpacked as a full matrix and Source2MEGMat is accumulated
+        //  in the last product.
 
         const SymMatrix HeadMatInv(argv[2]);
         const Matrix Head2MEGMat(argv[4]);
-        const Matrix& tmp1 = Head2MEGMat*HeadMatInv;
         const Matrix SourceMat(argv[3]);
-        const Matrix& tmp2 = tmp1*SourceMat;
         const Matrix Source2MEGMat(argv[5]);
-        const Matrix MEGGainMat = Source2MEGMat+tmp2;
+        const GainMEG MEGGainMat(HeadMatInv,SourceMat,Head2MEGMat,Source2MEGMat);
         MEGGainMat.save(argv[6]);
 
     } else if ( !strcmp(argv[1], "-MEGadjoint") ) {
@@ -133,11 +144,11 @@ main(int argc,char** argv) {
 
         Geometry geo(argv[2],argv[3]);
         const Matrix dipoles(argv[4]);
-        const SymMatrix HeadMat(argv[5]);
+        SymMatrix HeadMat(argv[5]);
         const Matrix Head2MEGMat(argv[6]);
         const Matrix Source2MEGMat(argv[7]);
 
-        const GainMEGadjoint MEGGainMat(geo, dipoles, HeadMat, Head2MEGMat, Source2MEGMat);
+        const GainMEGadjoint MEGGainMat(geo, dipoles, std::move(HeadMat), Head2MEGMat, Source2MEGMat);
         MEGGainMat.save(argv[8]);
 
     } else if (!strcmp(argv[1],"-EEGMEGadjoint")) {
@@ -149,12 +160,12 @@ main(int argc,char** argv) {
 
         Geometry geo(argv[2],argv[3]);
         const Matrix dipoles(argv[4]);
-        const SymMatrix HeadMat(argv[5]);
+        SymMatrix HeadMat(argv[5]);
         const SparseMatrix Head2EEGMat(argv[6]);
         const Matrix Head2MEGMat(argv[7]);
         const Matrix Source2MEGMat(argv[8]);
 
-        const GainEEGMEGadjoint EEGMEGGainMat(geo, dipoles, HeadMat, Head2EEGMat, Head2MEGMat, Source2MEGMat);
+        const GainEEGMEGadjoint EEGMEGGainMat(geo, dipoles, std::move(HeadMat), Head2EEGMat, Head2MEGMat, Source2MEGMat);
         EEGMEGGainMat.saveEEG(argv[9]);
         EEGMEGGainMat.saveMEG(argv[10]);
 
@@ -165,13 +176,10 @@ main(int argc,char** argv) {
 
         const SymMatrix HeadMatInv(argv[2]);
         const Matrix Head2IPMat(argv[4]);
-
-        const Matrix& tmp1 = Head2IPMat*HeadMatInv;
         const Matrix SourceMat(argv[3]);
-        const Matrix& tmp2 = tmp1*SourceMat;
         const Matrix Source2IPMat(argv[5]);
 
-        const Matrix& InternalPotGainMat = Source2IPMat+tmp2;
+        const GainInternalPot InternalPotGainMat(HeadMatInv,SourceMat,Head2IPMat,Source2IPMat);
         InternalPotGainMat.save(argv[6]);
 
     } else if (!strcmp(argv[1],"-EITInternalPotential") || !strcmp(argv[1], "-EITIP")) {
@@ -183,7 +191,7 @@ main(int argc,char** argv) {
         const Matrix Head2IPMat(argv[4]);
         const Matrix SourceMat(argv[3]);
 
-        const Matrix& InternalPotGainMat = (Head2IPMat*HeadMatInv)*SourceMat;
+        const GainEITInternalPot InternalPotGainMat(HeadMatInv,SourceMat,Head2IPMat);
 
         InternalPotGainMat.save(argv[5]);
 
@@ -234,6 +242,15 @@ getHelp(char** argv) {
     std::cout << "            HeadMat, Head2EEGMat, EEGGainMatrix" << std::endl;
     std::cout << "            bin Matrix" << std::endl << std::endl;
 
+    std::cout << "   -EEGadjointMatrixFree :   Compute the gain for EEG without assembling the head matrix" << std::endl;
+    std::cout << "            (iterative solver, for large models)" << std::endl;
+    std::cout << "            Filepaths are in order :" << std::endl;
+    std::cout << "            geometry file (.geom)" << std::endl;
+    std::cout << "            conductivity file (.cond)" << std::endl;
+    std::cout << "            dipoles positions and orientations" << std::endl;
+    std::cout << "            Head2EEGMat, EEGGainMatrix" << std::endl;
+    std::cout << "            bin Matrix" << std::endl << std::endl;
+
     std::cout << "   -MEGadjoint :   Compute the gain for MEG " << std::endl;
     std::cout << "            Filepaths are in order :" << std::endl;
     std::cout << "            geometry file (.geom)" << std::endl;
@@ -250,5 +267,7 @@ getHelp(char** argv) {
     std::cout << "            HeadMat, Head2EEGMat, Head2MEGMat, Source2MEGMat, EEGGainMatrix, MEGGainMatrix" << std::endl;
     std::cout << "            bin Matrix" << std::endl << std::endl;
 
+    std::cout << execution_options_help() << std::endl;
+
     exit(0);
 }
@@ -0,0 +1,130 @@
+/*
+Project Name : OpenMEEG
+
+© INRIA and ENPC (contributors: Geoffray ADDE, Maureen CLERC, Alexandre 
+GRAMFORT, Renaud KERIVEN, Jan KYBIC, Perrine LANDREAU, Théodore PAPADOPOULO,
+Emmanuel OLIVI
+Maureen.Clerc.AT.inria.fr, keriven.AT.certis.enpc.fr,
+kybic.AT.fel.cvut.cz, papadop.AT.inria.fr)
+
+The OpenMEEG software is a C++ package for solving the forward/inverse
+problems of electroencephalography and magnetoencephalography.
+
+This software is governed by the CeCILL-B license under French law and
+abiding by the rules of distribution of free software.  You can  use,
+modify and/ or redistribute the software under the terms of the CeCILL-B
+license as circulated by CEA, CNRS and INRIA at the following URL
+"http://www.cecill.info".
+
+As a counterpart to the access to the source code and  rights to copy,
+modify and redistribute granted by the license, users are provided only
+with a limited warranty  and the software's authors,  the holders of the
+economic rights,  and the successive licensors  have only  limited
+liability.
+
+In this respect, the user's attention is drawn to the risks associated
+with loading,  using,  modifying and/or developing or reproducing the
+software by the user in light of its specific status of free software,
+that may mean  that it is complicated to manipulate,  and  that  also
+therefore means  that it is reserved for developers  and  experienced
+professionals having in-depth computer knowledge. Users are therefore
+encouraged to load and test the software's suitability as regards their
+requirements in conditions enabling the security of their systems and/or
+data to be ensured and,  more generally, to use and operate it in the
+same conditions as regards security.
+
+The fact that you are presently reading this means that you have had
+knowledge of the CeCILL-B license and that you accept its terms.
+*/
+
+#include <om_utils.h>
+#include <commandline.h>
+#include <assemble.h>
+#include <leadfield_pipeline.h>
+
+using namespace OpenMEEG;
+
+int
+main(int argc,char* argv[]) {
+
+    execution_options(argc,argv);
+    print_version(argv[0]);
+
+    const CommandLine cmd(argc,argv,"Compute EEG and/or MEG leadfields in one run, without writing the intermediate matrices");
+    const std::string& geom_filename   = cmd.option("-g",     std::string(),"Geometry file (.geom)");
+    const std::string& cond_filename   = cmd.option("-c",     std::string(),"Conductivity file (.cond)");
+    const std::string& dip_filename    = cmd.option("-d",     std::string(),"Dipoles file (6 columns, or 3 for dipole locations)");
+    const std::string& eeg_sensors     = cmd.option("-e",     std::string(),"EEG electrodes file");
+    const std::string& meg_sensors     = cmd.option("-m",     std::string(),"MEG squids file");
+    const std::string& eeg_filename    = cmd.option("-eeg",   std::string(),"Output EEG gain matrix");
+    const std::string& meg_filename    = cmd.option("-meg",   std::string(),"Output MEG gain matrix");
+    const std::string& method_name     = cmd.option("-method",std::string("auto"),"Formulation: direct, adjoint or auto (cheapest)");
+    const std::string& intermediates   = cmd.option("-save",  std::string(),"Also save the intermediate matrices with this prefix");
+    const bool         old_ordering    = cmd.option("-old",   false,        "Old ordering of the unknowns");
+    const bool         stream          = cmd.option("-stream",false,        "Write the gains by blocks of dipoles as they are computed (.bin outputs)");
+
+    if (cmd.help_mode())
+        return 0;
+
+    const bool eeg = eeg_sensors!="" && eeg_filename!="";
+    const bool meg = meg_sensors!="" && meg_filename!="";
+    if (geom_filename=="" || cond_filename=="" || dip_filename=="" || (!eeg && !meg)) {
+        std::cerr << "Missing arguments, try the -h option" << std::endl;
+        return 1;
+    }
+
+    LeadfieldPipeline::Method method;
+    if (method_name=="auto")
+        method = LeadfieldPipeline::AUTO;
+    else if (method_name=="direct")
+        method = LeadfieldPipeline::DIRECT;
+    else if (method_name=="adjoint")
+        method = LeadfieldPipeline::ADJOINT;
+    else {
+        std::cerr << "Unknown method " << method_name << ", try the -h option" << std::endl;
+        return 1;
+    }
+
+    if (stream && ((eeg && tolower(getFilenameExtension(eeg_filename))!="bin") || (meg && tolower(getFilenameExtension(meg_filename))!="bin"))) {
+        std::cerr << "Streamed gains can only be written to raw binary (.bin) files" << std::endl;
+        return 1;
+    }
+
+    print_commandline(argc,argv);
+
+    const auto start_time = std::chrono::system_clock::now();
+
+    const Geometry geo(geom_filename,cond_filename,old_ordering);
+    const Matrix   dipoles(dip_filename.c_str());
+
+    const Sensors electrodes = eeg ? Sensors(eeg_sensors.c_str()) : Sensors();
+    const Sensors squids     = meg ? Sensors(meg_sensors.c_str()) : Sensors();
+
+    const size_t N         = geo.nb_parameters()-geo.nb_current_barrier_triangles();
+    const size_t n_sensors = electrodes.getNumberOfSensors()+squids.getNumberOfSensors();
+    const size_t n_sources = DipSourceMat::components(dipoles)*dipoles.nlin();
+    std::cout << "Estimated cost (flops): direct " << LeadfieldPipeline::cost(LeadfieldPipeline::DIRECT,N,n_sensors,n_sources)
+              << ", adjoint " << LeadfieldPipeline::cost(LeadfieldPipeline::ADJOINT,N,n_sensors,n_sources) << std::endl;
+
+    const Sensors* eeg_sensors_ptr = eeg ? &electrodes : nullptr;
+    const Sensors* meg_sensors_ptr = meg ? &squids     : nullptr;
+
+    if (stream) {
+        const LeadfieldPipeline leadfields(geo,dipoles,eeg_sensors_ptr,meg_sensors_ptr,eeg_filename,meg_filename,method,intermediates);
+        std::cout << "Formulation: " << LeadfieldPipeline::name(leadfields.method()) << std::endl;
+    } else {
+        const LeadfieldPipeline leadfields(geo,dipoles,eeg_sensors_ptr,meg_sensors_ptr,method,intermediates);
+        std::cout << "Formulation: " << LeadfieldPipeline::name(leadfields.method()) << std::endl;
+        if (eeg)
+            leadfields.EEG().save(eeg_filename);
+        if (meg)
+            leadfields.MEG().save(meg_filename);
+    }
+
+    // Stop Chrono
+
+    const auto end_time = std::chrono::system_clock::now();
+    dispEllapsed(end_time-start_time);
+
+    return 0;
+}
@@ -38,10 +38,12 @@ knowledge of the CeCILL-B license and that you accept its terms.
 */
 
 #include <cstring>
+#include <cstdlib>
 
 #include <matrix.h>
 #include <symmatrix.h>
 #include <vector.h>
+#include <out_of_core.h>
 
 #include <commandline.h>
 #include <om_utils.h>
@@ -53,7 +55,14 @@ getHelp(char** argv) {
     std::cout << argv[0] <<" [-option] [filepaths...]" << std::endl << std::endl
               << "   Inverse HeadMatrix " << std::endl
               << "   Filepaths are in order :" << std::endl
-              << "       HeadMat (bin), HeadMatInv (bin)" << std::endl << std::endl;
+              << "       HeadMat (bin), HeadMatInv (bin)" << std::endl << std::endl
+              << "   -ooc, --out-of-core memory : " << std::endl
+              << "       Invert the HeadMatrix out of core (tile by tile, the factors being stored in the scratch file HeadMatInv.lu)" << std::endl
+              << "       with at most about memory MB of RAM. Filepaths are the same as above and must be raw binary files." << std::endl
+              << "       An optional trailing -checkpoint DIR stores the factors in DIR and saves the progress after each tile:" << std::endl
+              << "       a rerun with the same arguments after an interruption only processes the unfinished tiles." << std::endl
+              << "       (The in-core inversion is a single LAPACK call and cannot be checkpointed.)" << std::endl << std::endl
+              << execution_options_help() << std::endl;
 
     exit(0);
 }
@@ -61,6 +70,7 @@ getHelp(char** argv) {
 int
 main(int argc,char* argv[]) {
 
+    execution_options(argc,argv);
     print_version(argv[0]);
 
     if (argc==1) {
@@ -76,11 +86,23 @@ main(int argc,char* argv[]) {
 
     auto start_time = std::chrono::system_clock::now();
 
-    SymMatrix HeadMat;
-
-    HeadMat.load(argv[1]);
-    HeadMat.invert(); // invert inplace
-    HeadMat.save(argv[2]);
+    if ((!strcmp(argv[1],"-ooc")) || (!strcmp(argv[1],"--out-of-core"))) {
+        if (argc<5) {
+            std::cerr << "Not enough arguments \nPlease try \"" << argv[0] << " -h\" or \"" << argv[0] << " --help \" \n" << std::endl;
+            return 1;
+        }
+        const size_t memory = static_cast<size_t>(atof(argv[2])*(1<<20));
+        const bool checkpointing = argc>=7 && !strcmp(argv[5],"-checkpoint");
+        const std::string signature = "HeadMatInv "+Checkpoint::stamp(argv[3])+' '+argv[4];
+        const Checkpoint checkpoint = (checkpointing) ? Checkpoint(argv[6],signature) : Checkpoint();
+        invert_out_of_core(argv[3],argv[4],memory,checkpoint);
+    } else {
+        SymMatrix HeadMat;
+
+        HeadMat.load(argv[1]);
+        HeadMat.invert(); // invert inplace
+        HeadMat.save(argv[2]);
+    }
 
     // Stop Chrono
 
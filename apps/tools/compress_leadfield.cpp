@@ -0,0 +1,80 @@
+/*
+Project Name : OpenMEEG
+
+© INRIA and ENPC (contributors: Geoffray ADDE, Maureen CLERC, Alexandre 
+GRAMFORT, Renaud KERIVEN, Jan KYBIC, Perrine LANDREAU, Théodore PAPADOPOULO,
+Emmanuel OLIVI
+Maureen.Clerc.AT.inria.fr, keriven.AT.certis.enpc.fr,
+kybic.AT.fel.cvut.cz, papadop.AT.inria.fr)
+
+The OpenMEEG software is a C++ package for solving the forward/inverse
+problems of electroencephalography and magnetoencephalography.
+
+This software is governed by the CeCILL-B license under French law and
+abiding by the rules of distribution of free software.  You can  use,
+modify and/ or redistribute the software under the terms of the CeCILL-B
+license as circulated by CEA, CNRS and INRIA at the following URL
+"http://www.cecill.info".
+
+As a counterpart to the access to the source code and  rights to copy,
+modify and redistribute granted by the license, users are provided only
+with a limited warranty  and the software's authors,  the holders of the
+economic rights,  and the successive licensors  have only  limited
+liability.
+
+In this respect, the user's attention is drawn to the risks associated
+with loading,  using,  modifying and/or developing or reproducing the
+software by the user in light of its specific status of free software,
+that may mean  that it is complicated to manipulate,  and  that  also
+therefore means  that it is reserved for developers  and  experienced
+professionals having in-depth computer knowledge. Users are therefore
+encouraged to load and test the software's suitability as regards their
+requirements in conditions enabling the security of their systems and/or
+data to be ensured and,  more generally, to use and operate it in the
+same conditions as regards security.
+
+The fact that you are presently reading this means that you have had
+knowledge of the CeCILL-B license and that you accept its terms.
+*/
+
+#include <matrix.h>
+#include <compressed_leadfield.h>
+#include <commandline.h>
+
+using namespace OpenMEEG;
+
+int
+main(int argc,char* argv[]) {
+
+    execution_options(argc,argv);
+    print_version(argv[0]);
+
+    const CommandLine cmd(argc,argv,"Compress a gain matrix (leadfield) by blocks of sources with truncated SVDs");
+    const std::string& input_filename  = cmd.option("-i",    std::string(),"Input gain matrix");
+    const std::string& output_filename = cmd.option("-o",    std::string(),"Output compressed leadfield (or matrix with -d)");
+    const unsigned     block_size      = cmd.option("-block",300U,         "Number of columns (sources) per block, 0 for a global truncated SVD");
+    const double       tol             = cmd.option("-tol",  1e-4,         "Bound on the relative (Frobenius) error");
+    const bool         decompress      = cmd.option("-d",    false,        "Decompress the input compressed leadfield instead");
+
+    if (cmd.help_mode())
+        return 0;
+
+    if (input_filename=="" || output_filename=="") {
+        std::cerr << "Missing arguments, try the -h option" << std::endl;
+        return 1;
+    }
+
+    if (decompress) {
+        CompressedLeadfield G;
+        G.load(input_filename);
+        G.info();
+        G.decompress().save(output_filename);
+        return 0;
+    }
+
+    const CompressedLeadfield& G = CompressedLeadfield::compress(input_filename,block_size,tol);
+    G.info();
+    G.save(output_filename);
+
+    return 0;
+}
@@ -76,15 +76,11 @@ main(int argc,char* argv[]) {
     Matrix output(sensors.getNumberOfPositions(), 3);
 
     const size_t nb_positions = sensors.getNumberOfPositions();
+    const ClosestPoints& closest = dist_points_interface(sensors.getPositions(),interface);
     for (size_t i=0; i<nb_positions; ++i) {
-        const Vector position = sensors.getPosition(i);
-        Vect3 current_position;
-        for (unsigned k=0; k<3; ++k)
-            current_position(k) = position(k);
-        Vect3 alphas;
-        Triangle triangle; // closest triangle
-        dist_point_interface(current_position,interface,alphas,triangle);
-        current_position = alphas(0)*triangle.vertex(0)+alphas(1)*triangle.vertex(1)+alphas(2)*triangle.vertex(2);
+        const Vect3&    alphas   = closest[i].alphas;
+        const Triangle& triangle = *closest[i].triangle; // closest triangle
+        const Vect3& current_position = alphas(0)*triangle.vertex(0)+alphas(1)*triangle.vertex(1)+alphas(2)*triangle.vertex(2);
         for (unsigned k=0; k<3; ++k)
             output(i,k) = current_position(k);
     }
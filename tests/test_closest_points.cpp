@@ -0,0 +1,110 @@
+/*
+Project Name : OpenMEEG
+
+© INRIA and ENPC (contributors: Geoffray ADDE, Maureen CLERC, Alexandre 
+GRAMFORT, Renaud KERIVEN, Jan KYBIC, Perrine LANDREAU, Théodore PAPADOPOULO,
+Emmanuel OLIVI
+Maureen.Clerc.AT.inria.fr, keriven.AT.certis.enpc.fr,
+kybic.AT.fel.cvut.cz, papadop.AT.inria.fr)
+
+The OpenMEEG software is a C++ package for solving the forward/inverse
+problems of electroencephalography and magnetoencephalography.
+
+This software is governed by the CeCILL-B license under French law and
+abiding by the rules of distribution of free software.  You can  use,
+modify and/ or redistribute the software under the terms of the CeCILL-B
+license as circulated by CEA, CNRS and INRIA at the following URL
+"http://www.cecill.info".
+
+As a counterpart to the access to the source code and  rights to copy,
+modify and redistribute granted by the license, users are provided only
+with a limited warranty  and the software's authors,  the holders of the
+economic rights,  and the successive licensors  have only  limited
+liability.
+
+In this respect, the user's attention is drawn to the risks associated
+with loading,  using,  modifying and/or developing or reproducing the
+software by the user in light of its specific status of free software,
+that may mean  that it is complicated to manipulate,  and  that  also
+therefore means  that it is reserved for developers  and  experienced
+professionals having in-depth computer knowledge. Users are therefore
+encouraged to load and test the software's suitability as regards their
+requirements in conditions enabling the security of their systems and/or
+data to be ensured and,  more generally, to use and operate it in the
+same conditions as regards security.
+
+The fact that you are presently reading this means that you have had
+knowledge of the CeCILL-B license and that you accept its terms.
+*/
+
+#include <random>
+#include <limits>
+#include <iostream>
+
+#include <boundingbox.h>
+#include <danielsson.h>
+
+using namespace OpenMEEG;
+
+int main(int argc,char** argv) {
+
+    if (argc!=3) {
+        std::cerr << "Wrong nb of parameters" << std::endl;
+        return 1;
+    }
+
+    Geometry geo(argv[1],argv[2]);
+
+    //  Points around the head, some of them at mesh vertices (where several triangles are at the same distance).
+
+    BoundingBox bb;
+    for (const auto& vertex : geo.vertices())
+        bb.add(vertex);
+
+    std::mt19937 gen(1);
+    std::uniform_real_distribution<> unit(0.0,1.0);
+    const Vertex& lo = bb.min();
+    const Vertex& hi = bb.max();
+
+    const unsigned n = 2000;
+    Matrix points(n,3);
+    for (unsigned i=0; i<n; ++i) {
+        const Vertex& vertex = geo.vertices()[gen()%geo.vertices().size()];
+        for (unsigned k=0; k<3; ++k)
+            points(i,k) = (i%4==0) ? vertex(k) : lo(k)-0.1*(hi(k)-lo(k))+1.2*(hi(k)-lo(k))*unit(gen);
+    }
+
+    //  The results must be exactly those of an exhaustive search.
+
+    unsigned errors = 0;
+    for (auto& mesh : geo.meshes()) {
+        Interface interface(mesh.name());
+        interface.oriented_meshes().push_back(OrientedMesh(mesh,OrientedMesh::Normal));
+        const ClosestPoints& closest = dist_points_interface(points,interface);
+        for (unsigned i=0; i<n; ++i) {
+            const Vect3 p(points(i,0),points(i,1),points(i,2));
+            double distance = std::numeric_limits<double>::max();
+            const Triangle* nearest = nullptr;
+            Vect3 alphas;
+            for (const auto& triangle : mesh.triangles()) {
+                bool  inside;
+                Vect3 alphas_triangle;
+                const double d = dist_point_triangle(p,triangle,alphas_triangle,inside);
+                if (d<distance) {
+                    distance = d;
+                    nearest  = &triangle;
+                    alphas   = alphas_triangle;
+                }
+            }
+            if (closest[i].triangle!=nearest || closest[i].distance!=distance || closest[i].alphas!=alphas)
+                ++errors;
+        }
+    }
+
+    if (errors!=0) {
+        std::cerr << "Error: " << errors << " closest points differ from the exhaustive search." << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,154 @@
+/*
+Project Name : OpenMEEG
+
+© INRIA and ENPC (contributors: Geoffray ADDE, Maureen CLERC, Alexandre 
+GRAMFORT, Renaud KERIVEN, Jan KYBIC, Perrine LANDREAU, Théodore PAPADOPOULO,
+Emmanuel OLIVI
+Maureen.Clerc.AT.inria.fr, keriven.AT.certis.enpc.fr,
+kybic.AT.fel.cvut.cz, papadop.AT.inria.fr)
+
+The OpenMEEG software is a C++ package for solving the forward/inverse
+problems of electroencephalography and magnetoencephalography.
+
+This software is governed by the CeCILL-B license under French law and
+abiding by the rules of distribution of free software.  You can  use,
+modify and/ or redistribute the software under the terms of the CeCILL-B
+license as circulated by CEA, CNRS and INRIA at the following URL
+"http://www.cecill.info".
+
+As a counterpart to the access to the source code and  rights to copy,
+modify and redistribute granted by the license, users are provided only
+with a limited warranty  and the software's authors,  the holders of the
+economic rights,  and the successive licensors  have only  limited
+liability.
+
+In this respect, the user's attention is drawn to the risks associated
+with loading,  using,  modifying and/or developing or reproducing the
+software by the user in light of its specific status of free software,
+that may mean  that it is complicated to manipulate,  and  that  also
+therefore means  that it is reserved for developers  and  experienced
+professionals having in-depth computer knowledge. Users are therefore
+encouraged to load and test the software's suitability as regards their
+requirements in conditions enabling the security of their systems and/or
+data to be ensured and,  more generally, to use and operate it in the
+same conditions as regards security.
+
+The fact that you are presently reading this means that you have had
+knowledge of the CeCILL-B license and that you accept its terms.
+*/
+
+#include <iostream>
+
+#include <assemble.h>
+#include <sensors.h>
+#include <test_utils.hpp>
+
+using namespace OpenMEEG;
+
+//  Dipoles 3*s+j of the result are the dipoles s moved by delta along the axis j.
+
+Matrix shifted(const Matrix& dipoles,const double delta) {
+    Matrix res(3*dipoles.nlin(),dipoles.ncol());
+    for (unsigned s=0; s<dipoles.nlin(); ++s)
+        for (unsigned j=0; j<3; ++j) {
+            res.setlin(3*s+j,dipoles.getlin(s));
+            res(3*s+j,j) += delta;
+        }
+    return res;
+}
+
+//  Central finite differences (columns 3*s+j are the derivatives of the column s along the axis j).
+
+template <typename Assemble>
+Matrix finite_differences(const Matrix& dipoles,const double h,Assemble assemble) {
+    return (assemble(shifted(dipoles,h))-assemble(shifted(dipoles,-h)))/(2*h);
+}
+
+//  True if the assembly rejects its dipoles.
+
+template <typename Assemble>
+bool rejects(Assemble assemble) {
+    try {
+        assemble();
+    } catch (const OpenMEEG::BadData&) {
+        return true;
+    }
+    return false;
+}
+
+int main(int argc,char** argv) {
+
+    if (argc!=6) {
+        std::cerr << "Wrong nb of parameters" << std::endl;
+        return 1;
+    }
+
+    const Geometry geo(argv[1],argv[2]);
+    const Matrix   dipoles(argv[3]);
+    const Matrix   points(argv[4]);
+    const Sensors  squids(argv[5]);
+
+    //  Analytic derivatives with respect to the dipole positions versus central finite differences of the
+    //  DipSourceMat (without adaptive integration, which is not smooth), DipSource2InternalPotMat and DipSource2MEGMat.
+
+    const double h = 1e-5;
+    bool ok = true;
+
+    const Matrix& dsm_fd = finite_differences(dipoles,h,[&](const Matrix& dips) { return DipSourceMat(geo,dips,3,false); });
+    ok = check(difference(dsm_fd,DipSourceGradMat(geo,dipoles,3,false))<1e-6,"DipSourceGradMat") && ok;
+
+    const Matrix& ds2ipm_fd = finite_differences(dipoles,h,[&](const Matrix& dips) { return DipSource2InternalPotMat(geo,dips,points); });
+    ok = check(difference(ds2ipm_fd,DipSource2InternalPotGradMat(geo,dipoles,points))<1e-6,"DipSource2InternalPotGradMat") && ok;
+
+    const Matrix& ds2mm_fd = finite_differences(dipoles,h,[&](const Matrix& dips) { return DipSource2MEGMat(dips,squids); });
+    ok = check(difference(ds2mm_fd,DipSource2MEGGradMat(dipoles,squids))<1e-6,"DipSource2MEGGradMat") && ok;
+
+    //  Free orientation dipoles (positions only) versus the equivalent dipoles with unit moments along x, y and z.
+
+    Matrix positions(dipoles.nlin(),3);
+    Matrix unit_dipoles(3*dipoles.nlin(),6);
+    unit_dipoles.set(0.0);
+    for (unsigned s=0; s<dipoles.nlin(); ++s)
+        for (unsigned j=0; j<3; ++j) {
+            positions(s,j) = dipoles(s,j);
+            for (unsigned k=0; k<3; ++k)
+                unit_dipoles(3*s+k,j) = dipoles(s,j);
+            unit_dipoles(3*s+j,3+j) = 1.0;
+        }
+
+    const double eps = 1e-12;
+    ok = check(difference(DipSourceMat(geo,positions,3,false),DipSourceMat(geo,unit_dipoles,3,false))<eps,"DipSourceMat (free orientation)") && ok;
+    ok = check(difference(DipSourceMat(geo,positions),DipSourceMat(geo,unit_dipoles))<1e-3,"DipSourceMat (free orientation, adaptive)") && ok;
+    ok = check(difference(DipSource2InternalPotMat(geo,positions,points),DipSource2InternalPotMat(geo,unit_dipoles,points))<eps,
+               "DipSource2InternalPotMat (free orientation)") && ok;
+    ok = check(difference(DipSource2MEGMat(positions,squids),DipSource2MEGMat(unit_dipoles,squids))<eps,"DipSource2MEGMat (free orientation)") && ok;
+    ok = check(difference(DipSourceGradMat(geo,positions),DipSourceGradMat(geo,unit_dipoles))<eps,"DipSourceGradMat (free orientation)") && ok;
+    ok = check(difference(DipSource2InternalPotGradMat(geo,positions,points),DipSource2InternalPotGradMat(geo,unit_dipoles,points))<eps,
+               "DipSource2InternalPotGradMat (free orientation)") && ok;
+    ok = check(difference(DipSource2MEGGradMat(positions,squids),DipSource2MEGGradMat(unit_dipoles,squids))<eps,
+               "DipSource2MEGGradMat (free orientation)") && ok;
+
+    //  Right hand sides assembled by blocks of dipoles (as for the adjoint gains) versus dipole by dipole
+    //  (the block is filled with garbage first, as assemble overwrites its columns).
+
+    for (const Matrix& dips : { dipoles, positions }) {
+        const unsigned nc = DipSourceMat::components(dips);
+        const Matrix& per_dipole = DipSourceMat(geo,dips);
+        Matrix blocked(per_dipole.nlin(),per_dipole.ncol());
+        blocked.set(1.0);
+        const size_t half = dips.nlin()/2;
+        DipSourceMat::assemble(geo,dips,0,blocked.view(0,blocked.nlin(),0,nc*half));
+        DipSourceMat::assemble(geo,dips,half,blocked.view(0,blocked.nlin(),nc*half,nc*(dips.nlin()-half)));
+        ok = check(difference(blocked,per_dipole)<eps,(nc==3) ? "DipSourceMat (blocked, free orientation)" : "DipSourceMat (blocked)") && ok;
+    }
+
+    //  Dipole files with neither 3 nor 6 columns are rejected.
+
+    Matrix bad_dipoles(1,4);
+    bad_dipoles.set(0.0);
+    ok = check(rejects([&]() { DipSource2MEGMat(bad_dipoles,squids); }),"DipSource2MEGMat (bad dipoles)") && ok;
+    ok = check(rejects([&]() { DipSource2InternalPotGradMat(geo,bad_dipoles,points); }),"DipSource2InternalPotGradMat (bad dipoles)") && ok;
+    ok = check(rejects([&]() { DipSource2MEGGradMat(bad_dipoles,squids); }),"DipSource2MEGGradMat (bad dipoles)") && ok;
+
+    return (ok) ? 0 : 1;
+}
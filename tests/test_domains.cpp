@@ -0,0 +1,118 @@
+/*
+Project Name : OpenMEEG
+
+© INRIA and ENPC (contributors: Geoffray ADDE, Maureen CLERC, Alexandre 
+GRAMFORT, Renaud KERIVEN, Jan KYBIC, Perrine LANDREAU, Théodore PAPADOPOULO,
+Emmanuel OLIVI
+Maureen.Clerc.AT.inria.fr, keriven.AT.certis.enpc.fr,
+kybic.AT.fel.cvut.cz, papadop.AT.inria.fr)
+
+The OpenMEEG software is a C++ package for solving the forward/inverse
+problems of electroencephalography and magnetoencephalography.
+
+This software is governed by the CeCILL-B license under French law and
+abiding by the rules of distribution of free software.  You can  use,
+modify and/ or redistribute the software under the terms of the CeCILL-B
+license as circulated by CEA, CNRS and INRIA at the following URL
+"http://www.cecill.info".
+
+As a counterpart to the access to the source code and  rights to copy,
+modify and redistribute granted by the license, users are provided only
+with a limited warranty  and the software's authors,  the holders of the
+economic rights,  and the successive licensors  have only  limited
+liability.
+
+In this respect, the user's attention is drawn to the risks associated
+with loading,  using,  modifying and/or developing or reproducing the
+software by the user in light of its specific status of free software,
+that may mean  that it is complicated to manipulate,  and  that  also
+therefore means  that it is reserved for developers  and  experienced
+professionals having in-depth computer knowledge. Users are therefore
+encouraged to load and test the software's suitability as regards their
+requirements in conditions enabling the security of their systems and/or
+data to be ensured and,  more generally, to use and operate it in the
+same conditions as regards security.
+
+The fact that you are presently reading this means that you have had
+knowledge of the CeCILL-B license and that you accept its terms.
+*/
+
+#include <cmath>
+#include <random>
+#include <iostream>
+
+#include <constants.h>
+#include <boundingbox.h>
+#include <geometry.h>
+
+using namespace OpenMEEG;
+
+//  Reference classification: exact sums of the triangle solid angles.
+
+bool inside(const Interface& interface,const Vect3& p) {
+    double solangle = 0.0;
+    for (const auto& omesh : interface.oriented_meshes())
+        solangle += omesh.orientation()*omesh.mesh().solid_angle(p);
+    return std::round(solangle/(4*Pi))==-1.0;
+}
+
+const Domain* domain(const Geometry& geo,const Vect3& p) {
+    for (const auto& domain : geo.domains()) {
+        bool in = true;
+        for (const auto& boundary : domain.boundaries())
+            in = in && (inside(boundary.interface(),p)==boundary.inside());
+        if (in)
+            return &domain;
+    }
+    return nullptr;
+}
+
+int main(int argc,char** argv) {
+
+    if (argc!=3) {
+        std::cerr << "Wrong nb of parameters" << std::endl;
+        return 1;
+    }
+
+    Geometry geo(argv[1],argv[2]);
+
+    //  Points uniformly distributed around the head and points close to the interfaces.
+
+    BoundingBox bb;
+    for (const auto& vertex : geo.vertices())
+        bb.add(vertex);
+
+    std::mt19937 gen(1);
+    std::uniform_real_distribution<> unit(0.0,1.0);
+    const Vertex& lo = bb.min();
+    const Vertex& hi = bb.max();
+
+    const unsigned n = 4000;
+    Matrix points(n,3);
+    for (unsigned i=0; i<n/2; ++i)
+        for (unsigned k=0; k<3; ++k)
+            points(i,k) = lo(k)-0.1*(hi(k)-lo(k))+1.2*(hi(k)-lo(k))*unit(gen);
+
+    for (unsigned i=n/2; i<n; ++i) {
+        const Vertex& vertex = geo.vertices()[gen()%geo.vertices().size()];
+        const double scale = 1.0+((i%2) ? 1e-2 : 1e-4)*(2*unit(gen)-1.0);
+        for (unsigned k=0; k<3; ++k)
+            points(i,k) = bb.center()(k)+scale*(vertex(k)-bb.center()(k));
+    }
+
+    const Geometry::DomainsReference& domains = geo.domains(points);
+
+    unsigned errors = 0;
+    for (unsigned i=0; i<n; ++i) {
+        const Vect3 p(points(i,0),points(i,1),points(i,2));
+        if (domains[i]!=domain(geo,p) || domains[i]!=&geo.domain(p))
+            ++errors;
+    }
+
+    if (errors!=0) {
+        std::cerr << "Error: " << errors << " points out of " << n << " are misclassified." << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,119 @@
+/*
+Project Name : OpenMEEG
+
+© INRIA and ENPC (contributors: Geoffray ADDE, Maureen CLERC, Alexandre 
+GRAMFORT, Renaud KERIVEN, Jan KYBIC, Perrine LANDREAU, Théodore PAPADOPOULO,
+Emmanuel OLIVI
+Maureen.Clerc.AT.inria.fr, keriven.AT.certis.enpc.fr,
+kybic.AT.fel.cvut.cz, papadop.AT.inria.fr)
+
+The OpenMEEG software is a C++ package for solving the forward/inverse
+problems of electroencephalography and magnetoencephalography.
+
+This software is governed by the CeCILL-B license under French law and
+abiding by the rules of distribution of free software.  You can  use,
+modify and/ or redistribute the software under the terms of the CeCILL-B
+license as circulated by CEA, CNRS and INRIA at the following URL
+"http://www.cecill.info".
+
+As a counterpart to the access to the source code and  rights to copy,
+modify and redistribute granted by the license, users are provided only
+with a limited warranty  and the software's authors,  the holders of the
+economic rights,  and the successive licensors  have only  limited
+liability.
+
+In this respect, the user's attention is drawn to the risks associated
+with loading,  using,  modifying and/or developing or reproducing the
+software by the user in light of its specific status of free software,
+that may mean  that it is complicated to manipulate,  and  that  also
+therefore means  that it is reserved for developers  and  experienced
+professionals having in-depth computer knowledge. Users are therefore
+encouraged to load and test the software's suitability as regards their
+requirements in conditions enabling the security of their systems and/or
+data to be ensured and,  more generally, to use and operate it in the
+same conditions as regards security.
+
+The fact that you are presently reading this means that you have had
+knowledge of the CeCILL-B license and that you accept its terms.
+*/
+
+#include <iostream>
+
+#include <assemble.h>
+#include <gain.h>
+#include <sensors.h>
+#include <forward_evaluator.h>
+#include <test_utils.hpp>
+
+using namespace OpenMEEG;
+
+//  Fields (and Jacobians) of the dipoles computed one at a time by the evaluator, in the layout of the gain matrices.
+
+void evaluate(ForwardEvaluator& evaluator,const Matrix& dipoles,Matrix& fields,Matrix& jacobians) {
+    fields    = Matrix(evaluator.nb_sensors(),dipoles.nlin());
+    jacobians = Matrix(evaluator.nb_sensors(),3*dipoles.nlin());
+    for (unsigned s=0; s<dipoles.nlin(); ++s) {
+        const Vect3 r(dipoles(s,0),dipoles(s,1),dipoles(s,2));
+        const Vect3 q(dipoles(s,3),dipoles(s,4),dipoles(s,5));
+        const Vector& field = evaluator(r,q);
+        Vector field2(evaluator.nb_sensors());
+        Matrix jacobian(evaluator.nb_sensors(),3);
+        evaluator.evaluate(r,q,field2,jacobian);
+        om_error((field-field2).norm()<=1e-12*field.norm());
+        fields.setcol(s,field);
+        for (unsigned j=0; j<3; ++j)
+            jacobians.setcol(3*s+j,jacobian.getcol(j));
+    }
+}
+
+int main(int argc,char** argv) {
+
+    if (argc!=6) {
+        std::cerr << "Wrong nb of parameters" << std::endl;
+        return 1;
+    }
+
+    const Geometry geo(argv[1],argv[2]);
+    const Matrix   dipoles(argv[3]);
+    const Sensors  electrodes(argv[4]);
+    const Sensors  squids(argv[5]);
+
+    //  References: the gains and their Jacobians computed with the (non adaptive) source matrices.
+
+    const SymMatrix    HM = HeadMat(geo);
+    SymMatrix          HeadMatInv(HM,DEEP_COPY);
+    HeadMatInv.invert();
+    const Head2EEGMat  H2EM(geo,electrodes);
+    const Head2MEGMat  H2MM(geo,squids);
+    const DipSourceMat     DSM(geo,dipoles,3,false);
+    const DipSourceGradMat DSGM(geo,dipoles,3,false);
+
+    const GainEEG EEG(HeadMatInv,DSM,H2EM);
+    const GainEEG EEGJacobian(HeadMatInv,DSGM,H2EM);
+    const GainMEG MEG(HeadMatInv,DSM,H2MM,DipSource2MEGMat(dipoles,squids));
+    const GainMEG MEGJacobian(HeadMatInv,DSGM,H2MM,DipSource2MEGGradMat(dipoles,squids));
+
+    bool ok = true;
+    const double eps = 1e-10;
+    Matrix fields;
+    Matrix jacobians;
+
+    ForwardEvaluator eeg(geo,HM,H2EM);
+    evaluate(eeg,dipoles,fields,jacobians);
+    ok = check(difference(fields,EEG)<eps,"EEG fields") && ok;
+    ok = check(difference(jacobians,EEGJacobian)<eps,"EEG Jacobians") && ok;
+
+    ForwardEvaluator meg(geo,HM,H2MM,squids);
+    evaluate(meg,dipoles,fields,jacobians);
+    ok = check(difference(fields,MEG)<eps,"MEG fields") && ok;
+    ok = check(difference(jacobians,MEGJacobian)<eps,"MEG Jacobians") && ok;
+
+    //  A copy (e.g. for another thread) gives the same fields.
+
+    ForwardEvaluator copy(meg);
+    Matrix copy_fields;
+    evaluate(copy,dipoles,copy_fields,jacobians);
+    ok = check(difference(copy_fields,fields)==0.0,"copied evaluator") && ok;
+
+    return (ok) ? 0 : 1;
+}
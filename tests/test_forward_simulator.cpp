@@ -0,0 +1,126 @@
+/*
+Project Name : OpenMEEG
+
+© INRIA and ENPC (contributors: Geoffray ADDE, Maureen CLERC, Alexandre 
+GRAMFORT, Renaud KERIVEN, Jan KYBIC, Perrine LANDREAU, Théodore PAPADOPOULO,
+Emmanuel OLIVI
+Maureen.Clerc.AT.inria.fr, keriven.AT.certis.enpc.fr,
+kybic.AT.fel.cvut.cz, papadop.AT.inria.fr)
+
+The OpenMEEG software is a C++ package for solving the forward/inverse
+problems of electroencephalography and magnetoencephalography.
+
+This software is governed by the CeCILL-B license under French law and
+abiding by the rules of distribution of free software.  You can  use,
+modify and/ or redistribute the software under the terms of the CeCILL-B
+license as circulated by CEA, CNRS and INRIA at the following URL
+"http://www.cecill.info".
+
+As a counterpart to the access to the source code and  rights to copy,
+modify and redistribute granted by the license, users are provided only
+with a limited warranty  and the software's authors,  the holders of the
+economic rights,  and the successive licensors  have only  limited
+liability.
+
+In this respect, the user's attention is drawn to the risks associated
+with loading,  using,  modifying and/or developing or reproducing the
+software by the user in light of its specific status of free software,
+that may mean  that it is complicated to manipulate,  and  that  also
+therefore means  that it is reserved for developers  and  experienced
+professionals having in-depth computer knowledge. Users are therefore
+encouraged to load and test the software's suitability as regards their
+requirements in conditions enabling the security of their systems and/or
+data to be ensured and,  more generally, to use and operate it in the
+same conditions as regards security.
+
+The fact that you are presently reading this means that you have had
+knowledge of the CeCILL-B license and that you accept its terms.
+*/
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <cstring>
+
+#include <forward.h>
+#include <execution_policy.h>
+#include <test_utils.hpp>
+
+using namespace OpenMEEG;
+
+bool same_bytes(const Matrix& A,const Matrix& B) {
+    return A.nlin()==B.nlin() && A.ncol()==B.ncol() && std::memcmp(A.data(),B.data(),A.size()*sizeof(double))==0;
+}
+
+std::string contents(const std::string& filename) {
+    std::ifstream ifs(filename,std::ios::binary);
+    std::ostringstream oss;
+    oss << ifs.rdbuf();
+    return oss.str();
+}
+
+void set_threads(const unsigned n) {
+    ExecutionPolicy policy;
+    policy.threads = n;
+    set_execution_policy(policy);
+}
+
+//  The simulated data (with noise) must be bit-identical with 1 and N threads, in memory and streamed.
+
+int main() {
+
+    const size_t   n_sensors = 20;
+    const size_t   n_sources = 30;
+    const size_t   n_samples = 101;
+    const size_t   chunk     = 7;
+    const unsigned threads   = 4;
+
+    Matrix G(n_sensors,n_sources);
+    for (size_t j=0; j<n_sources; ++j)
+        for (size_t i=0; i<n_sensors; ++i)
+            G(i,j) = std::sin(1.0+i+3.0*j);
+
+    Matrix S(n_sources,n_samples);
+    for (size_t j=0; j<n_samples; ++j)
+        for (size_t i=0; i<n_sources; ++i)
+            S(i,j) = std::cos(0.5*i+0.1*j);
+    S.save("forward_sources.bin");
+
+    const ForwardSimulator<Matrix> forward(G,0.1,1234,chunk);
+
+    set_threads(1);
+    const Matrix sequential = forward(S);
+    forward("forward_sources.bin","forward_data_1.bin");
+
+    set_threads(threads);
+    const Matrix parallel = forward(S);
+    forward("forward_sources.bin","forward_data_N.bin");
+
+    bool ok = true;
+    ok = check(same_bytes(sequential,parallel),"in memory simulation with 1 and N threads") && ok;
+    ok = check(contents("forward_data_1.bin")==contents("forward_data_N.bin"),"streamed simulation with 1 and N threads") && ok;
+
+    const Matrix streamed("forward_data_N.bin");
+    ok = check(same_bytes(streamed,sequential),"streamed simulation") && ok;
+
+    //  The noise depends on the seed.
+
+    const ForwardSimulator<Matrix> other(G,0.1,4321,chunk);
+    ok = check(!same_bytes(other(S),sequential),"seeding of the noise") && ok;
+
+    //  Distinct indices give distinct deviates, including those which would share a counter (i<<32)^j.
+
+    const CounterNoise noise(1.0,1234);
+    ok = check(noise(1,0)!=noise(0,uint64_t(1)<<32) && noise(1,1)!=noise(0,(uint64_t(1)<<32)+1),"noise counter") && ok;
+
+    //  Streamed sources must match the gain.
+
+    const Matrix S2(S.submat(0,n_sources-1,0,n_samples));
+    S2.save("forward_sources.bin");
+    try {
+        forward("forward_sources.bin","forward_data_1.bin");
+        ok = check(false,"dimension check of the streamed sources") && ok;
+    } catch (const maths::BadContent&) { }
+
+    return (ok) ? 0 : 1;
+}
@@ -0,0 +1,118 @@
+/*
+Project Name : OpenMEEG
+
+© INRIA and ENPC (contributors: Geoffray ADDE, Maureen CLERC, Alexandre 
+GRAMFORT, Renaud KERIVEN, Jan KYBIC, Perrine LANDREAU, Théodore PAPADOPOULO,
+Emmanuel OLIVI
+Maureen.Clerc.AT.inria.fr, keriven.AT.certis.enpc.fr,
+kybic.AT.fel.cvut.cz, papadop.AT.inria.fr)
+
+The OpenMEEG software is a C++ package for solving the forward/inverse
+problems of electroencephalography and magnetoencephalography.
+
+This software is governed by the CeCILL-B license under French law and
+abiding by the rules of distribution of free software.  You can  use,
+modify and/ or redistribute the software under the terms of the CeCILL-B
+license as circulated by CEA, CNRS and INRIA at the following URL
+"http://www.cecill.info".
+
+As a counterpart to the access to the source code and  rights to copy,
+modify and redistribute granted by the license, users are provided only
+with a limited warranty  and the software's authors,  the holders of the
+economic rights,  and the successive licensors  have only  limited
+liability.
+
+In this respect, the user's attention is drawn to the risks associated
+with loading,  using,  modifying and/or developing or reproducing the
+software by the user in light of its specific status of free software,
+that may mean  that it is complicated to manipulate,  and  that  also
+therefore means  that it is reserved for developers  and  experienced
+professionals having in-depth computer knowledge. Users are therefore
+encouraged to load and test the software's suitability as regards their
+requirements in conditions enabling the security of their systems and/or
+data to be ensured and,  more generally, to use and operate it in the
+same conditions as regards security.
+
+The fact that you are presently reading this means that you have had
+knowledge of the CeCILL-B license and that you accept its terms.
+*/
+
+#include <iostream>
+
+#include <mesh.h>
+
+using namespace OpenMEEG;
+
+//  Reference results: test all the pairs of triangles.
+
+Mesh::TrianglePairs intersections(const Mesh& m1,const Mesh& m2) {
+    Mesh::TrianglePairs pairs;
+    for (const auto& triangle1 : m1.triangles())
+        for (const auto& triangle2 : m2.triangles())
+            if (triangle1.intersects(triangle2))
+                pairs.push_back({ &triangle1, &triangle2 });
+    return pairs;
+}
+
+Mesh::TrianglePairs self_intersections(const Mesh& m) {
+    Mesh::TrianglePairs pairs;
+    const Triangles& triangles = m.triangles();
+    for (auto tit1=triangles.begin(); tit1!=triangles.end(); ++tit1)
+        for (auto tit2=tit1+1; tit2!=triangles.end(); ++tit2)
+            if (!tit1->contains(tit2->vertex(0)) && !tit1->contains(tit2->vertex(1)) && !tit1->contains(tit2->vertex(2)))
+                if (tit1->intersects(*tit2))
+                    pairs.push_back({ &*tit1, &*tit2 });
+    return pairs;
+}
+
+int main(int argc,char** argv) {
+
+    if (argc!=2) {
+        std::cerr << "Wrong nb of parameters" << std::endl;
+        return 1;
+    }
+
+    Mesh mesh1(argv[1]);
+
+    if (!mesh1.self_intersections().empty()) {
+        std::cerr << "Error: mesh " << argv[1] << " should not self intersect." << std::endl;
+        return 1;
+    }
+
+    //  A slightly translated copy of the mesh crosses the original one.
+
+    Mesh mesh2(argv[1]);
+    for (auto& vertex : mesh2.vertices())
+        vertex->x() += 0.05;
+
+    const Mesh::TrianglePairs& pairs = mesh1.intersections(mesh2);
+    if (pairs.empty() || pairs!=intersections(mesh1,mesh2)) {
+        std::cerr << "Error: intersections differ from the exhaustive search." << std::endl;
+        return 1;
+    }
+
+    //  Pulling a vertex through the mesh, beyond the opposite side, makes its triangles cross the mesh.
+
+    Mesh mesh3(argv[1]);
+    Vect3 center(0.0,0.0,0.0);
+    for (const auto& vertex : mesh3.vertices())
+        center = center+*vertex;
+    center = center/mesh3.vertices().size();
+
+    Vertex& moved = *mesh3.vertices().front();
+    const Vect3 position = center+2.0*(center-moved);
+    moved.x() = position.x();
+    moved.y() = position.y();
+    moved.z() = position.z();
+
+    const Mesh::TrianglePairs& self_pairs = mesh3.self_intersections();
+    bool incident = !self_pairs.empty();
+    for (const auto& pair : self_pairs)
+        incident = incident && (pair.first->contains(moved) || pair.second->contains(moved));
+    if (!incident || !mesh3.has_self_intersection() || self_pairs!=self_intersections(mesh3)) {
+        std::cerr << "Error: self intersections of the deformed mesh are WRONG." << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,164 @@
+/*
+Project Name : OpenMEEG
+
+© INRIA and ENPC (contributors: Geoffray ADDE, Maureen CLERC, Alexandre 
+GRAMFORT, Renaud KERIVEN, Jan KYBIC, Perrine LANDREAU, Théodore PAPADOPOULO,
+Emmanuel OLIVI
+Maureen.Clerc.AT.inria.fr, keriven.AT.certis.enpc.fr,
+kybic.AT.fel.cvut.cz, papadop.AT.inria.fr)
+
+The OpenMEEG software is a C++ package for solving the forward/inverse
+problems of electroencephalography and magnetoencephalography.
+
+This software is governed by the CeCILL-B license under French law and
+abiding by the rules of distribution of free software.  You can  use,
+modify and/ or redistribute the software under the terms of the CeCILL-B
+license as circulated by CEA, CNRS and INRIA at the following URL
+"http://www.cecill.info".
+
+As a counterpart to the access to the source code and  rights to copy,
+modify and redistribute granted by the license, users are provided only
+with a limited warranty  and the software's authors,  the holders of the
+economic rights,  and the successive licensors  have only  limited
+liability.
+
+In this respect, the user's attention is drawn to the risks associated
+with loading,  using,  modifying and/or developing or reproducing the
+software by the user in light of its specific status of free software,
+that may mean  that it is complicated to manipulate,  and  that  also
+therefore means  that it is reserved for developers  and  experienced
+professionals having in-depth computer knowledge. Users are therefore
+encouraged to load and test the software's suitability as regards their
+requirements in conditions enabling the security of their systems and/or
+data to be ensured and,  more generally, to use and operate it in the
+same conditions as regards security.
+
+The fact that you are presently reading this means that you have had
+knowledge of the CeCILL-B license and that you accept its terms.
+*/
+
+#include <cmath>
+#include <iostream>
+
+#include <inverse.h>
+#include <test_utils.hpp>
+
+using namespace OpenMEEG;
+
+// Largest |A(i,j)-B(i,j)| relative to the largest |B(i,j)|.
+
+double max_difference(const Matrix& A,const Matrix& B) {
+    double diff = 0.0;
+    double norm = 0.0;
+    for (size_t i=0; i<A.nlin(); ++i)
+        for (size_t j=0; j<A.ncol(); ++j) {
+            diff = std::max(diff,std::abs(A(i,j)-B(i,j)));
+            norm = std::max(norm,std::abs(B(i,j)));
+        }
+    return diff/norm;
+}
+
+Matrix gain(const size_t m,const size_t n) {
+    Matrix G(m,n);
+    for (size_t i=0; i<m; ++i)
+        for (size_t j=0; j<n; ++j)
+            G(i,j) = sin(1.0+1.3*i+0.7*j*j)+((i==j%m) ? 1.0 : 0.0);
+    return G;
+}
+
+int main() {
+
+    bool ok = true;
+
+    // Overdetermined problem and tiny regularization: K*G = I.
+
+    const Matrix& G1 = gain(30,12);
+    const MinimumNormOperator K1(G1,1e-12);
+    Matrix I(12,12);
+    I.set(0.0);
+    for (size_t i=0; i<12; ++i)
+        I(i,i) = 1.0;
+    ok = check(max_difference(K1*G1,I)<1e-8,"MNE (pseudo inverse)") && ok;
+
+    // Underdetermined problem with a noise covariance: K = Gw'*(Gw*Gw'+l2*I)^{-1}*W for Gw = W*G,
+    // i.e. K = G'*(G*G'+l2*C)^{-1} since W'*W = C^{-1}.
+
+    const size_t m = 20;
+    const size_t n = 60;
+    const Matrix& G = gain(m,n);
+    SymMatrix C(m);
+    for (size_t i=0; i<m; ++i)
+        for (size_t j=i; j<m; ++j)
+            C(i,j) = ((i==j) ? 1.0 : 0.0)+0.5*pow(0.5,j-i); // positive definite
+
+    const double lambda2 = 1.0/9;
+    const MinimumNormOperator K(G,C,lambda2);
+
+    const Matrix& Cf = Matrix(C);
+    double trace = 0.0; // trace(Gw*Gw') = trace(G'*C^{-1}*G)
+    {
+        Matrix X(G,DEEP_COPY);
+        factorize(C).solve(X);
+        for (size_t j=0; j<n; ++j)
+            for (size_t i=0; i<m; ++i)
+                trace += G(i,j)*X(i,j);
+    }
+    const double l2 = lambda2*trace/m;
+    Matrix A = G*G.transpose()+Cf*l2;
+    const Matrix& Kref = G.transpose()*A.inverse();
+    ok = check(max_difference(K,Kref)<1e-10,"MNE with noise covariance") && ok;
+
+    // dSPM: unit noise variance for each source (pooled over 3 components for free orientations).
+
+    for (const unsigned components : { 1U, 3U }) {
+        const MinimumNormOperator D(G,C,lambda2,MinimumNormOperator::dSPM,components);
+        const Matrix& N = D*Cf*D.transpose();
+        double err = 0.0;
+        for (size_t l=0; l<n/components; ++l) {
+            double v = 0.0;
+            for (size_t c=0; c<components; ++c)
+                v += N(components*l+c,components*l+c);
+            err = std::max(err,std::abs(v-1.0));
+        }
+        ok = check(err<1e-10,"dSPM") && ok;
+    }
+
+    // sLORETA: MNE lines divided by the square roots of the diagonal of the resolution matrix K*G.
+
+    const MinimumNormOperator S(G,C,lambda2,MinimumNormOperator::sLORETA);
+    const Matrix& R = K*G;
+    Matrix Sref(K,DEEP_COPY);
+    for (size_t i=0; i<n; ++i)
+        for (size_t j=0; j<m; ++j)
+            Sref(i,j) /= std::sqrt(R(i,i));
+    ok = check(max_difference(S,Sref)<1e-10,"sLORETA") && ok;
+
+    // LCMV: unit gain (identity diagonal blocks of K*G).
+
+    for (const unsigned components : { 1U, 3U }) {
+        const Matrix& Gl = gain(m,3*components);
+        const LCMVOperator B(Gl,C,0.05,components);
+        const Matrix& BG = B*Gl;
+        double err = 0.0;
+        for (size_t l=0; l<3; ++l)
+            for (size_t a=0; a<components; ++a)
+                for (size_t b=0; b<components; ++b)
+                    err = std::max(err,std::abs(BG(components*l+a,components*l+b)-((a==b) ? 1.0 : 0.0)));
+        ok = check(err<1e-10,"LCMV") && ok;
+    }
+
+    // Application by chunks of time samples, in memory and streamed.
+
+    Matrix data(m,1000);
+    for (size_t i=0; i<m; ++i)
+        for (size_t j=0; j<data.ncol(); ++j)
+            data(i,j) = sin(0.01*j*(i+1));
+    const Matrix& estimates = K*data;
+    ok = check(max_difference(K.apply(data,64),estimates)<1e-12,"InverseOperator::apply") && ok;
+
+    data.save("inverse_data.bin");
+    K.apply("inverse_data.bin","inverse_estimates.bin",64);
+    ok = check(max_difference(Matrix("inverse_estimates.bin"),estimates)<1e-12,"InverseOperator::apply (files)") && ok;
+
+    return (ok) ? 0 : 1;
+}
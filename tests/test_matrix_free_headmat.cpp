@@ -0,0 +1,85 @@
+/*
+Project Name : OpenMEEG
+
+© INRIA and ENPC (contributors: Geoffray ADDE, Maureen CLERC, Alexandre 
+GRAMFORT, Renaud KERIVEN, Jan KYBIC, Perrine LANDREAU, Théodore PAPADOPOULO,
+Emmanuel OLIVI
+Maureen.Clerc.AT.inria.fr, keriven.AT.certis.enpc.fr,
+kybic.AT.fel.cvut.cz, papadop.AT.inria.fr)
+
+The OpenMEEG software is a C++ package for solving the forward/inverse
+problems of electroencephalography and magnetoencephalography.
+
+This software is governed by the CeCILL-B license under French law and
+abiding by the rules of distribution of free software.  You can  use,
+modify and/ or redistribute the software under the terms of the CeCILL-B
+license as circulated by CEA, CNRS and INRIA at the following URL
+"http://www.cecill.info".
+
+As a counterpart to the access to the source code and  rights to copy,
+modify and redistribute granted by the license, users are provided only
+with a limited warranty  and the software's authors,  the holders of the
+economic rights,  and the successive licensors  have only  limited
+liability.
+
+In this respect, the user's attention is drawn to the risks associated
+with loading,  using,  modifying and/or developing or reproducing the
+software by the user in light of its specific status of free software,
+that may mean  that it is complicated to manipulate,  and  that  also
+therefore means  that it is reserved for developers  and  experienced
+professionals having in-depth computer knowledge. Users are therefore
+encouraged to load and test the software's suitability as regards their
+requirements in conditions enabling the security of their systems and/or
+data to be ensured and,  more generally, to use and operate it in the
+same conditions as regards security.
+
+The fact that you are presently reading this means that you have had
+knowledge of the CeCILL-B license and that you accept its terms.
+*/
+
+#include <random>
+#include <iostream>
+
+#include <assemble.h>
+#include <matrix_free_headmat.h>
+#include <test_utils.hpp>
+
+using namespace OpenMEEG;
+
+int main(int argc,char** argv) {
+
+    if (argc!=3) {
+        std::cerr << "Wrong nb of parameters" << std::endl;
+        return 1;
+    }
+
+    const Geometry geo(argv[1],argv[2]);
+    const Matrix   H = Matrix(HeadMat(geo));
+
+    std::mt19937 gen(1);
+    std::uniform_real_distribution<> unit(-1.0,1.0);
+    Matrix X(H.ncol(),3);
+    for (unsigned j=0; j<X.ncol(); ++j)
+        for (unsigned i=0; i<X.nlin(); ++i)
+            X(i,j) = unit(gen);
+    const Matrix& HX = H*X;
+
+    //  The products are those of the assembled head matrix, whatever the near field threshold: with the smallest
+    //  one, only the adjacent triangles are cached; with the largest one, all the triangle pairs are.
+
+    bool   ok   = true;
+    size_t near = 0;
+    for (const double near_field : { 1.0,2.0,1000.0 }) {
+        const MatrixFreeHeadMat Hmf(geo,3,near_field);
+        const std::string what = "MatrixFreeHeadMat (near field "+std::to_string(near_field)+")";
+        std::cout << what << ": " << Hmf.near_field_size() << " near field interactions, relative difference "
+                  << difference(Hmf*X,HX) << std::endl;
+        ok = check(Hmf.nlin()==H.nlin() && Hmf.ncol()==H.ncol(),what+" dimensions") && ok;
+        ok = check(difference(Hmf*X,HX)<1e-10,what+" product") && ok;
+        ok = check((Hmf*X.getcol(0)-HX.getcol(0)).norm()<1e-10*HX.getcol(0).norm(),what+" vector product") && ok;
+        ok = check(Hmf.size()==Hmf.near_field_size() && Hmf.near_field_size()>near,what+" near field") && ok;
+        near = Hmf.near_field_size();
+    }
+
+    return (ok) ? 0 : 1;
+}
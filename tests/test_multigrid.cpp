@@ -0,0 +1,145 @@
+/*
+Project Name : OpenMEEG
+
+© INRIA and ENPC (contributors: Geoffray ADDE, Maureen CLERC, Alexandre 
+GRAMFORT, Renaud KERIVEN, Jan KYBIC, Perrine LANDREAU, Théodore PAPADOPOULO,
+Emmanuel OLIVI
+Maureen.Clerc.AT.inria.fr, keriven.AT.certis.enpc.fr,
+kybic.AT.fel.cvut.cz, papadop.AT.inria.fr)
+
+The OpenMEEG software is a C++ package for solving the forward/inverse
+problems of electroencephalography and magnetoencephalography.
+
+This software is governed by the CeCILL-B license under French law and
+abiding by the rules of distribution of free software.  You can  use,
+modify and/ or redistribute the software under the terms of the CeCILL-B
+license as circulated by CEA, CNRS and INRIA at the following URL
+"http://www.cecill.info".
+
+As a counterpart to the access to the source code and  rights to copy,
+modify and redistribute granted by the license, users are provided only
+with a limited warranty  and the software's authors,  the holders of the
+economic rights,  and the successive licensors  have only  limited
+liability.
+
+In this respect, the user's attention is drawn to the risks associated
+with loading,  using,  modifying and/or developing or reproducing the
+software by the user in light of its specific status of free software,
+that may mean  that it is complicated to manipulate,  and  that  also
+therefore means  that it is reserved for developers  and  experienced
+professionals having in-depth computer knowledge. Users are therefore
+encouraged to load and test the software's suitability as regards their
+requirements in conditions enabling the security of their systems and/or
+data to be ensured and,  more generally, to use and operate it in the
+same conditions as regards security.
+
+The fact that you are presently reading this means that you have had
+knowledge of the CeCILL-B license and that you accept its terms.
+*/
+
+#include <random>
+#include <iostream>
+
+#include <assemble.h>
+#include <gain.h>
+#include <test_utils.hpp>
+
+using namespace OpenMEEG;
+
+//  Count the applications of a preconditioner (one per GMRes iteration, plus one per restart).
+
+template <typename Preconditioner>
+class Counted {
+public:
+
+    Counted(const Preconditioner& p): M(p) { }
+
+    Vector operator()(const Vector& r) const {
+        ++count;
+        return M(r);
+    }
+
+    mutable unsigned count = 0;
+
+private:
+
+    const Preconditioner& M;
+};
+
+//  Number of preconditioner applications of GMRes for H*x=b, 0 if GMRes does not converge.
+
+template <typename HeadMatrix,typename Preconditioner>
+unsigned iterations(const HeadMatrix& H,const Preconditioner& M,const Vector& b) {
+    const Counted<Preconditioner> counted(M);
+    Vector x(b.nlin());
+    if (GMRes(H,counted,x,b,1000,1e-9,100)!=0 || (H*x-b).norm()>1e-8*b.norm())
+        return 0;
+    return counted.count;
+}
+
+Vector random_vector(const unsigned n) {
+    std::mt19937 gen(1);
+    std::uniform_real_distribution<> unit(-1.0,1.0);
+    Vector b(n);
+    for (unsigned i=0; i<n; ++i)
+        b(i) = unit(gen);
+    return b;
+}
+
+int main(int argc,char** argv) {
+
+    //  Successive refinements of the same head model (geometry and conductivity files).
+
+    if (argc<7 || argc%2==0) {
+        std::cerr << "Wrong nb of parameters" << std::endl;
+        return 1;
+    }
+
+    bool ok = true;
+
+    //  Galerkin projection of the matrix-free head matrix versus P'*H*P with the assembled head matrix
+    //  (on the coarsest model), for a sparse P with a few non-zeros per line.
+
+    const Geometry geo(argv[1],argv[2]);
+    const MatrixFreeHeadMat Hmf(geo);
+    const SymMatrix H = HeadMat(geo);
+    const unsigned n = H.nlin();
+    {
+        SparseMatrix P(n,n/3);
+        for (unsigned i=0; i<n; ++i) {
+            P(i,i%(n/3))     = 1.0+0.01*i;
+            P(i,(7*i)%(n/3)) = 0.5;
+        }
+        const Matrix& Pd = Matrix(P);
+        const Matrix& reference = Pd.transpose()*(H*Pd);
+        ok = check(difference(Matrix(Hmf.galerkin(P)),reference)<1e-12,"the Galerkin projection of the matrix-free head matrix") && ok;
+    }
+
+    //  The matrix-free and assembled versions of the two-level preconditioner are the same.
+
+    const Vector& b = random_vector(n);
+    const unsigned mf_iterations = iterations(Hmf,TwoLevelPreconditioner(Hmf),b);
+    const unsigned iterations0   = iterations(H,TwoLevelPreconditioner(geo,H),b);
+    std::cout << "Matrix-free two-level: " << mf_iterations << " iterations" << std::endl;
+    ok = check(mf_iterations!=0 && mf_iterations<=iterations0+1 && iterations0<=mf_iterations+1,"GMRes with the matrix-free two-level preconditioner") && ok;
+
+    //  Iterations of GMRes (with the assembled head matrices) for the successive refinements: the Jacobi
+    //  iterations grow with the number of unknowns, the two-level ones do not.
+
+    unsigned max_iterations = iterations0;
+    for (int i=1; i<argc; i+=2) {
+        const Geometry   g(argv[i],argv[i+1]);
+        const SymMatrix& Hg = (i==1) ? H : SymMatrix(HeadMat(g));
+        const Vector&    bg = random_vector(Hg.nlin());
+
+        const unsigned jacobi    = iterations(Hg,Jacobi<SymMatrix>(Hg),bg);
+        const unsigned two_level = iterations(Hg,TwoLevelPreconditioner(g,Hg),bg);
+        std::cout << Hg.nlin() << " unknowns: Jacobi " << jacobi << " iterations, two-level " << two_level << " iterations" << std::endl;
+
+        ok = check(jacobi!=0 && two_level!=0 && two_level<jacobi,"GMRes with the two-level preconditioner") && ok;
+        max_iterations = std::max(max_iterations,two_level);
+    }
+    ok = check(max_iterations<=1.25*iterations0,"the flat iteration count of the two-level preconditioner") && ok;
+
+    return (ok) ? 0 : 1;
+}
@@ -39,6 +39,7 @@
     #include <assemble.h>
     #include <gain.h>
     #include <forward.h>
+    #include <forward_evaluator.h>
     #include <iostream>
 
     #ifdef SWIGPYTHON
@@ -491,6 +492,10 @@ namespace OpenMEEG {
 
 %ignore OpenMEEG::Mesh::name(); // ignore non const name() method
 
+%ignore OpenMEEG::ForwardEvaluator::evaluate(const Vect3&,const Vect3&,double*);
+%ignore OpenMEEG::ForwardEvaluator::evaluate(const Vect3&,const Vect3&,double*,double*);
+%rename(__call__) OpenMEEG::ForwardEvaluator::operator();
+
 %extend OpenMEEG::Mesh {
 
     void add_triangles(PyObject* pyobj,const IndexMap& indmap) {
@@ -572,5 +577,6 @@ namespace OpenMEEG {
 %include <assemble.h>
 %include <gain.h>
 %include <forward.h>
+%include <forward_evaluator.h>
 
 %pythoncode "make_geometry.py"